@@ -0,0 +1,221 @@
+/*
+ * gitg-bench.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Micro benchmarks for gitg internals. Not installed, build with
+   'make gitg-bench'. Run as:
+
+   git log --pretty=format:%H%x01%an%x01%s%x01%P%x01%at > log.txt
+   ./gitg-bench utf8 log.txt
+   ./gitg-bench hash [entries]
+*/
+
+#include <glib.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gitg-utils.h"
+#include "gitg-hash-index.h"
+
+#define BENCH_CHUNK_SIZE 10000
+#define BENCH_ITERATIONS 10
+#define BENCH_HASH_ENTRIES 1000000
+
+typedef gsize (*BenchFunc)(gchar *chunk, gsize size);
+
+/* The old runner path: every line validated and copied on its own */
+static gsize
+utf8_per_line(gchar *chunk, gsize size)
+{
+	gchar *ptr = chunk;
+	gchar *end = chunk + size;
+	gchar *newline;
+	gsize num = 0;
+
+	while ((newline = memchr(ptr, '\n', end - ptr)))
+	{
+		g_free(gitg_utils_convert_utf8(ptr, newline - ptr));
+
+		ptr = newline + 1;
+		++num;
+	}
+
+	return num;
+}
+
+/* The new runner path: the chunk is validated once, lines are only
+   converted when that fails */
+static gsize
+utf8_per_chunk(gchar *chunk, gsize size)
+{
+	gchar *ptr = chunk;
+	gchar *end = chunk + size;
+	gchar *newline;
+	gsize num = 0;
+	gboolean valid = gitg_utils_validate_utf8(chunk, size);
+
+	while ((newline = memchr(ptr, '\n', end - ptr)))
+	{
+		if (!valid && !g_utf8_validate(ptr, newline - ptr, NULL))
+			g_free(gitg_utils_convert_utf8(ptr, newline - ptr));
+
+		ptr = newline + 1;
+		++num;
+	}
+
+	return num;
+}
+
+static void
+run_utf8(gchar const *name, BenchFunc func, gchar *contents, gsize length)
+{
+	GTimer *timer = g_timer_new();
+	gsize lines = 0;
+	gint i;
+
+	for (i = 0; i < BENCH_ITERATIONS; ++i)
+	{
+		gsize offset;
+
+		for (offset = 0; offset < length; offset += BENCH_CHUNK_SIZE)
+			lines += func(contents + offset, MIN(BENCH_CHUNK_SIZE, length - offset));
+	}
+
+	gdouble elapsed = g_timer_elapsed(timer, NULL);
+	gdouble mb = (gdouble)length * BENCH_ITERATIONS / (1024 * 1024);
+
+	g_print("%-10s %10.2f MB/s (%lu lines in %.3fs)\n", name, mb / elapsed, (gulong)lines, elapsed);
+	g_timer_destroy(timer);
+}
+
+static gint
+bench_utf8(gchar const *filename)
+{
+	gchar *contents;
+	gsize length;
+	GError *error = NULL;
+
+	if (!g_file_get_contents(filename, &contents, &length, &error))
+	{
+		g_printerr("Could not read %s: %s\n", filename, error->message);
+		g_error_free(error);
+
+		return 1;
+	}
+
+	g_print("UTF-8 validation of %s (%lu bytes, %d byte chunks)\n", filename, (gulong)length, BENCH_CHUNK_SIZE);
+
+	run_utf8("per line", utf8_per_line, contents, length);
+	run_utf8("per chunk", utf8_per_chunk, contents, length);
+
+	g_free(contents);
+	return 0;
+}
+
+static void
+report_hash(gchar const *name, gchar const *what, GTimer *timer, guint num)
+{
+	gdouble elapsed = g_timer_elapsed(timer, NULL);
+
+	g_print("%-10s %-8s %8.1f ns/op (%.3fs)\n", name, what, elapsed * 1e9 / num, elapsed);
+	g_timer_start(timer);
+}
+
+/* Row index lookups as done by the repository: insert all, then look up
+   every hash once and as many hashes which are not there */
+static gint
+bench_hash(guint num)
+{
+	Hash *hashes = g_new(Hash, num * 2);
+	GRand *rand = g_rand_new_with_seed(42);
+	GTimer *timer = g_timer_new();
+	guint found;
+	guint i;
+
+	for (i = 0; i < num * 2 * HASH_BINARY_SIZE; ++i)
+		((gchar *)hashes)[i] = (gchar)g_rand_int(rand);
+
+	g_print("Hash index with %u entries\n", num);
+
+	GHashTable *table = g_hash_table_new(gitg_utils_hash_hash, gitg_utils_hash_equal);
+	g_timer_start(timer);
+
+	for (i = 0; i < num; ++i)
+		g_hash_table_insert(table, hashes[i], GUINT_TO_POINTER(i + 1));
+
+	report_hash("GHashTable", "insert", timer, num);
+
+	for (i = 0, found = 0; i < num * 2; ++i)
+		found += g_hash_table_lookup(table, hashes[i]) != NULL;
+
+	report_hash("GHashTable", "lookup", timer, num * 2);
+	g_hash_table_destroy(table);
+
+	g_assert(found == num);
+
+	GitgHashIndex *index = gitg_hash_index_new(NULL);
+	g_timer_start(timer);
+
+	for (i = 0; i < num; ++i)
+		gitg_hash_index_insert(index, hashes[i], GUINT_TO_POINTER(i));
+
+	report_hash("index", "insert", timer, num);
+
+	for (i = 0, found = 0; i < num * 2; ++i)
+		found += gitg_hash_index_lookup_extended(index, hashes[i], NULL);
+
+	report_hash("index", "lookup", timer, num * 2);
+	gitg_hash_index_free(index);
+
+	g_assert(found == num);
+
+	g_timer_destroy(timer);
+	g_rand_free(rand);
+	g_free(hashes);
+
+	return 0;
+}
+
+static void
+usage(gchar const *prgname)
+{
+	g_printerr("Usage: %s utf8 <git log capture>\n", prgname);
+	g_printerr("       %s hash [entries]\n", prgname);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "utf8") == 0 && argc > 2)
+		return bench_utf8(argv[2]);
+
+	if (strcmp(argv[1], "hash") == 0)
+		return bench_hash(argc > 2 ? (guint)atoi(argv[2]) : BENCH_HASH_ENTRIES);
+
+	usage(argv[0]);
+	return 1;
+}
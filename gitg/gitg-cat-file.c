@@ -0,0 +1,431 @@
+/*
+ * gitg-cat-file.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-cat-file.h"
+#include "gitg-utils.h"
+#include "gitg-types.h"
+#include "gitg-debug.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define GITG_CAT_FILE_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_CAT_FILE, GitgCatFilePrivate))
+
+#define READ_SIZE 4096
+
+/* Properties */
+enum
+{
+	PROP_0,
+
+	PROP_PATH,
+	PROP_CONTENTS
+};
+
+struct _GitgCatFilePrivate
+{
+	gchar *path;
+	gboolean contents;
+
+	GPid pid;
+	gint stdin_fd;
+	gint stdout_fd;
+
+	GString *buffer;
+	gsize offset;
+
+	GMutex *lock;
+};
+
+G_DEFINE_TYPE(GitgCatFile, gitg_cat_file, G_TYPE_OBJECT)
+
+static void
+cat_file_shutdown(GitgCatFile *cat_file)
+{
+	if (!cat_file->priv->pid)
+		return;
+
+	/* Closing stdin makes git exit after it answered pending requests */
+	close(cat_file->priv->stdin_fd);
+	close(cat_file->priv->stdout_fd);
+
+	waitpid(cat_file->priv->pid, NULL, 0);
+	g_spawn_close_pid(cat_file->priv->pid);
+
+	cat_file->priv->pid = 0;
+
+	g_string_truncate(cat_file->priv->buffer, 0);
+	cat_file->priv->offset = 0;
+}
+
+static gboolean
+cat_file_spawn(GitgCatFile *cat_file)
+{
+	gchar const *argv[] = {
+		"git",
+		"cat-file",
+		cat_file->priv->contents ? "--batch" : "--batch-check",
+		NULL
+	};
+
+	GError *error = NULL;
+
+	gboolean ret = g_spawn_async_with_pipes(cat_file->priv->path,
+	                                        (gchar **)argv,
+	                                        NULL,
+	                                        G_SPAWN_SEARCH_PATH |
+	                                        G_SPAWN_DO_NOT_REAP_CHILD |
+	                                        (gitg_debug_enabled(GITG_DEBUG_RUNNER) ? 0 : G_SPAWN_STDERR_TO_DEV_NULL),
+	                                        NULL,
+	                                        NULL,
+	                                        &(cat_file->priv->pid),
+	                                        &(cat_file->priv->stdin_fd),
+	                                        &(cat_file->priv->stdout_fd),
+	                                        NULL,
+	                                        &error);
+
+	if (!ret)
+	{
+		g_warning("Could not start git cat-file: %s", error->message);
+		g_error_free(error);
+
+		cat_file->priv->pid = 0;
+	}
+
+	return ret;
+}
+
+static gboolean
+write_all(gint fd, gchar const *data, gsize size)
+{
+	while (size > 0)
+	{
+		gssize num = write(fd, data, size);
+
+		if (num < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return FALSE;
+		}
+
+		data += num;
+		size -= num;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+fill_buffer(GitgCatFile *cat_file)
+{
+	GString *buffer = cat_file->priv->buffer;
+	gsize len = buffer->len;
+	gssize num;
+
+	g_string_set_size(buffer, len + READ_SIZE);
+
+	do
+	{
+		num = read(cat_file->priv->stdout_fd, buffer->str + len, READ_SIZE);
+	} while (num < 0 && errno == EINTR);
+
+	g_string_truncate(buffer, len + MAX(num, 0));
+	return num > 0;
+}
+
+static gchar *
+read_line(GitgCatFile *cat_file)
+{
+	GString *buffer = cat_file->priv->buffer;
+
+	while (TRUE)
+	{
+		gchar *start = buffer->str + cat_file->priv->offset;
+		gchar *newline = memchr(start, '\n', buffer->len - cat_file->priv->offset);
+
+		if (newline)
+		{
+			cat_file->priv->offset += newline - start + 1;
+			return g_strndup(start, newline - start);
+		}
+
+		if (!fill_buffer(cat_file))
+			return NULL;
+	}
+}
+
+static gchar *
+read_contents(GitgCatFile *cat_file, gsize size)
+{
+	GString *buffer = cat_file->priv->buffer;
+	gchar *ret;
+
+	/* Contents are followed by a LF */
+	while (buffer->len - cat_file->priv->offset < size + 1)
+	{
+		if (!fill_buffer(cat_file))
+			return NULL;
+	}
+
+	ret = g_malloc(size + 1);
+	memcpy(ret, buffer->str + cat_file->priv->offset, size);
+	ret[size] = '\0';
+
+	cat_file->priv->offset += size + 1;
+	return ret;
+}
+
+/* Parses '<sha> <type> <size>'. Anything else (e.g. '<name> missing') means
+   the object could not be found */
+static gboolean
+parse_header(gchar *header, gchar **sha, gchar **type, gsize *size)
+{
+	gchar *parts[3];
+	gchar *end;
+
+	if (gitg_utils_split_inplace(header, " ", parts, 3) != 3 ||
+	    strlen(parts[0]) != HASH_SHA_SIZE || strchr(parts[2], ' '))
+		return FALSE;
+
+	*size = strtoul(parts[2], &end, 10);
+
+	if (*parts[2] == '\0' || *end != '\0')
+		return FALSE;
+
+	*sha = parts[0];
+	*type = parts[1];
+
+	return TRUE;
+}
+
+static gchar *
+cat_file_request(GitgCatFile *cat_file, gchar const *name, gchar **type, gsize *size, gchar **contents)
+{
+	gchar *header = NULL;
+	gchar *request;
+	gchar *sha = NULL;
+	gchar *tp;
+	gsize sz;
+	gint attempt;
+
+	/* The name is sent as a single line */
+	if (strchr(name, '\n'))
+		return NULL;
+
+	request = g_strconcat(name, "\n", NULL);
+
+	g_mutex_lock(cat_file->priv->lock);
+
+	/* Restart the process once if it died, or was never started */
+	for (attempt = 0; attempt < 2 && !header; ++attempt)
+	{
+		if (!cat_file->priv->pid && !cat_file_spawn(cat_file))
+			break;
+
+		if (write_all(cat_file->priv->stdin_fd, request, strlen(request)))
+			header = read_line(cat_file);
+
+		if (!header)
+			cat_file_shutdown(cat_file);
+	}
+
+	g_free(request);
+
+	if (header && parse_header(header, &sha, &tp, &sz))
+	{
+		gchar *data = NULL;
+
+		if (cat_file->priv->contents && !(data = read_contents(cat_file, sz)))
+		{
+			/* The process died halfway, its state is unknown */
+			cat_file_shutdown(cat_file);
+			sha = NULL;
+		}
+		else
+		{
+			sha = g_strdup(sha);
+
+			if (type)
+				*type = g_strdup(tp);
+
+			if (size)
+				*size = sz;
+
+			if (contents)
+				*contents = data;
+			else
+				g_free(data);
+		}
+	}
+	else
+	{
+		sha = NULL;
+	}
+
+	/* Discard what was consumed by this request */
+	g_string_erase(cat_file->priv->buffer, 0, cat_file->priv->offset);
+	cat_file->priv->offset = 0;
+
+	g_mutex_unlock(cat_file->priv->lock);
+
+	g_free(header);
+	return sha;
+}
+
+static void
+gitg_cat_file_finalize(GObject *object)
+{
+	GitgCatFile *cat_file = GITG_CAT_FILE(object);
+
+	cat_file_shutdown(cat_file);
+
+	g_free(cat_file->priv->path);
+	g_string_free(cat_file->priv->buffer, TRUE);
+	g_mutex_free(cat_file->priv->lock);
+
+	G_OBJECT_CLASS(gitg_cat_file_parent_class)->finalize(object);
+}
+
+static void
+gitg_cat_file_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GitgCatFile *self = GITG_CAT_FILE(object);
+
+	switch (prop_id)
+	{
+		case PROP_PATH:
+			g_free(self->priv->path);
+			self->priv->path = g_value_dup_string(value);
+		break;
+		case PROP_CONTENTS:
+			self->priv->contents = g_value_get_boolean(value);
+		break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gitg_cat_file_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GitgCatFile *self = GITG_CAT_FILE(object);
+
+	switch (prop_id)
+	{
+		case PROP_PATH:
+			g_value_set_string(value, self->priv->path);
+		break;
+		case PROP_CONTENTS:
+			g_value_set_boolean(value, self->priv->contents);
+		break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gitg_cat_file_class_init(GitgCatFileClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	object_class->finalize = gitg_cat_file_finalize;
+	object_class->set_property = gitg_cat_file_set_property;
+	object_class->get_property = gitg_cat_file_get_property;
+
+	g_object_class_install_property(object_class, PROP_PATH,
+					 g_param_spec_string("path",
+							      "PATH",
+							      "The repository path",
+							      NULL,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property(object_class, PROP_CONTENTS,
+					 g_param_spec_boolean("contents",
+							      "CONTENTS",
+							      "Whether object contents are read (--batch) or only checked (--batch-check)",
+							      FALSE,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_type_class_add_private(object_class, sizeof(GitgCatFilePrivate));
+}
+
+static void
+gitg_cat_file_init(GitgCatFile *self)
+{
+	self->priv = GITG_CAT_FILE_GET_PRIVATE(self);
+
+	self->priv->buffer = g_string_sized_new(READ_SIZE);
+	self->priv->lock = g_mutex_new();
+}
+
+GitgCatFile *
+gitg_cat_file_new(gchar const *path, gboolean contents)
+{
+	return GITG_CAT_FILE(g_object_new(GITG_TYPE_CAT_FILE, "path", path, "contents", contents, NULL));
+}
+
+/* Returns the sha of the object name resolves to, or NULL if it could not be
+   found. type and size may be NULL */
+gchar *
+gitg_cat_file_check(GitgCatFile *cat_file, gchar const *name, gchar **type, gsize *size)
+{
+	g_return_val_if_fail(GITG_IS_CAT_FILE(cat_file), NULL);
+	g_return_val_if_fail(name != NULL, NULL);
+
+	return cat_file_request(cat_file, name, type, size, NULL);
+}
+
+/* Returns the contents of the object name resolves to (NUL terminated, size
+   bytes long), or NULL if it could not be found. Only valid on a contents
+   cat file */
+gchar *
+gitg_cat_file_contents(GitgCatFile *cat_file, gchar const *name, gchar **type, gsize *size)
+{
+	g_return_val_if_fail(GITG_IS_CAT_FILE(cat_file), NULL);
+	g_return_val_if_fail(cat_file->priv->contents, NULL);
+	g_return_val_if_fail(name != NULL, NULL);
+
+	gchar *contents = NULL;
+	gchar *sha = cat_file_request(cat_file, name, type, size, &contents);
+
+	g_free(sha);
+	return contents;
+}
+
+/* Stops the running process, it is started again on the next request */
+void
+gitg_cat_file_close(GitgCatFile *cat_file)
+{
+	g_return_if_fail(GITG_IS_CAT_FILE(cat_file));
+
+	g_mutex_lock(cat_file->priv->lock);
+	cat_file_shutdown(cat_file);
+	g_mutex_unlock(cat_file->priv->lock);
+}
@@ -0,0 +1,69 @@
+/*
+ * gitg-cat-file.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_CAT_FILE_H__
+#define __GITG_CAT_FILE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GITG_TYPE_CAT_FILE				(gitg_cat_file_get_type ())
+#define GITG_CAT_FILE(obj)				(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_CAT_FILE, GitgCatFile))
+#define GITG_CAT_FILE_CONST(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_CAT_FILE, GitgCatFile const))
+#define GITG_CAT_FILE_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GITG_TYPE_CAT_FILE, GitgCatFileClass))
+#define GITG_IS_CAT_FILE(obj)			(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GITG_TYPE_CAT_FILE))
+#define GITG_IS_CAT_FILE_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GITG_TYPE_CAT_FILE))
+#define GITG_CAT_FILE_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GITG_TYPE_CAT_FILE, GitgCatFileClass))
+
+typedef struct _GitgCatFile			GitgCatFile;
+typedef struct _GitgCatFileClass	GitgCatFileClass;
+typedef struct _GitgCatFilePrivate	GitgCatFilePrivate;
+
+/* A long running 'git cat-file --batch' (or --batch-check) process. Requests
+   are written to the process and answered synchronously, so repeated object
+   lookups do not pay for a fork/exec each. The process is restarted when it
+   dies, and drained when the object is finalized */
+struct _GitgCatFile
+{
+	GObject parent;
+
+	GitgCatFilePrivate *priv;
+};
+
+struct _GitgCatFileClass
+{
+	GObjectClass parent_class;
+};
+
+GType gitg_cat_file_get_type (void) G_GNUC_CONST;
+
+GitgCatFile *gitg_cat_file_new(gchar const *path, gboolean contents);
+
+gchar *gitg_cat_file_check(GitgCatFile *cat_file, gchar const *name, gchar **type, gsize *size);
+gchar *gitg_cat_file_contents(GitgCatFile *cat_file, gchar const *name, gchar **type, gsize *size);
+
+void gitg_cat_file_close(GitgCatFile *cat_file);
+
+G_END_DECLS
+
+#endif /* __GITG_CAT_FILE_H__ */
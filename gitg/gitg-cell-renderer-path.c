@@ -51,6 +51,7 @@ struct _GitgCellRendererPathPrivate
 	GitgRevision *revision;
 	GitgRevision *next_revision;
 	GSList *labels;
+	GitgDecoration *decoration;
 	guint lane_width;
 	guint triangle_width;
 	guint dot_width;
@@ -65,7 +66,7 @@ G_DEFINE_TYPE(GitgCellRendererPath, gitg_cell_renderer_path, GTK_TYPE_CELL_RENDE
 static gint
 num_lanes(GitgCellRendererPath *self)
 {
-	return g_slist_length (gitg_revision_get_lanes(self->priv->revision));
+	return gitg_lane_row_length(gitg_revision_get_lanes(self->priv->revision));
 }
 
 static gboolean
@@ -82,19 +83,54 @@ is_dummy(GitgRevision *revision)
 	}
 }
 
+/* The labels of the row, from its decoration when set with set_row */
+static GSList *
+get_labels(GitgCellRendererPath *self)
+{
+	if (self->priv->decoration)
+		return self->priv->decoration->refs;
+	
+	return self->priv->labels;
+}
+
+/* The font of the text renderer itself, the font-desc property is a copy */
+static PangoFontDescription *
+get_font(GitgCellRendererPath *self)
+{
+	return GTK_CELL_RENDERER_TEXT(self)->font;
+}
+
 static gint
-total_width(GitgCellRendererPath *self, GtkWidget *widget)
+labels_width(GitgCellRendererPath *self, GtkWidget *widget)
 {
-	PangoFontDescription *font;
-	g_object_get(self, "font-desc", &font, NULL);
+	GitgDecoration *decoration = self->priv->decoration;
+	PangoFontDescription *font = get_font(self);
+	guint font_hash;
 	
+	if (!decoration)
+		return gitg_label_renderer_width(widget, font, self->priv->labels);
+	
+	font_hash = pango_font_description_hash(font);
+	
+	if (decoration->width < 0 || decoration->font_hash != font_hash)
+	{
+		decoration->width = gitg_label_renderer_width(widget, font, decoration->refs);
+		decoration->font_hash = font_hash;
+	}
+	
+	return decoration->width;
+}
+
+static gint
+total_width(GitgCellRendererPath *self, GtkWidget *widget)
+{
 	gint offset = 0;
 	
 	if (is_dummy(self->priv->revision))
 		offset = self->priv->lane_width;
 	
 	return num_lanes(self) * self->priv->lane_width + 
-	       gitg_label_renderer_width(widget, font, self->priv->labels) +
+	       labels_width(self, widget) +
 	       offset;
 }
 
@@ -158,22 +194,22 @@ draw_paths_real(GitgCellRendererPath *self, cairo_t *cr, GdkRectangle *area, Git
 	if (!revision)
 		return;
 
-	GSList *lanes = gitg_revision_get_lanes(revision);
-	gint8 to = 0;
+	GitgLaneRow *lanes = gitg_revision_get_lanes(revision);
+	guint to;
 	gdouble cw = self->priv->lane_width;
 	gdouble ch = area->height / 2.0;
-	GitgLane *lane;
 	
-	while (lanes)
+	for (to = 0; to < gitg_lane_row_length(lanes); ++to)
 	{
-		GSList *item;
+		GitgLane *lane = &lanes->lanes[to];
+		gint8 const *merges = gitg_lane_row_get_from(lanes, lane);
+		guint i;
 
-		lane = (GitgLane *)(lanes->data);
 		gitg_color_set_cairo_source(lane->color, cr);
 		
-		for (item = lane->from; item; item = item->next)
+		for (i = 0; i < lane->num_from; ++i)
 		{
-			gint8 from = (gint8)GPOINTER_TO_INT(item->data);
+			gint8 from = merges[i];
 			
 			cairo_move_to(cr, area->x + from * cw + cw / 2.0, area->y + yoffset * ch);
 			cairo_curve_to(cr, area->x + from * cw + cw / 2.0, area->y + (yoffset + 1) * ch,
@@ -182,9 +218,6 @@ draw_paths_real(GitgCellRendererPath *self, cairo_t *cr, GdkRectangle *area, Git
 			
 			cairo_stroke(cr);
 		}
-
-		++to;
-		lanes = lanes->next;
 	}
 }
 
@@ -203,20 +236,22 @@ draw_bottom_paths(GitgCellRendererPath *self, cairo_t *cr, GdkRectangle *area)
 static void
 draw_arrows(GitgCellRendererPath *self, cairo_t *cr, GdkRectangle *area)
 {
-	GSList *item;
-	gint8 to = 0;
+	GitgLaneRow *lanes = gitg_revision_get_lanes(self->priv->revision);
+	guint to;
 	
-	for (item = gitg_revision_get_lanes(self->priv->revision); item; item = item->next)
+	for (to = 0; to < gitg_lane_row_length(lanes); ++to)
 	{
-		GitgLane *lane = (GitgLane *)item->data;
+		GitgLane *lane = &lanes->lanes[to];
+		
+		if (!GITG_IS_LANE_BOUNDARY(lane))
+			continue;
+
 		gitg_color_set_cairo_source(lane->color, cr);
 		
 		if (lane->type & GITG_LANE_TYPE_START)
 			draw_arrow(self, cr, area, to, TRUE);
-		else if (lane->type & GITG_LANE_TYPE_END)
+		else
 			draw_arrow(self, cr, area, to, FALSE);
-		
-		++to;
 	}
 }
 
@@ -236,15 +271,12 @@ static void
 draw_labels(GitgCellRendererPath *self, GtkWidget *widget, cairo_t *context, GdkRectangle *area)
 {
 	gint offset = num_lanes(self) * self->priv->lane_width;
-	PangoFontDescription *font;
 	
 	if (is_dummy(self->priv->revision))
 		offset += self->priv->lane_width;
 	
-	g_object_get(self, "font-desc", &font, NULL);
-	
 	cairo_translate(context, offset, 0.0);
-	gitg_label_renderer_draw(widget, font, context, self->priv->labels, area);
+	gitg_label_renderer_draw(widget, get_font(self), context, get_labels(self), area);
 }
 
 static void
@@ -367,7 +399,7 @@ gitg_cell_renderer_path_get_property(GObject *object, guint prop_id, GValue *val
 			g_value_set_uint(value, self->priv->triangle_width);
 		break;
 		case PROP_LABELS:
-			g_value_set_pointer(value, self->priv->labels);
+			g_value_set_pointer(value, get_labels(self));
 		break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -402,6 +434,7 @@ gitg_cell_renderer_path_set_property(GObject *object, guint prop_id, const GValu
 		case PROP_LABELS:
 			g_slist_free(self->priv->labels);
 			self->priv->labels = (GSList *)g_value_get_pointer(value);
+			self->priv->decoration = NULL;
 		break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -496,9 +529,6 @@ gitg_cell_renderer_path_get_ref_at_pos (GtkWidget *widget, GitgCellRendererPath
 	g_return_val_if_fail (GTK_IS_WIDGET (widget), NULL);
 	g_return_val_if_fail (GITG_IS_CELL_RENDERER_PATH (renderer), NULL);
 	
-	PangoFontDescription *font;
-	g_object_get (renderer, "font-desc", &font, NULL);
-	
 	gint offset = 0;
 	
 	if (is_dummy(renderer->priv->revision))
@@ -506,7 +536,27 @@ gitg_cell_renderer_path_get_ref_at_pos (GtkWidget *widget, GitgCellRendererPath
 	
 	x -= num_lanes(renderer) * renderer->priv->lane_width + offset;
 
-	return gitg_label_renderer_get_ref_at_pos (widget, font, renderer->priv->labels, x, hot_x);
+	return gitg_label_renderer_get_ref_at_pos (widget, get_font(renderer), get_labels(renderer), x, hot_x);
+}
+
+/* Sets the row to draw without going through properties. The decoration
+   is not copied, it has to stay around while the row is drawn */
+void
+gitg_cell_renderer_path_set_row (GitgCellRendererPath *renderer, GitgRevision *revision, GitgRevision *next_revision, GitgDecoration *decoration)
+{
+	g_return_if_fail (GITG_IS_CELL_RENDERER_PATH (renderer));
+	
+	gitg_revision_ref(revision);
+	gitg_revision_unref(renderer->priv->revision);
+	renderer->priv->revision = revision;
+	
+	gitg_revision_ref(next_revision);
+	gitg_revision_unref(renderer->priv->next_revision);
+	renderer->priv->next_revision = next_revision;
+	
+	g_slist_free(renderer->priv->labels);
+	renderer->priv->labels = NULL;
+	renderer->priv->decoration = decoration;
 }
 
 GdkPixbuf *
@@ -515,8 +565,5 @@ gitg_cell_renderer_path_render_ref (GtkWidget *widget, GitgCellRendererPath *ren
 	g_return_val_if_fail (GTK_IS_WIDGET (widget), NULL);
 	g_return_val_if_fail (GITG_IS_CELL_RENDERER_PATH (renderer), NULL);
 
-	PangoFontDescription *font;
-	g_object_get(renderer, "font-desc", &font, NULL);
-	
-	return gitg_label_renderer_render_ref (widget, font, ref, renderer->priv->last_height, minwidth);
+	return gitg_label_renderer_render_ref (widget, get_font(renderer), ref, renderer->priv->last_height, minwidth);
 }
@@ -25,6 +25,7 @@
 
 #include <gtk/gtkcellrenderertext.h>
 #include "gitg-ref.h"
+#include "gitg-repository.h"
 
 G_BEGIN_DECLS
 
@@ -56,6 +57,8 @@ GtkCellRenderer *gitg_cell_renderer_path_new(void);
 GitgRef *gitg_cell_renderer_path_get_ref_at_pos (GtkWidget *widget, GitgCellRendererPath *renderer, gint x, gint *hot_x);
 GdkPixbuf *gitg_cell_renderer_path_render_ref (GtkWidget *widget, GitgCellRendererPath *renderer, GitgRef *ref, gint minwidth);
 
+void gitg_cell_renderer_path_set_row (GitgCellRendererPath *renderer, GitgRevision *revision, GitgRevision *next_revision, GitgDecoration *decoration);
+
 G_END_DECLS
 
 #endif /* __GITG_CELL_RENDERER_PATH_H__ */
@@ -73,22 +73,45 @@ gitg_color_set_cairo_source(GitgColor *color, cairo_t *cr)
 }
 
 static gint8
-next_index()
+next_index(gint8 *current)
 {
-	gint8 next = current_index++;
+	gint8 next = (*current)++;
 	
-	if (current_index == sizeof(palette) / sizeof(gchar const *))
-		current_index = 0;
+	if (*current == sizeof(palette) / sizeof(gchar const *))
+		*current = 0;
 
 	return next;
 }
 
 GitgColor *
 gitg_color_next()
+{
+	return gitg_color_next_from(&current_index);
+}
+
+/* Like gitg_color_next, but the palette position is kept in current
+   instead of globally */
+GitgColor *
+gitg_color_next_from(gint8 *current)
 {
 	GitgColor *res = g_new(GitgColor, 1);
 	res->ref_count = 1;
-	res->index = next_index();
+	res->index = next_index(current);
+
+	return res;
+}
+
+GitgColor *
+gitg_color_new(gint8 index)
+{
+	GitgColor *res = g_new(GitgColor, 1);
+	res->ref_count = 1;
+	
+	/* index may come from a cache on disk, never index outside the palette */
+	if (index < 0 || index >= sizeof(palette) / sizeof(gchar const *))
+		index = 0;
+
+	res->index = index;
 
 	return res;
 }
@@ -96,7 +119,13 @@ gitg_color_next()
 GitgColor *
 gitg_color_next_index(GitgColor *color)
 {
-	color->index = next_index();
+	return gitg_color_next_index_from(color, &current_index);
+}
+
+GitgColor *
+gitg_color_next_index_from(GitgColor *color, gint8 *current)
+{
+	color->index = next_index(current);
 	return color;
 }
 
@@ -116,7 +145,7 @@ gitg_color_ref(GitgColor *color)
 	if (!color)
 		return NULL;
 
-	++color->ref_count;
+	g_atomic_int_inc(&color->ref_count);
 	return color;
 }
 
@@ -126,9 +155,7 @@ gitg_color_unref(GitgColor *color)
 	if (!color)
 		return NULL;
 	
-	--color->ref_count;
-	
-	if (color->ref_count == 0)
+	if (g_atomic_int_dec_and_test(&color->ref_count))
 	{
 		g_free(color);
 		return NULL;
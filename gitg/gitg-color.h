@@ -28,9 +28,11 @@
 
 typedef struct _GitgColor			GitgColor;
 
+/* Colors are shared along a lane, also between the loader thread and the
+   main loop, so they are reference counted atomically */
 struct _GitgColor
 {
-	gulong ref_count;
+	gint ref_count;
 	gint8 index;
 };
 
@@ -39,7 +41,10 @@ void gitg_color_get(GitgColor *color, gdouble *r, gdouble *g, gdouble *b);
 void gitg_color_set_cairo_source(GitgColor *color, cairo_t *cr);
 
 GitgColor *gitg_color_next();
+GitgColor *gitg_color_next_from(gint8 *current);
+GitgColor *gitg_color_new(gint8 index);
 GitgColor *gitg_color_next_index(GitgColor *color);
+GitgColor *gitg_color_next_index_from(GitgColor *color, gint8 *current);
 GitgColor *gitg_color_ref(GitgColor *color);
 GitgColor *gitg_color_copy(GitgColor *color);
 GitgColor *gitg_color_unref(GitgColor *color);
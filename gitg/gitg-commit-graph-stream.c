@@ -0,0 +1,664 @@
+/*
+ * gitg-commit-graph-stream.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-commit-graph-stream.h"
+#include "gitg-cat-file.h"
+#include "gitg-hash-index.h"
+#include "gitg-utils.h"
+
+#include <string.h>
+
+#define GITG_COMMIT_GRAPH_STREAM_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_COMMIT_GRAPH_STREAM, GitgCommitGraphStreamPrivate))
+
+#define NO_NODE G_MAXUINT32
+
+/* Commits in the graph are nodes by their position, commits newer than the
+   graph come after them */
+typedef struct
+{
+	Hash hash;
+	gint64 time;
+
+	guint64 generation;
+	gboolean has_generation;
+	gboolean seen;
+
+	GArray *parent_hashes;
+	GArray *parents;
+} Extra;
+
+typedef struct
+{
+	guint64 generation;
+	gint64 time;
+	guint32 id;
+} Node;
+
+struct _GitgCommitGraphStreamPrivate
+{
+	GitgCommitGraph *graph;
+	guint32 size;
+
+	gchar *path;
+	GitgCatFile *cat_file;
+
+	GArray *tips;
+	gboolean started;
+
+	guint8 *seen;
+	GPtrArray *extras;
+	GitgHashIndex *extra_ids;
+
+	/* Corrected dates plus one, for graphs which do not store them */
+	guint64 *corrected;
+
+	GArray *heap;
+	GArray *parents;
+	GArray *stack;
+	GArray *line_parents;
+
+	GString *buffer;
+	gsize offset;
+};
+
+G_DEFINE_TYPE(GitgCommitGraphStream, gitg_commit_graph_stream, G_TYPE_INPUT_STREAM)
+
+static void
+extra_free(Extra *extra)
+{
+	g_array_free(extra->parent_hashes, TRUE);
+	g_array_free(extra->parents, TRUE);
+
+	g_slice_free(Extra, extra);
+}
+
+static void
+gitg_commit_graph_stream_finalize(GObject *object)
+{
+	GitgCommitGraphStream *self = GITG_COMMIT_GRAPH_STREAM(object);
+
+	gitg_commit_graph_free(self->priv->graph);
+	g_free(self->priv->path);
+
+	if (self->priv->cat_file)
+		g_object_unref(self->priv->cat_file);
+
+	g_array_free(self->priv->tips, TRUE);
+
+	g_free(self->priv->seen);
+	g_free(self->priv->corrected);
+
+	g_ptr_array_foreach(self->priv->extras, (GFunc)extra_free, NULL);
+	g_ptr_array_free(self->priv->extras, TRUE);
+	gitg_hash_index_free(self->priv->extra_ids);
+
+	g_array_free(self->priv->heap, TRUE);
+	g_array_free(self->priv->parents, TRUE);
+	g_array_free(self->priv->stack, TRUE);
+	g_array_free(self->priv->line_parents, TRUE);
+
+	g_string_free(self->priv->buffer, TRUE);
+
+	G_OBJECT_CLASS(gitg_commit_graph_stream_parent_class)->finalize(object);
+}
+
+static inline Extra *
+get_extra(GitgCommitGraphStream *self, guint32 id)
+{
+	return (Extra *)g_ptr_array_index(self->priv->extras, id - self->priv->size);
+}
+
+static guint32
+lookup_node(GitgCommitGraphStream *self, gchar const *hash)
+{
+	guint32 position;
+	gpointer index;
+
+	if (gitg_commit_graph_lookup(self->priv->graph, hash, &position))
+		return position;
+
+	index = gitg_hash_index_lookup(self->priv->extra_ids, hash);
+	return index ? self->priv->size + GPOINTER_TO_UINT(index) - 1 : NO_NODE;
+}
+
+static gchar const *
+node_hash(GitgCommitGraphStream *self, guint32 id)
+{
+	if (id < self->priv->size)
+		return gitg_commit_graph_get_hash(self->priv->graph, id);
+
+	return get_extra(self, id)->hash;
+}
+
+static gint64
+node_time(GitgCommitGraphStream *self, guint32 id)
+{
+	if (id < self->priv->size)
+		return gitg_commit_graph_get_time(self->priv->graph, id);
+
+	return get_extra(self, id)->time;
+}
+
+static gboolean
+node_parents(GitgCommitGraphStream *self, guint32 id, GArray *parents)
+{
+	Extra *extra;
+
+	if (id < self->priv->size)
+		return gitg_commit_graph_get_parents(self->priv->graph, id, parents);
+
+	extra = get_extra(self, id);
+	g_array_append_vals(parents, extra->parents->data, extra->parents->len);
+
+	return TRUE;
+}
+
+/* Marks id as seen, returns whether it was seen before */
+static gboolean
+node_seen(GitgCommitGraphStream *self, guint32 id)
+{
+	gboolean ret;
+
+	if (id < self->priv->size)
+	{
+		ret = (self->priv->seen[id >> 3] & (1 << (id & 7))) != 0;
+		self->priv->seen[id >> 3] |= 1 << (id & 7);
+	}
+	else
+	{
+		Extra *extra = get_extra(self, id);
+
+		ret = extra->seen;
+		extra->seen = TRUE;
+	}
+
+	return ret;
+}
+
+static gboolean
+known_generation(GitgCommitGraphStream *self, guint32 id, guint64 *generation)
+{
+	if (id >= self->priv->size)
+	{
+		Extra *extra = get_extra(self, id);
+
+		*generation = extra->generation;
+		return extra->has_generation;
+	}
+
+	if (!self->priv->corrected)
+		return gitg_commit_graph_get_generation(self->priv->graph, id, generation);
+
+	*generation = self->priv->corrected[id] - 1;
+	return self->priv->corrected[id] != 0;
+}
+
+static void
+set_generation(GitgCommitGraphStream *self, guint32 id, guint64 generation)
+{
+	if (id >= self->priv->size)
+	{
+		Extra *extra = get_extra(self, id);
+
+		extra->generation = generation;
+		extra->has_generation = TRUE;
+	}
+	else
+	{
+		self->priv->corrected[id] = generation + 1;
+	}
+}
+
+/* Computes the corrected commit date of id from those of its ancestors,
+   for commits newer than the graph and for graphs which do not store it */
+static gboolean
+node_generation(GitgCommitGraphStream *self, guint32 id, guint64 *generation)
+{
+	GArray *stack = self->priv->stack;
+	GArray *parents = self->priv->parents;
+	guint64 limit = 4 * ((guint64)self->priv->size + self->priv->extras->len) + 16;
+
+	if (known_generation(self, id, generation))
+		return TRUE;
+
+	g_array_set_size(stack, 0);
+	g_array_append_val(stack, id);
+
+	while (stack->len)
+	{
+		guint32 top = g_array_index(stack, guint32, stack->len - 1);
+		guint64 value = node_time(self, top);
+		gboolean ready = TRUE;
+		guint i;
+
+		if (known_generation(self, top, generation))
+		{
+			g_array_set_size(stack, stack->len - 1);
+			continue;
+		}
+
+		/* Only a corrupt graph has cycles */
+		if (stack->len > limit)
+			return FALSE;
+
+		g_array_set_size(parents, 0);
+
+		if (!node_parents(self, top, parents))
+			return FALSE;
+
+		for (i = 0; i < parents->len; ++i)
+		{
+			guint32 parent = g_array_index(parents, guint32, i);
+			guint64 parent_generation;
+
+			if (known_generation(self, parent, &parent_generation))
+			{
+				value = MAX(value, parent_generation + 1);
+			}
+			else
+			{
+				g_array_append_val(stack, parent);
+				ready = FALSE;
+			}
+		}
+
+		if (ready)
+		{
+			set_generation(self, top, value);
+			g_array_set_size(stack, stack->len - 1);
+		}
+	}
+
+	return known_generation(self, id, generation);
+}
+
+static inline gboolean
+node_before(Node const *a, Node const *b)
+{
+	if (a->generation != b->generation)
+		return a->generation > b->generation;
+
+	if (a->time != b->time)
+		return a->time > b->time;
+
+	return a->id < b->id;
+}
+
+static void
+heap_push(GArray *heap, Node *node)
+{
+	guint pos = heap->len;
+
+	g_array_set_size(heap, heap->len + 1);
+
+	while (pos > 0)
+	{
+		guint parent = (pos - 1) / 2;
+		Node *up = &g_array_index(heap, Node, parent);
+
+		if (!node_before(node, up))
+			break;
+
+		g_array_index(heap, Node, pos) = *up;
+		pos = parent;
+	}
+
+	g_array_index(heap, Node, pos) = *node;
+}
+
+static Node
+heap_pop(GArray *heap)
+{
+	Node top = g_array_index(heap, Node, 0);
+	Node last = g_array_index(heap, Node, heap->len - 1);
+	guint pos = 0;
+
+	g_array_set_size(heap, heap->len - 1);
+
+	if (heap->len == 0)
+		return top;
+
+	while (TRUE)
+	{
+		guint child = 2 * pos + 1;
+
+		if (child >= heap->len)
+			break;
+
+		if (child + 1 < heap->len &&
+		    node_before(&g_array_index(heap, Node, child + 1), &g_array_index(heap, Node, child)))
+		{
+			++child;
+		}
+
+		if (!node_before(&g_array_index(heap, Node, child), &last))
+			break;
+
+		g_array_index(heap, Node, pos) = g_array_index(heap, Node, child);
+		pos = child;
+	}
+
+	g_array_index(heap, Node, pos) = last;
+	return top;
+}
+
+static gboolean
+push_node(GitgCommitGraphStream *self, guint32 id)
+{
+	Node node;
+
+	if (node_seen(self, id))
+		return TRUE;
+
+	if (!node_generation(self, id, &node.generation))
+		return FALSE;
+
+	node.time = node_time(self, id);
+	node.id = id;
+
+	heap_push(self->priv->heap, &node);
+	return TRUE;
+}
+
+/* Reads a commit which is not in the graph, NULL when hash is not a commit */
+static Extra *
+read_extra(GitgCommitGraphStream *self, gchar const *hash)
+{
+	gchar sha1[HASH_SHA_SIZE + 1];
+	gchar *type = NULL;
+	gchar *contents;
+	gchar const *line;
+	gchar const *next;
+	Extra *extra = NULL;
+
+	if (!self->priv->cat_file)
+		self->priv->cat_file = gitg_cat_file_new(self->priv->path, TRUE);
+
+	gitg_utils_hash_to_sha1(hash, sha1);
+	sha1[HASH_SHA_SIZE] = '\0';
+
+	contents = gitg_cat_file_contents(self->priv->cat_file, sha1, &type, NULL);
+
+	if (!contents || !type || strcmp(type, "commit") != 0)
+	{
+		g_free(contents);
+		g_free(type);
+
+		return NULL;
+	}
+
+	extra = g_slice_new0(Extra);
+	memcpy(extra->hash, hash, HASH_BINARY_SIZE);
+
+	extra->parent_hashes = g_array_new(FALSE, FALSE, sizeof(Hash));
+	extra->parents = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+	/* The headers end at the first empty line */
+	for (line = contents; *line && *line != '\n'; line = next)
+	{
+		gchar const *eol = strchr(line, '\n');
+
+		next = eol ? eol + 1 : line + strlen(line);
+
+		if (g_str_has_prefix(line, "parent ") && next - line > 7 + HASH_SHA_SIZE)
+		{
+			Hash parent;
+
+			gitg_utils_sha1_to_hash(line + 7, parent);
+			g_array_append_val(extra->parent_hashes, parent);
+		}
+		else if (g_str_has_prefix(line, "committer "))
+		{
+			/* committer <name> <<email>> <time> <zone> */
+			gchar const *ptr = next;
+
+			while (ptr > line && *ptr != '>')
+				--ptr;
+
+			extra->time = g_ascii_strtoll(ptr + 1, NULL, 10);
+		}
+	}
+
+	g_free(contents);
+	g_free(type);
+
+	return extra;
+}
+
+static guint32
+add_extra(GitgCommitGraphStream *self, Extra *extra)
+{
+	g_ptr_array_add(self->priv->extras, extra);
+	gitg_hash_index_insert(self->priv->extra_ids, extra->hash, GUINT_TO_POINTER(self->priv->extras->len));
+
+	return self->priv->size + self->priv->extras->len - 1;
+}
+
+/* Reads the commits from tip down to where the graph takes over. Returns
+   the node of tip, or NO_NODE if it is not a commit */
+static guint32
+load_tip(GitgCommitGraphStream *self, gchar const *tip)
+{
+	guint32 id = lookup_node(self, tip);
+	guint first = self->priv->extras->len;
+	GQueue *queue;
+	Extra *extra;
+	guint i;
+
+	if (id != NO_NODE)
+		return id;
+
+	extra = read_extra(self, tip);
+
+	if (!extra)
+		return NO_NODE;
+
+	id = add_extra(self, extra);
+	queue = g_queue_new();
+	g_queue_push_tail(queue, extra);
+
+	while ((extra = g_queue_pop_head(queue)))
+	{
+		for (i = 0; i < extra->parent_hashes->len; ++i)
+		{
+			gchar const *hash = g_array_index(extra->parent_hashes, Hash, i);
+			Extra *parent;
+
+			if (lookup_node(self, hash) != NO_NODE)
+				continue;
+
+			parent = read_extra(self, hash);
+
+			/* A missing parent leaves the history cut off there */
+			if (parent)
+			{
+				add_extra(self, parent);
+				g_queue_push_tail(queue, parent);
+			}
+		}
+	}
+
+	g_queue_free(queue);
+
+	for (i = first; i < self->priv->extras->len; ++i)
+	{
+		extra = (Extra *)g_ptr_array_index(self->priv->extras, i);
+		guint j;
+
+		for (j = 0; j < extra->parent_hashes->len; ++j)
+		{
+			guint32 parent = lookup_node(self, g_array_index(extra->parent_hashes, Hash, j));
+
+			if (parent != NO_NODE)
+				g_array_append_val(extra->parents, parent);
+		}
+	}
+
+	return id;
+}
+
+static gboolean
+walk_start(GitgCommitGraphStream *self)
+{
+	guint i;
+
+	if (!gitg_commit_graph_has_generations(self->priv->graph))
+		self->priv->corrected = g_new0(guint64, self->priv->size);
+
+	for (i = 0; i < self->priv->tips->len; ++i)
+	{
+		guint32 id = load_tip(self, g_array_index(self->priv->tips, Hash, i));
+
+		if (id != NO_NODE && !push_node(self, id))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Writes the line of the next commit, and queues its parents */
+static gboolean
+walk_next(GitgCommitGraphStream *self)
+{
+	Node node = heap_pop(self->priv->heap);
+	GArray *parents = self->priv->line_parents;
+	GString *buffer = self->priv->buffer;
+	gchar sha1[HASH_SHA_SIZE];
+	guint i;
+
+	gitg_utils_hash_to_sha1(node_hash(self, node.id), sha1);
+
+	g_string_append_len(buffer, sha1, HASH_SHA_SIZE);
+	g_string_append(buffer, "\01");
+
+	g_array_set_size(parents, 0);
+
+	if (!node_parents(self, node.id, parents))
+		return FALSE;
+
+	for (i = 0; i < parents->len; ++i)
+	{
+		guint32 parent = g_array_index(parents, guint32, i);
+
+		if (i != 0)
+			g_string_append_c(buffer, ' ');
+
+		gitg_utils_hash_to_sha1(node_hash(self, parent), sha1);
+		g_string_append_len(buffer, sha1, HASH_SHA_SIZE);
+
+		if (!push_node(self, parent))
+			return FALSE;
+	}
+
+	g_string_append_printf(buffer, "\01%" G_GINT64_FORMAT "\n", node.time);
+	return TRUE;
+}
+
+static gssize
+gitg_commit_graph_stream_read(GInputStream *stream, void *buffer, gsize count, GCancellable *cancellable, GError **error)
+{
+	GitgCommitGraphStream *self = GITG_COMMIT_GRAPH_STREAM(stream);
+	GString *lines = self->priv->buffer;
+	gboolean ok = TRUE;
+	gsize num;
+
+	if (!self->priv->started)
+	{
+		self->priv->started = TRUE;
+		ok = walk_start(self);
+	}
+
+	while (ok && lines->len - self->priv->offset < count && self->priv->heap->len)
+	{
+		if (g_cancellable_set_error_if_cancelled(cancellable, error))
+			return -1;
+
+		ok = walk_next(self);
+	}
+
+	if (!ok)
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "The commit-graph is corrupt");
+		return -1;
+	}
+
+	num = MIN(count, lines->len - self->priv->offset);
+	memcpy(buffer, lines->str + self->priv->offset, num);
+
+	self->priv->offset += num;
+
+	if (self->priv->offset == lines->len)
+	{
+		g_string_truncate(lines, 0);
+		self->priv->offset = 0;
+	}
+
+	return num;
+}
+
+static void
+gitg_commit_graph_stream_class_init(GitgCommitGraphStreamClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+	GInputStreamClass *stream_class = G_INPUT_STREAM_CLASS(klass);
+
+	object_class->finalize = gitg_commit_graph_stream_finalize;
+	stream_class->read_fn = gitg_commit_graph_stream_read;
+
+	g_type_class_add_private(object_class, sizeof(GitgCommitGraphStreamPrivate));
+}
+
+static void
+gitg_commit_graph_stream_init(GitgCommitGraphStream *self)
+{
+	self->priv = GITG_COMMIT_GRAPH_STREAM_GET_PRIVATE(self);
+
+	self->priv->tips = g_array_new(FALSE, FALSE, sizeof(Hash));
+	self->priv->extras = g_ptr_array_new();
+	self->priv->extra_ids = gitg_hash_index_new(NULL);
+
+	self->priv->heap = g_array_new(FALSE, FALSE, sizeof(Node));
+	self->priv->parents = g_array_new(FALSE, FALSE, sizeof(guint32));
+	self->priv->stack = g_array_new(FALSE, FALSE, sizeof(guint32));
+	self->priv->line_parents = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+	self->priv->buffer = g_string_sized_new(4096);
+}
+
+GInputStream *
+gitg_commit_graph_stream_new(GitgCommitGraph *graph, gchar const *path, Hash const *tips, guint num_tips)
+{
+	GitgCommitGraphStream *ret;
+
+	g_return_val_if_fail(graph != NULL, NULL);
+
+	ret = g_object_new(GITG_TYPE_COMMIT_GRAPH_STREAM, NULL);
+
+	ret->priv->graph = graph;
+	ret->priv->size = gitg_commit_graph_size(graph);
+	ret->priv->path = g_strdup(path);
+	ret->priv->seen = g_new0(guint8, ret->priv->size / 8 + 1);
+
+	g_array_append_vals(ret->priv->tips, tips, num_tips);
+
+	return G_INPUT_STREAM(ret);
+}
@@ -0,0 +1,69 @@
+/*
+ * gitg-commit-graph-stream.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_COMMIT_GRAPH_STREAM_H__
+#define __GITG_COMMIT_GRAPH_STREAM_H__
+
+#include <gio/gio.h>
+
+#include "gitg-commit-graph.h"
+#include "gitg-types.h"
+
+G_BEGIN_DECLS
+
+#define GITG_TYPE_COMMIT_GRAPH_STREAM				(gitg_commit_graph_stream_get_type ())
+#define GITG_COMMIT_GRAPH_STREAM(obj)				(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_COMMIT_GRAPH_STREAM, GitgCommitGraphStream))
+#define GITG_COMMIT_GRAPH_STREAM_CONST(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_COMMIT_GRAPH_STREAM, GitgCommitGraphStream const))
+#define GITG_COMMIT_GRAPH_STREAM_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GITG_TYPE_COMMIT_GRAPH_STREAM, GitgCommitGraphStreamClass))
+#define GITG_IS_COMMIT_GRAPH_STREAM(obj)			(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GITG_TYPE_COMMIT_GRAPH_STREAM))
+#define GITG_IS_COMMIT_GRAPH_STREAM_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GITG_TYPE_COMMIT_GRAPH_STREAM))
+#define GITG_COMMIT_GRAPH_STREAM_GET_CLASS(obj)		(G_TYPE_INSTANCE_GET_CLASS ((obj), GITG_TYPE_COMMIT_GRAPH_STREAM, GitgCommitGraphStreamClass))
+
+typedef struct _GitgCommitGraphStream			GitgCommitGraphStream;
+typedef struct _GitgCommitGraphStreamClass		GitgCommitGraphStreamClass;
+typedef struct _GitgCommitGraphStreamPrivate	GitgCommitGraphStreamPrivate;
+
+/* The history of a set of tips, walked in the commit-graph and written out
+   as log lines in the format the history loader parses, with the committer
+   date. Commits come in order of their corrected commit date, which puts
+   every commit before its parents. Commits newer than the graph are
+   read with cat-file. The walk runs in the thread reading the stream */
+struct _GitgCommitGraphStream
+{
+	GInputStream parent;
+
+	GitgCommitGraphStreamPrivate *priv;
+};
+
+struct _GitgCommitGraphStreamClass
+{
+	GInputStreamClass parent_class;
+};
+
+GType gitg_commit_graph_stream_get_type (void) G_GNUC_CONST;
+
+/* Takes over graph. path is the working directory git runs in */
+GInputStream *gitg_commit_graph_stream_new(GitgCommitGraph *graph, gchar const *path, Hash const *tips, guint num_tips);
+
+G_END_DECLS
+
+#endif /* __GITG_COMMIT_GRAPH_STREAM_H__ */
@@ -0,0 +1,517 @@
+/*
+ * gitg-commit-graph.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-commit-graph.h"
+#include "gitg-types.h"
+
+#include <string.h>
+
+/* See Documentation/technical/commit-graph-format.txt in git. All numbers
+   are in network byte order */
+#define GRAPH_SIGNATURE "CGPH"
+#define GRAPH_VERSION 1
+#define GRAPH_HASH_SHA1 1
+
+#define GRAPH_HEADER_SIZE 8
+#define GRAPH_CHUNK_LOOKUP_SIZE 12
+#define GRAPH_DATA_SIZE (HASH_BINARY_SIZE + 16)
+
+#define CHUNK_ID(a, b, c, d) (((guint32)(a) << 24) | ((guint32)(b) << 16) | ((guint32)(c) << 8) | (guint32)(d))
+
+#define CHUNK_FANOUT CHUNK_ID('O', 'I', 'D', 'F')
+#define CHUNK_OIDS CHUNK_ID('O', 'I', 'D', 'L')
+#define CHUNK_DATA CHUNK_ID('C', 'D', 'A', 'T')
+#define CHUNK_EDGES CHUNK_ID('E', 'D', 'G', 'E')
+#define CHUNK_GENERATIONS CHUNK_ID('G', 'D', 'A', '2')
+#define CHUNK_GENERATIONS_OVERFLOW CHUNK_ID('G', 'D', 'O', '2')
+
+#define PARENT_NONE 0x70000000
+#define PARENT_EDGES 0x80000000
+#define EDGE_LAST 0x80000000
+#define GENERATION_OVERFLOW 0x80000000
+
+typedef struct
+{
+	GMappedFile *file;
+
+	/* Commits in this graph and in the graphs it is based on */
+	guint32 num;
+	guint32 base;
+
+	guchar const *fanout;
+	guchar const *oids;
+	guchar const *data;
+
+	guchar const *edges;
+	guint32 num_edges;
+
+	/* Corrected commit date offsets, NULL for older graphs */
+	guchar const *generations;
+	guchar const *overflow;
+	guint32 num_overflow;
+} Layer;
+
+struct _GitgCommitGraph
+{
+	Layer *layers;
+	guint num_layers;
+
+	guint32 size;
+	gboolean generations;
+};
+
+static inline guint32
+read_uint32(guchar const *data)
+{
+	guint32 value;
+
+	memcpy(&value, data, sizeof(value));
+	return GUINT32_FROM_BE(value);
+}
+
+static inline guint64
+read_uint64(guchar const *data)
+{
+	guint64 value;
+
+	memcpy(&value, data, sizeof(value));
+	return GUINT64_FROM_BE(value);
+}
+
+static gboolean
+layer_open(Layer *layer, gchar const *filename, guint num_base)
+{
+	guchar const *data;
+	gsize length;
+	guint num_chunks;
+	guint i;
+	gsize fanout_size = 0;
+	gsize oids_size = 0;
+	gsize data_size = 0;
+	gsize edges_size = 0;
+	gsize generations_size = 0;
+	gsize overflow_size = 0;
+
+	layer->file = g_mapped_file_new(filename, FALSE, NULL);
+
+	if (!layer->file)
+		return FALSE;
+
+	data = (guchar const *)g_mapped_file_get_contents(layer->file);
+	length = g_mapped_file_get_length(layer->file);
+
+	if (length < GRAPH_HEADER_SIZE ||
+	    memcmp(data, GRAPH_SIGNATURE, 4) != 0 ||
+	    data[4] != GRAPH_VERSION ||
+	    data[5] != GRAPH_HASH_SHA1 ||
+	    data[7] != num_base)
+	{
+		return FALSE;
+	}
+
+	num_chunks = data[6];
+
+	if (GRAPH_HEADER_SIZE + (num_chunks + 1) * GRAPH_CHUNK_LOOKUP_SIZE > length)
+		return FALSE;
+
+	for (i = 0; i < num_chunks; ++i)
+	{
+		guchar const *entry = data + GRAPH_HEADER_SIZE + i * GRAPH_CHUNK_LOOKUP_SIZE;
+		guint64 offset = read_uint64(entry + 4);
+		guint64 end = read_uint64(entry + GRAPH_CHUNK_LOOKUP_SIZE + 4);
+
+		if (offset > end || end > length)
+			return FALSE;
+
+		switch (read_uint32(entry))
+		{
+			case CHUNK_FANOUT:
+				layer->fanout = data + offset;
+				fanout_size = end - offset;
+			break;
+			case CHUNK_OIDS:
+				layer->oids = data + offset;
+				oids_size = end - offset;
+			break;
+			case CHUNK_DATA:
+				layer->data = data + offset;
+				data_size = end - offset;
+			break;
+			case CHUNK_EDGES:
+				layer->edges = data + offset;
+				edges_size = end - offset;
+			break;
+			case CHUNK_GENERATIONS:
+				layer->generations = data + offset;
+				generations_size = end - offset;
+			break;
+			case CHUNK_GENERATIONS_OVERFLOW:
+				layer->overflow = data + offset;
+				overflow_size = end - offset;
+			break;
+		}
+	}
+
+	if (!layer->fanout || !layer->oids || !layer->data || fanout_size != 256 * 4)
+		return FALSE;
+
+	layer->num = read_uint32(layer->fanout + 255 * 4);
+	layer->num_edges = edges_size / 4;
+	layer->num_overflow = overflow_size / 8;
+
+	if (oids_size != (guint64)layer->num * HASH_BINARY_SIZE ||
+	    data_size != (guint64)layer->num * GRAPH_DATA_SIZE)
+	{
+		return FALSE;
+	}
+
+	if (generations_size != (guint64)layer->num * 4)
+		layer->generations = NULL;
+
+	return TRUE;
+}
+
+/* git does not use the commit-graph when history is rewritten by grafts or
+   replace refs, or cut off in a shallow clone */
+static gboolean
+graph_usable(gchar const *git_dir)
+{
+	static gchar const *disabled[] = {
+		"shallow",
+		"info/grafts",
+		"refs/replace",
+		NULL
+	};
+
+	gchar const **item;
+
+	for (item = disabled; *item; ++item)
+	{
+		gchar *path = g_build_filename(git_dir, *item, NULL);
+		gboolean exists = g_file_test(path, G_FILE_TEST_EXISTS);
+
+		g_free(path);
+
+		if (exists)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Filenames of the graph layers, the base first */
+static gchar **
+graph_filenames(gchar const *git_dir)
+{
+	gchar *filename = g_build_filename(git_dir, "objects", "info", "commit-graph", NULL);
+	gchar *contents;
+	gchar **lines;
+	gchar **line;
+	GPtrArray *ret;
+
+	if (g_file_test(filename, G_FILE_TEST_IS_REGULAR))
+	{
+		gchar **single = g_new0(gchar *, 2);
+
+		single[0] = filename;
+		return single;
+	}
+
+	g_free(filename);
+	filename = g_build_filename(git_dir, "objects", "info", "commit-graphs", "commit-graph-chain", NULL);
+
+	if (!g_file_get_contents(filename, &contents, NULL, NULL))
+	{
+		g_free(filename);
+		return NULL;
+	}
+
+	g_free(filename);
+
+	lines = g_strsplit(contents, "\n", 0);
+	ret = g_ptr_array_new();
+
+	for (line = lines; *line; ++line)
+	{
+		gchar *name;
+
+		if (!**line)
+			continue;
+
+		name = g_strconcat("graph-", *line, ".graph", NULL);
+		g_ptr_array_add(ret, g_build_filename(git_dir, "objects", "info", "commit-graphs", name, NULL));
+
+		g_free(name);
+	}
+
+	g_strfreev(lines);
+	g_free(contents);
+
+	if (ret->len == 0)
+	{
+		g_ptr_array_free(ret, TRUE);
+		return NULL;
+	}
+
+	g_ptr_array_add(ret, NULL);
+	return (gchar **)g_ptr_array_free(ret, FALSE);
+}
+
+/* Returns NULL when there is no commit-graph, or when it cannot be used */
+GitgCommitGraph *
+gitg_commit_graph_open(gchar const *git_dir)
+{
+	GitgCommitGraph *graph;
+	gchar **filenames;
+	guint i;
+
+	g_return_val_if_fail(git_dir != NULL, NULL);
+
+	if (!graph_usable(git_dir))
+		return NULL;
+
+	filenames = graph_filenames(git_dir);
+
+	if (!filenames)
+		return NULL;
+
+	graph = g_slice_new0(GitgCommitGraph);
+	graph->num_layers = g_strv_length(filenames);
+	graph->layers = g_new0(Layer, graph->num_layers);
+	graph->generations = TRUE;
+
+	for (i = 0; i < graph->num_layers; ++i)
+	{
+		Layer *layer = &graph->layers[i];
+
+		if (!layer_open(layer, filenames[i], i) || G_MAXUINT32 - graph->size < layer->num)
+		{
+			gitg_commit_graph_free(graph);
+			graph = NULL;
+
+			break;
+		}
+
+		layer->base = graph->size;
+		graph->size += layer->num;
+
+		/* Corrected dates are only comparable when every layer has them */
+		graph->generations = graph->generations && layer->generations;
+	}
+
+	g_strfreev(filenames);
+	return graph;
+}
+
+void
+gitg_commit_graph_free(GitgCommitGraph *graph)
+{
+	guint i;
+
+	if (graph == NULL)
+		return;
+
+	for (i = 0; i < graph->num_layers; ++i)
+	{
+		if (graph->layers[i].file)
+			g_mapped_file_free(graph->layers[i].file);
+	}
+
+	g_free(graph->layers);
+	g_slice_free(GitgCommitGraph, graph);
+}
+
+guint32
+gitg_commit_graph_size(GitgCommitGraph *graph)
+{
+	return graph->size;
+}
+
+static Layer *
+layer_for_position(GitgCommitGraph *graph, guint32 position, guint32 *index)
+{
+	guint i;
+
+	for (i = 0; i < graph->num_layers; ++i)
+	{
+		Layer *layer = &graph->layers[i];
+
+		if (position < layer->base + layer->num)
+		{
+			*index = position - layer->base;
+			return layer;
+		}
+	}
+
+	return NULL;
+}
+
+/* Looks up the position of the commit with binary hash, the oids of every
+   layer are sorted and bucketed by their first byte */
+gboolean
+gitg_commit_graph_lookup(GitgCommitGraph *graph, gchar const *hash, guint32 *position)
+{
+	guchar first = (guchar)hash[0];
+	guint i;
+
+	for (i = 0; i < graph->num_layers; ++i)
+	{
+		Layer *layer = &graph->layers[i];
+		guint32 lo = first ? read_uint32(layer->fanout + (first - 1) * 4) : 0;
+		guint32 hi = read_uint32(layer->fanout + first * 4);
+
+		while (lo < hi)
+		{
+			guint32 mid = lo + (hi - lo) / 2;
+			gint cmp = memcmp(layer->oids + (gsize)mid * HASH_BINARY_SIZE, hash, HASH_BINARY_SIZE);
+
+			if (cmp == 0)
+			{
+				*position = layer->base + mid;
+				return TRUE;
+			}
+
+			if (cmp < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+	}
+
+	return FALSE;
+}
+
+/* The binary hash of the commit at position */
+gchar const *
+gitg_commit_graph_get_hash(GitgCommitGraph *graph, guint32 position)
+{
+	guint32 index;
+	Layer *layer = layer_for_position(graph, position, &index);
+
+	g_return_val_if_fail(layer != NULL, NULL);
+	return (gchar const *)layer->oids + (gsize)index * HASH_BINARY_SIZE;
+}
+
+gint64
+gitg_commit_graph_get_time(GitgCommitGraph *graph, guint32 position)
+{
+	guint32 index;
+	Layer *layer = layer_for_position(graph, position, &index);
+	guchar const *record;
+
+	g_return_val_if_fail(layer != NULL, 0);
+
+	record = layer->data + (gsize)index * GRAPH_DATA_SIZE + HASH_BINARY_SIZE;
+	return ((gint64)(read_uint32(record + 8) & 0x3) << 32) | read_uint32(record + 12);
+}
+
+gboolean
+gitg_commit_graph_has_generations(GitgCommitGraph *graph)
+{
+	return graph->generations;
+}
+
+/* The corrected commit date: the commit date, raised where needed to be
+   later than that of its parents. Ordering by it puts commits before their
+   parents. Returns FALSE when the graph does not store it */
+gboolean
+gitg_commit_graph_get_generation(GitgCommitGraph *graph, guint32 position, guint64 *generation)
+{
+	guint32 index;
+	Layer *layer = layer_for_position(graph, position, &index);
+	guint64 offset;
+
+	if (!layer || !graph->generations)
+		return FALSE;
+
+	offset = read_uint32(layer->generations + (gsize)index * 4);
+
+	if (offset & GENERATION_OVERFLOW)
+	{
+		offset &= ~GENERATION_OVERFLOW;
+
+		if (offset >= layer->num_overflow)
+			return FALSE;
+
+		offset = read_uint64(layer->overflow + offset * 8);
+	}
+
+	*generation = gitg_commit_graph_get_time(graph, position) + offset;
+	return TRUE;
+}
+
+static gboolean
+add_parent(Layer *layer, guint32 parent, GArray *parents)
+{
+	/* Parents are in the same layer or in the ones below it */
+	if (parent >= layer->base + layer->num)
+		return FALSE;
+
+	g_array_append_val(parents, parent);
+	return TRUE;
+}
+
+/* Appends the positions of the parents of the commit at position. Returns
+   FALSE when the graph is corrupt */
+gboolean
+gitg_commit_graph_get_parents(GitgCommitGraph *graph, guint32 position, GArray *parents)
+{
+	guint32 index;
+	Layer *layer = layer_for_position(graph, position, &index);
+	guchar const *record;
+	guint32 first;
+	guint32 second;
+	guint32 edge;
+
+	if (!layer)
+		return FALSE;
+
+	record = layer->data + (gsize)index * GRAPH_DATA_SIZE + HASH_BINARY_SIZE;
+	first = read_uint32(record);
+	second = read_uint32(record + 4);
+
+	if (first == PARENT_NONE)
+		return TRUE;
+
+	if (!add_parent(layer, first, parents))
+		return FALSE;
+
+	if (second == PARENT_NONE)
+		return TRUE;
+
+	if (!(second & PARENT_EDGES))
+		return add_parent(layer, second, parents);
+
+	/* Octopus merges list the parents after the first in the edges chunk */
+	for (edge = second & ~PARENT_EDGES; edge < layer->num_edges; ++edge)
+	{
+		guint32 value = read_uint32(layer->edges + (gsize)edge * 4);
+
+		if (!add_parent(layer, value & ~EDGE_LAST, parents))
+			return FALSE;
+
+		if (value & EDGE_LAST)
+			return TRUE;
+	}
+
+	return FALSE;
+}
@@ -0,0 +1,51 @@
+/*
+ * gitg-commit-graph.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_COMMIT_GRAPH_H__
+#define __GITG_COMMIT_GRAPH_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Read only view on the commit-graph git writes in objects/info, either a
+   single file or a chain of split graphs. Commits are addressed by their
+   position in the graph, parents of a commit in the graph are always in the
+   graph too. Safe to use from any thread once opened */
+typedef struct _GitgCommitGraph GitgCommitGraph;
+
+GitgCommitGraph *gitg_commit_graph_open(gchar const *git_dir);
+void gitg_commit_graph_free(GitgCommitGraph *graph);
+
+guint32 gitg_commit_graph_size(GitgCommitGraph *graph);
+gboolean gitg_commit_graph_lookup(GitgCommitGraph *graph, gchar const *hash, guint32 *position);
+
+gchar const *gitg_commit_graph_get_hash(GitgCommitGraph *graph, guint32 position);
+gboolean gitg_commit_graph_has_generations(GitgCommitGraph *graph);
+
+gint64 gitg_commit_graph_get_time(GitgCommitGraph *graph, guint32 position);
+gboolean gitg_commit_graph_get_generation(GitgCommitGraph *graph, guint32 position, guint64 *generation);
+gboolean gitg_commit_graph_get_parents(GitgCommitGraph *graph, guint32 position, GArray *parents);
+
+G_END_DECLS
+
+#endif /* __GITG_COMMIT_GRAPH_H__ */
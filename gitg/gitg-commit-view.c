@@ -30,6 +30,7 @@
 #include "gitg-commit.h"
 #include "gitg-utils.h"
 #include "gitg-diff-view.h"
+#include "gitg-text-stream.h"
 #include "gitg-preferences.h"
 #include "gitg-data-binding.h"
 
@@ -126,6 +127,15 @@ static void on_unstage_changes(GtkAction *action, GitgCommitView *view);
 
 static void on_check_button_amend_toggled (GtkToggleButton *button, GitgCommitView *view);
 
+static void
+cancel_runner(GitgCommitView *view)
+{
+	if (view->priv->repository)
+		gitg_repository_cancel_command(view->priv->repository, view->priv->runner);
+	else
+		gitg_runner_cancel(view->priv->runner);
+}
+
 static void
 gitg_commit_view_finalize(GObject *object)
 {
@@ -353,7 +363,7 @@ check_selection(GtkTreeView    *tree_view,
 	if (view->priv->update_id)
 		g_signal_handler_disconnect(view->priv->runner, view->priv->update_id);
 
-	gitg_runner_cancel(view->priv->runner);
+	cancel_runner(view);
 	view->priv->update_id = 0;
 
 	GtkTextView *tv = GTK_TEXT_VIEW(view->priv->changes_view);
@@ -460,7 +470,7 @@ unstaged_selection_changed(GtkTreeSelection *selection, GitgCommitView *view)
 		gchar ct[10];
 		g_snprintf(ct, sizeof(ct), "-U%d", view->priv->context_size);
 		
-		gitg_repository_run_commandv(view->priv->repository, view->priv->runner, NULL, "diff", ct, "--", path, NULL);
+		gitg_repository_schedule_commandv(view->priv->repository, view->priv->runner, GITG_SCHEDULER_PRIORITY_FOREGROUND, "diff", ct, "--", path, NULL);
 		g_free(path);
 	}
 	
@@ -511,7 +521,7 @@ staged_selection_changed(GtkTreeSelection *selection, GitgCommitView *view)
 			connect_update(view);
 
 			gchar *indexpath = g_strconcat(":0:", path, NULL);
-			gitg_repository_run_commandv(view->priv->repository, view->priv->runner, NULL, "show", "--encoding=UTF-8", indexpath, NULL);
+			gitg_repository_schedule_commandv(view->priv->repository, view->priv->runner, GITG_SCHEDULER_PRIORITY_FOREGROUND, "show", "--encoding=UTF-8", indexpath, NULL);
 			g_free(indexpath);
 		}
 		
@@ -527,7 +537,7 @@ staged_selection_changed(GtkTreeSelection *selection, GitgCommitView *view)
 		gchar ct[10];
 		g_snprintf(ct, sizeof(ct), "-U%d", view->priv->context_size);
 
-		gitg_repository_run_commandv(view->priv->repository, view->priv->runner, NULL, "diff-index", ct, "--cached", head, "--", path, NULL);
+		gitg_repository_schedule_commandv(view->priv->repository, view->priv->runner, GITG_SCHEDULER_PRIORITY_FOREGROUND, "diff-index", ct, "--cached", head, "--", path, NULL);
 		g_free(head);
 	}
 
@@ -579,8 +589,8 @@ has_hunk_mark(GtkSourceBuffer *buffer, GtkTextIter *iter)
 	return has_mark;
 }
 
-static gchar *
-get_patch_header(GitgCommitView *view, GtkTextBuffer *buffer, GtkTextIter const *iter)
+static gboolean
+get_patch_header(GitgCommitView *view, GtkTextBuffer *buffer, GtkTextIter const *iter, GtkTextIter *start, GtkTextIter *stop)
 {
 	GtkTextIter begin = *iter;
 	GtkTextIter end;
@@ -610,13 +620,16 @@ get_patch_header(GitgCommitView *view, GtkTextBuffer *buffer, GtkTextIter const
 	}
 	
 	if (!foundstart || !foundend)
-		return NULL;
+		return FALSE;
 	
-	return gtk_text_buffer_get_text(buffer, &begin, &end, FALSE);
+	*start = begin;
+	*stop = end;
+
+	return TRUE;
 }
 
-static gchar *
-get_patch_contents(GitgCommitView *view, GtkTextBuffer *buffer, GtkTextIter const *iter)
+static void
+get_patch_contents(GitgCommitView *view, GtkTextBuffer *buffer, GtkTextIter const *iter, GtkTextIter *stop)
 {
 	/* iter marks the start of the patch, we go until we find the next hunk,
 	   or next file start (or end of file) */
@@ -643,35 +656,37 @@ get_patch_contents(GitgCommitView *view, GtkTextBuffer *buffer, GtkTextIter cons
 		}
 	}
 	
-	return gtk_text_buffer_get_text(buffer, &begin, &end, FALSE);
+	*stop = end;
 }
 
-static gchar *
+/* The patch is streamed out of the buffer instead of copied, it has to be
+   read before the buffer changes */
+static GInputStream *
 get_hunk_patch(GitgCommitView *view, GtkTextIter *iter)
 {
+	GtkTextIter start;
+	GtkTextIter end;
+
 	/* Get patch header */
 	GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view->priv->changes_view));
-	gchar *header = get_patch_header(view, buffer, iter);
 	
-	if (!header)
+	if (!get_patch_header(view, buffer, iter, &start, &end))
 		return NULL;
 	
+	GitgTextStream *stream = gitg_text_stream_new(buffer);
+	gitg_text_stream_add_range(stream, &start, &end);
+	
 	/* Get patch contents */
-	gchar *contents = get_patch_contents(view, buffer, iter);
+	get_patch_contents(view, buffer, iter, &end);
+	gitg_text_stream_add_range(stream, iter, &end);
 
-	if (!contents)
-	{
-		g_free(header);
-		return NULL;
-	}
-	
-	return g_strconcat(header, contents, NULL);
+	return G_INPUT_STREAM(stream);
 }
 
 static gboolean
 handle_stage_unstage(GitgCommitView *view, GtkTextIter *iter)
 {
-	gchar *hunk = get_hunk_patch(view, iter);
+	GInputStream *hunk = get_hunk_patch(view, iter);
 	
 	if (!hunk)
 		return FALSE;
@@ -692,13 +707,13 @@ handle_stage_unstage(GitgCommitView *view, GtkTextIter *iter)
 	}
 	
 	g_object_unref(file);
-	g_free(hunk);
+	g_object_unref(hunk);
 	
 	return ret;
 }
 
 static gboolean
-get_hunk_at_pointer(GitgCommitView *view, GtkTextIter *iter, gchar **hunk)
+get_hunk_at_pointer(GitgCommitView *view, GtkTextIter *iter, GInputStream **hunk)
 {
 	GtkTextView *textview = GTK_TEXT_VIEW(view->priv->changes_view);
 	gint x;
@@ -1035,6 +1050,7 @@ gitg_commit_view_dispose(GObject *object)
 	
 	if (self->priv->repository)
 	{
+		cancel_runner(self);
 		g_object_unref(self->priv->repository);
 		self->priv->repository = NULL;
 	}
@@ -1164,6 +1180,7 @@ gitg_commit_view_set_repository(GitgCommitView *view, GitgRepository *repository
 
 	if (view->priv->repository)
 	{
+		cancel_runner(view);
 		g_object_unref(view->priv->repository);
 		view->priv->repository = NULL;
 	}
@@ -1604,9 +1621,11 @@ do_revert_changes(GitgCommitView *view)
 	{
 		GitgChangedFile *file = g_object_ref(view->priv->current_file);
 
-		gchar *hunk = get_hunk_patch(view, &view->priv->context_iter);
-		ret = gitg_commit_revert(view->priv->commit, view->priv->current_file, hunk, NULL);
-		g_free(hunk);
+		GInputStream *hunk = get_hunk_patch(view, &view->priv->context_iter);
+		ret = hunk && gitg_commit_revert(view->priv->commit, view->priv->current_file, hunk, NULL);
+
+		if (hunk)
+			g_object_unref(hunk);
 		
 		if (ret && view->priv->current_file == file)
 			gitg_diff_view_remove_hunk(GITG_DIFF_VIEW(view->priv->changes_view), &view->priv->context_iter);
@@ -25,8 +25,10 @@
 #include "gitg-utils.h"
 #include "gitg-changed-file.h"
 #include "gitg-config.h"
+#include "gitg-index-file.h"
 
 #include <string.h>
+#include <stdlib.h>
 
 #define GITG_COMMIT_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_COMMIT, GitgCommitPrivate))
 
@@ -56,6 +58,9 @@ struct _GitgCommitPrivate
 	guint end_id;
 	
 	GHashTable *files;
+	
+	/* Entries of the index, read once until it changes */
+	GitgIndexFile *index_file;
 };
 
 static guint commit_signals[LAST_SIGNAL] = { 0 };
@@ -90,7 +95,10 @@ runner_cancel(GitgCommit *commit)
 		commit->priv->end_id = 0;
 	}
 
-	gitg_runner_cancel(commit->priv->runner);
+	if (commit->priv->repository)
+		gitg_repository_cancel_command(commit->priv->repository, commit->priv->runner);
+	else
+		gitg_runner_cancel(commit->priv->runner);
 }
 
 static void
@@ -102,6 +110,7 @@ gitg_commit_finalize(GObject *object)
 	g_object_unref(commit->priv->runner);
 	
 	g_hash_table_destroy(commit->priv->files);
+	gitg_index_file_free(commit->priv->index_file);
 
 	G_OBJECT_CLASS(gitg_commit_parent_class)->finalize(object);
 }
@@ -113,6 +122,7 @@ gitg_commit_dispose(GObject *object)
 	
 	if (self->priv->repository)
 	{
+		runner_cancel(self);
 		g_signal_handlers_disconnect_by_func(self->priv->repository, G_CALLBACK(gitg_commit_refresh), self);
 
 		g_object_unref(self->priv->repository);
@@ -146,7 +156,10 @@ gitg_commit_set_property(GObject *object, guint prop_id, const GValue *value, GP
 		case PROP_REPOSITORY:
 		{
 			if (self->priv->repository)
+			{
+				runner_cancel(self);
 				g_object_unref(self->priv->repository);
+			}
 
 			self->priv->repository = g_value_dup_object(value);
 			g_signal_connect_swapped(self->priv->repository, "load", G_CALLBACK(gitg_commit_refresh), self);
@@ -207,6 +220,8 @@ gitg_commit_init(GitgCommit *self)
 	self->priv = GITG_COMMIT_GET_PRIVATE(self);
 	
 	self->priv->runner = gitg_runner_new(10000);
+	gitg_runner_set_line_views(self->priv->runner, TRUE);
+
 	self->priv->files = g_hash_table_new_full(g_file_hash, (GEqualFunc)g_file_equal, (GDestroyNotify)g_object_unref, (GDestroyNotify)g_object_unref);
 }
 
@@ -232,7 +247,7 @@ runner_connect(GitgCommit *commit, GCallback updatefunc, GCallback endfunc)
 	}
 
 	if (updatefunc)
-		commit->priv->update_id = g_signal_connect(commit->priv->runner, "update", updatefunc, commit);
+		commit->priv->update_id = g_signal_connect(commit->priv->runner, "update-lines", updatefunc, commit);
 	
 	if (endfunc)
 		commit->priv->end_id = g_signal_connect(commit->priv->runner, "end-loading", endfunc, commit);
@@ -254,19 +269,16 @@ update_changed_file_status(GitgChangedFile *file, char const *action, gchar cons
 }
 
 static void
-add_files(GitgCommit *commit, gchar **buffer, gboolean cached)
+add_files(GitgCommit *commit, GitgRunnerLine *lines, gboolean cached)
 {
-	gchar *line;
-	
-	while ((line = *buffer++) != NULL)
+	for (; lines->line != NULL; ++lines)
 	{
-		gchar **parts = g_strsplit_set(line, " \t", 0);
-		guint len = g_strv_length(parts);
+		gchar *parts[6];
+		guint len = gitg_utils_split_inplace(lines->line, " \t", parts, 6);
 		
 		if (len < 6)
 		{
-			g_warning("Invalid line: %s (%d)", line, len);
-			g_strfreev(parts);
+			g_warning("Invalid line: %s (%d)", lines->line, len);
 			continue;
 		}
 		
@@ -305,7 +317,6 @@ add_files(GitgCommit *commit, gchar **buffer, gboolean cached)
 				gitg_changed_file_set_status(f, GITG_CHANGED_FILE_STATUS_MODIFIED);
 			
 			g_object_unref(file);
-			g_strfreev(parts);
 			continue;
 		}
 		
@@ -324,15 +335,13 @@ add_files(GitgCommit *commit, gchar **buffer, gboolean cached)
 		
 		g_signal_connect(f, "changed", G_CALLBACK(on_changed_file_changed), commit);
 		g_signal_emit(commit, commit_signals[INSERTED], 0, f);
-
-		g_strfreev(parts);
 	}
 }
 
 static void
-read_cached_files_update(GitgRunner *runner, gchar **buffer, GitgCommit *commit)
+read_cached_files_update(GitgRunner *runner, GitgRunnerLine *lines, GitgCommit *commit)
 {
-	add_files(commit, buffer, TRUE);
+	add_files(commit, lines, TRUE);
 }
 
 static gboolean
@@ -358,14 +367,14 @@ read_unstaged_files_end(GitgRunner *runner, gboolean cancelled, GitgCommit *comm
 	gitg_runner_cancel(runner);
 
 	runner_connect(commit, G_CALLBACK(read_cached_files_update), G_CALLBACK(refresh_done));	
-	gitg_repository_run_commandv(commit->priv->repository, commit->priv->runner, NULL, "diff-index", "--cached", head, NULL);
+	gitg_repository_schedule_commandv(commit->priv->repository, commit->priv->runner, GITG_SCHEDULER_PRIORITY_BACKGROUND, "diff-index", "--cached", head, NULL);
 	g_free(head);
 }
 
 static void
-read_unstaged_files_update(GitgRunner *runner, gchar **buffer, GitgCommit *commit)
+read_unstaged_files_update(GitgRunner *runner, GitgRunnerLine *lines, GitgCommit *commit)
 {
-	add_files(commit, buffer, FALSE);
+	add_files(commit, lines, FALSE);
 }
 
 static void
@@ -374,7 +383,7 @@ read_other_files_end(GitgRunner *runner, gboolean cancelled, GitgCommit *commit)
 	gitg_runner_cancel(runner);
 	
 	runner_connect(commit, G_CALLBACK(read_unstaged_files_update), G_CALLBACK(read_unstaged_files_end));
-	gitg_repository_run_commandv(commit->priv->repository,commit->priv->runner, NULL, "diff-files", NULL);
+	gitg_repository_schedule_commandv(commit->priv->repository, commit->priv->runner, GITG_SCHEDULER_PRIORITY_BACKGROUND, "diff-files", NULL);
 }
 
 static void
@@ -387,12 +396,12 @@ changed_file_new(GitgChangedFile *f)
 }
 
 static void
-read_other_files_update(GitgRunner *runner, gchar **buffer, GitgCommit *commit)
+read_other_files_update(GitgRunner *runner, GitgRunnerLine *lines, GitgCommit *commit)
 {
-	gchar *line;
-
-	while ((line = *buffer++) != NULL)
+	for (; lines->line != NULL; ++lines)
 	{
+		gchar const *line = lines->line;
+
 		/* Skip empty lines */
 		if (!*line)
 			continue;
@@ -426,14 +435,38 @@ update_index_end(GitgRunner *runner, gboolean cancelled, GitgCommit *commit)
 	gitg_runner_cancel(runner);
 	runner_connect(commit, G_CALLBACK(read_other_files_update), G_CALLBACK(read_other_files_end));
 	
-	gitg_repository_run_commandv(commit->priv->repository, commit->priv->runner, NULL, "ls-files", "--others", "--exclude-standard", NULL);
+	gitg_repository_schedule_commandv(commit->priv->repository, commit->priv->runner, GITG_SCHEDULER_PRIORITY_BACKGROUND, "ls-files", "--others", "--exclude-standard", NULL);
 }
 
 static void
 update_index(GitgCommit *commit)
 {
 	runner_connect(commit, NULL, G_CALLBACK(update_index_end));
-	gitg_repository_run_commandv(commit->priv->repository, commit->priv->runner, NULL, "update-index", "-q", "--unmerged", "--ignore-missing", "--refresh", NULL);
+	gitg_repository_schedule_commandv(commit->priv->repository, commit->priv->runner, GITG_SCHEDULER_PRIORITY_BACKGROUND, "update-index", "-q", "--unmerged", "--ignore-missing", "--refresh", NULL);
+}
+
+/* Forgets the entries read from the index, after git changed it. Writes
+   within the same second may not show in its stat */
+static void
+drop_index_file(GitgCommit *commit)
+{
+	gitg_index_file_free(commit->priv->index_file);
+	commit->priv->index_file = NULL;
+}
+
+static GitgIndexFile *
+index_file(GitgCommit *commit)
+{
+	if (commit->priv->index_file && !gitg_index_file_is_stale(commit->priv->index_file))
+		return commit->priv->index_file;
+	
+	gchar *git_dir = g_build_filename(gitg_repository_get_path(commit->priv->repository), ".git", NULL);
+	
+	drop_index_file(commit);
+	commit->priv->index_file = gitg_index_file_new(git_dir);
+	
+	g_free(git_dir);
+	return commit->priv->index_file;
 }
 
 static void
@@ -449,6 +482,7 @@ gitg_commit_refresh(GitgCommit *commit)
 	g_return_if_fail(GITG_IS_COMMIT(commit));
 
 	runner_cancel(commit);
+	drop_index_file(commit);
 	
 	g_hash_table_foreach(commit->priv->files, (GHFunc)set_can_delete, commit);
 
@@ -459,11 +493,117 @@ gitg_commit_refresh(GitgCommit *commit)
 		refresh_done(commit->priv->runner, FALSE, commit);
 }
 
+/* The mode and hash of path in the HEAD tree, read from the tree containing
+   it through the cat-file process */
+static gboolean
+head_entry(GitgCommit *commit, gchar const *path, guint32 *mode, gchar *hash)
+{
+	gchar *dir = g_path_get_dirname(path);
+	gchar *base = g_path_get_basename(path);
+	gchar *spec = g_strconcat("HEAD:", strcmp(dir, ".") == 0 ? "" : dir, NULL);
+	gchar *type = NULL;
+	gsize size = 0;
+	gchar *tree = gitg_repository_cat_file(commit->priv->repository, spec, &type, &size);
+	gboolean ret = FALSE;
+	
+	if (tree && type && strcmp(type, "tree") == 0)
+	{
+		gchar const *ptr = tree;
+		gchar const *end = tree + size;
+		
+		/* Entries are '<octal mode> <name>\0<binary hash>' */
+		while (ptr < end)
+		{
+			gchar const *space = memchr(ptr, ' ', end - ptr);
+			gchar const *nul = space ? memchr(space, '\0', end - space) : NULL;
+			
+			if (!nul || end - nul - 1 < HASH_BINARY_SIZE)
+				break;
+			
+			if (strcmp(space + 1, base) == 0)
+			{
+				*mode = strtoul(ptr, NULL, 8);
+				memcpy(hash, nul + 1, HASH_BINARY_SIZE);
+				ret = TRUE;
+				
+				break;
+			}
+			
+			ptr = nul + 1 + HASH_BINARY_SIZE;
+		}
+	}
+	
+	g_free(tree);
+	g_free(type);
+	g_free(spec);
+	g_free(base);
+	g_free(dir);
+	
+	return ret;
+}
+
+/* Determines the staged state from the object ids and modes of the HEAD
+   and index entries. The index is read directly, the HEAD tree through the
+   cat-file process, so git is not spawned. Returns FALSE when that is not
+   conclusive (no index entry, or an index which can not be read directly) */
+static gboolean
+update_index_staged_objects(GitgCommit *commit, GitgChangedFile *file, gchar const *path)
+{
+	GitgIndexFile *index = index_file(commit);
+	guint32 index_mode;
+	guint32 head_mode;
+	Hash index_hash;
+	Hash head_hash;
+	
+	if (!index || !gitg_index_file_lookup(index, path, &index_mode, index_hash))
+		return FALSE;
+	
+	GitgChangedFileChanges changes = gitg_changed_file_get_changes(file);
+	
+	if (!head_entry(commit, path, &head_mode, head_hash))
+	{
+		gitg_changed_file_set_mode(file, "000000");
+		gitg_changed_file_set_sha(file, "0000000000000000000000000000000000000000");
+		gitg_changed_file_set_status(file, GITG_CHANGED_FILE_STATUS_NEW);
+		gitg_changed_file_set_changes(file, changes | GITG_CHANGED_FILE_CHANGES_CACHED);
+	}
+	else if (memcmp(index_hash, head_hash, HASH_BINARY_SIZE) != 0 || index_mode != head_mode)
+	{
+		/* Unstaging writes back the HEAD entry, mode included */
+		gchar *sha = gitg_utils_hash_to_sha1_new(head_hash);
+		gchar *mode = g_strdup_printf("%06o", head_mode);
+		
+		gitg_changed_file_set_mode(file, mode);
+		gitg_changed_file_set_sha(file, sha);
+		gitg_changed_file_set_status(file, GITG_CHANGED_FILE_STATUS_MODIFIED);
+		gitg_changed_file_set_changes(file, changes | GITG_CHANGED_FILE_CHANGES_CACHED);
+		
+		g_free(mode);
+		g_free(sha);
+	}
+	else
+	{
+		/* Same blob and mode, nothing is staged. This is the common case
+		   of a file with only unstaged changes */
+		gitg_changed_file_set_changes(file, changes & ~GITG_CHANGED_FILE_CHANGES_CACHED);
+	}
+	
+	return TRUE;
+}
+
 static void
 update_index_staged(GitgCommit *commit, GitgChangedFile *file)
 {
 	GFile *f = gitg_changed_file_get_file(file);
 	gchar *path = gitg_repository_relative(commit->priv->repository, f);
+	
+	if (update_index_staged_objects(commit, file, path))
+	{
+		g_free(path);
+		g_object_unref(f);
+		return;
+	}
+	
 	gchar *head = gitg_repository_parse_head(commit->priv->repository);
 
 	gchar **ret = gitg_repository_command_with_outputv(commit->priv->repository, NULL, "diff-index", "--cached", head, "--", path, NULL);
@@ -526,6 +666,7 @@ update_index_file(GitgCommit *commit, GitgChangedFile *file)
 	g_object_unref(f);
 
 	gitg_repository_commandv(commit->priv->repository, NULL, "update-index", "-q", "--unmerged", "--ignore-missing", "--refresh", NULL);
+	drop_index_file(commit);
 	
 	g_free(path);
 }
@@ -556,14 +697,14 @@ refresh_changes(GitgCommit *commit, GitgChangedFile *file)
 }
 
 gboolean
-apply_hunk(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, gboolean reverse, GError **error)
+apply_hunk(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, gboolean reverse, GError **error)
 {
 	g_return_val_if_fail(GITG_IS_COMMIT(commit), FALSE);
 	g_return_val_if_fail(GITG_IS_CHANGED_FILE(file), FALSE);
 	
 	g_return_val_if_fail(hunk != NULL, FALSE);
 	
-	gboolean ret = gitg_repository_command_with_inputv(commit->priv->repository, hunk, error, "apply", "--cached", reverse ? "--reverse" : NULL, NULL);
+	gboolean ret = gitg_repository_command_with_input_streamv(commit->priv->repository, hunk, error, "apply", "--cached", reverse ? "--reverse" : NULL, NULL);
 	
 	if (ret)
 		refresh_changes(commit, file);
@@ -572,7 +713,7 @@ apply_hunk(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, gboolea
 }
 
 gboolean
-gitg_commit_stage(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, GError **error)
+gitg_commit_stage(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, GError **error)
 {
 	if (hunk)
 		return apply_hunk(commit, file, hunk, FALSE, error);
@@ -594,7 +735,7 @@ gitg_commit_stage(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk,
 }
 
 gboolean
-gitg_commit_unstage(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, GError **error)
+gitg_commit_unstage(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, GError **error)
 {
 	if (hunk)
 		return apply_hunk(commit, file, hunk, TRUE, error);
@@ -943,7 +1084,7 @@ remove_file(GitgCommit *commit, GitgChangedFile *file)
 }
 
 gboolean
-gitg_commit_revert(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, GError **error)
+gitg_commit_revert(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, GError **error)
 {
 	gboolean ret;
 	
@@ -965,7 +1106,7 @@ gitg_commit_revert(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk,
 		GitgRunner *runner = gitg_runner_new_synchronized(1000);
 		gchar const *argv[] = {"patch", "-p1", "-R", NULL};
 		
-		ret = gitg_runner_run_with_arguments(runner, argv, gitg_repository_get_path(commit->priv->repository), hunk, NULL); 
+		ret = gitg_runner_run_with_input_stream(runner, argv, gitg_repository_get_path(commit->priv->repository), hunk, NULL);
 	
 		update_index_file(commit, file);
 		update_index_unstaged(commit, file);
@@ -24,6 +24,7 @@
 #define __GITG_COMMIT_H__
 
 #include <glib-object.h>
+#include <gio/gio.h>
 #include "gitg-repository.h"
 #include "gitg-changed-file.h"
 
@@ -68,13 +69,13 @@ GType gitg_commit_get_type(void) G_GNUC_CONST;
 GitgCommit *gitg_commit_new(GitgRepository *repository);
 
 void gitg_commit_refresh(GitgCommit *commit);
-gboolean gitg_commit_stage(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, GError **error);
-gboolean gitg_commit_unstage(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, GError **error);
+gboolean gitg_commit_stage(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, GError **error);
+gboolean gitg_commit_unstage(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, GError **error);
 
 gboolean gitg_commit_has_changes(GitgCommit *commit);
 gboolean gitg_commit_commit(GitgCommit *commit, gchar const *comment, gboolean signoff, gboolean amend, GError **error);
 
-gboolean gitg_commit_revert(GitgCommit *commit, GitgChangedFile *file, gchar const *hunk, GError **error);
+gboolean gitg_commit_revert(GitgCommit *commit, GitgChangedFile *file, GInputStream *hunk, GError **error);
 gboolean gitg_commit_add_ignore(GitgCommit *commit, GitgChangedFile *file, GError **error);
 
 GitgChangedFile *gitg_commit_find_changed_file(GitgCommit *commit, GFile *file);
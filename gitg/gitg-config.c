@@ -187,45 +187,62 @@ get_value_global_regex (GitgConfig *config, gchar const *regex)
 	return get_value_process (config, ret);
 }
 
+/* Local values are memoized by the repository, until its config changes */
+static gchar *
+get_value_cached_process (gchar **lines)
+{
+	gchar *res;
+	
+	if (lines)
+	{
+		res = g_strjoinv ("\n", lines);
+		g_strfreev (lines);
+	}
+	else
+	{
+		res = NULL;
+	}
+	
+	return res;
+}
+
 static gchar *
 get_value_local (GitgConfig *config, gchar const *key)
 {
-	gboolean ret;
+	gchar **ret;
 	gchar const *path = gitg_repository_get_path (config->priv->repository);
 	gchar *cfg = g_build_filename (path, ".git", "config", NULL);
 
-	ret = gitg_repository_run_commandv (config->priv->repository, 
-	                                    config->priv->runner,
-	                                    NULL,
-	                                    "config",
-	                                    "--file",
-	                                    cfg,
-	                                    key,
-	                                    NULL);
+	ret = gitg_repository_command_with_output_cachedv (config->priv->repository, 
+	                                                   NULL,
+	                                                   "config",
+	                                                   "--file",
+	                                                   cfg,
+	                                                   key,
+	                                                   NULL);
 	g_free (cfg);
 	
-	return get_value_process (config, ret);
+	return get_value_cached_process (ret);
 }
 
 static gchar *
 get_value_local_regex (GitgConfig *config, gchar const *regex)
 {
-	gboolean ret;
+	gchar **ret;
 	gchar const *path = gitg_repository_get_path (config->priv->repository);
 	gchar *cfg = g_build_filename (path, ".git", "config", NULL);
 
-	ret = gitg_repository_run_commandv (config->priv->repository, 
-	                                    config->priv->runner,
-	                                    NULL,
-	                                    "config",
-	                                    "--file",
-	                                    cfg,
-	                                    "--get-regexp",
-	                                    regex,
-	                                    NULL);
+	ret = gitg_repository_command_with_output_cachedv (config->priv->repository, 
+	                                                   NULL,
+	                                                   "config",
+	                                                   "--file",
+	                                                   cfg,
+	                                                   "--get-regexp",
+	                                                   regex,
+	                                                   NULL);
 	g_free (cfg);
 	
-	return get_value_process (config, ret);
+	return get_value_cached_process (ret);
 }
 
 static gboolean
@@ -249,15 +266,19 @@ set_value_local (GitgConfig *config, gchar const *key, gchar const *value)
 	gchar const *path = gitg_repository_get_path (config->priv->repository);
 	gchar *cfg = g_build_filename (path, ".git", "config", NULL);
 
-	return gitg_repository_run_commandv (config->priv->repository, 
-	                                     config->priv->runner,
-	                                     NULL,
-	                                     "config",
-	                                     "--file",
-	                                     cfg,
-	                                     value == NULL ? "--unset" : key,
-	                                     value == NULL ? key : value,
-	                                     NULL);
+	gboolean ret = gitg_repository_run_commandv (config->priv->repository, 
+	                                             config->priv->runner,
+	                                             NULL,
+	                                             "config",
+	                                             "--file",
+	                                             cfg,
+	                                             value == NULL ? "--unset" : key,
+	                                             value == NULL ? key : value,
+	                                             NULL);
+	g_free (cfg);
+	
+	gitg_repository_invalidate (config->priv->repository);
+	return ret;
 }
 
 static gboolean
@@ -282,16 +303,20 @@ rename_local (GitgConfig *config, gchar const *old, gchar const *nw)
 	gchar const *path = gitg_repository_get_path (config->priv->repository);
 	gchar *cfg = g_build_filename (path, ".git", "config", NULL);
 
-	return gitg_repository_run_commandv (config->priv->repository, 
-	                                     config->priv->runner,
-	                                     NULL,
-	                                     "config",
-	                                     "--file",
-	                                     cfg,
-	                                     "--rename-section",
-	                                     old,
-	                                     nw,
-	                                     NULL);
+	gboolean ret = gitg_repository_run_commandv (config->priv->repository, 
+	                                             config->priv->runner,
+	                                             NULL,
+	                                             "config",
+	                                             "--file",
+	                                             cfg,
+	                                             "--rename-section",
+	                                             old,
+	                                             nw,
+	                                             NULL);
+	g_free (cfg);
+	
+	gitg_repository_invalidate (config->priv->repository);
+	return ret;
 }
 
 gchar *
@@ -0,0 +1,108 @@
+/*
+ * gitg-date-cache.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-date-cache.h"
+#include "gitg-utils.h"
+
+#include <time.h>
+
+/* A few screens full of rows */
+#define DATE_CACHE_BITS 9
+#define DATE_CACHE_SIZE (1 << DATE_CACHE_BITS)
+
+typedef struct
+{
+	guint64 timestamp;
+	gchar *text;
+} Entry;
+
+struct _GitgDateCache
+{
+	Entry entries[DATE_CACHE_SIZE];
+	
+	gboolean relative;
+	guint64 now;
+};
+
+static void
+clear_entries(GitgDateCache *cache)
+{
+	guint i;
+	
+	for (i = 0; i < DATE_CACHE_SIZE; ++i)
+	{
+		g_free(cache->entries[i].text);
+		cache->entries[i].text = NULL;
+	}
+}
+
+GitgDateCache *
+gitg_date_cache_new(gboolean relative)
+{
+	GitgDateCache *cache = g_slice_new0(GitgDateCache);
+	
+	cache->relative = relative;
+	cache->now = time(NULL);
+	
+	return cache;
+}
+
+void
+gitg_date_cache_free(GitgDateCache *cache)
+{
+	if (!cache)
+		return;
+	
+	clear_entries(cache);
+	g_slice_free(GitgDateCache, cache);
+}
+
+void
+gitg_date_cache_set_now(GitgDateCache *cache, guint64 now)
+{
+	/* Relative dates only change by the minute */
+	if (cache->relative && now / 60 != cache->now / 60)
+		clear_entries(cache);
+	
+	cache->now = now;
+}
+
+gchar const *
+gitg_date_cache_lookup(GitgDateCache *cache, guint64 timestamp)
+{
+	/* Spreads commits close in time over the slots */
+	guint32 slot = ((guint32)timestamp * 2654435761u) >> (32 - DATE_CACHE_BITS);
+	Entry *entry = &cache->entries[slot];
+	
+	if (entry->text && entry->timestamp == timestamp)
+		return entry->text;
+	
+	g_free(entry->text);
+	
+	if (cache->relative)
+		entry->text = gitg_utils_timestamp_to_relative_str(timestamp, cache->now);
+	else
+		entry->text = gitg_utils_timestamp_to_str(timestamp);
+	
+	entry->timestamp = timestamp;
+	return entry->text;
+}
@@ -0,0 +1,46 @@
+/*
+ * gitg-date-cache.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_DATE_CACHE_H__
+#define __GITG_DATE_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Small cache of formatted dates by timestamp, so rows which are drawn
+   again do not format their date again. Relative dates are formatted
+   against the time last set with gitg_date_cache_set_now */
+typedef struct _GitgDateCache GitgDateCache;
+
+GitgDateCache *gitg_date_cache_new(gboolean relative);
+void gitg_date_cache_free(GitgDateCache *cache);
+
+void gitg_date_cache_set_now(GitgDateCache *cache, guint64 now);
+
+/* The returned string is owned by the cache, and valid until the next
+   lookup */
+gchar const *gitg_date_cache_lookup(GitgDateCache *cache, guint64 timestamp);
+
+G_END_DECLS
+
+#endif /* __GITG_DATE_CACHE_H__ */
@@ -34,6 +34,7 @@ static guint debug_enabled = GITG_DEBUG_NONE;
 void gitg_debug_init()
 {
 	DEBUG_FROM_ENV(GITG_DEBUG_RUNNER);
+	DEBUG_FROM_ENV(GITG_DEBUG_RUNNER_STATS);
 }
 
 gboolean gitg_debug_enabled(guint debug)
@@ -28,7 +28,8 @@
 enum
 {
 	GITG_DEBUG_NONE = 0,
-	GITG_DEBUG_RUNNER = 1 << 0
+	GITG_DEBUG_RUNNER = 1 << 0,
+	GITG_DEBUG_RUNNER_STATS = 1 << 1
 };
 
 void gitg_debug_init();
@@ -0,0 +1,267 @@
+/*
+ * gitg-hash-index.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-hash-index.h"
+
+#include <string.h>
+
+#define INDEX_MIN_SIZE 64
+
+/* Grow when more than 7/10 of the slots are used */
+#define INDEX_LOAD_NUM 7
+#define INDEX_LOAD_DEN 10
+
+/* 32 bytes on 64 bit, two entries per cache line */
+typedef struct
+{
+	Hash hash;
+	guint32 used;
+	gpointer value;
+} Entry;
+
+struct _GitgHashIndex
+{
+	Entry *entries;
+	guint mask;
+	guint size;
+
+	GDestroyNotify value_destroy;
+};
+
+/* SHA-1 is uniformly distributed, its first bytes make a fine slot hash */
+static inline guint
+slot_for_hash(GitgHashIndex *index, gchar const *hash)
+{
+	guint64 prefix;
+
+	memcpy(&prefix, hash, sizeof(prefix));
+	return (guint)(prefix ^ (prefix >> 32)) & index->mask;
+}
+
+static inline gboolean
+hash_equal(gchar const *a, gchar const *b)
+{
+	return memcmp(a, b, HASH_BINARY_SIZE) == 0;
+}
+
+/* Returns the slot holding hash, or the empty slot it would go into */
+static guint
+find_slot(GitgHashIndex *index, gchar const *hash)
+{
+	guint slot = slot_for_hash(index, hash);
+
+	while (index->entries[slot].used && !hash_equal(index->entries[slot].hash, hash))
+		slot = (slot + 1) & index->mask;
+
+	return slot;
+}
+
+static void
+resize(GitgHashIndex *index, guint capacity)
+{
+	Entry *entries = index->entries;
+	guint num = index->mask + 1;
+	guint i;
+
+	index->entries = g_new0(Entry, capacity);
+	index->mask = capacity - 1;
+
+	for (i = 0; i < num; ++i)
+	{
+		if (entries[i].used)
+			index->entries[find_slot(index, entries[i].hash)] = entries[i];
+	}
+
+	g_free(entries);
+}
+
+static guint
+capacity_for(guint size)
+{
+	guint capacity = INDEX_MIN_SIZE;
+
+	while ((guint64)size * INDEX_LOAD_DEN > (guint64)capacity * INDEX_LOAD_NUM)
+		capacity <<= 1;
+
+	return capacity;
+}
+
+GitgHashIndex *
+gitg_hash_index_new(GDestroyNotify value_destroy)
+{
+	GitgHashIndex *index = g_slice_new0(GitgHashIndex);
+
+	index->entries = g_new0(Entry, INDEX_MIN_SIZE);
+	index->mask = INDEX_MIN_SIZE - 1;
+	index->value_destroy = value_destroy;
+
+	return index;
+}
+
+void
+gitg_hash_index_free(GitgHashIndex *index)
+{
+	if (index == NULL)
+		return;
+
+	gitg_hash_index_remove_all(index);
+
+	g_free(index->entries);
+	g_slice_free(GitgHashIndex, index);
+}
+
+/* Makes room for size entries in total, so they go in without rehashing */
+void
+gitg_hash_index_reserve(GitgHashIndex *index, guint size)
+{
+	guint capacity = capacity_for(size);
+
+	if (capacity > index->mask + 1)
+		resize(index, capacity);
+}
+
+/* Inserts or replaces the value for hash, a replaced value is destroyed */
+void
+gitg_hash_index_insert(GitgHashIndex *index, gchar const *hash, gpointer value)
+{
+	guint slot = find_slot(index, hash);
+	Entry *entry = &index->entries[slot];
+
+	if (entry->used)
+	{
+		if (index->value_destroy)
+			index->value_destroy(entry->value);
+
+		entry->value = value;
+		return;
+	}
+
+	if ((guint64)(index->size + 1) * INDEX_LOAD_DEN > (guint64)(index->mask + 1) * INDEX_LOAD_NUM)
+	{
+		resize(index, (index->mask + 1) << 1);
+		entry = &index->entries[find_slot(index, hash)];
+	}
+
+	memcpy(entry->hash, hash, HASH_BINARY_SIZE);
+	entry->used = TRUE;
+	entry->value = value;
+
+	++index->size;
+}
+
+gboolean
+gitg_hash_index_remove(GitgHashIndex *index, gchar const *hash)
+{
+	guint slot = find_slot(index, hash);
+	guint next = slot;
+
+	if (!index->entries[slot].used)
+		return FALSE;
+
+	if (index->value_destroy)
+		index->value_destroy(index->entries[slot].value);
+
+	/* Shift back entries of the probe run which would otherwise become
+	   unreachable, instead of leaving a tombstone */
+	while (TRUE)
+	{
+		next = (next + 1) & index->mask;
+
+		if (!index->entries[next].used)
+			break;
+
+		guint home = slot_for_hash(index, index->entries[next].hash);
+
+		/* Entry at next can stay when its home lies cyclically in (slot, next] */
+		if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next))
+			continue;
+
+		index->entries[slot] = index->entries[next];
+		slot = next;
+	}
+
+	index->entries[slot].used = FALSE;
+	index->entries[slot].value = NULL;
+
+	--index->size;
+	return TRUE;
+}
+
+void
+gitg_hash_index_remove_all(GitgHashIndex *index)
+{
+	guint i;
+
+	if (index->value_destroy)
+	{
+		for (i = 0; i <= index->mask; ++i)
+		{
+			if (index->entries[i].used)
+				index->value_destroy(index->entries[i].value);
+		}
+	}
+
+	memset(index->entries, 0, sizeof(Entry) * (index->mask + 1));
+	index->size = 0;
+}
+
+gboolean
+gitg_hash_index_lookup_extended(GitgHashIndex *index, gchar const *hash, gpointer *value)
+{
+	Entry *entry = &index->entries[find_slot(index, hash)];
+
+	if (!entry->used)
+		return FALSE;
+
+	if (value)
+		*value = entry->value;
+
+	return TRUE;
+}
+
+gpointer
+gitg_hash_index_lookup(GitgHashIndex *index, gchar const *hash)
+{
+	gpointer value = NULL;
+
+	gitg_hash_index_lookup_extended(index, hash, &value);
+	return value;
+}
+
+guint
+gitg_hash_index_size(GitgHashIndex *index)
+{
+	return index->size;
+}
+
+/* The index must not be changed from func */
+void
+gitg_hash_index_foreach(GitgHashIndex *index, GitgHashIndexFunc func, gpointer user_data)
+{
+	guint i;
+
+	for (i = 0; i <= index->mask; ++i)
+	{
+		if (index->entries[i].used)
+			func(index->entries[i].hash, index->entries[i].value, user_data);
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * gitg-hash-index.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_HASH_INDEX_H__
+#define __GITG_HASH_INDEX_H__
+
+#include <glib.h>
+
+#include "gitg-types.h"
+
+G_BEGIN_DECLS
+
+/* Open addressing table from binary hashes to values. Keys are copied into
+   the table, so they do not need to outlive their entry */
+typedef struct _GitgHashIndex GitgHashIndex;
+
+typedef void (*GitgHashIndexFunc)(gchar const *hash, gpointer value, gpointer user_data);
+
+GitgHashIndex *gitg_hash_index_new(GDestroyNotify value_destroy);
+void gitg_hash_index_free(GitgHashIndex *index);
+
+void gitg_hash_index_reserve(GitgHashIndex *index, guint size);
+
+void gitg_hash_index_insert(GitgHashIndex *index, gchar const *hash, gpointer value);
+gboolean gitg_hash_index_remove(GitgHashIndex *index, gchar const *hash);
+void gitg_hash_index_remove_all(GitgHashIndex *index);
+
+gpointer gitg_hash_index_lookup(GitgHashIndex *index, gchar const *hash);
+gboolean gitg_hash_index_lookup_extended(GitgHashIndex *index, gchar const *hash, gpointer *value);
+
+guint gitg_hash_index_size(GitgHashIndex *index);
+void gitg_hash_index_foreach(GitgHashIndex *index, GitgHashIndexFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __GITG_HASH_INDEX_H__ */
@@ -0,0 +1,502 @@
+/*
+ * gitg-history-cache.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-history-cache.h"
+#include "gitg-lane.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/* File layout: header, revisions, lanes, hashes (parents and lane
+   boundaries), merge indices, tips and strings. Every section is an array
+   of fixed size records in host byte order, records refer to each other by
+   index, strings by offset. The tips are the commits the history was
+   loaded for, as a string */
+#define CACHE_MAGIC "GITGHIST"
+#define CACHE_VERSION 3
+#define CACHE_BYTE_ORDER 0x01020304
+
+typedef struct
+{
+	gchar magic[8];
+	guint32 version;
+	guint32 byte_order;
+	gchar key[HASH_SHA_SIZE];
+
+	guint32 num_revisions;
+	guint32 num_lanes;
+	guint32 num_hashes;
+	guint32 num_from;
+	guint32 strings_size;
+	guint32 tips_size;
+} CacheHeader;
+
+typedef struct
+{
+	Hash hash;
+	gchar sign;
+	gint8 mylane;
+	guint16 num_parents;
+	gint64 timestamp;
+
+	guint32 author;
+	guint32 subject;
+	guint32 parents;
+	guint32 lanes;
+	guint32 num_lanes;
+	guint32 flags;
+} CacheRevision;
+
+/* The author and subject were loaded, the strings are empty otherwise */
+#define CACHE_REVISION_DETAILS (1 << 0)
+
+typedef struct
+{
+	gint8 type;
+	gint8 color;
+	guint16 num_from;
+	guint32 from;
+	guint32 boundary;
+} CacheLane;
+
+static void
+header_key(gchar const *key, gchar *ret)
+{
+	gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+
+	memcpy(ret, checksum, HASH_SHA_SIZE);
+	g_free(checksum);
+}
+
+/* Authors are stored once, at the offset they were first seen at */
+static guint32
+string_offset(GHashTable *authors, gchar const *author, guint32 *size)
+{
+	gpointer offset = g_hash_table_lookup(authors, author);
+
+	if (offset)
+		return GPOINTER_TO_UINT(offset) - 1;
+
+	g_hash_table_insert(authors, (gpointer)author, GUINT_TO_POINTER(*size + 1));
+
+	offset = GUINT_TO_POINTER(*size + 1);
+	*size += strlen(author) + 1;
+
+	return GPOINTER_TO_UINT(offset) - 1;
+}
+
+/* The sections after the revisions are written to files of their own while
+   going over the revisions once, and appended once all are written */
+typedef struct
+{
+	FILE *lanes;
+	FILE *hashes;
+	FILE *from;
+	FILE *strings;
+} Sections;
+
+static gboolean
+sections_open(Sections *sections)
+{
+	sections->lanes = tmpfile();
+	sections->hashes = tmpfile();
+	sections->from = tmpfile();
+	sections->strings = tmpfile();
+
+	return sections->lanes && sections->hashes && sections->from && sections->strings;
+}
+
+static gboolean
+sections_failed(Sections *sections)
+{
+	return ferror(sections->lanes) || ferror(sections->hashes) || ferror(sections->from) || ferror(sections->strings);
+}
+
+static void
+sections_close(Sections *sections)
+{
+	FILE *files[] = {sections->lanes, sections->hashes, sections->from, sections->strings};
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(files); ++i)
+	{
+		if (files[i])
+			fclose(files[i]);
+	}
+}
+
+static void
+append_section(FILE *f, FILE *section)
+{
+	gchar buffer[64 * 1024];
+	gsize read;
+
+	rewind(section);
+
+	while ((read = fread(buffer, 1, sizeof(buffer), section)) > 0)
+		fwrite(buffer, 1, read, f);
+}
+
+/* Writes the records of rv, with the lanes laned has. The header counts
+   the records written so far, records refer to them by index */
+static void
+write_revision(FILE *f, Sections *sections, CacheHeader *header, GHashTable *authors, GitgRevision *rv, GitgRevision *laned)
+{
+	CacheRevision record = {{0,},};
+	GitgLaneRow *row = gitg_revision_get_lanes(laned);
+	gchar const *author = gitg_revision_get_author(rv);
+	gchar const *subject = gitg_revision_get_subject(rv);
+	guint32 strings = header->strings_size;
+	guint num_parents;
+	Hash *parents = gitg_revision_get_parents_hash(rv, &num_parents);
+	guint j;
+
+	memcpy(record.hash, gitg_revision_get_hash(rv), HASH_BINARY_SIZE);
+	record.sign = gitg_revision_get_sign(rv);
+	record.mylane = gitg_revision_get_mylane(laned);
+	record.num_parents = num_parents;
+	record.timestamp = gitg_revision_get_timestamp(rv);
+	record.flags = gitg_revision_has_details(rv) ? CACHE_REVISION_DETAILS : 0;
+
+	record.author = string_offset(authors, author, &header->strings_size);
+
+	if (header->strings_size != strings)
+		fwrite(author, 1, strlen(author) + 1, sections->strings);
+
+	record.subject = header->strings_size;
+	header->strings_size += strlen(subject) + 1;
+	fwrite(subject, 1, strlen(subject) + 1, sections->strings);
+
+	/* Boundary hashes follow the parents of their revision */
+	record.parents = header->num_hashes;
+	header->num_hashes += num_parents;
+
+	if (num_parents)
+		fwrite(parents, sizeof(Hash), num_parents, sections->hashes);
+
+	record.lanes = header->num_lanes;
+	record.num_lanes = gitg_lane_row_length(row);
+
+	for (j = 0; j < record.num_lanes; ++j)
+	{
+		GitgLane *lane = &row->lanes[j];
+		CacheLane lane_record = {0,};
+
+		lane_record.type = lane->type;
+		lane_record.color = lane->color ? lane->color->index : 0;
+		lane_record.num_from = lane->num_from;
+		lane_record.from = header->num_from + lane->from;
+
+		if (GITG_IS_LANE_BOUNDARY(lane))
+		{
+			lane_record.boundary = header->num_hashes + lane->boundary;
+			fwrite(gitg_lane_row_get_hash(row, lane), sizeof(Hash), 1, sections->hashes);
+		}
+
+		fwrite(&lane_record, sizeof(lane_record), 1, sections->lanes);
+		fwrite(gitg_lane_row_get_from(row, lane), sizeof(gint8), lane->num_from, sections->from);
+	}
+
+	header->num_lanes += record.num_lanes;
+	header->num_from += row ? row->num_from : 0;
+	header->num_hashes += row ? row->num_hashes : 0;
+
+	fwrite(&record, sizeof(record), 1, f);
+}
+
+/* Writes revisions and their current lanes to filename, replacing it
+   atomically. tips are stored along, they are handed back on load. Rows
+   which do not keep their lanes get them from lanes_func, which is called
+   for every row in order when given. The revisions are gone over once */
+gboolean
+gitg_history_cache_save(gchar const *filename,
+                        gchar const *key,
+                        gchar const *tips,
+                        GitgRevision **revisions,
+                        guint num,
+                        GitgHistoryCacheLanesFunc lanes_func,
+                        gpointer userdata,
+                        GError **error)
+{
+	CacheHeader header = {{0,},};
+	GHashTable *authors = g_hash_table_new(g_str_hash, g_str_equal);
+	gchar *dirname = g_path_get_dirname(filename);
+	gchar *tmp = g_strconcat(filename, ".tmp", NULL);
+	Sections sections = {NULL,};
+	gboolean ret = FALSE;
+	gboolean failed;
+	FILE *f = NULL;
+	guint i;
+
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.byte_order = CACHE_BYTE_ORDER;
+	header_key(key, header.key);
+	header.num_revisions = num;
+	header.tips_size = strlen(tips) + 1;
+
+	if (g_mkdir_with_parents(dirname, 0700) != 0 || !(f = g_fopen(tmp, "wb")))
+	{
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Could not open %s: %s", tmp, g_strerror(errno));
+		goto out;
+	}
+
+	if (!sections_open(&sections))
+	{
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Could not open temporary file: %s", g_strerror(errno));
+		fclose(f);
+		g_unlink(tmp);
+
+		goto out;
+	}
+
+	/* Written again once the sections are counted */
+	fwrite(&header, sizeof(header), 1, f);
+
+	for (i = 0; i < num; ++i)
+	{
+		GitgRevision *laned = lanes_func ? lanes_func(i, userdata) : revisions[i];
+		write_revision(f, &sections, &header, authors, revisions[i], laned);
+	}
+
+	append_section(f, sections.lanes);
+	append_section(f, sections.hashes);
+	append_section(f, sections.from);
+	fwrite(tips, 1, header.tips_size, f);
+	append_section(f, sections.strings);
+
+	rewind(f);
+	fwrite(&header, sizeof(header), 1, f);
+
+	failed = ferror(f) != 0 || sections_failed(&sections);
+
+	if (fclose(f) != 0 || failed)
+	{
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Could not write %s: %s", tmp, g_strerror(errno));
+		g_unlink(tmp);
+
+		goto out;
+	}
+
+	if (g_rename(tmp, filename) != 0)
+	{
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Could not write %s: %s", filename, g_strerror(errno));
+		g_unlink(tmp);
+
+		goto out;
+	}
+
+	ret = TRUE;
+
+out:
+	sections_close(&sections);
+	g_hash_table_destroy(authors);
+	g_free(dirname);
+	g_free(tmp);
+
+	return ret;
+}
+
+static GitgColor *
+cached_color(GitgColor **colors, gint8 index)
+{
+	guint8 slot = (guint8)index;
+
+	if (!colors[slot])
+		colors[slot] = gitg_color_new(index);
+
+	return colors[slot];
+}
+
+static GitgLaneRow *
+load_lanes(CacheHeader const *header,
+           CacheLane const *lanes,
+           Hash const *hashes,
+           gint8 const *from,
+           CacheRevision const *record,
+           GitgColor **colors)
+{
+	GitgLaneSpec *specs = g_new(GitgLaneSpec, record->num_lanes);
+	GitgLaneRow *ret;
+	guint i;
+
+	for (i = 0; i < record->num_lanes; ++i)
+	{
+		CacheLane const *cached = &lanes[record->lanes + i];
+		GitgLaneSpec *spec = &specs[i];
+
+		spec->type = cached->type;
+		spec->color = cached_color(colors, cached->color);
+		spec->from = from + cached->from;
+		spec->num_from = cached->num_from;
+		spec->hash = GITG_IS_LANE_BOUNDARY(spec) ? hashes[cached->boundary] : NULL;
+	}
+
+	ret = gitg_lane_row_new(specs, record->num_lanes);
+	g_free(specs);
+
+	return ret;
+}
+
+/* Checks that everything record refers to is inside the file */
+static gboolean
+record_valid(CacheHeader const *header, CacheRevision const *record, CacheLane const *lanes)
+{
+	guint num_from = 0;
+	guint i;
+
+	if (record->author >= header->strings_size ||
+	    record->subject >= header->strings_size ||
+	    (guint64)record->parents + record->num_parents > header->num_hashes ||
+	    (guint64)record->lanes + record->num_lanes > header->num_lanes ||
+	    record->num_lanes > G_MAXUINT16)
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < record->num_lanes; ++i)
+	{
+		CacheLane const *lane = &lanes[record->lanes + i];
+
+		if ((guint64)lane->from + lane->num_from > header->num_from)
+			return FALSE;
+
+		/* Has to fit in a row */
+		num_from += lane->num_from;
+
+		if (lane->num_from > G_MAXUINT8 || num_from > G_MAXUINT16)
+			return FALSE;
+
+		if ((lane->type & (GITG_LANE_TYPE_START | GITG_LANE_TYPE_END)) &&
+		    lane->boundary >= header->num_hashes)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Returns the revisions stored in filename with their lanes, or NULL when
+   there is no valid cache for key. Revisions are allocated from arena, tips
+   is set to the tips they were saved with */
+GPtrArray *
+gitg_history_cache_load(gchar const *filename, gchar const *key, gchar **tips, GitgRevisionArena *arena)
+{
+	GMappedFile *file = g_mapped_file_new(filename, FALSE, NULL);
+	CacheHeader const *header;
+	CacheRevision const *revisions;
+	CacheLane const *lanes;
+	Hash const *hashes;
+	gint8 const *from;
+	gchar const *stored_tips;
+	gchar const *strings;
+	gchar expected[HASH_SHA_SIZE];
+	GitgColor *colors[256] = {NULL,};
+	GPtrArray *ret = NULL;
+	gchar const *data;
+	gsize length;
+	guint64 size;
+	guint i;
+
+	if (!file)
+		return NULL;
+
+	data = g_mapped_file_get_contents(file);
+	length = g_mapped_file_get_length(file);
+
+	header = (CacheHeader const *)data;
+	header_key(key, expected);
+
+	if (length < sizeof(CacheHeader) ||
+	    memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != CACHE_VERSION ||
+	    header->byte_order != CACHE_BYTE_ORDER ||
+	    memcmp(header->key, expected, HASH_SHA_SIZE) != 0)
+	{
+		goto out;
+	}
+
+	size = sizeof(CacheHeader) +
+	       (guint64)header->num_revisions * sizeof(CacheRevision) +
+	       (guint64)header->num_lanes * sizeof(CacheLane) +
+	       (guint64)header->num_hashes * sizeof(Hash) +
+	       (guint64)header->num_from +
+	       (guint64)header->tips_size +
+	       (guint64)header->strings_size;
+
+	/* Strings must be terminated, whatever offset they are read at */
+	if (size != length || (header->strings_size && data[length - 1] != '\0'))
+		goto out;
+
+	revisions = (CacheRevision const *)(header + 1);
+	lanes = (CacheLane const *)(revisions + header->num_revisions);
+	hashes = (Hash const *)(lanes + header->num_lanes);
+	from = (gint8 const *)(hashes + header->num_hashes);
+	stored_tips = (gchar const *)(from + header->num_from);
+	strings = stored_tips + header->tips_size;
+
+	if (header->tips_size == 0 || stored_tips[header->tips_size - 1] != '\0')
+		goto out;
+
+	ret = g_ptr_array_sized_new(header->num_revisions);
+
+	for (i = 0; i < header->num_revisions; ++i)
+	{
+		CacheRevision const *record = &revisions[i];
+
+		if (!record_valid(header, record, lanes))
+		{
+			g_ptr_array_foreach(ret, (GFunc)gitg_revision_unref, NULL);
+			g_ptr_array_free(ret, TRUE);
+			ret = NULL;
+
+			break;
+		}
+
+		gboolean details = (record->flags & CACHE_REVISION_DETAILS) != 0;
+		GitgRevision *rv = gitg_revision_new_from_hashes(arena,
+		                                                 record->hash,
+		                                                 details ? strings + record->author : NULL,
+		                                                 details ? strings + record->subject : NULL,
+		                                                 hashes + record->parents,
+		                                                 record->num_parents,
+		                                                 record->timestamp);
+
+		gitg_revision_set_sign(rv, record->sign);
+		gitg_revision_set_lanes(rv, load_lanes(header, lanes, hashes, from, record, colors), record->mylane);
+
+		g_ptr_array_add(ret, rv);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(colors); ++i)
+		gitg_color_unref(colors[i]);
+
+	if (ret)
+		*tips = g_strdup(stored_tips);
+
+out:
+	g_mapped_file_free(file);
+	return ret;
+}
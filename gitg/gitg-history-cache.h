@@ -0,0 +1,47 @@
+/*
+ * gitg-history-cache.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_HISTORY_CACHE_H__
+#define __GITG_HISTORY_CACHE_H__
+
+#include <glib.h>
+
+#include "gitg-revision.h"
+
+G_BEGIN_DECLS
+
+/* Returns a revision laid out like the row at index, for rows which do not
+   keep their lanes */
+typedef GitgRevision *(*GitgHistoryCacheLanesFunc)(guint index, gpointer userdata);
+
+/* Loaded revisions and their lanes, stored in a file which is mapped on
+   load. A cache is only used when it was saved with the same key, which
+   should cover the arguments of the history and its layout. The tips the
+   history was loaded for are stored with it, so it can be brought up to
+   date when they moved */
+gboolean gitg_history_cache_save(gchar const *filename, gchar const *key, gchar const *tips, GitgRevision **revisions, guint num, 
+                                 GitgHistoryCacheLanesFunc lanes_func, gpointer userdata, GError **error);
+GPtrArray *gitg_history_cache_load(gchar const *filename, gchar const *key, gchar **tips, GitgRevisionArena *arena);
+
+G_END_DECLS
+
+#endif /* __GITG_HISTORY_CACHE_H__ */
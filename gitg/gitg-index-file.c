@@ -0,0 +1,302 @@
+/*
+ * gitg-index-file.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-index-file.h"
+#include "gitg-types.h"
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <string.h>
+
+/* See Documentation/gitformat-index.txt in git. All numbers are in network
+   byte order */
+#define INDEX_SIGNATURE "DIRC"
+#define INDEX_HEADER_SIZE 12
+
+/* ctime, mtime, dev, ino, mode, uid, gid and size, then the hash and the
+   flags. The name follows, or the extended flags first */
+#define ENTRY_MODE_OFFSET 24
+#define ENTRY_HASH_OFFSET 40
+#define ENTRY_FLAGS_OFFSET (ENTRY_HASH_OFFSET + HASH_BINARY_SIZE)
+#define ENTRY_SIZE (ENTRY_FLAGS_OFFSET + 2)
+
+#define FLAG_EXTENDED 0x4000
+#define FLAG_STAGE 0x3000
+
+#define EXTENSION_ID(a, b, c, d) (((guint32)(a) << 24) | ((guint32)(b) << 16) | ((guint32)(c) << 8) | (guint32)(d))
+
+/* Entries of a split index live partly in the shared index, a sparse index
+   has directories in place of the files below them */
+#define EXTENSION_LINK EXTENSION_ID('l', 'i', 'n', 'k')
+#define EXTENSION_SPARSE EXTENSION_ID('s', 'd', 'i', 'r')
+
+typedef struct
+{
+	guint32 mode;
+	Hash hash;
+} Entry;
+
+struct _GitgIndexFile
+{
+	gchar *filename;
+	struct stat st;
+
+	/* Path to Entry */
+	GHashTable *entries;
+};
+
+static inline guint32
+read_uint32(guchar const *data)
+{
+	guint32 value;
+
+	memcpy(&value, data, sizeof(value));
+	return GUINT32_FROM_BE(value);
+}
+
+static inline guint16
+read_uint16(guchar const *data)
+{
+	guint16 value;
+
+	memcpy(&value, data, sizeof(value));
+	return GUINT16_FROM_BE(value);
+}
+
+/* The offset encoding of varint.c in git, used for the name compression of
+   version 4 */
+static gboolean
+read_varint(guchar const **data, guchar const *end, gsize *value)
+{
+	guchar c;
+	gsize val;
+
+	if (*data >= end)
+		return FALSE;
+
+	c = *(*data)++;
+	val = c & 127;
+
+	while (c & 128)
+	{
+		if (*data >= end)
+			return FALSE;
+
+		c = *(*data)++;
+		val = ((val + 1) << 7) + (c & 127);
+	}
+
+	*value = val;
+	return TRUE;
+}
+
+static gboolean
+same_stat(struct stat const *a, struct stat const *b)
+{
+	return a->st_mtime == b->st_mtime &&
+	       a->st_size == b->st_size &&
+	       a->st_ino == b->st_ino &&
+	       a->st_dev == b->st_dev;
+}
+
+static void
+entry_free(Entry *entry)
+{
+	g_slice_free(Entry, entry);
+}
+
+static gboolean
+read_entries(GitgIndexFile *index, guchar const *data, guchar const *end)
+{
+	GString *name = g_string_new("");
+	guchar const *entry;
+	guint32 version;
+	guint32 num;
+	guint32 i;
+	gboolean ret = FALSE;
+
+	/* The file ends in a checksum */
+	if (end - data < INDEX_HEADER_SIZE + HASH_BINARY_SIZE || memcmp(data, INDEX_SIGNATURE, 4) != 0)
+		goto out;
+
+	version = read_uint32(data + 4);
+	num = read_uint32(data + 8);
+
+	if (version < 2 || version > 4)
+		goto out;
+
+	end -= HASH_BINARY_SIZE;
+	entry = data + INDEX_HEADER_SIZE;
+
+	for (i = 0; i < num; ++i)
+	{
+		guchar const *p = entry + ENTRY_SIZE;
+		guchar const *nul;
+		guint16 flags;
+
+		if (end - entry < ENTRY_SIZE)
+			goto out;
+
+		flags = read_uint16(entry + ENTRY_FLAGS_OFFSET);
+
+		if (flags & FLAG_EXTENDED)
+		{
+			if (version < 3 || end - p < 2)
+				goto out;
+
+			p += 2;
+		}
+
+		/* Version 4 names strip a number of bytes from the end of the
+		   previous name and append the rest */
+		if (version == 4)
+		{
+			gsize strip;
+
+			if (!read_varint(&p, end, &strip) || strip > name->len)
+				goto out;
+
+			g_string_truncate(name, name->len - strip);
+		}
+		else
+		{
+			g_string_truncate(name, 0);
+		}
+
+		nul = memchr(p, '\0', end - p);
+
+		if (!nul)
+			goto out;
+
+		g_string_append_len(name, (gchar const *)p, nul - p);
+
+		if ((flags & FLAG_STAGE) == 0)
+		{
+			Entry *e = g_slice_new(Entry);
+
+			e->mode = read_uint32(entry + ENTRY_MODE_OFFSET);
+			memcpy(e->hash, entry + ENTRY_HASH_OFFSET, HASH_BINARY_SIZE);
+
+			g_hash_table_insert(index->entries, g_strndup(name->str, name->len), e);
+		}
+
+		/* Older versions pad entries with NULs to a multiple of 8 */
+		if (version == 4)
+			entry = nul + 1;
+		else
+			entry += ((nul - entry) + 8) & ~7;
+	}
+
+	/* Extensions, the entries are not complete with some of them */
+	while (entry <= end && end - entry >= 8)
+	{
+		guint32 id = read_uint32(entry);
+		guint32 size = read_uint32(entry + 4);
+
+		if (id == EXTENSION_LINK || id == EXTENSION_SPARSE || size > (guint64)(end - entry - 8))
+			goto out;
+
+		entry += 8 + size;
+	}
+
+	ret = TRUE;
+
+out:
+	g_string_free(name, TRUE);
+	return ret;
+}
+
+GitgIndexFile *
+gitg_index_file_new(gchar const *git_dir)
+{
+	GitgIndexFile *index = g_slice_new0(GitgIndexFile);
+	GMappedFile *file;
+	gboolean ret;
+
+	index->filename = g_build_filename(git_dir, "index", NULL);
+	index->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)entry_free);
+
+	/* Stat before reading, a change in between makes it stale */
+	if (g_stat(index->filename, &index->st) != 0 ||
+	    !(file = g_mapped_file_new(index->filename, FALSE, NULL)))
+	{
+		gitg_index_file_free(index);
+		return NULL;
+	}
+
+	ret = read_entries(index,
+	                   (guchar const *)g_mapped_file_get_contents(file),
+	                   (guchar const *)g_mapped_file_get_contents(file) + g_mapped_file_get_length(file));
+
+	g_mapped_file_free(file);
+
+	if (!ret)
+	{
+		gitg_index_file_free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+void
+gitg_index_file_free(GitgIndexFile *index)
+{
+	if (!index)
+		return;
+
+	g_hash_table_destroy(index->entries);
+	g_free(index->filename);
+
+	g_slice_free(GitgIndexFile, index);
+}
+
+gboolean
+gitg_index_file_is_stale(GitgIndexFile *index)
+{
+	struct stat st;
+
+	g_return_val_if_fail(index != NULL, TRUE);
+
+	return g_stat(index->filename, &st) != 0 || !same_stat(&st, &index->st);
+}
+
+gboolean
+gitg_index_file_lookup(GitgIndexFile *index, gchar const *path, guint32 *mode, gchar *hash)
+{
+	Entry *entry;
+
+	g_return_val_if_fail(index != NULL, FALSE);
+
+	entry = g_hash_table_lookup(index->entries, path);
+
+	if (!entry)
+		return FALSE;
+
+	if (mode)
+		*mode = entry->mode;
+
+	if (hash)
+		memcpy(hash, entry->hash, HASH_BINARY_SIZE);
+
+	return TRUE;
+}
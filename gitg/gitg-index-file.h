@@ -0,0 +1,47 @@
+/*
+ * gitg-index-file.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_INDEX_FILE_H__
+#define __GITG_INDEX_FILE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GitgIndexFile GitgIndexFile;
+
+/* The stage 0 entries of the index of git_dir, read once without spawning
+   git. Returns NULL when the index can not be read this way (unknown
+   versions, split and sparse indices) */
+GitgIndexFile *gitg_index_file_new(gchar const *git_dir);
+void gitg_index_file_free(GitgIndexFile *index);
+
+/* Whether the index file changed on disk since index was read */
+gboolean gitg_index_file_is_stale(GitgIndexFile *index);
+
+/* Looks up the entry of path (relative to the work tree). mode and hash
+   (binary) may be NULL */
+gboolean gitg_index_file_lookup(GitgIndexFile *index, gchar const *path, guint32 *mode, gchar *hash);
+
+G_END_DECLS
+
+#endif /* __GITG_INDEX_FILE_H__ */
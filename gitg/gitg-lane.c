@@ -22,65 +22,251 @@
 
 #include "gitg-lane.h"
 
-/* GitgLane functions */
-GitgLane *
-gitg_lane_copy(GitgLane *lane)
+#include <string.h>
+
+/* GitgLaneRow functions */
+static gsize
+row_size(guint num_lanes, guint num_from, guint num_hashes)
+{
+	return sizeof(GitgLaneRow) + 
+	       num_lanes * sizeof(GitgLane) + 
+	       num_from * sizeof(gint8) + 
+	       num_hashes * sizeof(Hash);
+}
+
+static gint8 *
+row_from(GitgLaneRow *row)
+{
+	return (gint8 *)(row->lanes + row->num_lanes);
+}
+
+static gchar *
+row_hashes(GitgLaneRow *row)
 {
-	GitgLane *copy = g_slice_new(GitgLane);
-	copy->color = gitg_color_ref(lane->color);
-	copy->from = g_slist_copy(lane->from);
-	copy->type = lane->type;
+	return (gchar *)(row_from(row) + row->num_from);
+}
+
+/* Packs lanes into a new row, referencing their colors */
+GitgLaneRow *
+gitg_lane_row_new(GitgLaneSpec const *lanes, guint num)
+{
+	GitgLaneRow *row;
+	guint num_from = 0;
+	guint num_hashes = 0;
+	guint i;
+	
+	for (i = 0; i < num; ++i)
+	{
+		GitgLaneSpec const *spec = &lanes[i];
+		
+		num_from += spec->num_from;
+		
+		if (GITG_IS_LANE_BOUNDARY(spec))
+			++num_hashes;
+	}
+	
+	row = g_slice_alloc(row_size(num, num_from, num_hashes));
+	row->num_lanes = num;
+	row->num_from = num_from;
+	row->num_hashes = num_hashes;
+	
+	num_from = 0;
+	num_hashes = 0;
+	
+	for (i = 0; i < num; ++i)
+	{
+		GitgLaneSpec const *spec = &lanes[i];
+		GitgLane *lane = &row->lanes[i];
+		
+		lane->color = gitg_color_ref(spec->color);
+		lane->type = spec->type;
+		lane->from = num_from;
+		lane->num_from = spec->num_from;
+		lane->boundary = 0;
+		
+		if (spec->num_from)
+			memcpy(row_from(row) + num_from, spec->from, spec->num_from * sizeof(gint8));
 
+		num_from += spec->num_from;
+		
+		if (GITG_IS_LANE_BOUNDARY(spec))
+		{
+			gchar *hash = row_hashes(row) + num_hashes * HASH_BINARY_SIZE;
+			
+			if (spec->hash)
+				memcpy(hash, spec->hash, HASH_BINARY_SIZE);
+			else
+				memset(hash, 0, HASH_BINARY_SIZE);
+			
+			lane->boundary = num_hashes++;
+		}
+	}
+	
+	return row;
+}
+
+GitgLaneRow *
+gitg_lane_row_copy(GitgLaneRow *row)
+{
+	GitgLaneRow *copy;
+	guint i;
+	
+	if (row == NULL)
+		return NULL;
+	
+	copy = g_slice_copy(row_size(row->num_lanes, row->num_from, row->num_hashes), row);
+	
+	for (i = 0; i < copy->num_lanes; ++i)
+		gitg_color_ref(copy->lanes[i].color);
+	
 	return copy;
 }
 
+void
+gitg_lane_row_free(GitgLaneRow *row)
+{
+	guint i;
+	
+	if (row == NULL)
+		return;
+	
+	for (i = 0; i < row->num_lanes; ++i)
+		gitg_color_unref(row->lanes[i].color);
+	
+	g_slice_free1(row_size(row->num_lanes, row->num_from, row->num_hashes), row);
+}
+
+guint
+gitg_lane_row_length(GitgLaneRow *row)
+{
+	return row ? row->num_lanes : 0;
+}
+
 GitgLane *
-gitg_lane_dup(GitgLane *lane)
+gitg_lane_row_get(GitgLaneRow *row, guint index)
+{
+	if (row == NULL || index >= row->num_lanes)
+		return NULL;
+	
+	return &row->lanes[index];
+}
+
+/* The indices of the lanes in the previous row merging on lane */
+gint8 *
+gitg_lane_row_get_from(GitgLaneRow *row, GitgLane *lane)
+{
+	return row_from(row) + lane->from;
+}
+
+/* The hash of a boundary lane, NULL for other lanes */
+gchar const *
+gitg_lane_row_get_hash(GitgLaneRow *row, GitgLane *lane)
 {
-	GitgLane *dup = g_slice_new(GitgLane);
-	dup->color = gitg_color_copy(lane->color);
-	dup->from = g_slist_copy(lane->from);
-	dup->type = lane->type;
+	if (!GITG_IS_LANE_BOUNDARY(lane))
+		return NULL;
 	
-	return dup;
+	return row_hashes(row) + lane->boundary * HASH_BINARY_SIZE;
 }
 
+/* Describes the lane at index, pointing into row */
 void
-gitg_lane_free(GitgLane *lane)
+gitg_lane_row_get_spec(GitgLaneRow *row, guint index, GitgLaneSpec *spec)
 {
-	gitg_color_unref(lane->color);
-	g_slist_free(lane->from);
+	GitgLane *lane = &row->lanes[index];
 	
-	if (GITG_IS_LANE_BOUNDARY(lane))
-		g_slice_free(GitgLaneBoundary, (GitgLaneBoundary *)lane);
-	else
-		g_slice_free(GitgLane, lane);
+	spec->color = lane->color;
+	spec->type = lane->type;
+	spec->from = gitg_lane_row_get_from(row, lane);
+	spec->num_from = lane->num_from;
+	spec->hash = gitg_lane_row_get_hash(row, lane);
 }
 
-GitgLane *
-gitg_lane_new()
+/* Rows are changed by packing them anew, the functions below free row and
+   return the changed one */
+static GitgLaneSpec *
+row_specs(GitgLaneRow *row, GitgLaneSpec *specs)
 {
-	return gitg_lane_new_with_color(NULL);
+	guint i;
+	
+	for (i = 0; i < gitg_lane_row_length(row); ++i)
+		gitg_lane_row_get_spec(row, i, &specs[i]);
+	
+	return specs;
 }
 
-GitgLane *
-gitg_lane_new_with_color(GitgColor *color)
+GitgLaneRow *
+gitg_lane_row_remove(GitgLaneRow *row, guint index)
 {
-	GitgLane *lane = g_slice_new0(GitgLane);
-	lane->color = color ? gitg_color_ref(color) : gitg_color_next();
+	GitgLaneSpec *specs;
+	GitgLaneRow *ret;
+	guint num = gitg_lane_row_length(row);
+	
+	g_return_val_if_fail(index < num, row);
+	
+	specs = row_specs(row, g_newa(GitgLaneSpec, num));
+	memmove(specs + index, specs + index + 1, (num - index - 1) * sizeof(GitgLaneSpec));
+	
+	ret = gitg_lane_row_new(specs, num - 1);
+	gitg_lane_row_free(row);
 	
-	return lane;
+	return ret;
 }
 
-GitgLaneBoundary *
-gitg_lane_convert_boundary(GitgLane *lane, GitgLaneType type)
+GitgLaneRow *
+gitg_lane_row_insert(GitgLaneRow *row, guint index, GitgLaneSpec const *lane)
+{
+	GitgLaneSpec *specs;
+	GitgLaneRow *ret;
+	guint num = gitg_lane_row_length(row);
+	
+	g_return_val_if_fail(index <= num, row);
+	
+	specs = row_specs(row, g_newa(GitgLaneSpec, num + 1));
+	memmove(specs + index + 1, specs + index, (num - index) * sizeof(GitgLaneSpec));
+	specs[index] = *lane;
+	
+	ret = gitg_lane_row_new(specs, num + 1);
+	gitg_lane_row_free(row);
+	
+	return ret;
+}
+
+/* Turns the lane at index into a boundary to hash */
+GitgLaneRow *
+gitg_lane_row_set_boundary(GitgLaneRow *row, guint index, GitgLaneType type, gchar const *hash)
+{
+	GitgLaneSpec *specs;
+	GitgLaneRow *ret;
+	guint num = gitg_lane_row_length(row);
+	
+	g_return_val_if_fail(index < num, row);
+	
+	specs = row_specs(row, g_newa(GitgLaneSpec, num));
+	specs[index].type |= type;
+	specs[index].hash = hash;
+	
+	ret = gitg_lane_row_new(specs, num);
+	gitg_lane_row_free(row);
+	
+	return ret;
+}
+
+/* Updates the merge indices after a lane was inserted (direction 1) or
+   removed (direction -1) at index in the previous row */
+void
+gitg_lane_row_shift_merges(GitgLaneRow *row, gint8 index, gint direction)
 {
-	GitgLaneBoundary *boundary = g_slice_new(GitgLaneBoundary);
+	gint8 *from;
+	guint i;
 	
-	boundary->lane = *lane;
-	boundary->lane.type |= type;
+	if (row == NULL)
+		return;
 	
-	g_slice_free(GitgLane, lane);
+	from = row_from(row);
 	
-	return boundary;
+	for (i = 0; i < row->num_from; ++i)
+	{
+		if ((direction < 0 && from[i] > index) || (direction > 0 && from[i] >= index))
+			from[i] += direction;
+	}
 }
@@ -40,25 +40,49 @@ typedef enum
 	GITG_LANE_SIGN_UNSTAGED = 1 << 6,
 } GitgLaneType;
 
+/* The lanes of a row are stored in a single block: the lanes, followed by
+   the merge indices of all lanes and the hashes of the boundary lanes */
 typedef struct
 {
-	GitgColor *color; /** Pointer to color */
-	GSList *from; /** List of lanes merging on this lane */
+	GitgColor *color; /** Pointer to color, shared along the lane */
+	guint16 from; /** Offset of the merges on this lane in the merge indices */
+	guint16 boundary; /** Index of the hash of a boundary lane */
+	guint8 num_from; /** Number of lanes merging on this lane */
 	gint8 type;
 } GitgLane;
 
 typedef struct
 {
-	GitgLane lane;
-	Hash hash;
-} GitgLaneBoundary;
+	guint16 num_lanes;
+	guint16 num_from;
+	guint16 num_hashes;
+	
+	GitgLane lanes[];
+} GitgLaneRow;
 
-GitgLane *gitg_lane_new();
-GitgLane *gitg_lane_new_with_color(GitgColor *color);
-GitgLane *gitg_lane_copy(GitgLane *lane);
-GitgLane *gitg_lane_dup(GitgLane *lane);
+/* Description of a lane to store in a row */
+typedef struct
+{
+	GitgColor *color;
+	gint8 type;
+	gint8 const *from;
+	guint num_from;
+	gchar const *hash; /** Hash of a boundary lane */
+} GitgLaneSpec;
+
+GitgLaneRow *gitg_lane_row_new(GitgLaneSpec const *lanes, guint num);
+GitgLaneRow *gitg_lane_row_copy(GitgLaneRow *row);
+void gitg_lane_row_free(GitgLaneRow *row);
+
+guint gitg_lane_row_length(GitgLaneRow *row);
+GitgLane *gitg_lane_row_get(GitgLaneRow *row, guint index);
+gint8 *gitg_lane_row_get_from(GitgLaneRow *row, GitgLane *lane);
+gchar const *gitg_lane_row_get_hash(GitgLaneRow *row, GitgLane *lane);
+void gitg_lane_row_get_spec(GitgLaneRow *row, guint index, GitgLaneSpec *spec);
 
-void gitg_lane_free(GitgLane *lane);
-GitgLaneBoundary *gitg_lane_convert_boundary(GitgLane *lane, GitgLaneType type);
+GitgLaneRow *gitg_lane_row_remove(GitgLaneRow *row, guint index);
+GitgLaneRow *gitg_lane_row_insert(GitgLaneRow *row, guint index, GitgLaneSpec const *lane);
+GitgLaneRow *gitg_lane_row_set_boundary(GitgLaneRow *row, guint index, GitgLaneType type, gchar const *hash);
+void gitg_lane_row_shift_merges(GitgLaneRow *row, gint8 index, gint direction);
 
 #endif /* __GITG_LANE_H__ */
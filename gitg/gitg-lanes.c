@@ -22,7 +22,7 @@
 
 #include "gitg-lanes.h"
 #include "gitg-utils.h"
-#include <string.h>
+#include "gitg-hash-index.h"
 
 #define GITG_LANES_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_LANES, GitgLanesPrivate))
 
@@ -37,7 +37,13 @@ enum
 
 typedef struct
 {
-	GitgLane *lane;
+	GitgColor *color;
+	
+	/* indices of the lanes merging on this lane */
+	gint8 *merges;
+	guint num_merges;
+	guint merges_size;
+
 	guint8 inactive;
 	gchar const *from;
 	gchar const *to;
@@ -63,12 +69,27 @@ struct _GitgLanesPrivate
 	
 	/* hash table of rev hash -> CollapsedLane where rev hash is the hash
 	   to be expected on the lane */
-	GHashTable *collapsed;
+	GitgHashIndex *collapsed;
 	
 	gint inactive_max;
 	gint inactive_collapse;
 	gint inactive_gap;
 	gboolean inactive_enabled;
+	
+	/* Position in the color palette, each layout has its own so they can
+	   run next to each other */
+	gint8 color_index;
+};
+
+/* The state of the lanes before a revision. The revisions laid out after
+   restoring it get the same lanes they got the first time, the colors aside
+   since those change along a lane after the fact */
+struct _GitgLanesCheckpoint
+{
+	GSList *lanes;
+	GSList *previous;
+	GSList *collapsed;
+	gint8 color_index;
 };
 
 G_DEFINE_TYPE(GitgLanes, gitg_lanes, G_TYPE_OBJECT)
@@ -76,7 +97,8 @@ G_DEFINE_TYPE(GitgLanes, gitg_lanes, G_TYPE_OBJECT)
 static void
 lane_container_free(LaneContainer *container)
 {
-	gitg_lane_free(container->lane);
+	gitg_color_unref(container->color);
+	g_free(container->merges);
 	g_slice_free(LaneContainer, container);
 }
 
@@ -91,7 +113,7 @@ static CollapsedLane *
 collapsed_lane_new(LaneContainer *container)
 {
 	CollapsedLane *collapsed = g_slice_new(CollapsedLane);
-	collapsed->color = gitg_color_ref(container->lane->color);
+	collapsed->color = gitg_color_ref(container->color);
 	collapsed->from = container->from;
 	collapsed->to = container->to;
 	
@@ -141,7 +163,7 @@ gitg_lanes_finalize(GObject *object)
 	GitgLanes *self = GITG_LANES(object);
 	
 	gitg_lanes_reset(self);
-	g_hash_table_destroy(self->priv->collapsed);
+	gitg_hash_index_free(self->priv->collapsed);
 	
 	G_OBJECT_CLASS(gitg_lanes_parent_class)->finalize(object);
 }
@@ -246,7 +268,7 @@ static void
 gitg_lanes_init(GitgLanes *self)
 {
 	self->priv = GITG_LANES_GET_PRIVATE(self);
-	self->priv->collapsed = g_hash_table_new_full(gitg_utils_hash_hash, gitg_utils_hash_equal, NULL, (GDestroyNotify)collapsed_lane_free);
+	self->priv->collapsed = gitg_hash_index_new((GDestroyNotify)collapsed_lane_free);
 }
 
 GitgLanes *
@@ -262,83 +284,93 @@ lane_container_new_with_color(gchar const *from, gchar const *to, GitgColor *col
 
 	ret->from = from;
 	ret->to = to;
-	ret->lane = gitg_lane_new_with_color(color);
+	ret->color = color ? gitg_color_ref(color) : gitg_color_next();
+	ret->merges = NULL;
+	ret->num_merges = 0;
+	ret->merges_size = 0;
 	ret->inactive = 0;
 
 	return ret;
 }
 
 static LaneContainer *
-lane_container_new(gchar const *from, gchar const *to)
+lane_container_new(GitgLanes *lanes, gchar const *from, gchar const *to)
 {
-	return lane_container_new_with_color(from, to, NULL);
+	GitgColor *color = gitg_color_next_from(&lanes->priv->color_index);
+	LaneContainer *ret = lane_container_new_with_color(from, to, color);
+	
+	gitg_color_unref(color);
+	return ret;
 }
 
-GSList *
+static void
+lane_container_add_merge(LaneContainer *container, gint8 index)
+{
+	if (container->num_merges == container->merges_size)
+	{
+		container->merges_size = container->merges_size ? container->merges_size * 2 : 2;
+		container->merges = g_renew(gint8, container->merges, container->merges_size);
+	}
+	
+	container->merges[container->num_merges++] = index;
+}
+
+static GitgLaneRow *
 lanes_list(GitgLanes *lanes)
 {
-	GSList *lns = NULL;
+	GitgLaneSpec *specs = g_newa(GitgLaneSpec, g_slist_length(lanes->priv->lanes));
 	GSList *item;
+	guint num = 0;
 	
 	for (item = lanes->priv->lanes; item; item = item->next)
-		lns = g_slist_prepend(lns, gitg_lane_copy(((LaneContainer*)item->data)->lane));
+	{
+		LaneContainer *container = (LaneContainer *)item->data;
+		GitgLaneSpec *spec = &specs[num++];
+		
+		spec->color = container->color;
+		spec->type = GITG_LANE_TYPE_NONE;
+		spec->from = container->merges;
+		spec->num_from = container->num_merges;
+		spec->hash = NULL;
+	}
 	
-	return g_slist_reverse(lns);
+	return gitg_lane_row_new(specs, num);
 }
 
 void
 gitg_lanes_reset(GitgLanes *lanes)
 {
 	free_lanes(lanes);
-	gitg_color_reset();
+	lanes->priv->color_index = 0;
 	
 	g_slist_foreach(lanes->priv->previous, (GFunc)gitg_revision_unref, NULL);
 	g_slist_free(lanes->priv->previous);
 	lanes->priv->previous = NULL;
 	
-	g_hash_table_remove_all(lanes->priv->collapsed);
+	gitg_hash_index_remove_all(lanes->priv->collapsed);
 }
 
 static void
 lane_container_next(LaneContainer *container, gint index)
 {
-	GitgLane *lane = gitg_lane_copy(container->lane);
-	lane->type = GITG_LANE_TYPE_NONE;
-	g_slist_free(lane->from);
-	
-	gitg_lane_free(container->lane);
-
-	container->lane = lane;
-	container->lane->from = g_slist_prepend(NULL, GINT_TO_POINTER((gint)(index)));
+	container->num_merges = 0;
+	lane_container_add_merge(container, index);
 	
 	if (container->to)
 		++container->inactive;
 }
 
 static void
-update_lane_merge_indices(GSList *from, gint8 index, gint direction)
+update_lane_merge_indices(LaneContainer *container, gint8 index, gint direction)
 {
-	GSList *item;
+	guint i;
 	
-	for (item = from; item; item = g_slist_next(item))
+	for (i = 0; i < container->num_merges; ++i)
 	{
-		gint8 idx = GPOINTER_TO_INT(item->data);
+		gint8 idx = container->merges[i];
 
 		if ((direction < 0 && idx > index) || (direction > 0 && idx >= index))
-			item->data = GINT_TO_POINTER(idx + direction);
-	}
-}
-
-static void
-update_merge_indices(GSList *lanes, gint8 index, gint direction)
-{
-	GSList *item;
-	
-	for (item = lanes; item; item = g_slist_next(item))
-	{
-		GitgLane *lane = (GitgLane *)item->data;
-		
-		update_lane_merge_indices(lane->from, index, direction);
+			container->merges[i] = idx + direction;
 	}
 }
 
@@ -348,7 +380,7 @@ add_collapsed(GitgLanes *lanes, LaneContainer *container, gint8 index)
 	CollapsedLane *collapsed = collapsed_lane_new(container);
 	collapsed->index = index;
 	
-	g_hash_table_insert(lanes->priv->collapsed, (gpointer)container->to, collapsed);
+	gitg_hash_index_insert(lanes->priv->collapsed, container->to, collapsed);
 }
 
 static void
@@ -363,21 +395,19 @@ collapse_lane(GitgLanes *lanes, LaneContainer *container, gint8 index)
 	for (item = lanes->priv->previous; item; item = g_slist_next(item))
 	{
 		GitgRevision *revision = GITG_REVISION(item->data);
-		GSList *lns = gitg_revision_get_lanes(revision);
+		GitgLaneRow *lns = gitg_revision_get_lanes(revision);
 		
 		/* remove lane at 'index' and update merge indices for the lanes
 		   after 'index' in the list */
 		if (item->next)
 		{
-			GSList *collapsed = g_slist_nth(lns, index);
-			GitgLane *lane = (GitgLane *)collapsed->data;
-			
-			gint8 newindex = GPOINTER_TO_INT(lane->from->data);
+			GitgLane *lane = gitg_lane_row_get(lns, index);
+			gint8 newindex = lane->num_from ? gitg_lane_row_get_from(lns, lane)[0] : index;
 
-			lns = gitg_revision_remove_lane(revision, lane);
+			lns = gitg_revision_remove_lane(revision, index);
 			
 			if (item->next->next)
-				update_merge_indices(lns, newindex, -1);
+				gitg_lane_row_shift_merges(lns, newindex, -1);
 			
 			gint mylane = gitg_revision_get_mylane(revision);
 			
@@ -388,13 +418,9 @@ collapse_lane(GitgLanes *lanes, LaneContainer *container, gint8 index)
 		}
 		else
 		{
-			/* the last item we keep, and set the style of the lane to END */
-			GSList *lstlane = g_slist_nth(lns, index);
-			GitgLaneBoundary *boundary = gitg_lane_convert_boundary((GitgLane *)lstlane->data, GITG_LANE_TYPE_END);
-			
-			/* copy parent hash over */
-			memcpy(boundary->hash, container->to, HASH_BINARY_SIZE);
-			lstlane->data = boundary;
+			/* the last item we keep, and set the style of the lane to END,
+			   ending on the parent hash */
+			gitg_revision_set_lane_boundary(revision, index, GITG_LANE_TYPE_END, container->to);
 		}
 	}	
 }
@@ -405,7 +431,7 @@ update_current_lanes_merge_indices(GitgLanes *lanes, gint8 index, gint8 directio
 	GSList *item;
 	
 	for (item = lanes->priv->lanes; item; item = g_slist_next(item))
-		update_lane_merge_indices(((LaneContainer *)item->data)->lane->from, index, direction);
+		update_lane_merge_indices((LaneContainer *)item->data, index, direction);
 }
 
 static void
@@ -425,7 +451,7 @@ collapse_lanes(GitgLanes *lanes)
 			continue;
 		}
 
-		collapse_lane(lanes, container, GPOINTER_TO_INT(container->lane->from->data));
+		collapse_lane(lanes, container, container->merges[0]);
 		update_current_lanes_merge_indices(lanes, index, -1);
 		
 		GSList *next = g_slist_next(item);
@@ -440,7 +466,7 @@ collapse_lanes(GitgLanes *lanes)
 static gint8
 ensure_correct_index(GitgRevision *revision, gint8 index)
 {
-	guint len = g_slist_length(gitg_revision_get_lanes(revision));
+	guint len = gitg_lane_row_length(gitg_revision_get_lanes(revision));
 	
 	if (index > len)
 		index = len;
@@ -454,7 +480,6 @@ expand_lane(GitgLanes *lanes, CollapsedLane *lane)
 	GSList *item;
 	gint8 index = lane->index;
 
-	GitgLane *ln = gitg_lane_new_with_color(lane->color);
 	guint len = g_slist_length(lanes->priv->lanes);
 	gint8 next;
 	
@@ -466,7 +491,7 @@ expand_lane(GitgLanes *lanes, CollapsedLane *lane)
 
 	update_current_lanes_merge_indices(lanes, index, 1);
 
-	container->lane->from = g_slist_prepend(NULL, GINT_TO_POINTER((gint)next));
+	lane_container_add_merge(container, next);
 	lanes->priv->lanes = g_slist_insert(lanes->priv->lanes, container, index);
 
 	index = next;
@@ -480,27 +505,24 @@ expand_lane(GitgLanes *lanes, CollapsedLane *lane)
 			break;
 
 		/* insert new lane at the index */
-		GitgLane *copy = gitg_lane_copy(ln);
-		GSList *lns = gitg_revision_get_lanes(revision);
+		GitgLaneSpec spec = {lane->color, GITG_LANE_TYPE_NONE, &next, 0, NULL};
 
 		if (!item->next || cnt + 1 == lanes->priv->inactive_collapse)
 		{
-			GitgLaneBoundary *boundary = gitg_lane_convert_boundary(copy, GITG_LANE_TYPE_START);
-			
-			/* copy child hash in boundary */
-			memcpy(boundary->hash, lane->from, HASH_BINARY_SIZE);
-			copy = (GitgLane *)boundary;
+			/* starts from the child hash */
+			spec.type = GITG_LANE_TYPE_START;
+			spec.hash = lane->from;
 		}
 		else
 		{
 			next = ensure_correct_index(GITG_REVISION(item->next->data), index);
-			copy->from = g_slist_prepend(NULL, GINT_TO_POINTER((gint)next));
+			spec.num_from = 1;
 			
 			/* update merge indices */
-			update_merge_indices(lns, index, 1);
+			gitg_lane_row_shift_merges(gitg_revision_get_lanes(revision), index, 1);
 		}
 
-		lns = gitg_revision_insert_lane(revision, copy, index);
+		gitg_revision_insert_lane(revision, index, &spec);
 		gint mylane = gitg_revision_get_mylane(revision);
 		
 		if (mylane >= index)
@@ -509,20 +531,18 @@ expand_lane(GitgLanes *lanes, CollapsedLane *lane)
 		index = next;
 		++cnt;
 	}
-	
-	gitg_lane_free(ln);
 }
 
 static void
 expand_lane_from_hash(GitgLanes *lanes, gchar const *hash)
 {
-	CollapsedLane *collapsed = (CollapsedLane *)g_hash_table_lookup(lanes->priv->collapsed, hash);
+	CollapsedLane *collapsed = (CollapsedLane *)gitg_hash_index_lookup(lanes->priv->collapsed, hash);
 
 	if (!collapsed)
 		return;
 	
 	expand_lane(lanes, collapsed);
-	g_hash_table_remove(lanes->priv->collapsed, hash);
+	gitg_hash_index_remove(lanes->priv->collapsed, hash);
 }
 
 static void
@@ -581,8 +601,8 @@ prepare_lanes(GitgLanes *lanes, GitgRevision *next, gint8 *pos)
 			/* There already is a lane for this parent. This means that we add
 			   mypos as a merge for the lane, also this means the color of 
 			   this lane incluis the merge should change to one color */
-			container->lane->from = g_slist_append(container->lane->from, GINT_TO_POINTER((gint)*pos));
-			gitg_color_next_index(container->lane->color);
+			lane_container_add_merge(container, *pos);
+			gitg_color_next_index_from(container->color, &lanes->priv->color_index);
 			container->inactive = 0;
 			container->from = gitg_revision_get_hash(next);
 			
@@ -598,21 +618,21 @@ prepare_lanes(GitgLanes *lanes, GitgRevision *next, gint8 *pos)
 			   since this revision is a merge */
 			if (num > 1)
 			{
-				gitg_color_unref(mylane->lane->color);
-				mylane->lane->color = gitg_color_next();
+				gitg_color_unref(mylane->color);
+				mylane->color = gitg_color_next_from(&lanes->priv->color_index);
 			}
 			else
 			{
-				GitgColor *nc = gitg_color_copy(mylane->lane->color);
-				gitg_color_unref(mylane->lane->color);
-				mylane->lane->color = nc;
+				GitgColor *nc = gitg_color_copy(mylane->color);
+				gitg_color_unref(mylane->color);
+				mylane->color = nc;
 			}
 		}
 		else
 		{
 			/* Generate a new lane for this parent */
-			LaneContainer *newlane = lane_container_new(myhash, parents[i]);
-			newlane->lane->from = g_slist_prepend(NULL, GINT_TO_POINTER((gint)*pos));
+			LaneContainer *newlane = lane_container_new(lanes, myhash, parents[i]);
+			lane_container_add_merge(newlane, *pos);
 			lanes->priv->lanes = g_slist_append(lanes->priv->lanes, newlane);
 		}
 	}
@@ -635,11 +655,11 @@ prepare_lanes(GitgLanes *lanes, GitgRevision *next, gint8 *pos)
 	lanes->priv->previous = g_slist_prepend(lanes->priv->previous, gitg_revision_ref(next));
 }
 
-GSList *
+GitgLaneRow *
 gitg_lanes_next(GitgLanes *lanes, GitgRevision *next, gint8 *nextpos)
 {
 	LaneContainer *mylane;
-	GSList *res;
+	GitgLaneRow *res;
 	gchar const *myhash = gitg_revision_get_hash(next);
 
 	if (lanes->priv->inactive_enabled)
@@ -654,16 +674,16 @@ gitg_lanes_next(GitgLanes *lanes, GitgRevision *next, gint8 *nextpos)
 	{
 		/* apparently, there is no lane reserved for this revision, we
 		   add a new one */
-		lanes->priv->lanes = g_slist_append(lanes->priv->lanes, lane_container_new(myhash, NULL));
+		lanes->priv->lanes = g_slist_append(lanes->priv->lanes, lane_container_new(lanes, myhash, NULL));
 		*nextpos = g_slist_length(lanes->priv->lanes) - 1;
 	}
 	else
 	{
 		/* copy the color here because this represents a new stop */
-		GitgColor *nc = gitg_color_copy(mylane->lane->color);
-		gitg_color_unref(mylane->lane->color);
+		GitgColor *nc = gitg_color_copy(mylane->color);
+		gitg_color_unref(mylane->color);
 
-		mylane->lane->color = nc;
+		mylane->color = nc;
 		mylane->to = NULL;
 		mylane->from = gitg_revision_get_hash(next);
 		mylane->inactive = 0;
@@ -674,3 +694,167 @@ gitg_lanes_next(GitgLanes *lanes, GitgRevision *next, gint8 *nextpos)
 
 	return res;
 }
+
+/* Checkpoints copy the colors, keeping them shared the way they were */
+static GitgColor *
+copy_color(GHashTable *colors, GitgColor *color)
+{
+	GitgColor *copy = g_hash_table_lookup(colors, color);
+	
+	if (!copy)
+	{
+		copy = gitg_color_copy(color);
+		g_hash_table_insert(colors, color, copy);
+	}
+	
+	return gitg_color_ref(copy);
+}
+
+static GitgLaneRow *
+copy_lanes(GHashTable *colors, GitgLaneRow *lanes)
+{
+	GitgLaneRow *copy = gitg_lane_row_copy(lanes);
+	guint i;
+	
+	for (i = 0; i < gitg_lane_row_length(copy); ++i)
+	{
+		GitgLane *lane = &copy->lanes[i];
+		GitgColor *color = copy_color(colors, lane->color);
+		
+		gitg_color_unref(lane->color);
+		lane->color = color;
+	}
+	
+	return copy;
+}
+
+static LaneContainer *
+copy_container(GHashTable *colors, LaneContainer *container)
+{
+	LaneContainer *copy = g_slice_dup(LaneContainer, container);
+	
+	copy->color = copy_color(colors, container->color);
+	copy->merges = g_memdup(container->merges, container->merges_size * sizeof(gint8));
+
+	return copy;
+}
+
+static CollapsedLane *
+copy_collapsed(GHashTable *colors, CollapsedLane *collapsed)
+{
+	CollapsedLane *copy = g_slice_dup(CollapsedLane, collapsed);
+	
+	copy->color = copy_color(colors, collapsed->color);
+	return copy;
+}
+
+/* Collapsing and expanding change the lanes of the previous revisions, they
+   are copied along with their lanes so the originals are left alone */
+static GitgRevision *
+copy_revision(GHashTable *colors, GitgRevision *revision)
+{
+	guint num;
+	Hash *parents = gitg_revision_get_parents_hash(revision, &num);
+	GitgRevision *copy = gitg_revision_new_from_hashes(NULL, 
+	                                                   gitg_revision_get_hash(revision), 
+	                                                   NULL, 
+	                                                   NULL, 
+	                                                   (Hash const *)parents, 
+	                                                   num, 
+	                                                   gitg_revision_get_timestamp(revision));
+	
+	gitg_revision_set_sign(copy, gitg_revision_get_sign(revision));
+	gitg_revision_set_lanes(copy, copy_lanes(colors, gitg_revision_get_lanes(revision)), gitg_revision_get_mylane(revision));
+	
+	return copy;
+}
+
+typedef struct
+{
+	GHashTable *colors;
+	GSList *collapsed;
+} CopyCollapsed;
+
+static void
+add_collapsed_copy(gchar const *hash, CollapsedLane *collapsed, CopyCollapsed *copy)
+{
+	copy->collapsed = g_slist_prepend(copy->collapsed, copy_collapsed(copy->colors, collapsed));
+}
+
+static GHashTable *
+new_color_map()
+{
+	return g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)gitg_color_unref);
+}
+
+/* Saves the state of the lanes, safe to call from the thread laying them out */
+GitgLanesCheckpoint *
+gitg_lanes_save(GitgLanes *lanes)
+{
+	GitgLanesCheckpoint *checkpoint = g_slice_new0(GitgLanesCheckpoint);
+	GHashTable *colors = new_color_map();
+	CopyCollapsed collapsed = {colors, NULL};
+	GSList *item;
+	
+	for (item = lanes->priv->lanes; item; item = g_slist_next(item))
+		checkpoint->lanes = g_slist_prepend(checkpoint->lanes, copy_container(colors, (LaneContainer *)item->data));
+	
+	for (item = lanes->priv->previous; item; item = g_slist_next(item))
+		checkpoint->previous = g_slist_prepend(checkpoint->previous, copy_revision(colors, GITG_REVISION(item->data)));
+	
+	gitg_hash_index_foreach(lanes->priv->collapsed, (GitgHashIndexFunc)add_collapsed_copy, &collapsed);
+	
+	checkpoint->lanes = g_slist_reverse(checkpoint->lanes);
+	checkpoint->previous = g_slist_reverse(checkpoint->previous);
+	checkpoint->collapsed = collapsed.collapsed;
+	checkpoint->color_index = lanes->priv->color_index;
+	
+	g_hash_table_destroy(colors);
+	return checkpoint;
+}
+
+/* Continues the layout from checkpoint, which can be restored again later */
+void
+gitg_lanes_restore(GitgLanes *lanes, GitgLanesCheckpoint *checkpoint)
+{
+	GHashTable *colors = new_color_map();
+	GSList *item;
+	
+	gitg_lanes_reset(lanes);
+	
+	for (item = checkpoint->lanes; item; item = g_slist_next(item))
+		lanes->priv->lanes = g_slist_prepend(lanes->priv->lanes, copy_container(colors, (LaneContainer *)item->data));
+	
+	for (item = checkpoint->previous; item; item = g_slist_next(item))
+		lanes->priv->previous = g_slist_prepend(lanes->priv->previous, copy_revision(colors, GITG_REVISION(item->data)));
+	
+	for (item = checkpoint->collapsed; item; item = g_slist_next(item))
+	{
+		CollapsedLane *collapsed = copy_collapsed(colors, (CollapsedLane *)item->data);
+		gitg_hash_index_insert(lanes->priv->collapsed, collapsed->to, collapsed);
+	}
+	
+	lanes->priv->lanes = g_slist_reverse(lanes->priv->lanes);
+	lanes->priv->previous = g_slist_reverse(lanes->priv->previous);
+	lanes->priv->color_index = checkpoint->color_index;
+	
+	g_hash_table_destroy(colors);
+}
+
+void
+gitg_lanes_checkpoint_free(GitgLanesCheckpoint *checkpoint)
+{
+	if (!checkpoint)
+		return;
+	
+	g_slist_foreach(checkpoint->lanes, (GFunc)lane_container_free, NULL);
+	g_slist_free(checkpoint->lanes);
+	
+	g_slist_foreach(checkpoint->previous, (GFunc)gitg_revision_unref, NULL);
+	g_slist_free(checkpoint->previous);
+	
+	g_slist_foreach(checkpoint->collapsed, (GFunc)collapsed_lane_free, NULL);
+	g_slist_free(checkpoint->collapsed);
+	
+	g_slice_free(GitgLanesCheckpoint, checkpoint);
+}
@@ -40,6 +40,7 @@ G_BEGIN_DECLS
 typedef struct _GitgLanes			GitgLanes;
 typedef struct _GitgLanesClass		GitgLanesClass;
 typedef struct _GitgLanesPrivate	GitgLanesPrivate;
+typedef struct _GitgLanesCheckpoint	GitgLanesCheckpoint;
 
 struct _GitgLanes {
 	GObject parent;
@@ -55,7 +56,11 @@ GType gitg_lanes_get_type (void) G_GNUC_CONST;
 
 GitgLanes *gitg_lanes_new(void);
 void gitg_lanes_reset(GitgLanes *lanes);
-GSList *gitg_lanes_next(GitgLanes *lanes, GitgRevision *next, gint8 *mylane);
+GitgLaneRow *gitg_lanes_next(GitgLanes *lanes, GitgRevision *next, gint8 *mylane);
+
+GitgLanesCheckpoint *gitg_lanes_save(GitgLanes *lanes);
+void gitg_lanes_restore(GitgLanes *lanes, GitgLanesCheckpoint *checkpoint);
+void gitg_lanes_checkpoint_free(GitgLanesCheckpoint *checkpoint);
 
 G_END_DECLS
 
@@ -43,6 +43,8 @@ enum
 	PROP_HISTORY_SHOW_VIRTUAL_STAGED,
 	PROP_HISTORY_SHOW_VIRTUAL_UNSTAGED,
 	
+	PROP_HISTORY_RELATIVE_DATES,
+	
 	PROP_MESSAGE_SHOW_RIGHT_MARGIN,
 	PROP_MESSAGE_RIGHT_MARGIN_AT,
 	
@@ -399,6 +401,19 @@ gitg_preferences_class_init(GitgPreferencesClass *klass)
 							      TRUE,
 							      G_PARAM_READWRITE));
 
+	install_property_binding(PROP_HISTORY_RELATIVE_DATES, 
+							 "view/history",
+							 "relative-dates", 
+							 wrap_get_boolean,
+							 wrap_set_boolean);
+
+	g_object_class_install_property(object_class, PROP_HISTORY_RELATIVE_DATES,
+					 g_param_spec_boolean("history-relative-dates",
+							      "HISTORY_RELATIVE_DATES",
+							      "Show recent dates relative to now in history",
+							      FALSE,
+							      G_PARAM_READWRITE));
+
 
 	install_property_binding(PROP_MESSAGE_SHOW_RIGHT_MARGIN, 
 							 "commit/message",
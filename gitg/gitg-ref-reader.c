@@ -0,0 +1,469 @@
+/*
+ * gitg-ref-reader.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-ref-reader.h"
+#include "gitg-types.h"
+
+#include <string.h>
+
+#define PACKED_REFS_HEADER "# pack-refs with:"
+
+/* Symbolic refs pointing to symbolic refs are followed this deep */
+#define MAX_SYMBOLIC_DEPTH 5
+
+typedef struct
+{
+	gchar *name;
+	gchar sha1[HASH_SHA_SIZE + 1];
+
+	/* Name of the ref a symbolic ref points to */
+	gchar *target;
+} LooseRef;
+
+typedef struct
+{
+	GitgRefReaderFunc func;
+	gpointer user_data;
+
+	/* Loose refs sorted by name, the ones before next_loose are done */
+	GPtrArray *loose;
+	guint next_loose;
+	GHashTable *loose_names;
+
+	/* Packed refs which symbolic refs point to, name to sha1 */
+	GHashTable *targets;
+} Reader;
+
+static gboolean
+is_sha1(gchar const *str, gsize length)
+{
+	gsize i;
+
+	if (length < HASH_SHA_SIZE || (length > HASH_SHA_SIZE && !g_ascii_isspace(str[HASH_SHA_SIZE])))
+		return FALSE;
+
+	for (i = 0; i < HASH_SHA_SIZE; ++i)
+	{
+		if (!g_ascii_isxdigit(str[i]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Whether the refs are kept in files, and not in a reftable */
+static gboolean
+stored_in_files(gchar const *git_dir)
+{
+	gchar *path = g_build_filename(git_dir, "reftable", NULL);
+	gboolean ret = g_file_test(git_dir, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_EXISTS);
+
+	g_free(path);
+	return ret;
+}
+
+static LooseRef *
+loose_ref_new(gchar const *name, gchar const *contents, gsize length)
+{
+	LooseRef *ref;
+
+	if (g_str_has_prefix(contents, "ref: "))
+	{
+		ref = g_slice_new0(LooseRef);
+		ref->target = g_strchomp(g_strdup(contents + 5));
+	}
+	else if (is_sha1(contents, length))
+	{
+		ref = g_slice_new0(LooseRef);
+		memcpy(ref->sha1, contents, HASH_SHA_SIZE);
+	}
+	else
+	{
+		return NULL;
+	}
+
+	ref->name = g_strdup(name);
+	return ref;
+}
+
+static void
+loose_ref_free(LooseRef *ref)
+{
+	g_free(ref->name);
+	g_free(ref->target);
+
+	g_slice_free(LooseRef, ref);
+}
+
+static gint
+compare_loose(LooseRef **a, LooseRef **b)
+{
+	return strcmp((*a)->name, (*b)->name);
+}
+
+/* Collects the refs in directory path, name is the ref name of path */
+static void
+read_loose(GPtrArray *refs, gchar const *path, GString *name)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	gsize len = name->len;
+	gchar const *entry;
+
+	if (!dir)
+		return;
+
+	while ((entry = g_dir_read_name(dir)))
+	{
+		gchar *filename;
+		gchar *contents;
+		gsize length;
+
+		/* Refs which are being written */
+		if (g_str_has_suffix(entry, ".lock"))
+			continue;
+
+		filename = g_build_filename(path, entry, NULL);
+
+		g_string_append_c(name, '/');
+		g_string_append(name, entry);
+
+		if (g_file_test(filename, G_FILE_TEST_IS_DIR))
+		{
+			read_loose(refs, filename, name);
+		}
+		else if (g_file_get_contents(filename, &contents, &length, NULL))
+		{
+			LooseRef *ref = loose_ref_new(name->str, contents, length);
+
+			if (ref)
+				g_ptr_array_add(refs, ref);
+
+			g_free(contents);
+		}
+
+		g_string_truncate(name, len);
+		g_free(filename);
+	}
+
+	g_dir_close(dir);
+}
+
+/* Loose tags are not peeled on disk */
+static gchar const *
+loose_peeled(gchar const *name, gchar const *sha1)
+{
+	return g_str_has_prefix(name, "refs/tags/") ? NULL : sha1;
+}
+
+/* Follows a symbolic ref through the loose refs. Returns the name of the
+   ref it ends at, and sets sha1 when the object of that one is known */
+static gchar const *
+resolve_symbolic(Reader *reader, LooseRef *ref, gchar const **sha1)
+{
+	gint depth;
+
+	*sha1 = NULL;
+
+	for (depth = 0; ref->target && depth < MAX_SYMBOLIC_DEPTH; ++depth)
+	{
+		LooseRef *next = g_hash_table_lookup(reader->loose_names, ref->target);
+
+		if (!next)
+		{
+			gchar const *packed = g_hash_table_lookup(reader->targets, ref->target);
+
+			if (packed && *packed)
+				*sha1 = packed;
+
+			return ref->target;
+		}
+
+		ref = next;
+	}
+
+	if (!ref->target)
+		*sha1 = ref->sha1;
+
+	return ref->name;
+}
+
+/* Hands out the loose refs sorting before name, or all of them when name is
+   NULL. Returns whether there is a loose ref called name */
+static gboolean
+emit_loose_until(Reader *reader, gchar const *name)
+{
+	while (reader->next_loose < reader->loose->len)
+	{
+		LooseRef *ref = g_ptr_array_index(reader->loose, reader->next_loose);
+		gint cmp = name ? strcmp(ref->name, name) : -1;
+
+		if (cmp > 0)
+			return FALSE;
+
+		++reader->next_loose;
+
+		/* Symbolic refs go last, they may point to packed refs */
+		if (!ref->target)
+			reader->func(ref->name, ref->sha1, loose_peeled(ref->name, ref->sha1), reader->user_data);
+
+		if (cmp == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+emit_packed(Reader *reader, gchar const *name, gchar const *sha1, gchar const *peeled)
+{
+	if (g_hash_table_size(reader->targets))
+	{
+		gchar *target = g_hash_table_lookup(reader->targets, name);
+
+		if (target)
+			memcpy(target, sha1, HASH_SHA_SIZE);
+	}
+
+	if (!emit_loose_until(reader, name))
+		reader->func(name, sha1, peeled, reader->user_data);
+}
+
+static void
+parse_traits(gchar const *line, gchar const *eol, gboolean *peeled, gboolean *fully_peeled)
+{
+	gsize len = strlen(PACKED_REFS_HEADER);
+	gchar *traits = g_strndup(line + len, eol - line - len);
+	gchar *padded = g_strconcat(" ", traits, " ", NULL);
+
+	*peeled = strstr(padded, " peeled ") != NULL;
+	*fully_peeled = strstr(padded, " fully-peeled ") != NULL;
+
+	g_free(padded);
+	g_free(traits);
+}
+
+/* packed-refs has a line '<sha1> <name>' per ref, followed by '^<sha1>' with
+   the peeled object for tags. Which refs are peeled is told by the traits
+   in the header */
+static void
+read_packed(Reader *reader, gchar const *filename)
+{
+	GMappedFile *file = g_mapped_file_new(filename, FALSE, NULL);
+	GString *name;
+	gchar sha1[HASH_SHA_SIZE + 1] = {0,};
+	gchar peeled[HASH_SHA_SIZE + 1] = {0,};
+	gboolean has_ref = FALSE;
+	gboolean has_peeled = FALSE;
+	gboolean peeled_tags = FALSE;
+	gboolean fully_peeled = FALSE;
+	gchar const *data;
+	gchar const *end;
+	gchar const *line;
+	gchar const *next;
+
+	if (!file)
+		return;
+
+	data = g_mapped_file_get_contents(file);
+	end = data + g_mapped_file_get_length(file);
+	name = g_string_sized_new(256);
+
+	for (line = data; line < end; line = next)
+	{
+		gchar const *eol = memchr(line, '\n', end - line);
+
+		if (!eol)
+			eol = end;
+
+		next = eol + 1;
+
+		if (*line == '#')
+		{
+			if (line == data && eol - line >= strlen(PACKED_REFS_HEADER) &&
+			    strncmp(line, PACKED_REFS_HEADER, strlen(PACKED_REFS_HEADER)) == 0)
+			{
+				parse_traits(line, eol, &peeled_tags, &fully_peeled);
+			}
+
+			continue;
+		}
+
+		if (*line == '^')
+		{
+			if (has_ref && is_sha1(line + 1, eol - line - 1))
+			{
+				memcpy(peeled, line + 1, HASH_SHA_SIZE);
+				has_peeled = TRUE;
+			}
+
+			continue;
+		}
+
+		if (has_ref)
+		{
+			gboolean tag = g_str_has_prefix(name->str, "refs/tags/");
+
+			emit_packed(reader, name->str, sha1, has_peeled ? peeled : (!tag || peeled_tags || fully_peeled ? sha1 : NULL));
+		}
+
+		has_ref = FALSE;
+		has_peeled = FALSE;
+
+		if (eol - line < HASH_SHA_SIZE + 2 || !is_sha1(line, eol - line) || line[HASH_SHA_SIZE] != ' ')
+			continue;
+
+		memcpy(sha1, line, HASH_SHA_SIZE);
+
+		g_string_truncate(name, 0);
+		g_string_append_len(name, line + HASH_SHA_SIZE + 1, eol - line - HASH_SHA_SIZE - 1);
+
+		has_ref = TRUE;
+	}
+
+	if (has_ref)
+	{
+		gboolean tag = g_str_has_prefix(name->str, "refs/tags/");
+
+		emit_packed(reader, name->str, sha1, has_peeled ? peeled : (!tag || peeled_tags || fully_peeled ? sha1 : NULL));
+	}
+
+	g_string_free(name, TRUE);
+	g_mapped_file_free(file);
+}
+
+/* Refs come out sorted by name like for-each-ref lists them, except for
+   symbolic refs which come last */
+gboolean
+gitg_ref_reader_foreach(gchar const *git_dir, GitgRefReaderFunc func, gpointer user_data)
+{
+	Reader reader = {func, user_data, NULL, 0, NULL, NULL};
+	gchar *path;
+	GString *name;
+	guint i;
+
+	g_return_val_if_fail(git_dir != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	if (!stored_in_files(git_dir))
+		return FALSE;
+
+	path = g_build_filename(git_dir, "refs", NULL);
+
+	if (!g_file_test(path, G_FILE_TEST_IS_DIR))
+	{
+		g_free(path);
+		return FALSE;
+	}
+
+	reader.loose = g_ptr_array_new();
+	reader.loose_names = g_hash_table_new(g_str_hash, g_str_equal);
+	reader.targets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	name = g_string_new("refs");
+	read_loose(reader.loose, path, name);
+	g_string_free(name, TRUE);
+	g_free(path);
+
+	g_ptr_array_sort(reader.loose, (GCompareFunc)compare_loose);
+
+	for (i = 0; i < reader.loose->len; ++i)
+	{
+		LooseRef *ref = g_ptr_array_index(reader.loose, i);
+		g_hash_table_insert(reader.loose_names, ref->name, ref);
+	}
+
+	/* Symbolic refs which end up at packed refs pick up their object while
+	   packed-refs is read */
+	for (i = 0; i < reader.loose->len; ++i)
+	{
+		LooseRef *ref = g_ptr_array_index(reader.loose, i);
+		gchar const *sha1;
+		gchar const *end;
+
+		if (!ref->target)
+			continue;
+
+		end = resolve_symbolic(&reader, ref, &sha1);
+
+		if (!sha1 && !g_hash_table_lookup(reader.loose_names, end) && !g_hash_table_lookup(reader.targets, end))
+			g_hash_table_insert(reader.targets, g_strdup(end), g_malloc0(HASH_SHA_SIZE + 1));
+	}
+
+	path = g_build_filename(git_dir, "packed-refs", NULL);
+	read_packed(&reader, path);
+	g_free(path);
+
+	emit_loose_until(&reader, NULL);
+
+	for (i = 0; i < reader.loose->len; ++i)
+	{
+		LooseRef *ref = g_ptr_array_index(reader.loose, i);
+		gchar const *sha1;
+		gchar const *end;
+
+		if (!ref->target)
+			continue;
+
+		end = resolve_symbolic(&reader, ref, &sha1);
+
+		/* Dangling symbolic refs are left out, like git does */
+		if (sha1)
+			func(ref->name, sha1, loose_peeled(end, sha1), user_data);
+	}
+
+	g_hash_table_destroy(reader.targets);
+	g_hash_table_destroy(reader.loose_names);
+
+	g_ptr_array_foreach(reader.loose, (GFunc)loose_ref_free, NULL);
+	g_ptr_array_free(reader.loose, TRUE);
+
+	return TRUE;
+}
+
+gchar *
+gitg_ref_reader_head(gchar const *git_dir)
+{
+	gchar *filename;
+	gchar *contents;
+	gsize length;
+	gchar *ret = NULL;
+
+	g_return_val_if_fail(git_dir != NULL, NULL);
+
+	if (!stored_in_files(git_dir))
+		return NULL;
+
+	filename = g_build_filename(git_dir, "HEAD", NULL);
+
+	if (g_file_get_contents(filename, &contents, &length, NULL))
+	{
+		if (g_str_has_prefix(contents, "ref: "))
+			ret = g_strchomp(g_strdup(contents + 5));
+		else if (is_sha1(contents, length))
+			ret = g_strdup("HEAD");
+
+		g_free(contents);
+	}
+
+	g_free(filename);
+	return ret;
+}
@@ -0,0 +1,47 @@
+/*
+ * gitg-ref-reader.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_REF_READER_H__
+#define __GITG_REF_READER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Called for every ref under refs/ with the object it points to. peeled is
+   the object a tag points to, or sha1 itself when it is not a tag. It is
+   NULL when that is not recorded, which happens for tags which are not
+   peeled in packed-refs. Refs outside refs/tags are taken not to be tags */
+typedef void (*GitgRefReaderFunc)(gchar const *name, gchar const *sha1, gchar const *peeled, gpointer user_data);
+
+/* Reads packed-refs and the loose refs in git_dir, loose refs win over
+   packed ones. Returns FALSE, without calling func, when the refs are not
+   stored in files (reftable, a .git file for worktrees) */
+gboolean gitg_ref_reader_foreach(gchar const *git_dir, GitgRefReaderFunc func, gpointer user_data);
+
+/* Full name of the ref HEAD points to, "HEAD" when it is detached. NULL
+   when HEAD cannot be read from git_dir */
+gchar *gitg_ref_reader_head(gchar const *git_dir);
+
+G_END_DECLS
+
+#endif /* __GITG_REF_READER_H__ */
@@ -28,6 +28,13 @@
 #include "gitg-preferences.h"
 #include "gitg-data-binding.h"
 #include "gitg-config.h"
+#include "gitg-cat-file.h"
+#include "gitg-hash-index.h"
+#include "gitg-history-cache.h"
+#include "gitg-ref-reader.h"
+#include "gitg-commit-graph.h"
+#include "gitg-commit-graph-stream.h"
+#include "gitg-date-cache.h"
 
 #include <gio/gio.h>
 #include <glib/gi18n.h>
@@ -37,6 +44,52 @@
 
 #define GITG_REPOSITORY_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GITG_TYPE_REPOSITORY, GitgRepositoryPrivate))
 
+/* Git processes the views may run at the same time, the history loader is
+   not counted */
+#define SCHEDULER_MAX_RUNNING 2
+#define STORAGE_MIN_SIZE 1024
+
+/* A batch of at least BULK_INSERT_MIN rows is inserted in bulk when it adds
+   at least 1/BULK_INSERT_RATIO of the rows there are. Reattaching walks all
+   rows, a batch only pays that when it is a fair share of them. Each bulk
+   insert ends with its batch, views never show an empty history while it
+   loads */
+#define BULK_INSERT_MIN 256
+#define BULK_INSERT_RATIO 4
+
+/* Histories smaller than this load fast enough without a cache */
+#define HISTORY_CACHE_MIN_ROWS 5000
+
+/* Rows around a row without details which are loaded along with it, and
+   the most commits asked for at once */
+#define DETAILS_PREFETCH 64
+#define DETAILS_BATCH 512
+
+/* Author and subject shown until they are loaded (an ellipsis) */
+#define DETAILS_PLACEHOLDER "\xe2\x80\xa6"
+
+/* The lanes of long histories are paged. Every page of commits starts with
+   a checkpoint of the lanes, only the pages used last keep their lanes and
+   the others are laid out again from their checkpoint when shown. Commits
+   put in front of the history later belong to no page */
+#define LANES_PAGE_SIZE 2048
+#define LANES_PAGES_RESIDENT 16
+#define LANES_PAGED_MIN_ROWS 250000
+
+/* Hash of the staged and unstaged rows */
+#define DUMMY_SHA1 "0000000000000000000000000000000000000000"
+
+/* Relaning after an update stops once this many rows came out as before */
+#define RELANE_CONVERGE_ROWS 16
+
+/* Pages of relaned rows swapped in per main loop iteration */
+#define RELANE_CHUNKS_PER_IDLE 8
+
+/* Milliseconds the repository has to be quiet before changes are applied,
+   and the seconds they are held back at most */
+#define CHANGES_DELAY 250
+#define CHANGES_MAX_DELAY 2.0
+
 static void gitg_repository_tree_model_iface_init(GtkTreeModelIface *iface);
 
 G_DEFINE_TYPE_EXTENDED(GitgRepository, gitg_repository, G_TYPE_OBJECT, 0,
@@ -55,6 +108,9 @@ enum
 enum
 {
 	LOAD,
+	BEGIN_BULK_INSERT,
+	END_BULK_INSERT,
+	CHANGED,
 	LAST_SIGNAL
 };
 
@@ -69,12 +125,51 @@ enum
 	N_COLUMNS
 };
 
+/* Colors are shared along a lane and change when lanes merge, even after
+   the rows were laid out. A paged out page keeps the colors of its rows in
+   order of appearance, the layout from the checkpoint takes them over */
+typedef struct
+{
+	GitgLanesCheckpoint *checkpoint;
+	GPtrArray *colors;
+	guint used;
+} LanesPage;
+
+/* A relane runs on a thread of its own, on copies of the commits. The
+   thread hands out a chunk of laid out copies per page once the lanes of
+   the page are final, the main loop swaps their lanes into the rows */
+typedef struct
+{
+	gint ref_count;
+	GitgRepository *repository;
+	
+	GThread *thread;
+	GitgLanes *lanes;
+	GPtrArray *revisions;
+	GAsyncQueue *chunks;
+	gulong shift;
+	
+	/* The copies are allocated from an arena of the relane */
+	GitgRevisionArena *arena;
+	
+	gint cancelled;
+	gint idle_scheduled;
+	gboolean detached;
+} RelaneJob;
+
+/* The head chunk has the commits in front of the pages */
+typedef struct
+{
+	guint num;
+	GitgLanesCheckpoint *checkpoint;
+	GPtrArray *copies;
+	gboolean head;
+	gboolean end;
+} RelaneChunk;
+
 typedef enum
 {
 	LOAD_STAGE_NONE = 0,
-	LOAD_STAGE_STASH,
-	LOAD_STAGE_STAGED,
-	LOAD_STAGE_UNSTAGED,
 	LOAD_STAGE_COMMITS,
 	LOAD_STAGE_LAST
 } LoadStage;
@@ -83,26 +178,96 @@ struct _GitgRepositoryPrivate
 {
 	gchar *path;
 	GitgRunner *loader;
-	GHashTable *hashtable;
+	GitgHashIndex *hashtable;
 	gint stamp;
 	GType column_types[N_COLUMNS];
 	
 	GitgRevision **storage;
+	GitgRevisionArena *arena;
 	GitgLanes *lanes;
-	GHashTable *refs;
+	GitgHashIndex *refs;
 	GitgRef *current_ref;
 	GitgRef *working_ref;
 
 	gulong size;
 	gulong allocated;
-	gint grow_size;
+	
+	/* Number of rows of the previous load, storage is reserved for that many
+	   up front when loading again */
+	gulong size_hint;
 	
 	gchar **last_args;
 	guint idle_relane_id;
+	gboolean relane_pending;
+	RelaneJob *relane;
+	
+	/* Rows shown in the view, relaned rows outside are not announced */
+	gulong visible_first;
+	gulong visible_last;
+	
+	/* Pages of lanes, the loader thread adds them under pages_lock. laned
+	   counts the commits it laid out. The pages start after the pages_shift
+	   commits which were put in front later */
+	GMutex *pages_lock;
+	GPtrArray *pages;
+	GitgLanes *page_lanes;
+	guint laned;
+	gulong pages_shift;
+	guint pages_out;
+	guint pages_clock;
+	
+	GitgDateCache *date_cache;
 	
 	LoadStage load_stage;
-	
-	GFileMonitor *monitor;
+	GQueue *pending;
+	gulong pending_reach;
+	
+	/* The refs and the virtual rows load next to the history */
+	GitgRunner *refs_loader;
+	GitgRunner *stash_loader;
+	GitgRunner *staged_probe;
+	GitgRunner *unstaged_probe;
+	GitgLanes *virtual_lanes;
+	
+	/* The history is loaded without author and subject, they are loaded in
+	   batches for the rows which are shown. Requested holds the commits
+	   queued or being loaded, all is set while every commit is loaded */
+	GitgRunner *details_loader;
+	GitgHashIndex *details_requested;
+	GString *details_queue;
+	guint details_id;
+	gboolean details_all;
+	
+	/* Virtual rows at the top: stash entries, then staged and unstaged
+	   changes. commits_start counts all of them */
+	gulong num_stash;
+	gulong num_staged;
+	gulong commits_start;
+	
+	/* Labels of the staged and unstaged rows */
+	GitgDecoration *staged_decoration;
+	GitgDecoration *unstaged_decoration;
+	
+	/* The key and tips the history cache was last loaded or saved with */
+	gchar *history_key;
+	gchar *history_tips;
+	
+	GSList *git_monitors;
+	
+	/* Changes seen by the monitors which are not applied yet */
+	guint changes;
+	guint changes_id;
+	GTimer *changes_timer;
+	
+	/* Memoized output of read only queries, keyed by argv. Dropped whenever
+	   the generation is bumped (refs, HEAD, index or config changed) */
+	guint generation;
+	GHashTable *query_cache;
+	
+	GitgCatFile *cat_file_check;
+	GitgCatFile *cat_file;
+	
+	GitgScheduler *scheduler;
 };
 
 inline static gint
@@ -116,6 +281,9 @@ gitg_repository_error_quark()
 	return quark;
 }
 
+static void request_details(GitgRepository *repository, gint index);
+static void page_in_row(GitgRepository *repository, gulong index);
+
 /* GtkTreeModel implementations */
 static GtkTreeModelFlags 
 tree_model_get_flags(GtkTreeModel *tree_model)
@@ -200,16 +368,32 @@ tree_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, G
 	switch (column)
 	{
 		case OBJECT_COLUMN:
+			page_in_row(rp, index);
 			g_value_set_boxed(value, rv);
 		break;
 		case SUBJECT_COLUMN:
-			g_value_set_string(value, gitg_revision_get_subject(rv));
-		break;
 		case AUTHOR_COLUMN:
-			g_value_set_string(value, gitg_revision_get_author(rv));
+			if (!gitg_revision_has_details(rv))
+			{
+				request_details(rp, index);
+				g_value_set_static_string(value, DETAILS_PLACEHOLDER);
+			}
+			else if (column == SUBJECT_COLUMN)
+			{
+				g_value_set_string(value, gitg_revision_get_subject(rv));
+			}
+			else
+			{
+				g_value_set_string(value, gitg_revision_get_author(rv));
+			}
 		break;
 		case DATE_COLUMN:
-			g_value_take_string(value, gitg_utils_timestamp_to_str(gitg_revision_get_timestamp(rv)));
+			/* The history comes with the committer time, the author time
+			   shown arrives with the details */
+			if (gitg_revision_has_details(rv))
+				g_value_set_string(value, gitg_date_cache_lookup(rp->priv->date_cache, gitg_revision_get_timestamp(rv)));
+			else
+				g_value_set_string(value, "");
 		break;
 		default:
 			g_assert_not_reached();
@@ -308,12 +492,19 @@ gitg_repository_tree_model_iface_init(GtkTreeModelIface *iface)
 	iface->iter_parent = tree_model_iter_parent;
 }
 
+static void clear_lanes_pages(GitgRepository *repository);
+static void cancel_relane(GitgRepository *repository);
+static void decoration_free(GitgDecoration *decoration);
+
 static void
 do_clear(GitgRepository *repository, gboolean emit)
 {
 	gint i;
 	GtkTreePath *path = gtk_tree_path_new_from_indices(repository->priv->size - 1, -1);
 	
+	cancel_relane(repository);
+	clear_lanes_pages(repository);
+	
 	for (i = repository->priv->size - 1; i >= 0; --i)
 	{
 		if (emit)
@@ -329,46 +520,87 @@ do_clear(GitgRepository *repository, gboolean emit)
 	
 	gtk_tree_path_free(path);
 	
-	if (repository->priv->storage)
-		g_slice_free1(sizeof(GitgRevision *) * repository->priv->size, repository->priv->storage);
+	if (repository->priv->size > 0)
+		repository->priv->size_hint = repository->priv->size;
+
+	g_free(repository->priv->storage);
 	
 	repository->priv->storage = NULL;
 	repository->priv->size = 0;
 	repository->priv->allocated = 0;
+	repository->priv->commits_start = 0;
+	repository->priv->num_stash = 0;
+	repository->priv->num_staged = 0;
+	
+	/* Revisions still referenced elsewhere move out, the rows of the old
+	   arena are released right away */
+	gitg_revision_arena_detach(repository->priv->arena);
+	gitg_revision_arena_unref(repository->priv->arena);
+	repository->priv->arena = gitg_revision_arena_new();
 	
 	gitg_ref_free(repository->priv->current_ref);
 	repository->priv->current_ref = NULL;
 	
 	/* clear hash tables */
-	g_hash_table_remove_all(repository->priv->hashtable);
-	g_hash_table_remove_all(repository->priv->refs);
+	gitg_hash_index_remove_all(repository->priv->hashtable);
+	gitg_hash_index_remove_all(repository->priv->refs);
+	
+	gitg_hash_index_remove_all(repository->priv->details_requested);
+	g_string_truncate(repository->priv->details_queue, 0);
 	
 	gitg_color_reset();
 }
 
+static void flush_pending(GitgRepository *repository, gboolean add);
+static void cancel_loading(GitgRepository *repository);
+static gboolean loading(GitgRepository *repository);
+static gboolean update_history(GitgRepository *repository);
+
 static void
 gitg_repository_finalize(GObject *object)
 {
 	GitgRepository *rp = GITG_REPOSITORY(object);
 	
-	/* Make sure to cancel the loader */
-	gitg_runner_cancel(rp->priv->loader);
+	/* Make sure to cancel the loaders */
+	cancel_loading(rp);
 	g_object_unref(rp->priv->loader);
+	g_object_unref(rp->priv->refs_loader);
+	g_object_unref(rp->priv->stash_loader);
+	g_object_unref(rp->priv->details_loader);
+	g_object_unref(rp->priv->staged_probe);
+	g_object_unref(rp->priv->unstaged_probe);
+	
+	flush_pending(rp, FALSE);
+	g_queue_free(rp->priv->pending);
 	
 	g_object_unref(rp->priv->lanes);
+	g_object_unref(rp->priv->virtual_lanes);
+	g_object_unref(rp->priv->page_lanes);
 	
 	/* Clear the model to remove all revision objects */
 	do_clear(rp, FALSE);
+	gitg_revision_arena_unref(rp->priv->arena);
 	
 	/* Free the path */
 	g_free(rp->priv->path);
 	
 	/* Free the hash */
-	g_hash_table_destroy(rp->priv->hashtable);
-	g_hash_table_destroy(rp->priv->refs);
+	gitg_hash_index_free(rp->priv->hashtable);
+	gitg_hash_index_free(rp->priv->refs);
+	decoration_free(rp->priv->staged_decoration);
+	decoration_free(rp->priv->unstaged_decoration);
+	gitg_hash_index_free(rp->priv->details_requested);
+	g_string_free(rp->priv->details_queue, TRUE);
+	
+	g_ptr_array_free(rp->priv->pages, TRUE);
+	g_mutex_free(rp->priv->pages_lock);
+	
+	gitg_date_cache_free(rp->priv->date_cache);
 	
 	/* Free cached args */
 	g_strfreev(rp->priv->last_args);
+	g_free(rp->priv->history_key);
+	g_free(rp->priv->history_tips);
 	
 	if (rp->priv->idle_relane_id)
 	{
@@ -385,10 +617,38 @@ gitg_repository_finalize(GObject *object)
 		gitg_ref_free (rp->priv->working_ref);
 	}
 
-	if (rp->priv->monitor)
+	if (rp->priv->changes_id)
+	{
+		g_source_remove (rp->priv->changes_id);
+	}
+	
+	if (rp->priv->details_id)
+	{
+		g_source_remove(rp->priv->details_id);
+	}
+	
+	g_timer_destroy (rp->priv->changes_timer);
+	
+	g_slist_foreach (rp->priv->git_monitors, (GFunc)g_file_monitor_cancel, NULL);
+	g_slist_foreach (rp->priv->git_monitors, (GFunc)g_object_unref, NULL);
+	g_slist_free (rp->priv->git_monitors);
+	
+	g_hash_table_destroy (rp->priv->query_cache);
+	
+	/* Drain the cat-file processes */
+	if (rp->priv->cat_file_check)
+	{
+		g_object_unref (rp->priv->cat_file_check);
+	}
+	
+	if (rp->priv->cat_file)
+	{
+		g_object_unref (rp->priv->cat_file);
+	}
+	
+	if (rp->priv->scheduler)
 	{
-		g_file_monitor_cancel (rp->priv->monitor);
-		g_object_unref (rp->priv->monitor);
+		g_object_unref (rp->priv->scheduler);
 	}
 
 	G_OBJECT_CLASS (gitg_repository_parent_class)->finalize(object);
@@ -430,16 +690,76 @@ gitg_repository_get_property(GObject *object, guint prop_id, GValue *value, GPar
 	}
 }
 
+typedef struct
+{
+	gchar **output;
+} CachedQuery;
+
+static void
+cached_query_free (CachedQuery *cached)
+{
+	g_strfreev (cached->output);
+	g_slice_free (CachedQuery, cached);
+}
+
+/* The cache only holds entries of the current generation, it is emptied
+   by gitg_repository_invalidate */
+static CachedQuery *
+lookup_query (GitgRepository *repository, gchar const *key)
+{
+	return g_hash_table_lookup (repository->priv->query_cache, key);
+}
+
+/* Takes ownership of key, output (NULL for a failed query) is copied */
+static void
+cache_query (GitgRepository *repository, gchar *key, gchar **output)
+{
+	CachedQuery *cached = g_slice_new (CachedQuery);
+	
+	cached->output = g_strdupv (output);
+	
+	g_hash_table_insert (repository->priv->query_cache, key, cached);
+}
+
 static gchar *
 parse_ref_intern (GitgRepository *repository, gchar const *ref, gboolean symbolic)
 {
-	gchar **ret = gitg_repository_command_with_outputv(repository, NULL, "rev-parse", "--verify", symbolic ? "--symbolic-full-name" : ref, symbolic ? ref : NULL, NULL);
+	gchar *key = g_strconcat (symbolic ? "rev-parse " : "cat-file ", ref, NULL);
+	CachedQuery *cached = lookup_query (repository, key);
 	
-	if (!ret)
-		return NULL;
+	if (cached)
+	{
+		g_free (key);
+		return g_strdup (cached->output ? *cached->output : NULL);
+	}
+	
+	gchar *r;
+	
+	/* cat-file resolves names by the same rules as rev-parse, except that
+	   an ambiguous name silently resolves to its first match (refs/<name>,
+	   refs/tags/<name>, refs/heads/<name>, ...) where rev-parse --verify
+	   warns. Names it can not take on a line go to rev-parse */
+	if (!symbolic && !strchr (ref, '\n'))
+	{
+		r = gitg_repository_cat_file_check (repository, ref, NULL, NULL);
+	}
+	else if (!symbolic)
+	{
+		gchar **ret = gitg_repository_command_with_outputv(repository, NULL, "rev-parse", "--verify", ref, NULL);
+		
+		r = ret ? g_strdup(*ret) : NULL;
+		g_strfreev(ret);
+	}
+	else
+	{
+		gchar **ret = gitg_repository_command_with_outputv(repository, NULL, "rev-parse", "--verify", "--symbolic-full-name", ref, NULL);
+		
+		r = ret ? g_strdup(*ret) : NULL;
+		g_strfreev(ret);
+	}
 	
-	gchar *r = g_strdup(*ret);
-	g_strfreev(ret);
+	gchar *output[] = {r, NULL};
+	cache_query (repository, key, r ? output : NULL);
 	
 	return r;	
 }
@@ -463,51 +783,266 @@ get_current_working_ref(GitgRepository *repository)
 	return ret;
 }
 
+typedef void (*RefFunc)(GitgRepository *repository, gchar const *name, gchar const *sha1, gpointer data);
+
+static void foreach_ref(GitgRepository *repository, RefFunc func, gpointer data);
+static gboolean refresh_virtual(GitgRepository *repository);
+
+typedef struct
+{
+	GHashTable *old;
+	GSList *moved;
+} MovedRefs;
+
+static void
+on_moved_ref(GitgRepository *repository, gchar const *name, gchar const *sha1, MovedRefs *moved)
+{
+	gchar *key = g_strconcat(name, " ", sha1, NULL);
+	
+	if (!g_hash_table_remove(moved->old, key))
+		moved->moved = g_slist_prepend(moved->moved, g_strdup(name));
+	
+	g_free(key);
+}
+
+/* Names of the refs which are not in the refs map as they are on disk:
+   moved, created or deleted */
+static GSList *
+moved_refs(GitgRepository *repository)
+{
+	MovedRefs moved = {g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL), NULL};
+	GHashTable *names = g_hash_table_new(g_str_hash, g_str_equal);
+	GSList *refs = gitg_repository_get_refs(repository);
+	GSList *item;
+	GHashTableIter iter;
+	gchar *key;
+	
+	for (item = refs; item; item = g_slist_next(item))
+	{
+		GitgRef *ref = (GitgRef *)item->data;
+		gchar *sha1 = gitg_utils_hash_to_sha1_new(gitg_ref_get_hash(ref));
+		
+		g_hash_table_insert(moved.old, g_strconcat(gitg_ref_get_name(ref), " ", sha1, NULL), NULL);
+		g_free(sha1);
+	}
+	
+	foreach_ref(repository, (RefFunc)on_moved_ref, &moved);
+	
+	for (item = moved.moved; item; item = g_slist_next(item))
+		g_hash_table_insert(names, item->data, NULL);
+	
+	/* What is left in the old refs is gone. The map also has the older
+	   stash entries, which are not listed with the refs */
+	g_hash_table_iter_init(&iter, moved.old);
+	
+	while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL))
+	{
+		gchar *name = g_strndup(key, strrchr(key, ' ') - key);
+		
+		if (strcmp(name, "refs/stash") == 0 || g_hash_table_lookup_extended(names, name, NULL, NULL))
+		{
+			g_free(name);
+			continue;
+		}
+		
+		g_hash_table_insert(names, name, NULL);
+		moved.moved = g_slist_prepend(moved.moved, name);
+	}
+	
+	g_hash_table_destroy(names);
+	g_hash_table_destroy(moved.old);
+	
+	g_slist_foreach(refs, (GFunc)gitg_ref_free, NULL);
+	g_slist_free(refs);
+	
+	return moved.moved;
+}
+
+static gboolean
+flush_changes(GitgRepository *repository)
+{
+	/* A running load sees part of the changes already, apply them after */
+	if (loading(repository))
+		return TRUE;
+	
+	guint changes = repository->priv->changes;
+	GSList *refs = NULL;
+	
+	repository->priv->changes = GITG_REPOSITORY_CHANGE_NONE;
+	repository->priv->changes_id = 0;
+	
+	if ((changes & GITG_REPOSITORY_CHANGE_HEAD) && repository->priv->working_ref)
+	{
+		GitgRef *current = get_current_working_ref(repository);
+		
+		if (gitg_ref_equal(current, repository->priv->working_ref))
+			changes &= ~GITG_REPOSITORY_CHANGE_HEAD;
+		
+		gitg_ref_free(current);
+	}
+	
+	if (changes & GITG_REPOSITORY_CHANGE_REFS)
+		refs = moved_refs(repository);
+	
+	if (changes != GITG_REPOSITORY_CHANGE_NONE)
+		g_signal_emit(repository, repository_signals[CHANGED], 0, changes, refs);
+	
+	/* Nothing to bring up to date before the first load */
+	if (repository->priv->last_args)
+	{
+		if (changes & (GITG_REPOSITORY_CHANGE_HEAD | GITG_REPOSITORY_CHANGE_REFS))
+			gitg_repository_update(repository);
+		else if (changes & GITG_REPOSITORY_CHANGE_INDEX)
+			refresh_virtual(repository);
+	}
+	
+	g_slist_foreach(refs, (GFunc)g_free, NULL);
+	g_slist_free(refs);
+	
+	return FALSE;
+}
+
+/* Changes are applied once the repository was quiet for a while, but not
+   later than CHANGES_MAX_DELAY after the first one */
+static void
+queue_changes(GitgRepository *repository, GitgRepositoryChange changes)
+{
+	repository->priv->changes |= changes;
+	
+	if (repository->priv->changes_id)
+	{
+		if (g_timer_elapsed(repository->priv->changes_timer, NULL) >= CHANGES_MAX_DELAY)
+			return;
+		
+		g_source_remove(repository->priv->changes_id);
+	}
+	else
+	{
+		g_timer_start(repository->priv->changes_timer);
+	}
+	
+	repository->priv->changes_id = g_timeout_add(CHANGES_DELAY, (GSourceFunc)flush_changes, repository);
+}
+
+static GitgRepositoryChange
+classify_change(GitgRepository *repository, GFile *file)
+{
+	gchar *path = g_build_filename(repository->priv->path, ".git", NULL);
+	GFile *dir = g_file_new_for_path(path);
+	gchar *relative = g_file_get_relative_path(dir, file);
+	GitgRepositoryChange ret = GITG_REPOSITORY_CHANGE_NONE;
+	
+	/* Lock files are renamed onto the real ones when git is done */
+	if (!relative || g_str_has_suffix(relative, ".lock"))
+		ret = GITG_REPOSITORY_CHANGE_NONE;
+	else if (strcmp(relative, "HEAD") == 0)
+		ret = GITG_REPOSITORY_CHANGE_HEAD;
+	else if (strcmp(relative, "index") == 0)
+		ret = GITG_REPOSITORY_CHANGE_INDEX;
+	else if (strcmp(relative, "config") == 0)
+		ret = GITG_REPOSITORY_CHANGE_CONFIG;
+	else if (strcmp(relative, "packed-refs") == 0 || g_str_has_prefix(relative, "refs" G_DIR_SEPARATOR_S))
+		ret = GITG_REPOSITORY_CHANGE_REFS;
+	
+	g_free(relative);
+	g_object_unref(dir);
+	g_free(path);
+	
+	return ret;
+}
+
+static void monitor_directory(GitgRepository *repository, gchar const *path, gboolean recursive);
+
 static void
-on_head_changed (GFileMonitor      *monitor,
-                 GFile             *file,
-                 GFile             *otherfile,
-                 GFileMonitorEvent  event,
-                 GitgRepository    *repository)
+on_git_changed (GFileMonitor      *monitor,
+                GFile             *file,
+                GFile             *otherfile,
+                GFileMonitorEvent  event,
+                GitgRepository    *repository)
 {
 	switch (event)
 	{
 		case G_FILE_MONITOR_EVENT_CHANGED:
 		case G_FILE_MONITOR_EVENT_CREATED:
-		{
-			GitgRef *current = get_current_working_ref (repository);
-			
-			if (!gitg_ref_equal (current, repository->priv->working_ref))
-			{
-				gitg_repository_reload (repository);
-			}
-			
-			gitg_ref_free (current);
-		}
+		case G_FILE_MONITOR_EVENT_DELETED:
 		break;
 		default:
-		break;
+			return;
+	}
+	
+	GitgRepositoryChange change = classify_change (repository, file);
+	
+	if (change == GITG_REPOSITORY_CHANGE_NONE)
+		return;
+	
+	/* New directories of refs, e.g. of a new remote */
+	if (change == GITG_REPOSITORY_CHANGE_REFS && 
+	    event == G_FILE_MONITOR_EVENT_CREATED &&
+	    g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) == G_FILE_TYPE_DIRECTORY)
+	{
+		gchar *path = g_file_get_path (file);
+		
+		monitor_directory (repository, path, TRUE);
+		g_free (path);
 	}
+	
+	gitg_repository_invalidate (repository);
+	queue_changes (repository, change);
 }
 
 static void
-install_head_monitor (GitgRepository *repository)
+monitor_directory (GitgRepository *repository, gchar const *path, gboolean recursive)
 {
-	gchar *path = g_build_filename (repository->priv->path, ".git", "HEAD", NULL);
 	GFile *file = g_file_new_for_path (path);
+	GFileMonitor *monitor = g_file_monitor_directory (file, 
+	                                                  G_FILE_MONITOR_NONE,
+	                                                  NULL,
+	                                                  NULL);
 	
-	repository->priv->monitor = g_file_monitor_file (file, 
-	                                                 G_FILE_MONITOR_NONE,
-	                                                 NULL,
-	                                                 NULL);
+	if (monitor)
+	{
+		g_signal_connect (monitor, 
+		                  "changed", 
+		                  G_CALLBACK (on_git_changed),
+		                  repository);
 
-	g_signal_connect (repository->priv->monitor, 
-	                  "changed", 
-	                  G_CALLBACK (on_head_changed),
-	                  repository);
+		repository->priv->git_monitors = g_slist_prepend (repository->priv->git_monitors, monitor);
+	}
+	
+	g_object_unref (file);
+	
+	GDir *dir = recursive ? g_dir_open (path, 0, NULL) : NULL;
+	gchar const *name;
+	
+	if (!dir)
+		return;
+	
+	while ((name = g_dir_read_name (dir)))
+	{
+		gchar *child = g_build_filename (path, name, NULL);
+		
+		if (g_file_test (child, G_FILE_TEST_IS_DIR))
+			monitor_directory (repository, child, TRUE);
+		
+		g_free (child);
+	}
+	
+	g_dir_close (dir);
+}
 
+/* Watches HEAD, the index, config and packed-refs (in .git itself) and all
+   of refs/. Monitors are not recursive, so there is one per directory */
+static void
+install_git_monitors (GitgRepository *repository)
+{
+	gchar *path = g_build_filename (repository->priv->path, ".git", NULL);
+	gchar *refs = g_build_filename (path, "refs", NULL);
+	
+	monitor_directory (repository, path, FALSE);
+	monitor_directory (repository, refs, TRUE);
+	
+	g_free (refs);
 	g_free (path);
-	g_object_unref (file);
 }
 
 static GObject *
@@ -519,7 +1054,7 @@ gitg_repository_constructor (GType                  type,
 	                                                                           n_construct_properties,
 	                                                                           construct_properties);
 
-	install_head_monitor (GITG_REPOSITORY (ret));
+	install_git_monitors (GITG_REPOSITORY (ret));
 	
 	return ret;
 }
@@ -559,939 +1094,3391 @@ gitg_repository_class_init(GitgRepositoryClass *klass)
 			      G_TYPE_NONE,
 			      0);
 
+	/* Emitted around inserting a large batch of rows. Views may detach from
+	   the model in between, instead of handling every row-inserted */
+	repository_signals[BEGIN_BULK_INSERT] =
+   		g_signal_new ("begin-bulk-insert",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GitgRepositoryClass, begin_bulk_insert),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE,
+			      0);
+
+	repository_signals[END_BULK_INSERT] =
+   		g_signal_new ("end-bulk-insert",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GitgRepositoryClass, end_bulk_insert),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE,
+			      0);
+
+	/* Emitted with the GitgRepositoryChange flags of a burst of changes on
+	   disk and the names of the refs that moved, before the history is
+	   brought up to date */
+	repository_signals[CHANGED] =
+   		g_signal_new ("changed",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GitgRepositoryClass, changed),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__UINT_POINTER,
+			      G_TYPE_NONE,
+			      2,
+			      G_TYPE_UINT,
+			      G_TYPE_POINTER);
+
 	g_type_class_add_private(object_class, sizeof(GitgRepositoryPrivate));
 }
 
 static void
-append_revision(GitgRepository *repository, GitgRevision *rv)
+lanes_page_free(LanesPage *page)
 {
-	GSList *lanes;
-	gint8 mylane = 0;
+	gitg_lanes_checkpoint_free(page->checkpoint);
+	
+	if (page->colors)
+	{
+		g_ptr_array_foreach(page->colors, (GFunc)gitg_color_unref, NULL);
+		g_ptr_array_free(page->colors, TRUE);
+	}
 	
-	if (repository->priv->size == 0)
-		gitg_lanes_reset(repository->priv->lanes);
+	g_slice_free(LanesPage, page);
+}
 
-	lanes = gitg_lanes_next(repository->priv->lanes, rv, &mylane);
-	gitg_revision_set_lanes(rv, lanes, mylane);
+/* Called from the loader thread as well */
+static void
+add_lanes_page(GitgRepository *repository)
+{
+	LanesPage *page = g_slice_new0(LanesPage);
+	
+	page->checkpoint = gitg_lanes_save(repository->priv->lanes);
+	
+	g_mutex_lock(repository->priv->pages_lock);
+	g_ptr_array_add(repository->priv->pages, page);
+	g_mutex_unlock(repository->priv->pages_lock);
+}
 
-	gitg_repository_add(repository, rv, NULL);
-	gitg_revision_unref(rv);
+static LanesPage *
+get_lanes_page(GitgRepository *repository, guint num)
+{
+	LanesPage *page = NULL;
+	
+	g_mutex_lock(repository->priv->pages_lock);
+	
+	if (num < repository->priv->pages->len)
+		page = g_ptr_array_index(repository->priv->pages, num);
+	
+	g_mutex_unlock(repository->priv->pages_lock);
+	return page;
 }
 
+/* Only when all rows get their lanes laid out anew, paged out rows have none */
 static void
-add_dummy_commit(GitgRepository *repository, gboolean staged)
+clear_lanes_pages(GitgRepository *repository)
 {
-	GitgRevision *revision;
-	gchar const *subject;
-	struct timeval tv;
+	g_mutex_lock(repository->priv->pages_lock);
 	
-	gettimeofday(&tv, NULL);
+	g_ptr_array_foreach(repository->priv->pages, (GFunc)lanes_page_free, NULL);
+	g_ptr_array_set_size(repository->priv->pages, 0);
 	
-	if (staged)
-		subject = _("Staged changes");
-	else
-		subject = _("Unstaged changes");
+	g_mutex_unlock(repository->priv->pages_lock);
+	
+	repository->priv->laned = 0;
+	repository->priv->pages_out = 0;
+	repository->priv->pages_shift = 0;
+}
 
-	revision = gitg_revision_new("0000000000000000000000000000000000000000", "", subject, NULL, tv.tv_sec);
-	gitg_revision_set_sign(revision, staged ? 't' : 'u');
+static void
+assign_lanes(GitgRepository *repository, GitgRevision *rv)
+{
+	GitgLaneRow *lanes;
+	gint8 mylane = 0;
+	
+	if (repository->priv->laned++ % LANES_PAGE_SIZE == 0)
+		add_lanes_page(repository);
+
+	lanes = gitg_lanes_next(repository->priv->lanes, rv, &mylane);
+	gitg_revision_set_lanes(rv, lanes, mylane);
+}
 
-	append_revision(repository, revision);
+/* Rows are final once this many rows below them are laid out, collapsing
+   lanes goes back that far */
+static gulong
+lanes_reach(GitgLanes *lanes)
+{
+	gint collapse;
+	gint gap;
+	
+	g_object_get(lanes, "inactive-collapse", &collapse, "inactive-gap", &gap, NULL);
+	return collapse + gap + 1;
 }
 
 static void
-on_loader_end_loading(GitgRunner *object, gboolean cancelled, GitgRepository *repository)
+lanes_page_rows(GitgRepository *repository, guint num, gulong *first, gulong *last)
 {
-	if (cancelled)
-		return;
+	*first = repository->priv->commits_start + repository->priv->pages_shift + (gulong)num * LANES_PAGE_SIZE;
+	*last = MIN(*first + LANES_PAGE_SIZE, repository->priv->size);
+}
 
-	LoadStage current = repository->priv->load_stage++;
-	GitgPreferences *preferences = gitg_preferences_get_default();
-	gboolean show_unstaged;
-	gboolean show_staged;
+static void
+page_out(GitgRepository *repository, LanesPage *page, guint num)
+{
+	GHashTable *seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	gulong first;
+	gulong last;
+	gulong i;
 	
-	g_object_get(preferences, 
-	             "history-show-virtual-staged", &show_staged, 
-	             "history-show-virtual-unstaged", &show_unstaged,
-	             NULL);
-
-	switch (current)
+	lanes_page_rows(repository, num, &first, &last);
+	page->colors = g_ptr_array_new();
+	
+	for (i = first; i < last; ++i)
 	{
-		case LOAD_STAGE_STASH:
-		case LOAD_STAGE_STAGED:
+		GitgRevision *rv = repository->priv->storage[i];
+		GitgLaneRow *lanes = gitg_revision_get_lanes(rv);
+		guint j;
+		
+		for (j = 0; j < gitg_lane_row_length(lanes); ++j)
 		{
-			/* Check if there are staged changes */
-			gchar *head = gitg_repository_parse_head(repository);
-			const gchar *cached = NULL;
+			GitgColor *color = lanes->lanes[j].color;
 			
-			if (current == LOAD_STAGE_STAGED)
-			{
-				/* Check if there are unstaged changes */
-				if (show_staged && gitg_runner_get_exit_status(object) != 0)
-				{
-					add_dummy_commit(repository, TRUE);
-				}
-			}
-			else
-			{
-				cached = "--cached";
-			}
+			if (g_hash_table_lookup_extended(seen, color, NULL, NULL))
+				continue;
 			
-			gitg_repository_run_commandv(repository, object, NULL, "diff-index", "--quiet", head, cached, NULL);
-			g_free(head);
+			g_hash_table_insert(seen, color, NULL);
+			g_ptr_array_add(page->colors, gitg_color_ref(color));
 		}
-		break;
-		case LOAD_STAGE_UNSTAGED:
-			if (show_unstaged && gitg_runner_get_exit_status(object) != 0)
-			{
-				add_dummy_commit(repository, FALSE);
-			}
-
-			gitg_repository_run_command(repository, object, (gchar const **)repository->priv->last_args, NULL);
-
-		break;
-		default:
-		break;
+		
+		gitg_revision_set_lanes(rv, NULL, -1);
 	}
+	
+	g_hash_table_destroy(seen);
+	++repository->priv->pages_out;
 }
 
-static gint
-find_ref_custom (GitgRef *first, GitgRef *second)
-{
-	return gitg_ref_equal (first, second) ? 0 : 1;
-}
-
-static GitgRef *
-add_ref(GitgRepository *self, gchar const *sha1, gchar const *name)
+/* The colors of the laid out rows are replaced by the ones the page kept,
+   matched by order of appearance */
+static void
+adopt_page_colors(LanesPage *page, GitgRevision **rows, gulong num_rows)
 {
-	GitgRef *ref = gitg_ref_new(sha1, name);
-	GSList *refs = (GSList *)g_hash_table_lookup(self->priv->refs, 
-	                                             gitg_ref_get_hash(ref));
+	GHashTable *map = g_hash_table_new(g_direct_hash, g_direct_equal);
+	guint num = 0;
+	gulong i;
+	guint j;
 	
-	if (refs == NULL)
+	for (i = 0; i < num_rows; ++i)
 	{
-		g_hash_table_insert(self->priv->refs, 
-		                    (gpointer)gitg_ref_get_hash(ref), 
-		                    g_slist_append(NULL, ref));
-	}
-	else
-	{
-		if (!g_slist_find_custom (refs, ref, (GCompareFunc)find_ref_custom))
+		GitgLaneRow *lanes = gitg_revision_get_lanes(rows[i]);
+		
+		for (j = 0; j < gitg_lane_row_length(lanes); ++j)
 		{
-			refs = g_slist_append(refs, ref);
+			GitgColor *color = lanes->lanes[j].color;
+			
+			if (num < page->colors->len && !g_hash_table_lookup(map, color))
+				g_hash_table_insert(map, color, g_ptr_array_index(page->colors, num++));
 		}
-		else
+	}
+	
+	for (i = 0; i < num_rows; ++i)
+	{
+		GitgLaneRow *lanes = gitg_revision_get_lanes(rows[i]);
+		
+		for (j = 0; j < gitg_lane_row_length(lanes); ++j)
 		{
-			gitg_ref_free (ref);
+			GitgLane *lane = &lanes->lanes[j];
+			GitgColor *color = g_hash_table_lookup(map, lane->color);
+			
+			if (color)
+			{
+				gitg_color_unref(lane->color);
+				lane->color = gitg_color_ref(color);
+			}
 		}
 	}
 	
-	return ref;
+	g_hash_table_destroy(map);
 }
 
 static void
-loader_update_stash(GitgRepository *repository, gchar **buffer)
+copy_lanes_settings(GitgLanes *from, GitgLanes *to)
 {
-	gchar *line;
-	GitgPreferences *preferences = gitg_preferences_get_default();
-	gboolean show_stash;
+	gint max;
+	gint collapse;
+	gint gap;
+	gboolean enabled;
+	
+	g_object_get(from, 
+	             "inactive-max", &max, 
+	             "inactive-collapse", &collapse, 
+	             "inactive-gap", &gap, 
+	             "inactive-enabled", &enabled, 
+	             NULL);
 	
-	g_object_get(preferences, "history-show-virtual-stash", &show_stash, NULL);
+	g_object_set(to, 
+	             "inactive-max", max, 
+	             "inactive-collapse", collapse, 
+	             "inactive-gap", gap, 
+	             "inactive-enabled", enabled, 
+	             NULL);
+}
 
-	if (!show_stash)
-		return;
+/* Laying out lanes changes the revisions before it, copies are laid out
+   where the rows themselves are not to be touched. They go into an arena
+   of the layout, which goes with them */
+static GitgRevision *
+copy_for_lanes(GitgRevisionArena *arena, GitgRevision *rv)
+{
+	guint num_parents;
+	Hash *parents = gitg_revision_get_parents_hash(rv, &num_parents);
+	
+	return gitg_revision_new_from_hashes(arena, 
+	                                     gitg_revision_get_hash(rv), 
+	                                     NULL, 
+	                                     NULL, 
+	                                     (Hash const *)parents, 
+	                                     num_parents, 
+	                                     0);
+}
+
+/* Lays out the rows of a paged out page from its checkpoint. The rows
+   below it are laid out as copies, they only add the collapsing reaching
+   into the page. With page_copies, the rows of the page are laid out as
+   copies as well, which are added to it, and the page stays paged out */
+static void
+lay_out_page(GitgRepository *repository, LanesPage *page, guint num, GitgRevisionArena *arena, GPtrArray *page_copies)
+{
+	GitgLanes *lanes = repository->priv->page_lanes;
+	GPtrArray *copies = g_ptr_array_new();
+	gulong first;
+	gulong last;
+	gulong end;
+	gulong i;
+	
+	copy_lanes_settings(repository->priv->lanes, lanes);
+	lanes_page_rows(repository, num, &first, &last);
+	end = MIN(last + lanes_reach(lanes), repository->priv->size);
+	
+	gitg_lanes_restore(lanes, page->checkpoint);
 	
-	while ((line = *buffer++) != NULL)
+	for (i = first; i < end; ++i)
 	{
-		gchar **components = g_strsplit(line, "\01", 0);
-		guint len = g_strv_length(components);
+		GitgRevision *rv = repository->priv->storage[i];
+		GitgLaneRow *lns;
+		gint8 mylane;
 		
-		if (len < 4)
+		if (i >= last || page_copies)
 		{
-			g_strfreev(components);
-			continue;
+			rv = copy_for_lanes(arena, rv);
+			g_ptr_array_add(i >= last ? copies : page_copies, rv);
 		}
 		
-		/* components -> [hash, author, subject, timestamp] */
-		gint64 timestamp = g_ascii_strtoll(components[3], NULL, 0);
-		GitgRevision *rv = gitg_revision_new(components[0], components[1], components[2], NULL, timestamp);
-		
-		add_ref (repository, components[0], "refs/stash");
-		
-		gitg_revision_set_sign(rv, 's');
-		append_revision(repository, rv);
-		g_strfreev(components);
+		lns = gitg_lanes_next(lanes, rv, &mylane);
+		gitg_revision_set_lanes(rv, lns, mylane);
 	}
+	
+	/* The copies are referred to by the lanes until the reset */
+	gitg_lanes_reset(lanes);
+	
+	g_ptr_array_foreach(copies, (GFunc)gitg_revision_unref, NULL);
+	g_ptr_array_free(copies, TRUE);
+	
+	if (page_copies)
+		adopt_page_colors(page, (GitgRevision **)page_copies->pdata, page_copies->len);
+	else
+		adopt_page_colors(page, repository->priv->storage + first, last - first);
 }
 
 static void
-loader_update_commits(GitgRepository *self, gchar **buffer)
+page_in(GitgRepository *repository, LanesPage *page, guint num)
 {
-	gchar *line;
+	GitgRevisionArena *arena = gitg_revision_arena_new();
 	
-	while ((line = *buffer++) != NULL)
-	{
-		/* new line is read */
-		gchar **components = g_strsplit(line, "\01", 0);
-		guint len = g_strv_length(components);
-		
-		if (len < 5)
-		{
-			g_strfreev(components);
-			continue;
-		}
+	lay_out_page(repository, page, num, arena, NULL);
+	gitg_revision_arena_unref(arena);
+	
+	g_ptr_array_foreach(page->colors, (GFunc)gitg_color_unref, NULL);
+	g_ptr_array_free(page->colors, TRUE);
+	
+	page->colors = NULL;
+	--repository->priv->pages_out;
+}
 
-		/* components -> [hash, author, subject, parents ([1 2 3]), timestamp[, leftright]] */
-		gint64 timestamp = g_ascii_strtoll(components[4], NULL, 0);
+/* Pages out the lanes of the pages used longest ago, once the history is
+   long enough. A page can go once the rows it depends on are in */
+static void
+page_out_lanes(GitgRepository *repository)
+{
+	gulong reach = lanes_reach(repository->priv->lanes);
 	
-		GitgRevision *rv = gitg_revision_new(components[0], components[1], components[2], components[3], timestamp);
+	if (repository->priv->size - repository->priv->commits_start < LANES_PAGED_MIN_ROWS)
+		return;
+	
+	g_mutex_lock(repository->priv->pages_lock);
+	
+	while (repository->priv->pages->len - repository->priv->pages_out > LANES_PAGES_RESIDENT)
+	{
+		LanesPage *oldest = NULL;
+		guint num = 0;
+		guint i;
 		
-		if (len > 5 && strlen(components[5]) == 1 && strchr("<>-^", *components[5]) != NULL)
+		for (i = 0; i < repository->priv->pages->len; ++i)
 		{
-			gitg_revision_set_sign(rv, *components[5]);
+			LanesPage *page = g_ptr_array_index(repository->priv->pages, i);
+			gulong first;
+			gulong last;
+			
+			lanes_page_rows(repository, i, &first, &last);
+			
+			if (page->colors || last - first < LANES_PAGE_SIZE || last + reach > repository->priv->size)
+				continue;
+			
+			if (!oldest || page->used < oldest->used)
+			{
+				oldest = page;
+				num = i;
+			}
 		}
-
-		append_revision(self, rv);
-		g_strfreev(components);
+		
+		if (!oldest)
+			break;
+		
+		page_out(repository, oldest, num);
 	}
+	
+	g_mutex_unlock(repository->priv->pages_lock);
 }
 
+/* Called for every row handed out, the view always gets rows with lanes */
 static void
-on_loader_update(GitgRunner *object, gchar **buffer, GitgRepository *repository)
+page_in_row(GitgRepository *repository, gulong index)
 {
-	switch (repository->priv->load_stage)
+	LanesPage *page;
+	guint num;
+	
+	if (index < repository->priv->commits_start + repository->priv->pages_shift)
+		return;
+	
+	num = (index - repository->priv->commits_start - repository->priv->pages_shift) / LANES_PAGE_SIZE;
+	page = get_lanes_page(repository, num);
+	
+	if (!page)
+		return;
+	
+	page->used = ++repository->priv->pages_clock;
+	
+	if (page->colors)
 	{
-		case LOAD_STAGE_STASH:
-			loader_update_stash(repository, buffer);
-		break;
-		case LOAD_STAGE_STAGED:
-		break;
-		case LOAD_STAGE_UNSTAGED:
-		break;
-		case LOAD_STAGE_COMMITS:
-			loader_update_commits(repository, buffer);
-		break;
-		default:
-		break;
+		page_in(repository, page, num);
+		page_out_lanes(repository);
 	}
 }
 
+static void insert_rows(GitgRepository *repository, gulong position, GitgRevision **revisions, guint num);
+static void remove_rows(GitgRepository *repository, gulong position, gulong num);
+
+/* Virtual rows have no parents, so they do not change the lanes of the
+   commits. They are laned on their own as they come in, while the loader
+   thread may be laning the commits */
 static void
-free_refs(GSList *refs)
+insert_virtual(GitgRepository *repository, GitgRevision *rv, gulong position)
 {
-	g_slist_foreach(refs, (GFunc)gitg_ref_free, NULL);
-	g_slist_free(refs);
+	GitgLaneRow *lanes;
+	gint8 mylane = 0;
+	
+	lanes = gitg_lanes_next(repository->priv->virtual_lanes, rv, &mylane);
+	gitg_revision_set_lanes(rv, lanes, mylane);
+	
+	insert_rows(repository, position, &rv, 1);
+	++repository->priv->commits_start;
 }
 
-static gboolean
-repository_relane(GitgRepository *repository)
+static void
+add_dummy_commit(GitgRepository *repository, gboolean staged)
 {
-	repository->priv->idle_relane_id = 0;
-	
-	gitg_lanes_reset(repository->priv->lanes);
-	
-	guint i;
-	GtkTreeIter iter;
-	GtkTreePath *path = gtk_tree_path_new_first();
+	GitgRevision *revision;
+	gchar const *subject;
+	struct timeval tv;
 	
+	gettimeofday(&tv, NULL);
 	
-	for (i = 0; i < repository->priv->size; ++i)
-	{
-		gint8 mylane;
-		GitgRevision *revision = repository->priv->storage[i];
+	if (staged)
+		subject = _("Staged changes");
+	else
+		subject = _("Unstaged changes");
 
-		GSList *lanes = gitg_lanes_next(repository->priv->lanes, revision, &mylane);
-		gitg_revision_set_lanes(revision, lanes, mylane);
+	revision = gitg_revision_new_from_arena(repository->priv->arena, DUMMY_SHA1, "", subject, NULL, tv.tv_sec);
+	gitg_revision_set_sign(revision, staged ? 't' : 'u');
 
-		fill_iter(repository, i, &iter);
-		gtk_tree_model_row_changed(GTK_TREE_MODEL(repository), path, &iter);
-		
-		gtk_tree_path_next(path);
+	/* Stash rows go first, then staged and unstaged changes */
+	if (staged)
+	{
+		insert_virtual(repository, revision, repository->priv->num_stash);
+		repository->priv->num_staged = 1;
+	}
+	else
+	{
+		insert_virtual(repository, revision, repository->priv->num_stash + repository->priv->num_staged);
 	}
 	
-	gtk_tree_path_free(path);
-	
-	return FALSE;
+	gitg_revision_unref(revision);
 }
 
-static void
-prepare_relane(GitgRepository *repository)
+static void prepare_relane(GitgRepository *repository);
+static void loader_batch_free(GPtrArray *batch);
+
+static gint
+sort_strings(gchar const **a, gchar const **b)
 {
-	if (!repository->priv->idle_relane_id)
-		repository->priv->idle_relane_id = g_idle_add((GSourceFunc)repository_relane, repository);
+	return strcmp(*a, *b);
 }
 
-static gboolean
-convert_setting_to_inactive_max(GValue const *setting, GValue *value, gpointer userdata)
+static void
+flush_pending(GitgRepository *repository, gboolean add)
 {
-	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_INT), FALSE);
-	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_INT), FALSE);
+	GPtrArray *batch = g_ptr_array_new();
+	GitgRevision *rv;
 	
-	gint s = g_value_get_int(setting);
-	g_value_set_int(value, 2 + s * 8);
+	while ((rv = g_queue_pop_head(repository->priv->pending)))
+		g_ptr_array_add(batch, rv);
 	
-	prepare_relane(GITG_REPOSITORY(userdata));
-	return TRUE;
+	if (add)
+		gitg_repository_add_batch(repository, (GitgRevision **)batch->pdata, batch->len);
+
+	loader_batch_free(batch);
 }
 
-static gboolean
-convert_setting_to_inactive_collapse(GValue const *setting, GValue *value, gpointer userdata)
+static gchar *
+history_cache_filename(GitgRepository *repository)
 {
-	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_INT), FALSE);
-	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_INT), FALSE);
-
-	gint s = g_value_get_int(setting);
-	g_value_set_int(value, 1 + s * 3);
-
-	prepare_relane(GITG_REPOSITORY(userdata));	
-	return TRUE;
+	gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, repository->priv->path, -1);
+	gchar *ret = g_build_filename(g_get_user_cache_dir(), "gitg", "history", checksum, NULL);
+	
+	g_free(checksum);
+	return ret;
 }
 
-static gboolean
-convert_setting_to_inactive_gap(GValue const *setting, GValue *value, gpointer userdata)
+/* What the cached rows depend on besides the commits: the log arguments
+   and the lane settings. The tips are stored next to it, moving refs only
+   adds commits to a history which was not rewritten */
+static gchar *
+history_cache_key(GitgRepository *repository)
 {
-	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_INT), FALSE);
-	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_INT), FALSE);
-
-	g_value_set_int(value, 10);
+	GString *key = g_string_new("");
+	gchar **arg;
+	
+	gint inactive_max;
+	gint inactive_collapse;
+	gint inactive_gap;
+	gboolean inactive_enabled;
+	
+	g_object_get(repository->priv->lanes,
+	             "inactive-max", &inactive_max,
+	             "inactive-collapse", &inactive_collapse,
+	             "inactive-gap", &inactive_gap,
+	             "inactive-enabled", &inactive_enabled,
+	             NULL);
 	
-	prepare_relane(GITG_REPOSITORY(userdata));	
-	return TRUE;
+	g_string_append_printf(key, "lanes %d %d %d %d\n", inactive_max, inactive_collapse, inactive_gap, inactive_enabled);
+	
+	for (arg = repository->priv->last_args; arg && *arg; ++arg)
+		g_string_append_printf(key, "arg %s\n", *arg);
+	
+	return g_string_free(key, FALSE);
 }
 
-static gboolean
-convert_setting_to_inactive_enabled(GValue const *setting, GValue *value, gpointer userdata)
+/* HEAD and the commits the refs point at, one sha1 a line in a fixed
+   order */
+static gchar *
+ref_tips(GitgRepository *repository)
 {
-	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_BOOLEAN), FALSE);
-	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_BOOLEAN), FALSE);
-
-	gboolean s = g_value_get_boolean(setting);
-	g_value_set_boolean(value, s);
+	GPtrArray *tips = g_ptr_array_new();
+	GSList *refs = gitg_repository_get_refs(repository);
+	gchar *head = gitg_repository_parse_head(repository);
+	GString *ret = g_string_new("");
+	GSList *item;
+	guint i;
 	
-	prepare_relane(GITG_REPOSITORY(userdata));	
-	return TRUE;
+	if (head)
+		g_ptr_array_add(tips, head);
+	
+	for (item = refs; item; item = g_slist_next(item))
+	{
+		GitgRef *ref = (GitgRef *)item->data;
+		
+		/* Stash rows are loaded without their history */
+		if (strcmp(gitg_ref_get_name(ref), "refs/stash") != 0)
+			g_ptr_array_add(tips, gitg_utils_hash_to_sha1_new(gitg_ref_get_hash(ref)));
+	}
+	
+	/* The refs map has no defined order */
+	g_ptr_array_sort(tips, (GCompareFunc)sort_strings);
+	
+	for (i = 0; i < tips->len; ++i)
+	{
+		gchar const *tip = g_ptr_array_index(tips, i);
+		
+		if (i > 0 && strcmp(tip, g_ptr_array_index(tips, i - 1)) == 0)
+			continue;
+		
+		if (ret->len)
+			g_string_append_c(ret, '\n');
+		
+		g_string_append(ret, tip);
+	}
+	
+	g_ptr_array_foreach(tips, (GFunc)g_free, NULL);
+	g_ptr_array_free(tips, TRUE);
+	
+	g_slist_foreach(refs, (GFunc)gitg_ref_free, NULL);
+	g_slist_free(refs);
+	
+	return g_string_free(ret, FALSE);
 }
 
-static void
-on_update_virtual(GObject *object, GParamSpec *spec, GitgRepository *repository)
+static gboolean tip_args(GitgRepository *repository);
+static gchar *loaded_tips(gchar const *tips, GitgRevision **revisions, gulong num);
+static gboolean history_rewritten(GitgRepository *repository, gchar const *tips);
+static GPtrArray *load_new_commits(GitgRepository *repository, gchar const *tips);
+static void prepend_commits(GitgRepository *repository, GPtrArray *revisions);
+static void store_history_cache(GitgRepository *repository);
+
+/* Adds the commits from the history cache, if it was saved for the current
+   arguments. When the refs moved since, the commits which are new are put
+   in front, unless the history was rewritten */
+static gboolean
+load_history_cache(GitgRepository *repository)
 {
-	gitg_repository_reload (repository);
+	gchar *filename = history_cache_filename(repository);
+	gchar *key = history_cache_key(repository);
+	gchar *current = ref_tips(repository);
+	GPtrArray *revisions;
+	GPtrArray *added = NULL;
+	gchar *tips = NULL;
+	gchar *loaded = NULL;
+	gboolean ret = FALSE;
+	gboolean moved;
+	
+	revisions = gitg_history_cache_load(filename, key, &tips, repository->priv->arena);
+	g_free(filename);
+	
+	if (!revisions)
+		goto out;
+	
+	moved = strcmp(tips, current) != 0;
+	
+	if (moved)
+	{
+		/* Commits only get added for arguments which just name tips */
+		if (!tip_args(repository))
+			goto out;
+		
+		/* Tips the cached history does not have, such as branches which
+		   are not shown, have nothing to add */
+		loaded = loaded_tips(tips, (GitgRevision **)revisions->pdata, revisions->len);
+		
+		if (*loaded == '\0' || history_rewritten(repository, loaded))
+			goto out;
+	}
+	
+	gitg_repository_add_batch(repository, (GitgRevision **)revisions->pdata, revisions->len);
+	
+	if (moved)
+	{
+		/* New commits are told apart from the ones in the model */
+		if (!(added = load_new_commits(repository, loaded)))
+		{
+			remove_rows(repository, 
+			            repository->priv->commits_start, 
+			            repository->priv->size - repository->priv->commits_start);
+			goto out;
+		}
+		
+		prepend_commits(repository, added);
+	}
+	
+	g_free(repository->priv->history_key);
+	repository->priv->history_key = key;
+	key = NULL;
+	
+	g_free(repository->priv->history_tips);
+	repository->priv->history_tips = tips;
+	tips = NULL;
+	
+	/* Nothing left to load */
+	repository->priv->load_stage = LOAD_STAGE_LAST;
+	
+	if (moved)
+		store_history_cache(repository);
+	
+	ret = TRUE;
+	
+out:
+	if (revisions)
+		loader_batch_free(revisions);
+	
+	if (added)
+		loader_batch_free(added);
+	
+	g_free(loaded);
+	g_free(current);
+	g_free(tips);
+	g_free(key);
+	
+	return ret;
 }
 
-static void
-initialize_bindings(GitgRepository *repository)
+/* Rows of paged out pages are laid out for the cache as copies, one page
+   at a time, leaving the pages paged out */
+typedef struct
 {
-	GitgPreferences *preferences = gitg_preferences_get_default();
+	GitgRepository *repository;
+	GitgRevisionArena *arena;
+	GPtrArray *copies;
+	guint num;
+} CacheLanes;
+
+static GitgRevision *
+cache_lanes(guint index, CacheLanes *lanes)
+{
+	GitgRepository *repository = lanes->repository;
+	gulong row = repository->priv->commits_start + index;
+	LanesPage *page;
+	guint num;
 	
-	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes",
-							   repository->priv->lanes, "inactive-max",
-							   convert_setting_to_inactive_max,
-							   repository);
+	if (index < repository->priv->pages_shift)
+		return repository->priv->storage[row];
+	
+	num = (index - repository->priv->pages_shift) / LANES_PAGE_SIZE;
+	page = get_lanes_page(repository, num);
+	
+	if (!page || !page->colors)
+		return repository->priv->storage[row];
+	
+	if (!lanes->copies || lanes->num != num)
+	{
+		if (lanes->copies)
+		{
+			g_ptr_array_foreach(lanes->copies, (GFunc)gitg_revision_unref, NULL);
+			g_ptr_array_free(lanes->copies, TRUE);
+		}
+		
+		lanes->copies = g_ptr_array_sized_new(LANES_PAGE_SIZE);
+		lanes->num = num;
+		
+		lay_out_page(repository, page, num, lanes->arena, lanes->copies);
+	}
+	
+	return g_ptr_array_index(lanes->copies, (index - repository->priv->pages_shift) % LANES_PAGE_SIZE);
+}
 
-	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes",
-							   repository->priv->lanes, "inactive-collapse",
-							   convert_setting_to_inactive_collapse,
-							   repository);
+/* Saves the loaded commits, unless the cache has them already */
+static void
+store_history_cache(GitgRepository *repository)
+{
+	gulong num = repository->priv->size - repository->priv->commits_start;
+	CacheLanes lanes = {repository, NULL, NULL, 0};
+	GError *error = NULL;
+	
+	/* Lanes are stale until a pending or running relane is done */
+	if (num < HISTORY_CACHE_MIN_ROWS || 
+	    repository->priv->idle_relane_id || 
+	    repository->priv->relane)
+	{
+		return;
+	}
+	
+	gchar *key = history_cache_key(repository);
+	gchar *tips = ref_tips(repository);
+	
+	if (g_strcmp0(key, repository->priv->history_key) == 0 &&
+	    g_strcmp0(tips, repository->priv->history_tips) == 0)
+	{
+		g_free(key);
+		g_free(tips);
+		return;
+	}
+	
+	gchar *filename = history_cache_filename(repository);
+	
+	lanes.arena = gitg_revision_arena_new();
+	
+	if (!gitg_history_cache_save(filename,
+	                             key,
+	                             tips,
+	                             repository->priv->storage + repository->priv->commits_start,
+	                             num,
+	                             repository->priv->pages_out ? (GitgHistoryCacheLanesFunc)cache_lanes : NULL,
+	                             &lanes,
+	                             &error))
+	{
+		g_warning("Could not save history cache: %s", error->message);
+		g_error_free(error);
+	}
+	
+	if (lanes.copies)
+	{
+		g_ptr_array_foreach(lanes.copies, (GFunc)gitg_revision_unref, NULL);
+		g_ptr_array_free(lanes.copies, TRUE);
+	}
+	
+	gitg_revision_arena_unref(lanes.arena);
+	
+	g_free(repository->priv->history_key);
+	repository->priv->history_key = key;
+	
+	g_free(repository->priv->history_tips);
+	repository->priv->history_tips = tips;
+	
+	g_free(filename);
+}
 
-	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes",
-							   repository->priv->lanes, "inactive-gap",
-							   convert_setting_to_inactive_gap,
-							   repository);		
+static void
+on_loader_end_loading(GitgRunner *object, gboolean cancelled, GitgRepository *repository)
+{
+	/* The loader thread is done, the revisions it held back are final */
+	flush_pending(repository, !cancelled);
+	
+	if (!cancelled)
+		page_out_lanes(repository);
 
-	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes-active",
-	                           repository->priv->lanes, "inactive-enabled",
-	                           convert_setting_to_inactive_enabled,
-	                           repository);	
+	/* Lanes are not touched while the loader thread assigns them */
+	if (repository->priv->relane_pending)
+	{
+		repository->priv->relane_pending = FALSE;
+		prepare_relane(repository);
+	}
+	
+	if (cancelled)
+		return;
+	
+	repository->priv->load_stage = LOAD_STAGE_LAST;
+	
+	/* The cache stores the tips the refs point at */
+	if (!gitg_runner_running(repository->priv->refs_loader))
+		store_history_cache(repository);
+}
 
-	g_signal_connect(preferences, 
-	                 "notify::history-show-virtual-stash",
-	                 G_CALLBACK(on_update_virtual),
-	                 repository);
+/* Whether anything is still being loaded, details load on the side */
+static gboolean
+loading(GitgRepository *repository)
+{
+	return gitg_runner_running(repository->priv->loader) ||
+	       gitg_runner_running(repository->priv->refs_loader) ||
+	       gitg_runner_running(repository->priv->stash_loader) ||
+	       gitg_runner_running(repository->priv->staged_probe) ||
+	       gitg_runner_running(repository->priv->unstaged_probe);
+}
 
-	g_signal_connect(preferences, 
-	                 "notify::history-show-virtual-unstaged",
-	                 G_CALLBACK(on_update_virtual),
-	                 repository);
+static void
+cancel_loading(GitgRepository *repository)
+{
+	gitg_runner_cancel(repository->priv->loader);
+	gitg_runner_cancel(repository->priv->refs_loader);
+	gitg_runner_cancel(repository->priv->stash_loader);
+	gitg_runner_cancel(repository->priv->staged_probe);
+	gitg_runner_cancel(repository->priv->unstaged_probe);
+	gitg_runner_cancel(repository->priv->details_loader);
+}
 
-	g_signal_connect(preferences, 
-	                 "notify::history-show-virtual-staged",
-	                 G_CALLBACK(on_update_virtual),
-	                 repository);
+static GitgRef *add_ref(GitgRepository *self, gchar const *sha1, gchar const *name);
+
+static void
+on_stash_update(GitgRunner *runner, gchar **lines, GitgRepository *repository)
+{
+	for (; *lines; ++lines)
+	{
+		gchar **components = g_strsplit(*lines, "\01", 4);
+		
+		/* components -> [hash, author, subject, timestamp] */
+		if (g_strv_length(components) == 4)
+		{
+			gint64 timestamp = g_ascii_strtoll(components[3], NULL, 0);
+			GitgRevision *rv = gitg_revision_new_from_arena(repository->priv->arena, components[0], components[1], components[2], NULL, timestamp);
+			
+			gitg_revision_set_sign(rv, 's');
+			add_ref(repository, components[0], "refs/stash");
+			
+			insert_virtual(repository, rv, repository->priv->num_stash++);
+			gitg_revision_unref(rv);
+		}
+		
+		g_strfreev(components);
+	}
 }
 
 static void
-gitg_repository_init(GitgRepository *object)
+on_probe_end_loading(GitgRunner *runner, gboolean cancelled, GitgRepository *repository)
 {
-	object->priv = GITG_REPOSITORY_GET_PRIVATE(object);
-	object->priv->hashtable = g_hash_table_new_full(gitg_utils_hash_hash, gitg_utils_hash_equal, NULL, NULL);
+	/* diff-index --quiet exits with 1 when there are changes */
+	if (cancelled || gitg_runner_get_exit_status(runner) == 0)
+		return;
 	
-	object->priv->column_types[0] = GITG_TYPE_REVISION;
-	object->priv->column_types[1] = G_TYPE_STRING;
-	object->priv->column_types[2] = G_TYPE_STRING;
-	object->priv->column_types[3] = G_TYPE_STRING;
+	add_dummy_commit(repository, runner == repository->priv->staged_probe);
+}
+
+/* Starts the stash log and the probes for staged and unstaged changes. They
+   run next to the history, their rows are put in front of it as they come
+   in. The rows they replace must be removed already */
+static void
+load_virtual(GitgRepository *repository)
+{
+	gboolean show_stash;
+	gboolean show_staged;
+	gboolean show_unstaged;
 	
-	object->priv->lanes = gitg_lanes_new();
-	object->priv->grow_size = 1000;
-	object->priv->stamp = g_random_int();
-	object->priv->refs = g_hash_table_new_full(gitg_utils_hash_hash, gitg_utils_hash_equal, NULL, (GDestroyNotify)free_refs);
+	g_object_get(gitg_preferences_get_default(), 
+	             "history-show-virtual-stash", &show_stash,
+	             "history-show-virtual-staged", &show_staged, 
+	             "history-show-virtual-unstaged", &show_unstaged,
+	             NULL);
 	
-	object->priv->loader = gitg_runner_new(10000);
-	g_signal_connect(object->priv->loader, "update", G_CALLBACK(on_loader_update), object);
-	g_signal_connect(object->priv->loader, "end-loading", G_CALLBACK(on_loader_end_loading), object);
+	gitg_lanes_reset(repository->priv->virtual_lanes);
 	
-	initialize_bindings(object);
+	if (show_stash)
+	{
+		gitg_repository_run_commandv(repository, repository->priv->stash_loader, NULL, "log", "--pretty=format:%H\x01%an\x01%s\x01%at", "--encoding=UTF-8", "-g", "refs/stash", NULL);
+	}
+	
+	if (!show_staged && !show_unstaged)
+		return;
+	
+	gchar *head = gitg_repository_parse_head(repository);
+	
+	if (show_staged)
+	{
+		gitg_repository_run_commandv(repository, repository->priv->staged_probe, NULL, "diff-index", "--quiet", head, "--cached", NULL);
+	}
+	
+	if (show_unstaged)
+	{
+		gitg_repository_run_commandv(repository, repository->priv->unstaged_probe, NULL, "diff-index", "--quiet", head, NULL);
+	}
+	
+	g_free(head);
 }
 
 static void
-grow_storage(GitgRepository *repository, gint size)
+remove_virtual(GitgRepository *repository)
 {
-	if (repository->priv->size + size <= repository->priv->allocated)
-		return;
+	remove_rows(repository, 0, repository->priv->commits_start);
+	
+	repository->priv->commits_start = 0;
+	repository->priv->num_stash = 0;
+	repository->priv->num_staged = 0;
+}
+
+static gint
+find_ref_custom (GitgRef *first, GitgRef *second)
+{
+	return gitg_ref_equal (first, second) ? 0 : 1;
+}
+
+static GitgDecoration *
+decoration_new(GitgRef *ref)
+{
+	GitgDecoration *decoration = g_slice_new0(GitgDecoration);
 	
-	gulong prevallocated = repository->priv->allocated;
-	repository->priv->allocated += repository->priv->grow_size;
-	GitgRevision **newstorage = g_slice_alloc(sizeof(GitgRevision *) * repository->priv->allocated);
+	decoration->refs = g_slist_append(NULL, ref);
+	decoration->width = -1;
 	
-	int i;
-	for (i = 0; i < repository->priv->size; ++i)
-		newstorage[i] = repository->priv->storage[i];
+	return decoration;
+}
+
+static void
+decoration_free(GitgDecoration *decoration)
+{
+	g_slist_foreach(decoration->refs, (GFunc)gitg_ref_free, NULL);
+	g_slist_free(decoration->refs);
+	
+	g_slice_free(GitgDecoration, decoration);
+}
+
+static GitgRef *
+add_ref(GitgRepository *self, gchar const *sha1, gchar const *name)
+{
+	GitgRef *ref = gitg_ref_new(sha1, name);
+	GitgDecoration *decoration = gitg_hash_index_lookup(self->priv->refs, 
+	                                                    gitg_ref_get_hash(ref));
+	
+	if (decoration == NULL)
+	{
+		gitg_hash_index_insert(self->priv->refs, 
+		                       gitg_ref_get_hash(ref), 
+		                       decoration_new(ref));
+	}
+	else
+	{
+		if (!g_slist_find_custom (decoration->refs, ref, (GCompareFunc)find_ref_custom))
+		{
+			decoration->refs = g_slist_append(decoration->refs, ref);
+			decoration->width = -1;
+		}
+		else
+		{
+			gitg_ref_free (ref);
+		}
+	}
+	
+	return ref;
+}
+
+/* The loader parsers below run on the loader thread. They build the
+   revisions and assign their lanes, the main loop only inserts them */
+static void
+loader_add(GitgRepository *repository, GitgRevision *rv, GPtrArray *batch)
+{
+	assign_lanes(repository, rv);
+	g_queue_push_tail(repository->priv->pending, rv);
+	
+	/* Lanes of the most recent revisions are still changed when lanes get
+	   collapsed or expanded, only hand out those which are out of reach */
+	while (g_queue_get_length(repository->priv->pending) > repository->priv->pending_reach)
+	{
+		g_ptr_array_add(batch, g_queue_pop_head(repository->priv->pending));
+	}
+}
+
+/* Parses a line of the log, splitting it in place */
+static GitgRevision *
+parse_commit_line(GitgRepository *self, gchar *line)
+{
+	gchar *components[5];
+	guint len = gitg_utils_split_inplace(line, "\01", components, 5);
+	
+	if (len < 3)
+		return NULL;
+
+	/* components -> [hash, parents ([1 2 3]), timestamp[, leftright]], the
+	   author and subject are loaded later */
+	gint64 timestamp = g_ascii_strtoll(components[2], NULL, 0);
+
+	GitgRevision *rv = gitg_revision_new_from_arena(self->priv->arena, components[0], NULL, NULL, components[1], timestamp);
+	
+	if (len > 3 && strlen(components[3]) == 1 && strchr("<>-^", *components[3]) != NULL)
+	{
+		gitg_revision_set_sign(rv, *components[3]);
+	}
 	
-	if (repository->priv->storage)
-		g_slice_free1(sizeof(GitgRevision *) * prevallocated, repository->priv->storage);
+	return rv;
+}
+
+static void
+loader_parse_commits(GitgRepository *self, GitgRunnerLine *lines, GPtrArray *batch)
+{
+	for (; lines->line != NULL; ++lines)
+	{
+		/* new line is read, split it in place in the runners buffer */
+		GitgRevision *rv = parse_commit_line(self, lines->line);
 		
-	repository->priv->storage = newstorage;
+		if (rv)
+			loader_add(self, rv, batch);
+	}
 }
 
-GitgRepository *
-gitg_repository_new(gchar const *path)
+static gpointer
+loader_parse(GitgRunner *object, GitgRunnerLine *lines, GitgRepository *repository)
 {
-	return g_object_new(GITG_TYPE_REPOSITORY, "path", path, NULL);
+	GPtrArray *batch = g_ptr_array_new();
+
+	loader_parse_commits(repository, lines, batch);
+	
+	if (batch->len == 0)
+	{
+		g_ptr_array_free(batch, TRUE);
+		return NULL;
+	}
+	
+	return batch;
 }
 
-gchar const *
-gitg_repository_get_path(GitgRepository *self)
+static void
+loader_batch_free(GPtrArray *batch)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(self), NULL);
+	g_ptr_array_foreach(batch, (GFunc)gitg_revision_unref, NULL);
+	g_ptr_array_free(batch, TRUE);
+}
+
+static void
+on_loader_update(GitgRunner *object, GPtrArray *batch, GitgRepository *repository)
+{
+	gitg_repository_add_batch(repository, (GitgRevision **)batch->pdata, batch->len);
+	page_out_lanes(repository);
+}
+
+static RelaneJob *
+relane_job_ref(RelaneJob *job)
+{
+	g_atomic_int_inc(&job->ref_count);
+	return job;
+}
+
+/* Index of the first commit of chunk in the revisions of job */
+static gulong
+chunk_first(RelaneJob *job, RelaneChunk *chunk)
+{
+	return chunk->head ? 0 : job->shift + (gulong)chunk->num * LANES_PAGE_SIZE;
+}
+
+static gulong
+chunk_rows(RelaneJob *job, RelaneChunk *chunk)
+{
+	return chunk->head ? job->shift : LANES_PAGE_SIZE;
+}
+
+static void
+relane_chunk_free(RelaneChunk *chunk)
+{
+	if (chunk->checkpoint)
+		gitg_lanes_checkpoint_free(chunk->checkpoint);
 	
-	return self->priv->path;
+	if (chunk->copies)
+	{
+		g_ptr_array_foreach(chunk->copies, (GFunc)gitg_revision_unref, NULL);
+		g_ptr_array_free(chunk->copies, TRUE);
+	}
+	
+	g_slice_free(RelaneChunk, chunk);
 }
 
-GitgRunner *
-gitg_repository_get_loader(GitgRepository *self)
+/* The last reference goes on the main loop, after the thread is joined */
+static void
+relane_job_unref(RelaneJob *job)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(self), NULL);
-	return GITG_RUNNER(g_object_ref(self->priv->loader));
+	RelaneChunk *chunk;
+	
+	if (!g_atomic_int_dec_and_test(&job->ref_count))
+		return;
+	
+	while ((chunk = g_async_queue_try_pop(job->chunks)))
+		relane_chunk_free(chunk);
+	
+	g_async_queue_unref(job->chunks);
+	g_object_unref(job->lanes);
+	
+	g_ptr_array_foreach(job->revisions, (GFunc)gitg_revision_unref, NULL);
+	g_ptr_array_free(job->revisions, TRUE);
+	gitg_revision_arena_unref(job->arena);
+	
+	g_slice_free(RelaneJob, job);
+}
+
+static void
+emit_visible_rows_changed(GitgRepository *repository, gulong first, gulong last)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gulong i;
+	
+	first = MAX(first, repository->priv->visible_first);
+	last = MIN(last, repository->priv->visible_last + 1);
+	
+	if (first >= last)
+		return;
+	
+	path = gtk_tree_path_new_from_indices(first, -1);
+	
+	for (i = first; i < last; ++i)
+	{
+		fill_iter(repository, i, &iter);
+		gtk_tree_model_row_changed(GTK_TREE_MODEL(repository), path, &iter);
+		
+		gtk_tree_path_next(path);
+	}
+	
+	gtk_tree_path_free(path);
+}
+
+/* Swaps the lanes of a chunk into its rows and its checkpoint in for the
+   page. Rows which moved since the relane started are left alone, a new
+   relane is on its way for them. The head chunk has no page */
+static void
+swap_relane_chunk(GitgRepository *repository, RelaneJob *job, RelaneChunk *chunk)
+{
+	LanesPage *page;
+	gulong first = repository->priv->commits_start + chunk_first(job, chunk);
+	gboolean moved = FALSE;
+	guint i;
+	
+	for (i = 0; i < chunk->copies->len; ++i)
+	{
+		GitgRevision *copy = g_ptr_array_index(chunk->copies, i);
+		GitgRevision *rv = g_ptr_array_index(job->revisions, chunk_first(job, chunk) + i);
+		
+		if (first + i >= repository->priv->size || repository->priv->storage[first + i] != rv)
+		{
+			moved = TRUE;
+			continue;
+		}
+		
+		gitg_revision_set_lanes(rv, gitg_revision_steal_lanes(copy), gitg_revision_get_mylane(copy));
+	}
+	
+	if (moved)
+		return;
+	
+	if (chunk->head)
+	{
+		emit_visible_rows_changed(repository, first, first + chunk->copies->len);
+		return;
+	}
+	
+	page = g_slice_new0(LanesPage);
+	page->checkpoint = chunk->checkpoint;
+	chunk->checkpoint = NULL;
+	
+	g_mutex_lock(repository->priv->pages_lock);
+	
+	if (chunk->num < repository->priv->pages->len)
+	{
+		LanesPage *old = g_ptr_array_index(repository->priv->pages, chunk->num);
+		
+		/* The rows of a paged out page have their lanes again */
+		if (old->colors)
+			--repository->priv->pages_out;
+		
+		page->used = old->used;
+		lanes_page_free(old);
+		
+		repository->priv->pages->pdata[chunk->num] = page;
+	}
+	else
+	{
+		g_ptr_array_add(repository->priv->pages, page);
+	}
+	
+	g_mutex_unlock(repository->priv->pages_lock);
+	
+	emit_visible_rows_changed(repository, first, first + chunk->copies->len);
+}
+
+static void
+finish_relane(GitgRepository *repository)
+{
+	RelaneJob *job = repository->priv->relane;
+	
+	if (job->thread)
+		g_thread_join(job->thread);
+	
+	job->detached = TRUE;
+	repository->priv->relane = NULL;
+	relane_job_unref(job);
+	
+	repository->priv->laned = repository->priv->size - repository->priv->commits_start;
+	page_out_lanes(repository);
+}
+
+static gboolean
+relane_idle(RelaneJob *job)
+{
+	RelaneChunk *chunk;
+	guint swapped = 0;
+	
+	/* Anything pushed after this schedules a new idle */
+	g_atomic_int_set(&job->idle_scheduled, 0);
+	
+	if (job->detached)
+		return FALSE;
+	
+	while ((chunk = g_async_queue_try_pop(job->chunks)))
+	{
+		if (chunk->end)
+		{
+			relane_chunk_free(chunk);
+			finish_relane(job->repository);
+			
+			return FALSE;
+		}
+		
+		swap_relane_chunk(job->repository, job, chunk);
+		relane_chunk_free(chunk);
+		
+		/* Let the main loop draw in between */
+		if (++swapped == RELANE_CHUNKS_PER_IDLE)
+			return TRUE;
+	}
+	
+	return FALSE;
+}
+
+static void
+relane_push(RelaneJob *job, RelaneChunk *chunk)
+{
+	g_async_queue_push(job->chunks, chunk);
+	
+	if (g_atomic_int_compare_and_exchange(&job->idle_scheduled, 0, 1))
+	{
+		g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+		                (GSourceFunc)relane_idle,
+		                relane_job_ref(job),
+		                (GDestroyNotify)relane_job_unref);
+	}
+}
+
+/* Relane thread: lays out copies of the commits, a chunk is final once
+   the rows collapsing reaches back from are laid out */
+static gpointer
+relane_run(RelaneJob *job)
+{
+	GQueue *pending = g_queue_new();
+	gulong reach = lanes_reach(job->lanes);
+	RelaneChunk *chunk = NULL;
+	guint i;
+	
+	for (i = 0; i < job->revisions->len; ++i)
+	{
+		GitgRevision *copy;
+		GitgLaneRow *lanes;
+		gint8 mylane;
+		
+		if (g_atomic_int_get(&job->cancelled))
+			break;
+		
+		if (i == 0 && job->shift)
+		{
+			chunk = g_slice_new0(RelaneChunk);
+			
+			chunk->head = TRUE;
+			chunk->copies = g_ptr_array_sized_new(job->shift);
+			
+			g_queue_push_tail(pending, chunk);
+		}
+		else if (i >= job->shift && (i - job->shift) % LANES_PAGE_SIZE == 0)
+		{
+			chunk = g_slice_new0(RelaneChunk);
+			
+			chunk->num = (i - job->shift) / LANES_PAGE_SIZE;
+			chunk->checkpoint = gitg_lanes_save(job->lanes);
+			chunk->copies = g_ptr_array_sized_new(LANES_PAGE_SIZE);
+			
+			g_queue_push_tail(pending, chunk);
+		}
+		
+		copy = copy_for_lanes(job->arena, g_ptr_array_index(job->revisions, i));
+		
+		lanes = gitg_lanes_next(job->lanes, copy, &mylane);
+		gitg_revision_set_lanes(copy, lanes, mylane);
+		
+		g_ptr_array_add(chunk->copies, copy);
+		
+		while ((chunk = g_queue_peek_head(pending)) && 
+		       chunk->copies->len == chunk_rows(job, chunk) && 
+		       chunk_first(job, chunk) + chunk->copies->len + reach <= i + 1)
+		{
+			relane_push(job, g_queue_pop_head(pending));
+		}
+		
+		chunk = g_queue_peek_tail(pending);
+	}
+	
+	/* Nothing refers to the copies anymore after the reset */
+	gitg_lanes_reset(job->lanes);
+	
+	if (g_atomic_int_get(&job->cancelled))
+	{
+		g_queue_foreach(pending, (GFunc)relane_chunk_free, NULL);
+		g_queue_free(pending);
+		
+		return NULL;
+	}
+	
+	while ((chunk = g_queue_pop_head(pending)))
+		relane_push(job, chunk);
+	
+	g_queue_free(pending);
+	
+	chunk = g_slice_new0(RelaneChunk);
+	chunk->end = TRUE;
+	
+	relane_push(job, chunk);
+	return NULL;
+}
+
+/* Stops a running relane, the rows swapped in so far keep their lanes */
+static void
+cancel_relane(GitgRepository *repository)
+{
+	RelaneJob *job = repository->priv->relane;
+	
+	if (!job)
+		return;
+	
+	g_atomic_int_set(&job->cancelled, 1);
+	
+	if (job->thread)
+		g_thread_join(job->thread);
+	
+	job->detached = TRUE;
+	repository->priv->relane = NULL;
+	relane_job_unref(job);
+}
+
+static void
+start_relane(GitgRepository *repository)
+{
+	RelaneJob *job = g_slice_new0(RelaneJob);
+	gulong i;
+	
+	job->ref_count = 1;
+	job->repository = repository;
+	job->chunks = g_async_queue_new();
+	job->lanes = gitg_lanes_new();
+	job->arena = gitg_revision_arena_new();
+	job->shift = repository->priv->pages_shift;
+	job->revisions = g_ptr_array_sized_new(repository->priv->size - repository->priv->commits_start);
+	
+	copy_lanes_settings(repository->priv->lanes, job->lanes);
+	
+	/* Virtual rows are laned on their own */
+	for (i = repository->priv->commits_start; i < repository->priv->size; ++i)
+		g_ptr_array_add(job->revisions, gitg_revision_ref(repository->priv->storage[i]));
+	
+	repository->priv->relane = job;
+	job->thread = g_thread_create((GThreadFunc)relane_run, job, TRUE, NULL);
+	
+	if (!job->thread)
+		relane_run(job);
+}
+
+/* Runs from an idle, so that the bindings changing the lanes settings
+   together only relane once. A relane still running is started over */
+static gboolean
+repository_relane(GitgRepository *repository)
+{
+	repository->priv->idle_relane_id = 0;
+	
+	if (gitg_runner_running(repository->priv->loader))
+	{
+		repository->priv->relane_pending = TRUE;
+		return FALSE;
+	}
+	
+	cancel_relane(repository);
+	start_relane(repository);
+	
+	return FALSE;
+}
+
+static gboolean
+lanes_equal(GitgLaneRow *a, GitgLaneRow *b)
+{
+	guint i;
+	
+	if (gitg_lane_row_length(a) != gitg_lane_row_length(b))
+		return FALSE;
+	
+	for (i = 0; i < gitg_lane_row_length(a); ++i)
+	{
+		GitgLane *first = &a->lanes[i];
+		GitgLane *second = &b->lanes[i];
+		
+		/* Signs are only set once the lanes are assigned to a revision */
+		if ((first->type & (GITG_LANE_TYPE_START | GITG_LANE_TYPE_END)) != 
+		    (second->type & (GITG_LANE_TYPE_START | GITG_LANE_TYPE_END)))
+			return FALSE;
+		
+		if (GITG_IS_LANE_BOUNDARY(first) && 
+		    memcmp(gitg_lane_row_get_hash(a, first), gitg_lane_row_get_hash(b, second), HASH_BINARY_SIZE) != 0)
+			return FALSE;
+		
+		if (first->num_from != second->num_from ||
+		    memcmp(gitg_lane_row_get_from(a, first), gitg_lane_row_get_from(b, second), first->num_from) != 0)
+			return FALSE;
+	}
+	
+	return TRUE;
+}
+
+/* Colors are shared along a lane, this carries the colors of the rows
+   below up into the relaned rows */
+static void
+adopt_colors(GitgLaneRow *lanes, GitgLaneRow *old)
+{
+	guint i;
+	
+	for (i = 0; i < gitg_lane_row_length(lanes) && i < gitg_lane_row_length(old); ++i)
+		lanes->lanes[i].color->index = old->lanes[i].color->index;
+}
+
+/* Relanes the commits from the top after rows were put in front of the row
+   at first_old. Lanes only change down to where the new layout runs into
+   the old one, which is when enough old rows in a row come out the same.
+   Paged out rows are paged in to compare against, the pages reached get
+   their checkpoint from the new layout */
+static void
+relane_top(GitgRepository *repository, gulong first_old)
+{
+	GtkTreePath *path = gtk_tree_path_new_from_indices(repository->priv->commits_start, -1);
+	gulong pages_start = repository->priv->commits_start + repository->priv->pages_shift;
+	GtkTreeIter iter;
+	guint matched = 0;
+	gulong i;
+	gint collapse;
+	gint gap;
+	
+	g_object_get(repository->priv->lanes, 
+	             "inactive-collapse", &collapse, 
+	             "inactive-gap", &gap, 
+	             NULL);
+	
+	/* Collapsing still changes rows this far up */
+	guint converge = MAX(RELANE_CONVERGE_ROWS, collapse + gap + 1);
+	
+	gitg_lanes_reset(repository->priv->lanes);
+	
+	for (i = repository->priv->commits_start; i < repository->priv->size && matched < converge; ++i)
+	{
+		gint8 mylane;
+		GitgRevision *revision = repository->priv->storage[i];
+		GitgLaneRow *old;
+		GitgLaneRow *lanes;
+		LanesPage *page;
+		
+		page_in_row(repository, i);
+		
+		if (i >= pages_start && (i - pages_start) % LANES_PAGE_SIZE == 0 &&
+		    (page = get_lanes_page(repository, (i - pages_start) / LANES_PAGE_SIZE)))
+		{
+			gitg_lanes_checkpoint_free(page->checkpoint);
+			page->checkpoint = gitg_lanes_save(repository->priv->lanes);
+		}
+		
+		old = gitg_revision_get_lanes(revision);
+		lanes = gitg_lanes_next(repository->priv->lanes, revision, &mylane);
+		
+		if (i >= first_old && mylane == gitg_revision_get_mylane(revision) && lanes_equal(lanes, old))
+		{
+			adopt_colors(lanes, old);
+			++matched;
+		}
+		else
+		{
+			matched = 0;
+		}
+		
+		gitg_revision_set_lanes(revision, lanes, mylane);
+		
+		fill_iter(repository, i, &iter);
+		gtk_tree_model_row_changed(GTK_TREE_MODEL(repository), path, &iter);
+		
+		gtk_tree_path_next(path);
+	}
+	
+	gtk_tree_path_free(path);
+}
+
+static void
+prepare_relane(GitgRepository *repository)
+{
+	if (!repository->priv->idle_relane_id)
+		repository->priv->idle_relane_id = g_idle_add((GSourceFunc)repository_relane, repository);
+}
+
+static gboolean
+convert_setting_to_inactive_max(GValue const *setting, GValue *value, gpointer userdata)
+{
+	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_INT), FALSE);
+	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_INT), FALSE);
+	
+	gint s = g_value_get_int(setting);
+	g_value_set_int(value, 2 + s * 8);
+	
+	prepare_relane(GITG_REPOSITORY(userdata));
+	return TRUE;
+}
+
+static gboolean
+convert_setting_to_inactive_collapse(GValue const *setting, GValue *value, gpointer userdata)
+{
+	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_INT), FALSE);
+	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_INT), FALSE);
+
+	gint s = g_value_get_int(setting);
+	g_value_set_int(value, 1 + s * 3);
+
+	prepare_relane(GITG_REPOSITORY(userdata));	
+	return TRUE;
+}
+
+static gboolean
+convert_setting_to_inactive_gap(GValue const *setting, GValue *value, gpointer userdata)
+{
+	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_INT), FALSE);
+	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_INT), FALSE);
+
+	g_value_set_int(value, 10);
+	
+	prepare_relane(GITG_REPOSITORY(userdata));	
+	return TRUE;
+}
+
+static gboolean
+convert_setting_to_inactive_enabled(GValue const *setting, GValue *value, gpointer userdata)
+{
+	g_return_val_if_fail(G_VALUE_HOLDS(setting, G_TYPE_BOOLEAN), FALSE);
+	g_return_val_if_fail(G_VALUE_HOLDS(value, G_TYPE_BOOLEAN), FALSE);
+
+	gboolean s = g_value_get_boolean(setting);
+	g_value_set_boolean(value, s);
+	
+	prepare_relane(GITG_REPOSITORY(userdata));	
+	return TRUE;
+}
+
+static void
+on_update_virtual(GObject *object, GParamSpec *spec, GitgRepository *repository)
+{
+	gitg_repository_reload (repository);
+}
+
+static void
+initialize_bindings(GitgRepository *repository)
+{
+	GitgPreferences *preferences = gitg_preferences_get_default();
+	
+	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes",
+							   repository->priv->lanes, "inactive-max",
+							   convert_setting_to_inactive_max,
+							   repository);
+
+	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes",
+							   repository->priv->lanes, "inactive-collapse",
+							   convert_setting_to_inactive_collapse,
+							   repository);
+
+	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes",
+							   repository->priv->lanes, "inactive-gap",
+							   convert_setting_to_inactive_gap,
+							   repository);		
+
+	gitg_data_binding_new_full(preferences, "history-collapse-inactive-lanes-active",
+	                           repository->priv->lanes, "inactive-enabled",
+	                           convert_setting_to_inactive_enabled,
+	                           repository);	
+
+	g_signal_connect(preferences, 
+	                 "notify::history-show-virtual-stash",
+	                 G_CALLBACK(on_update_virtual),
+	                 repository);
+
+	g_signal_connect(preferences, 
+	                 "notify::history-show-virtual-unstaged",
+	                 G_CALLBACK(on_update_virtual),
+	                 repository);
+
+	g_signal_connect(preferences, 
+	                 "notify::history-show-virtual-staged",
+	                 G_CALLBACK(on_update_virtual),
+	                 repository);
+}
+
+static void on_refs_update(GitgRunner *runner, gchar **lines, GitgRepository *repository);
+static void on_refs_end_loading(GitgRunner *runner, gboolean cancelled, GitgRepository *repository);
+static void on_details_update(GitgRunner *runner, gchar **lines, GitgRepository *repository);
+static void on_details_end_loading(GitgRunner *runner, gboolean cancelled, GitgRepository *repository);
+
+static void
+gitg_repository_init(GitgRepository *object)
+{
+	object->priv = GITG_REPOSITORY_GET_PRIVATE(object);
+	object->priv->hashtable = gitg_hash_index_new(NULL);
+	
+	object->priv->column_types[0] = GITG_TYPE_REVISION;
+	object->priv->column_types[1] = G_TYPE_STRING;
+	object->priv->column_types[2] = G_TYPE_STRING;
+	object->priv->column_types[3] = G_TYPE_STRING;
+	
+	object->priv->lanes = gitg_lanes_new();
+	object->priv->page_lanes = gitg_lanes_new();
+	object->priv->pages = g_ptr_array_new();
+	object->priv->pages_lock = g_mutex_new();
+	object->priv->date_cache = gitg_date_cache_new(FALSE);
+	object->priv->visible_last = G_MAXULONG;
+	object->priv->arena = gitg_revision_arena_new();
+	object->priv->stamp = g_random_int();
+	object->priv->refs = gitg_hash_index_new((GDestroyNotify)decoration_free);
+	object->priv->staged_decoration = decoration_new(gitg_ref_new(DUMMY_SHA1, "staged"));
+	object->priv->unstaged_decoration = decoration_new(gitg_ref_new(DUMMY_SHA1, "unstaged"));
+	
+	object->priv->pending = g_queue_new();
+	object->priv->changes_timer = g_timer_new();
+	object->priv->query_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)cached_query_free);
+	
+	object->priv->loader = gitg_runner_new(10000);
+	gitg_runner_set_parser(object->priv->loader, 
+	                       (GitgRunnerParser)loader_parse, 
+	                       (GDestroyNotify)loader_batch_free, 
+	                       object);
+	gitg_runner_set_batch_budget(object->priv->loader, 8);
+
+	g_signal_connect(object->priv->loader, "update-batch", G_CALLBACK(on_loader_update), object);
+	g_signal_connect(object->priv->loader, "end-loading", G_CALLBACK(on_loader_end_loading), object);
+	
+	object->priv->refs_loader = gitg_runner_new(1000);
+	g_signal_connect(object->priv->refs_loader, "update", G_CALLBACK(on_refs_update), object);
+	g_signal_connect(object->priv->refs_loader, "end-loading", G_CALLBACK(on_refs_end_loading), object);
+	
+	object->priv->stash_loader = gitg_runner_new(1000);
+	g_signal_connect(object->priv->stash_loader, "update", G_CALLBACK(on_stash_update), object);
+	
+	object->priv->staged_probe = gitg_runner_new(1000);
+	g_signal_connect(object->priv->staged_probe, "end-loading", G_CALLBACK(on_probe_end_loading), object);
+	
+	object->priv->unstaged_probe = gitg_runner_new(1000);
+	g_signal_connect(object->priv->unstaged_probe, "end-loading", G_CALLBACK(on_probe_end_loading), object);
+	
+	object->priv->virtual_lanes = gitg_lanes_new();
+	
+	object->priv->details_loader = gitg_runner_new(10000);
+	g_signal_connect(object->priv->details_loader, "update", G_CALLBACK(on_details_update), object);
+	g_signal_connect(object->priv->details_loader, "end-loading", G_CALLBACK(on_details_end_loading), object);
+	
+	object->priv->details_requested = gitg_hash_index_new(NULL);
+	object->priv->details_queue = g_string_new("");
+	
+	initialize_bindings(object);
+}
+
+/* Storage grows geometrically, loading N revisions moves O(N) pointers */
+static void
+grow_storage(GitgRepository *repository, gulong size)
+{
+	if (repository->priv->size + size <= repository->priv->allocated)
+		return;
+	
+	gulong allocated = MAX(repository->priv->allocated * 2, STORAGE_MIN_SIZE);
+	
+	if (allocated < repository->priv->size + size)
+		allocated = repository->priv->size + size;
+	
+	repository->priv->storage = g_renew(GitgRevision *, repository->priv->storage, allocated);
+	repository->priv->allocated = allocated;
+}
+
+GitgRepository *
+gitg_repository_new(gchar const *path)
+{
+	return g_object_new(GITG_TYPE_REPOSITORY, "path", path, NULL);
+}
+
+gchar const *
+gitg_repository_get_path(GitgRepository *self)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(self), NULL);
+	
+	return self->priv->path;
+}
+
+GitgRunner *
+gitg_repository_get_loader(GitgRepository *self)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(self), NULL);
+	return GITG_RUNNER(g_object_ref(self->priv->loader));
+}
+
+static gboolean
+has_left_right(gchar const **av, int argc)
+{
+	int i;
+
+	for (i = 0; i < argc; ++i)
+		if (strcmp(av[i], "--left-right") == 0)
+			return TRUE;
+	
+	return FALSE;
+}
+
+static void
+build_log_args(GitgRepository *self, gint argc, gchar const **av)
+{
+	gchar **argv = g_new0(gchar *, 6 + (argc > 0 ? argc - 1 : 0));
+
+	argv[0] = g_strdup("log");
+	
+	if (has_left_right(av, argc))
+	{
+		argv[1] = g_strdup("--pretty=format:%H\x01%P\x01%ct\x01%m");
+	}
+	else
+	{
+		argv[1] = g_strdup("--pretty=format:%H\x01%P\x01%ct");
+	}
+	
+	argv[2] = g_strdup ("--encoding=UTF-8");
+	
+	gchar *head = NULL;
+	
+	if (argc <= 0)
+	{
+		head = gitg_repository_parse_ref(self, "HEAD");
+		
+		if (head)
+		{
+			argv[3] = g_strdup("HEAD");
+		}
+		
+		g_free(head);
+	}
+	else
+	{
+		int i;
+
+		for (i = 0; i < argc; ++i)
+		{
+			argv[3 + i] = g_strdup(av[i]);
+		}
+	}
+
+	g_strfreev(self->priv->last_args);
+	self->priv->last_args = argv;
+}
+
+static gchar *
+load_current_ref(GitgRepository *self)
+{
+	gchar **out;
+	gchar *ret = NULL;
+	gint i;
+	gint numargs;
+	
+	/* The history of HEAD, by far the most common, is resolved from HEAD
+	   itself */
+	if (self->priv->last_args[3] && strcmp(self->priv->last_args[3], "HEAD") == 0 && !self->priv->last_args[4])
+	{
+		gchar *git_dir = g_build_filename(self->priv->path, ".git", NULL);
+		
+		ret = gitg_ref_reader_head(git_dir);
+		g_free(git_dir);
+		
+		if (ret)
+			return ret;
+	}
+
+	numargs = g_strv_length(self->priv->last_args);
+
+	gchar const **argv = g_new0(gchar const *, numargs + 3);
+
+	argv[0] = "rev-parse";
+	argv[1] = "--no-flags";
+	argv[2] = "--symbolic-full-name";
+
+	for (i = 1; i < numargs; ++i)
+	{
+		argv[2 + i] = self->priv->last_args[i];
+	}
+
+	out = gitg_repository_command_with_output_cached(self, argv, NULL);
+	g_free(argv);
+	
+	if (!out)
+	{
+		return NULL;
+	}
+	
+	if (*out && !*(out + 1))
+	{
+		ret = g_strdup(*out);
+	}
+	
+	g_strfreev(out);
+	return ret;
+}
+
+static gchar const *list_refs_argv[] = {
+	"for-each-ref",
+	"--format=%(refname) %(objectname) %(*objectname)",
+	"refs",
+	NULL
+};
+
+static gchar **
+list_refs(GitgRepository *repository)
+{
+	return gitg_repository_command_with_output_cached(repository, list_refs_argv, NULL);
+}
+
+/* Each line of for-each-ref looks like <name> <hash> <peeled hash> */
+static void
+ref_line(GitgRepository *repository, gchar const *line, RefFunc func, gpointer data)
+{
+	gchar **components = g_strsplit(line, " ", 3);
+	guint len = g_strv_length(components);
+	
+	if (len == 2 || len == 3)
+	{
+		gchar const *obj = len == 3 && *components[2] ? components[2] : components[1];
+		func(repository, components[0], obj, data);
+	}
+	
+	g_strfreev(components);
+}
+
+typedef struct
+{
+	GitgRepository *repository;
+	RefFunc func;
+	gpointer data;
+} ForeachRef;
+
+static void
+on_ref_file(gchar const *name, gchar const *sha1, gchar const *peeled, ForeachRef *foreach)
+{
+	gchar *resolved = NULL;
+	
+	/* Loose tags do not have their peeled object on disk */
+	if (!peeled)
+	{
+		gchar *spec = g_strconcat(sha1, "^{}", NULL);
+		
+		resolved = gitg_repository_cat_file_check(foreach->repository, spec, NULL, NULL);
+		peeled = resolved ? resolved : sha1;
+		
+		g_free(spec);
+	}
+	
+	foreach->func(foreach->repository, name, peeled, foreach->data);
+	g_free(resolved);
+}
+
+/* Reads the refs from packed-refs and the loose ref files. Returns FALSE
+   when they are not stored in files, for-each-ref knows how to read them */
+static gboolean
+read_ref_files(GitgRepository *repository, RefFunc func, gpointer data)
+{
+	gchar *git_dir = g_build_filename(repository->priv->path, ".git", NULL);
+	ForeachRef foreach = {repository, func, data};
+	gboolean ret;
+	
+	ret = gitg_ref_reader_foreach(git_dir, (GitgRefReaderFunc)on_ref_file, &foreach);
+	
+	g_free(git_dir);
+	return ret;
+}
+
+static void
+foreach_ref(GitgRepository *repository, RefFunc func, gpointer data)
+{
+	gchar **lines;
+	gchar **line;
+	
+	if (read_ref_files(repository, func, data))
+		return;
+	
+	lines = list_refs(repository);
+	
+	for (line = lines; line && *line; ++line)
+		ref_line(repository, *line, func, data);
+	
+	g_strfreev(lines);
+}
+
+static void
+add_ref_func(GitgRepository *repository, gchar const *name, gchar const *sha1, gpointer data)
+{
+	add_ref(repository, sha1, name);
+}
+
+static void
+set_current_ref(GitgRepository *self)
+{
+	gchar *current = load_current_ref(self);
+	GSList *refs;
+	GSList *item;
+	
+	gitg_ref_free(self->priv->current_ref);
+	self->priv->current_ref = NULL;
+	
+	if (!current)
+		return;
+	
+	refs = gitg_repository_get_refs(self);
+	
+	for (item = refs; item; item = g_slist_next(item))
+	{
+		GitgRef *ref = (GitgRef *)item->data;
+		
+		if (strcmp(gitg_ref_get_name(ref), current) == 0)
+		{
+			self->priv->current_ref = gitg_ref_copy(ref);
+			break;
+		}
+	}
+	
+	g_slist_foreach(refs, (GFunc)gitg_ref_free, NULL);
+	g_slist_free(refs);
+	g_free(current);
+}
+
+static void
+load_refs(GitgRepository *self)
+{
+	foreach_ref(self, add_ref_func, NULL);
+	set_current_ref(self);
+}
+
+static void update_ref_rows(GitgRepository *repository, GSList *old);
+
+static void
+on_refs_update(GitgRunner *runner, gchar **lines, GitgRepository *repository)
+{
+	for (; *lines; ++lines)
+		ref_line(repository, *lines, add_ref_func, NULL);
+}
+
+static void
+on_refs_end_loading(GitgRunner *runner, gboolean cancelled, GitgRepository *repository)
+{
+	if (cancelled)
+		return;
+	
+	set_current_ref(repository);
+	
+	/* Labels of rows which are in already */
+	update_ref_rows(repository, NULL);
+	g_signal_emit(repository, repository_signals[LOAD], 0);
+	
+	if (repository->priv->load_stage == LOAD_STAGE_LAST)
+		store_history_cache(repository);
+}
+
+static gboolean run_commit_graph(GitgRepository *repository);
+
+/* The commits log starts right away, the virtual rows load next to it. Refs
+   are read from their files first, when that is not possible for-each-ref
+   runs next to the log too. Only a history cache has to wait for it, the
+   cache is brought up to date with the refs */
+static gboolean
+reload_revisions(GitgRepository *repository, GError **error)
+{
+	gchar *filename = history_cache_filename(repository);
+	gboolean cached = g_file_test(filename, G_FILE_TEST_EXISTS);
+	
+	g_free(filename);
+	
+	if (repository->priv->working_ref)
+	{
+		gitg_ref_free (repository->priv->working_ref);
+		repository->priv->working_ref = NULL;
+	}
+	
+	g_free(repository->priv->history_key);
+	repository->priv->history_key = NULL;
+	
+	g_free(repository->priv->history_tips);
+	repository->priv->history_tips = NULL;
+	
+	/* Reserve the storage once instead of growing it during the load */
+	grow_storage(repository, repository->priv->size_hint);
+	gitg_hash_index_reserve(repository->priv->hashtable, repository->priv->size_hint);
+	
+	gitg_lanes_reset(repository->priv->lanes);
+	clear_lanes_pages(repository);
+	load_virtual(repository);
+	
+	if (read_ref_files(repository, add_ref_func, NULL))
+		set_current_ref(repository);
+	else if (cached)
+		load_refs(repository);
+	else
+		gitg_repository_run_command(repository, repository->priv->refs_loader, list_refs_argv, NULL);
+	
+	if (!gitg_runner_running(repository->priv->refs_loader))
+	{
+		g_signal_emit(repository, repository_signals[LOAD], 0);
+		
+		if (cached && load_history_cache(repository))
+			return TRUE;
+	}
+	
+	repository->priv->load_stage = LOAD_STAGE_COMMITS;
+	
+	/* Read on the main thread, the loader thread only uses the copy */
+	repository->priv->pending_reach = lanes_reach(repository->priv->lanes);
+	
+	if (run_commit_graph(repository))
+		return TRUE;
+	
+	return gitg_repository_run_command(repository, repository->priv->loader, (gchar const **)repository->priv->last_args, error);
+}
+
+void
+gitg_repository_reload(GitgRepository *repository)
+{
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	g_return_if_fail(repository->priv->path != NULL);
+
+	cancel_loading(repository);
+	gitg_repository_clear(repository);
+	gitg_repository_invalidate(repository);
+	
+	reload_revisions(repository, NULL);
+}
+
+/* Brings the history up to date with the refs. Only the new commits are
+   loaded when the history was not rewritten, otherwise it is reloaded */
+void
+gitg_repository_update(GitgRepository *repository)
+{
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	g_return_if_fail(repository->priv->path != NULL);
+	
+	if (!update_history(repository))
+		gitg_repository_reload(repository);
+}
+
+gboolean
+gitg_repository_load(GitgRepository *self, int argc, gchar const **av, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(self), FALSE);
+	
+	if (self->priv->path == NULL)
+	{
+		if (error)
+		{
+			*error = g_error_new_literal(gitg_repository_error_quark(), GITG_REPOSITORY_ERROR_NOT_FOUND, _("Not a valid git repository"));
+		}
+			
+		return FALSE;
+	}
+
+	cancel_loading(self);
+	gitg_repository_clear(self);
+		
+	build_log_args(self, argc, av);
+	
+	/* request log (all the revision), the refs come with it */
+	return reload_revisions(self, error);
+}
+
+void
+gitg_repository_add(GitgRepository *self, GitgRevision *obj, GtkTreeIter *iter)
+{
+	/* validate our parameters */
+	g_return_if_fail(GITG_IS_REPOSITORY(self));
+	
+	gitg_repository_add_batch(self, &obj, 1);
+	
+	/* return the iter if the user cares */
+	if (iter)
+		fill_iter(self, self->priv->size - 1, iter);
+}
+
+/* Appends num revisions, which are referenced by the model. Large batches
+   are wrapped in begin-bulk-insert and end-bulk-insert */
+void
+gitg_repository_add_batch(GitgRepository *self, GitgRevision **revisions, guint num)
+{
+	g_return_if_fail(GITG_IS_REPOSITORY(self));
+	
+	if (num == 0)
+		return;
+	
+	gboolean bulk = num >= MAX(self->priv->size / BULK_INSERT_RATIO, BULK_INSERT_MIN);
+	GtkTreeIter iter = {0,};
+	guint i;
+	
+	if (bulk)
+		g_signal_emit(self, repository_signals[BEGIN_BULK_INSERT], 0);
+	
+	grow_storage(self, num);
+	
+	GtkTreePath *path = gtk_tree_path_new_from_indices(self->priv->size, -1);
+	
+	for (i = 0; i < num; ++i)
+	{
+		GitgRevision *rv = revisions[i];
+		gulong index = self->priv->size++;
+
+		/* put this object in our data storage */
+		self->priv->storage[index] = gitg_revision_ref(rv);
+		gitg_hash_index_insert(self->priv->hashtable, gitg_revision_get_hash(rv), GUINT_TO_POINTER(index));
+		
+		fill_iter(self, index, &iter);
+		gtk_tree_model_row_inserted(GTK_TREE_MODEL(self), path, &iter);
+		
+		gtk_tree_path_next(path);
+	}
+	
+	gtk_tree_path_free(path);
+	
+	if (bulk)
+		g_signal_emit(self, repository_signals[END_BULK_INSERT], 0);
+}
+
+static void
+reindex_rows(GitgRepository *repository, gulong from)
+{
+	gulong i;
+	
+	for (i = from; i < repository->priv->size; ++i)
+	{
+		gitg_hash_index_insert(repository->priv->hashtable, 
+		                       gitg_revision_get_hash(repository->priv->storage[i]), 
+		                       GUINT_TO_POINTER(i));
+	}
+}
+
+/* Inserts num revisions at position, rows below it move down */
+static void
+insert_rows(GitgRepository *repository, gulong position, GitgRevision **revisions, guint num)
+{
+	GtkTreeIter iter = {0,};
+	guint i;
+	
+	if (num == 0)
+		return;
+	
+	grow_storage(repository, num);
+	
+	memmove(repository->priv->storage + position + num, 
+	        repository->priv->storage + position, 
+	        sizeof(GitgRevision *) * (repository->priv->size - position));
+	
+	for (i = 0; i < num; ++i)
+		repository->priv->storage[position + i] = gitg_revision_ref(revisions[i]);
+	
+	repository->priv->size += num;
+	reindex_rows(repository, position);
+	
+	GtkTreePath *path = gtk_tree_path_new_from_indices(position, -1);
+	
+	for (i = 0; i < num; ++i)
+	{
+		fill_iter(repository, position + i, &iter);
+		gtk_tree_model_row_inserted(GTK_TREE_MODEL(repository), path, &iter);
+		
+		gtk_tree_path_next(path);
+	}
+	
+	gtk_tree_path_free(path);
+}
+
+/* Removes num rows from position, rows below it move up */
+static void
+remove_rows(GitgRepository *repository, gulong position, gulong num)
+{
+	gulong i;
+	
+	if (num == 0)
+		return;
+	
+	for (i = position; i < position + num; ++i)
+	{
+		GitgRevision *revision = repository->priv->storage[i];
+		gpointer index;
+		
+		/* The virtual rows share a hash, only drop what points here */
+		if (gitg_hash_index_lookup_extended(repository->priv->hashtable, gitg_revision_get_hash(revision), &index) &&
+		    GPOINTER_TO_UINT(index) == i)
+		{
+			gitg_hash_index_remove(repository->priv->hashtable, gitg_revision_get_hash(revision));
+		}
+		
+		gitg_revision_unref(revision);
+	}
+	
+	memmove(repository->priv->storage + position, 
+	        repository->priv->storage + position + num, 
+	        sizeof(GitgRevision *) * (repository->priv->size - position - num));
+	
+	repository->priv->size -= num;
+	reindex_rows(repository, position);
+	
+	GtkTreePath *path = gtk_tree_path_new_from_indices(position, -1);
+	
+	for (i = 0; i < num; ++i)
+		gtk_tree_model_row_deleted(GTK_TREE_MODEL(repository), path);
+	
+	gtk_tree_path_free(path);
+}
+
+void
+gitg_repository_clear(GitgRepository *repository)
+{
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	do_clear(repository, TRUE);
+}
+
+GitgRevision *
+gitg_repository_lookup(GitgRepository *store, gchar const *hash)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(store), NULL);
+	
+	gpointer result;
+	
+	if (!gitg_hash_index_lookup_extended(store->priv->hashtable, hash, &result))
+		return NULL;
+	
+	return store->priv->storage[GPOINTER_TO_UINT(result)];
+}
+
+gboolean
+gitg_repository_find_by_hash(GitgRepository *store, gchar const *hash, GtkTreeIter *iter)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(store), FALSE);
+	
+	gpointer result;
+	
+	if (!gitg_hash_index_lookup_extended(store->priv->hashtable, hash, &result))
+		return FALSE;
+	
+	GtkTreePath *path = gtk_tree_path_new_from_indices(GPOINTER_TO_UINT(result), -1);
+	gtk_tree_model_get_iter(GTK_TREE_MODEL(store), iter, path);
+	gtk_tree_path_free(path);
+
+	return TRUE;
+}
+
+gboolean
+gitg_repository_find(GitgRepository *store, GitgRevision *revision, GtkTreeIter *iter)
+{
+	return gitg_repository_find_by_hash(store, gitg_revision_get_hash(revision), iter);
+}
+
+static void
+copy_refs(gchar const *hash, GitgDecoration *decoration, GSList **ret)
+{
+	GSList *refs;
+	
+	for (refs = decoration->refs; refs; refs = refs->next)
+	{
+		*ret = g_slist_prepend(*ret, gitg_ref_copy((GitgRef *)refs->data));
+	}
+}
+
+GSList *
+gitg_repository_get_refs(GitgRepository *repository)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	GSList *ret = NULL;
+	
+	gitg_hash_index_foreach(repository->priv->refs, (GitgHashIndexFunc)copy_refs, &ret);
+	
+	ret = g_slist_reverse (ret);
+	return ret;
+}
+
+GSList *
+gitg_repository_get_refs_for_hash(GitgRepository *repository, gchar const *hash)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	GitgDecoration *decoration = gitg_hash_index_lookup(repository->priv->refs, hash);
+	
+	return decoration ? g_slist_copy(decoration->refs) : NULL;
+}
+
+/* Direct access to a row for drawing it. Nothing is copied, the revisions
+   and the decoration belong to the repository */
+gboolean
+gitg_repository_get_row(GitgRepository *repository, 
+                        GtkTreeIter *iter, 
+                        GitgRevision **revision, 
+                        GitgRevision **next_revision, 
+                        GitgDecoration **decoration)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(iter->stamp == repository->priv->stamp, FALSE);
+	
+	gulong index = GPOINTER_TO_INT(iter->user_data);
+	GitgRevision *rv;
+	
+	g_return_val_if_fail(index < repository->priv->size, FALSE);
+	
+	rv = repository->priv->storage[index];
+	page_in_row(repository, index);
+	
+	*revision = rv;
+	*next_revision = NULL;
+	
+	if (index + 1 < repository->priv->size)
+	{
+		page_in_row(repository, index + 1);
+		*next_revision = repository->priv->storage[index + 1];
+	}
+	
+	switch (gitg_revision_get_sign(rv))
+	{
+		case 't':
+			*decoration = repository->priv->staged_decoration;
+		break;
+		case 'u':
+			*decoration = repository->priv->unstaged_decoration;
+		break;
+		default:
+			*decoration = gitg_hash_index_lookup(repository->priv->refs, gitg_revision_get_hash(rv));
+		break;
+	}
+	
+	return TRUE;
+}
+
+GitgRef *
+gitg_repository_get_current_ref(GitgRepository *repository)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	
+	return repository->priv->current_ref;
+}
+
+gchar *
+gitg_repository_relative(GitgRepository *repository, GFile *file)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+	
+	GFile *parent = g_file_new_for_path(repository->priv->path);
+	gchar *ret = g_file_get_relative_path(parent, file);
+	g_object_unref(parent);
+	
+	return ret;
+}
+
+static gchar const **
+git_arguments(gchar const **argv)
+{
+	guint num = g_strv_length((gchar **)argv);
+	guint i;
+	gchar const **args = g_new0(gchar const *, num + 2);
+	args[0] = "git";	
+	
+	for (i = 0; i < num; ++i)
+		args[i + 1] = argv[i];
+	
+	return args;
+}
+
+gboolean
+gitg_repository_run_command_with_input(GitgRepository *repository, GitgRunner *runner, gchar const **argv, gchar const *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
+	
+	gchar const **args = git_arguments(argv);
+	
+	gboolean ret = gitg_runner_run_with_arguments(runner, args, repository->priv->path, input, error);
+	g_free(args);
+	
+	return ret;
+}
+
+/* Like gitg_repository_run_command_with_input, but input is streamed to
+   git while its output is read, so it never has to be in memory as a whole */
+gboolean
+gitg_repository_run_command_with_input_stream(GitgRepository *repository, GitgRunner *runner, gchar const **argv, GInputStream *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
+	
+	gchar const **args = git_arguments(argv);
+	
+	gboolean ret = gitg_runner_run_with_input_stream(runner, args, repository->priv->path, input, error);
+	g_free(args);
+	
+	return ret;
+}
+
+gboolean
+gitg_repository_run_command(GitgRepository *repository, GitgRunner *runner, gchar const **argv, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
+
+	return gitg_repository_run_command_with_input(repository, runner, argv, NULL, error);
+}
+
+gboolean 
+gitg_repository_command_with_input(GitgRepository *repository, gchar const **argv, gchar const *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
+
+	GitgRunner *runner = gitg_runner_new_synchronized(1000);
+	
+	gboolean ret = gitg_repository_run_command_with_input(repository, runner, argv, input, error);
+	g_object_unref(runner);
+	
+	/* Commands run for their effect, not their output */
+	gitg_repository_invalidate(repository);
+
+	return ret;
+}
+
+gboolean
+gitg_repository_command_with_input_stream(GitgRepository *repository, gchar const **argv, GInputStream *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
+
+	GitgRunner *runner = gitg_runner_new_synchronized(1000);
+	
+	gboolean ret = gitg_repository_run_command_with_input_stream(repository, runner, argv, input, error);
+	g_object_unref(runner);
+	
+	gitg_repository_invalidate(repository);
+
+	return ret;
+}
+
+gboolean
+gitg_repository_command(GitgRepository *repository, gchar const **argv, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
+
+	return gitg_repository_command_with_input(repository, argv, NULL, error);
+}
+
+typedef struct
+{
+	gchar **buffer;
+	guint size;
+} CommandOutput;
+
+static void
+command_with_output_update(GitgRunner *runner, gchar **buffer, CommandOutput *output)
+{
+	guint num = g_strv_length(buffer);
+	guint i;
+	
+	output->buffer = g_realloc(output->buffer, sizeof(gchar *) * (output->size + num + 1));
+	
+	for (i = 0; i < num; ++i)
+		output->buffer[output->size + i] = g_strdup(buffer[i]);
+	
+	output->size += num;
+	output->buffer[output->size] = NULL;
+}
+
+gchar **
+gitg_repository_command_with_input_and_output(GitgRepository *repository, gchar const **argv, gchar const *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+	
+	GitgRunner *runner = gitg_runner_new_synchronized(1000);
+	CommandOutput output = {NULL, 0};
+
+	g_signal_connect(runner, "update", G_CALLBACK(command_with_output_update), &output);
+	gboolean ret = gitg_repository_run_command_with_input(repository, runner, argv, input, error);
+	
+	if (!ret)
+	{
+		g_strfreev(output.buffer);
+		output.buffer = NULL;
+	}
+	
+	g_object_unref(runner);
+	return output.buffer;
+}
+
+gchar **
+gitg_repository_command_with_output(GitgRepository *repository, gchar const **argv, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+
+	return gitg_repository_command_with_input_and_output(repository, argv, NULL, error);
+}
+
+/* Each argument is prefixed with its length, so different argv never end
+   up with the same key */
+static gchar *
+query_key(gchar const **argv)
+{
+	GString *key = g_string_new("");
+	
+	for (; *argv; ++argv)
+		g_string_append_printf(key, "%u:%s", (guint)strlen(*argv), *argv);
+	
+	return g_string_free(key, FALSE);
+}
+
+/* Like gitg_repository_command_with_output, for queries which do not change
+   anything. The output is memoized (by argv) until the refs, HEAD, index
+   or config change, see gitg_repository_invalidate. Only the repository
+   itself is monitored, so queries reading anything else (like the global
+   config) should not be memoized. A memoized failure returns NULL without
+   setting error. Main loop only */
+gchar **
+gitg_repository_command_with_output_cached(GitgRepository *repository, gchar const **argv, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+	
+	gchar *key = query_key(argv);
+	CachedQuery *cached = lookup_query(repository, key);
+	
+	if (cached)
+	{
+		g_free(key);
+		return g_strdupv(cached->output);
+	}
+	
+	gchar **ret = gitg_repository_command_with_output(repository, argv, error);
+	cache_query(repository, key, ret);
+	
+	return ret;
+}
+
+static gchar const **
+parse_valist(va_list ap)
+{
+	gchar const *a;
+	gchar const **ret = NULL;
+	guint num = 0;
+	
+	while ((a = va_arg(ap, gchar const *)) != NULL)
+	{
+		ret = g_realloc(ret, sizeof(gchar const *) * (++num + 1));
+		ret[num - 1] = a;
+	}
+	
+	ret[num] = NULL;
+	return ret;
+}
+
+gboolean 
+gitg_repository_commandv(GitgRepository *repository, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gboolean ret = gitg_repository_command(repository, argv, error);
+	g_free(argv);
+	return ret;
+}
+
+gboolean 
+gitg_repository_command_with_inputv(GitgRepository *repository, gchar const *input, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gboolean ret = gitg_repository_command_with_input(repository, argv, input, error);
+	g_free(argv);
+	return ret;
+}
+
+gboolean 
+gitg_repository_run_commandv(GitgRepository *repository, GitgRunner *runner, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gboolean ret = gitg_repository_run_command(repository, runner, argv, error);
+	g_free(argv);
+	return ret;
+}
+
+gboolean
+gitg_repository_command_with_input_streamv(GitgRepository *repository, GInputStream *input, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gboolean ret = gitg_repository_command_with_input_stream(repository, argv, input, error);
+	g_free(argv);
+	return ret;
+}
+
+gboolean 
+gitg_repository_run_command_with_inputv(GitgRepository *repository, GitgRunner *runner, gchar const *input, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gboolean ret = gitg_repository_run_command_with_input(repository, runner, argv, input, error);
+	g_free(argv);
+	return ret;
+}
+
+gchar **
+gitg_repository_command_with_outputv(GitgRepository *repository, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gchar **ret = gitg_repository_command_with_output(repository, argv, error);
+	g_free(argv);
+	return ret;
+}
+
+gchar **
+gitg_repository_command_with_output_cachedv(GitgRepository *repository, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gchar **ret = gitg_repository_command_with_output_cached(repository, argv, error);
+	g_free(argv);
+	return ret;
+}
+
+gchar **
+gitg_repository_command_with_input_and_outputv(GitgRepository *repository, gchar const *input, GError **error, ...)
+{
+	va_list ap;
+	va_start(ap, error);
+	gchar const **argv = parse_valist(ap);
+	va_end(ap);
+	
+	gchar **ret = gitg_repository_command_with_input_and_output(repository, argv, input, error);
+	g_free(argv);
+	return ret;
+}
+
+/* Like gitg_repository_command_with_input_and_output, but git failing is an
+   error too. No output gives an empty vector */
+static gchar **
+query_with_input(GitgRepository *repository, gchar const **argv, gchar const *input)
+{
+	GitgRunner *runner = gitg_runner_new_synchronized(1000);
+	CommandOutput output = {g_new0(gchar *, 1), 0};
+	
+	g_signal_connect(runner, "update", G_CALLBACK(command_with_output_update), &output);
+	
+	if (!gitg_repository_run_command_with_input(repository, runner, argv, input, NULL) ||
+	    gitg_runner_get_exit_status(runner) != 0)
+	{
+		g_strfreev(output.buffer);
+		output.buffer = NULL;
+	}
+	
+	g_object_unref(runner);
+	return output.buffer;
+}
+
+/* Whether the log arguments only name the tips to show the history of. That
+   history can be walked in the commit-graph, and updated by putting new
+   commits in front. Options which limit or reorder it, ranges and paths
+   make for a full reload */
+static gboolean
+tip_args(GitgRepository *repository)
+{
+	static gchar const *options[] = {
+		"--all",
+		"--branches",
+		"--tags",
+		"--remotes",
+		"--topo-order",
+		"--date-order",
+		NULL
+	};
+	
+	gchar **arg;
+	
+	if (!repository->priv->last_args || !repository->priv->last_args[3])
+		return FALSE;
+	
+	for (arg = repository->priv->last_args + 3; *arg; ++arg)
+	{
+		if (**arg == '-')
+		{
+			gchar const **option;
+			
+			for (option = options; *option; ++option)
+			{
+				if (strcmp(*arg, *option) == 0)
+					break;
+			}
+			
+			if (!*option)
+				return FALSE;
+		}
+		else
+		{
+			if (strpbrk(*arg, "^~:") || strstr(*arg, "..") || strstr(*arg, "@{"))
+				return FALSE;
+			
+			gchar *path = g_build_filename(repository->priv->path, *arg, NULL);
+			gboolean exists = g_file_test(path, G_FILE_TEST_EXISTS);
+			
+			g_free(path);
+			
+			if (exists)
+				return FALSE;
+		}
+	}
+	
+	return TRUE;
 }
 
-static gboolean
-has_left_right(gchar const **av, int argc)
+typedef struct
 {
-	int i;
+	GArray *tips;
+	gchar const *prefix;
+} GraphTips;
 
-	for (i = 0; i < argc; ++i)
-		if (strcmp(av[i], "--left-right") == 0)
-			return TRUE;
+static void
+on_graph_tip(GitgRepository *repository, gchar const *name, gchar const *sha1, GraphTips *tips)
+{
+	Hash hash;
 	
-	return FALSE;
+	if (!g_str_has_prefix(name, tips->prefix))
+		return;
+	
+	gitg_utils_sha1_to_hash(sha1, hash);
+	g_array_append_val(tips->tips, hash);
 }
 
 static gboolean
-reload_revisions(GitgRepository *repository, GError **error)
+add_graph_tip(GitgRepository *repository, GraphTips *tips, gchar const *name)
 {
-	if (repository->priv->working_ref)
-	{
-		gitg_ref_free (repository->priv->working_ref);
-		repository->priv->working_ref = NULL;
-	}
-
-	g_signal_emit(repository, repository_signals[LOAD], 0);
+	gchar *spec = g_strconcat(name, "^{commit}", NULL);
+	gchar *sha1 = gitg_repository_cat_file_check(repository, spec, NULL, NULL);
+	Hash hash;
+	
+	g_free(spec);
+	
+	if (!sha1)
+		return FALSE;
 	
-	repository->priv->load_stage = LOAD_STAGE_STASH;
+	gitg_utils_sha1_to_hash(sha1, hash);
+	g_array_append_val(tips->tips, hash);
 	
-	return gitg_repository_run_commandv(repository, repository->priv->loader, error, "log", "--pretty=format:%H\x01%an\x01%s\x01%at", "--encoding=UTF-8", "-g", "refs/stash", NULL);
+	g_free(sha1);
+	return TRUE;
 }
 
-static void
-build_log_args(GitgRepository *self, gint argc, gchar const **av)
+/* The commits the log arguments start at, NULL when a name does not
+   resolve to a commit */
+static GArray *
+graph_tips(GitgRepository *repository)
 {
-	gchar **argv = g_new0(gchar *, 6 + (argc > 0 ? argc - 1 : 0));
-
-	argv[0] = g_strdup("log");
-	
-	if (has_left_right(av, argc))
-	{
-		argv[1] = g_strdup("--pretty=format:%H\x01%an\x01%s\x01%P\x01%at\x01%m");
-	}
-	else
+	static struct
 	{
-		argv[1] = g_strdup("--pretty=format:%H\x01%an\x01%s\x01%P\x01%at");
-	}
-	
-	argv[2] = g_strdup ("--encoding=UTF-8");
-	
-	gchar *head = NULL;
+		gchar const *option;
+		gchar const *prefix;
+	} ref_options[] = {
+		{"--all", "refs/"},
+		{"--branches", "refs/heads/"},
+		{"--tags", "refs/tags/"},
+		{"--remotes", "refs/remotes/"}
+	};
+	
+	GraphTips tips = {g_array_new(FALSE, FALSE, sizeof(Hash)), NULL};
+	gchar **arg;
+	guint i;
 	
-	if (argc <= 0)
+	for (arg = repository->priv->last_args + 3; *arg; ++arg)
 	{
-		head = gitg_repository_parse_ref(self, "HEAD");
-		
-		if (head)
+		if (**arg != '-')
 		{
-			argv[3] = g_strdup("HEAD");
+			if (!add_graph_tip(repository, &tips, *arg))
+			{
+				g_array_free(tips.tips, TRUE);
+				return NULL;
+			}
+			
+			continue;
 		}
 		
-		g_free(head);
-	}
-	else
-	{
-		int i;
-
-		for (i = 0; i < argc; ++i)
+		for (i = 0; i < G_N_ELEMENTS(ref_options); ++i)
 		{
-			argv[3 + i] = g_strdup(av[i]);
+			if (strcmp(*arg, ref_options[i].option) == 0)
+			{
+				tips.prefix = ref_options[i].prefix;
+				foreach_ref(repository, (RefFunc)on_graph_tip, &tips);
+			}
 		}
+		
+		/* --all includes HEAD, which may be detached or not born yet */
+		if (strcmp(*arg, "--all") == 0)
+			add_graph_tip(repository, &tips, "HEAD");
 	}
-
-	g_strfreev(self->priv->last_args);
-	self->priv->last_args = argv;
+	
+	return tips.tips;
 }
 
-static gchar *
-load_current_ref(GitgRepository *self)
+/* Walks the history in the commit-graph instead of running the log, when
+   there is a commit-graph and the log arguments only name tips */
+static gboolean
+run_commit_graph(GitgRepository *repository)
 {
-	gchar **out;
-	gchar *ret = NULL;
-	gint i;
-	gint numargs;
-
-	numargs = g_strv_length(self->priv->last_args);
-
-	gchar const **argv = g_new0(gchar const *, numargs + 3);
-
-	argv[0] = "rev-parse";
-	argv[1] = "--no-flags";
-	argv[2] = "--symbolic-full-name";
-
-	for (i = 1; i < numargs; ++i)
-	{
-		argv[2 + i] = self->priv->last_args[i];
-	}
-
-	out = gitg_repository_command_with_output(self, argv, NULL);
+	GitgCommitGraph *graph;
+	GInputStream *stream;
+	GArray *tips;
+	gchar *git_dir;
+	gboolean ret;
 	
-	if (!out)
-	{
-		return NULL;
-	}
+	if (!tip_args(repository))
+		return FALSE;
 	
-	if (*out && !*(out + 1))
+	git_dir = g_build_filename(repository->priv->path, ".git", NULL);
+	graph = gitg_commit_graph_open(git_dir);
+	g_free(git_dir);
+	
+	if (!graph)
+		return FALSE;
+	
+	tips = graph_tips(repository);
+	
+	if (!tips)
 	{
-		ret = g_strdup(*out);
+		gitg_commit_graph_free(graph);
+		return FALSE;
 	}
 	
-	g_strfreev(out);
+	stream = gitg_commit_graph_stream_new(graph, repository->priv->path, (Hash const *)tips->data, tips->len);
+	ret = gitg_runner_run_stream(repository->priv->loader, stream, NULL);
+	
+	g_object_unref(stream);
+	g_array_free(tips, TRUE);
+	
 	return ret;
 }
 
+static gchar const **log_arguments(GitgRepository *repository, guint skip, guint extra);
+
+static gchar const *details_argv[] = {
+	"log",
+	"--no-walk",
+	"--stdin",
+	"--pretty=format:%H\x01%an\x01%s\x01%at",
+	"--encoding=UTF-8",
+	NULL
+};
+
+/* Sends the next batch of queued commits to the details loader */
+static gboolean
+flush_details(GitgRepository *repository)
+{
+	GString *queue = repository->priv->details_queue;
+	
+	repository->priv->details_id = 0;
+	
+	/* The end of the running batch flushes again */
+	if (queue->len == 0 || gitg_runner_running(repository->priv->details_loader))
+		return FALSE;
+	
+	gsize len = MIN(queue->len, DETAILS_BATCH * (HASH_SHA_SIZE + 1));
+	gchar *input = g_strndup(queue->str, len);
+	
+	g_string_erase(queue, 0, len);
+	
+	gitg_repository_run_command_with_input(repository, repository->priv->details_loader, details_argv, input, NULL);
+	g_free(input);
+	
+	return FALSE;
+}
+
+/* Queues the commits without details around the row at index, the view asks
+   for the rows it shows so only those and their neighbours are loaded */
 static void
-load_refs(GitgRepository *self)
+request_details(GitgRepository *repository, gint index)
 {
-	gchar **refs = gitg_repository_command_with_outputv(self, NULL, "for-each-ref", "--format=%(refname) %(objectname) %(*objectname)", "refs", NULL);
+	GitgHashIndex *requested = repository->priv->details_requested;
+	GString *queue = repository->priv->details_queue;
+	gint start = MAX(index - DETAILS_PREFETCH, (gint)repository->priv->commits_start);
+	gint end = MIN(index + DETAILS_PREFETCH, (gint)repository->priv->size - 1);
+	gint i;
 	
-	if (!refs)
+	if (repository->priv->details_all || 
+	    gitg_hash_index_lookup_extended(requested, gitg_revision_get_hash(repository->priv->storage[index]), NULL))
 	{
 		return;
 	}
-		
-	gchar **buffer = refs;
-	gchar *buf;
-	gchar *current = load_current_ref(self);
 	
-	while ((buf = *buffer++) != NULL)
+	for (i = start; i <= end; ++i)
 	{
-		// each line will look like <name> <hash>
-		gchar **components = g_strsplit(buf, " ", 3);
-		guint len = g_strv_length(components);
+		GitgRevision *rv = repository->priv->storage[i];
+		gchar const *hash = gitg_revision_get_hash(rv);
+		gchar sha1[HASH_SHA_SIZE];
 		
-		if (len == 2 || len == 3)
+		if (gitg_revision_has_details(rv) || 
+		    gitg_hash_index_lookup_extended(requested, hash, NULL))
 		{
-			gchar const *obj = len == 3 && *components[2] ? components[2] : components[1];
-			GitgRef *ref = add_ref(self, obj, components[0]);
-		
-			if (current != NULL && strcmp(gitg_ref_get_name(ref), current) == 0)
-			{
-				self->priv->current_ref = gitg_ref_copy(ref);
-			}
+			continue;
 		}
 		
-		g_strfreev(components);
+		gitg_hash_index_insert(requested, hash, NULL);
+		gitg_utils_hash_to_sha1(hash, sha1);
+		
+		g_string_append_len(queue, sha1, HASH_SHA_SIZE);
+		g_string_append_c(queue, '\n');
 	}
-
-	g_strfreev(refs);
-	g_free(current);
-}
-
-void
-gitg_repository_reload(GitgRepository *repository)
-{
-	g_return_if_fail(GITG_IS_REPOSITORY(repository));
-	g_return_if_fail(repository->priv->path != NULL);
-
-	gitg_runner_cancel(repository->priv->loader);
-	gitg_repository_clear(repository);
 	
-	load_refs(repository);
-	reload_revisions(repository, NULL);
+	if (queue->len != 0 && !repository->priv->details_id)
+		repository->priv->details_id = g_idle_add((GSourceFunc)flush_details, repository);
 }
 
-gboolean
-gitg_repository_load(GitgRepository *self, int argc, gchar const **av, GError **error)
+/* Sets the details of a line in details format on the revision in the
+   model */
+static void
+details_line(GitgRepository *repository, gchar *line)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(self), FALSE);
+	gchar *components[4];
+	GtkTreeIter iter;
+	GtkTreePath *path;
+	gpointer index;
+	Hash hash;
 	
-	if (self->priv->path == NULL)
+	if (gitg_utils_split_inplace(line, "\01", components, 4) != 4 || 
+	    strlen(components[0]) != HASH_SHA_SIZE)
 	{
-		if (error)
-		{
-			*error = g_error_new_literal(gitg_repository_error_quark(), GITG_REPOSITORY_ERROR_NOT_FOUND, _("Not a valid git repository"));
-		}
-			
-		return FALSE;
+		return;
 	}
-
-	gitg_runner_cancel(self->priv->loader);
-	gitg_repository_clear(self);
-		
-	build_log_args(self, argc, av);
 	
-	/* first get the refs */
-	load_refs(self);
+	gitg_utils_sha1_to_hash(components[0], hash);
 	
-	/* request log (all the revision) */
-	return reload_revisions(self, error);
-}
-
-void
-gitg_repository_add(GitgRepository *self, GitgRevision *obj, GtkTreeIter *iter)
-{
-	GtkTreeIter iter1;
-
-	/* validate our parameters */
-	g_return_if_fail(GITG_IS_REPOSITORY(self));
+	if (!gitg_hash_index_lookup_extended(repository->priv->hashtable, hash, &index))
+		return;
 	
-	grow_storage(self, 1);
-
-	/* put this object in our data storage */
-	self->priv->storage[self->priv->size++] = gitg_revision_ref(obj);
-
-	g_hash_table_insert(self->priv->hashtable, (gpointer)gitg_revision_get_hash(obj), GUINT_TO_POINTER(self->priv->size - 1));
-
-	iter1.stamp = self->priv->stamp;
-	iter1.user_data = GINT_TO_POINTER(self->priv->size - 1);
-	iter1.user_data2 = NULL;
-	iter1.user_data3 = NULL;
+	gitg_revision_set_details(repository->priv->storage[GPOINTER_TO_UINT(index)], 
+	                          components[1], 
+	                          components[2], 
+	                          g_ascii_strtoll(components[3], NULL, 0));
 	
-	GtkTreePath *path = gtk_tree_path_new_from_indices(self->priv->size - 1, -1);
-	gtk_tree_model_row_inserted(GTK_TREE_MODEL(self), path, &iter1);
-	gtk_tree_path_free(path);
+	path = gtk_tree_path_new_from_indices(GPOINTER_TO_UINT(index), -1);
+	fill_iter(repository, GPOINTER_TO_UINT(index), &iter);
 	
-	/* return the iter if the user cares */
-	if (iter)
-		*iter = iter1;
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(repository), path, &iter);
+	gtk_tree_path_free(path);
 }
 
-void
-gitg_repository_clear(GitgRepository *repository)
+static void
+on_details_update(GitgRunner *runner, gchar **lines, GitgRepository *repository)
 {
-	g_return_if_fail(GITG_IS_REPOSITORY(repository));
-	do_clear(repository, TRUE);
+	for (; *lines; ++lines)
+		details_line(repository, *lines);
 }
 
-GitgRevision *
-gitg_repository_lookup(GitgRepository *store, gchar const *hash)
+static void
+on_details_end_loading(GitgRunner *runner, gboolean cancelled, GitgRepository *repository)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(store), NULL);
+	repository->priv->details_all = FALSE;
 	
-	gpointer result = g_hash_table_lookup(store->priv->hashtable, hash);
-	
-	if (!result)
-		return NULL;
+	/* Commits which did not make it are asked for again when shown */
+	if (cancelled)
+	{
+		gitg_hash_index_remove_all(repository->priv->details_requested);
+		g_string_truncate(repository->priv->details_queue, 0);
+		
+		return;
+	}
 	
-	return store->priv->storage[GPOINTER_TO_UINT(result)];
+	if (repository->priv->details_queue->len != 0 && !repository->priv->details_id)
+		repository->priv->details_id = g_idle_add((GSourceFunc)flush_details, repository);
 }
 
-gboolean
-gitg_repository_find_by_hash(GitgRepository *store, gchar const *hash, GtkTreeIter *iter)
+/* Loads the details of all commits in the history at once, searching needs
+   all of them */
+void
+gitg_repository_load_details(GitgRepository *repository)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(store), FALSE);
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
 	
-	gpointer result = g_hash_table_lookup(store->priv->hashtable, hash);
+	gulong i;
 	
-	if (!result)
-		return FALSE;
+	if (repository->priv->details_all || !repository->priv->last_args)
+		return;
 	
-	GtkTreePath *path = gtk_tree_path_new_from_indices(GPOINTER_TO_UINT(result), -1);
-	gtk_tree_model_get_iter(GTK_TREE_MODEL(store), iter, path);
-	gtk_tree_path_free(path);
+	for (i = repository->priv->commits_start; i < repository->priv->size; ++i)
+	{
+		if (!gitg_revision_has_details(repository->priv->storage[i]))
+			break;
+	}
+	
+	if (i == repository->priv->size)
+		return;
+	
+	if (repository->priv->details_id)
+	{
+		g_source_remove(repository->priv->details_id);
+		repository->priv->details_id = 0;
+	}
+	
+	/* The batches are covered by the full log */
+	gitg_runner_cancel(repository->priv->details_loader);
+	
+	gchar const **argv = log_arguments(repository, 3, 3);
+	
+	argv[0] = "log";
+	argv[1] = "--pretty=format:%H\x01%an\x01%s\x01%at";
+	argv[2] = "--encoding=UTF-8";
+	
+	repository->priv->details_all = gitg_repository_run_command(repository, repository->priv->details_loader, argv, NULL);
+	g_free(argv);
+}
 
-	return TRUE;
+/* The rows shown in the view, relaned rows are only announced there */
+void
+gitg_repository_set_visible_range(GitgRepository *repository, gulong first, gulong last)
+{
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	
+	repository->priv->visible_first = first;
+	repository->priv->visible_last = last;
 }
 
-gboolean
-gitg_repository_find(GitgRepository *store, GitgRevision *revision, GtkTreeIter *iter)
+/* Loads the details of revision right away, unless it has them already */
+void
+gitg_repository_ensure_details(GitgRepository *repository, GitgRevision *revision)
 {
-	return gitg_repository_find_by_hash(store, gitg_revision_get_hash(revision), iter);
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	
+	if (gitg_revision_has_details(revision))
+		return;
+	
+	gchar *sha1 = gitg_revision_get_sha1(revision);
+	gchar **out = gitg_repository_command_with_outputv(repository, 
+	                                                   NULL, 
+	                                                   "log", 
+	                                                   "-1", 
+	                                                   "--pretty=format:%H\x01%an\x01%s\x01%at", 
+	                                                   "--encoding=UTF-8", 
+	                                                   sha1, 
+	                                                   NULL);
+	
+	if (out && *out)
+		details_line(repository, *out);
+	
+	g_strfreev(out);
+	g_free(sha1);
 }
 
-GSList *
-gitg_repository_get_refs(GitgRepository *repository)
+/* The lines of tips which are among revisions, whose history is loaded.
+   Everything they reach is in revisions */
+static gchar *
+loaded_tips(gchar const *tips, GitgRevision **revisions, gulong num)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
-	GList *values = g_hash_table_get_values(repository->priv->refs);
-	GSList *ret = NULL;
-	GList *item;
+	gchar **lines = g_strsplit(tips, "\n", -1);
+	GitgHashIndex *index = gitg_hash_index_new(NULL);
+	GString *ret = g_string_new("");
+	Hash hash;
+	gchar **line;
+	gulong i;
+	
+	for (line = lines; *line; ++line)
+	{
+		if (strlen(*line) != HASH_SHA_SIZE)
+			continue;
+		
+		gitg_utils_sha1_to_hash(*line, hash);
+		gitg_hash_index_insert(index, hash, NULL);
+	}
 	
-	for (item = values; item; item = item->next)
+	for (i = 0; i < num; ++i)
 	{
-		GSList *val;
+		gchar const *rh = gitg_revision_get_hash(revisions[i]);
 		
-		for (val = (GSList *)item->data; val; val = val->next)
-		{
-			ret = g_slist_prepend(ret, gitg_ref_copy((GitgRef *)val->data));
-		}
+		if (gitg_hash_index_lookup_extended(index, rh, NULL))
+			gitg_hash_index_insert(index, rh, GINT_TO_POINTER(1));
 	}
 	
-	ret = g_slist_reverse (ret);
-	g_list_free(values);
-	return ret;
-}
-
-GSList *
-gitg_repository_get_refs_for_hash(GitgRepository *repository, gchar const *hash)
-{
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
-	return g_slist_copy((GSList *)g_hash_table_lookup(repository->priv->refs, hash));
+	for (line = lines; *line; ++line)
+	{
+		if (strlen(*line) != HASH_SHA_SIZE)
+			continue;
+		
+		gitg_utils_sha1_to_hash(*line, hash);
+		
+		if (!gitg_hash_index_lookup(index, hash))
+			continue;
+		
+		if (ret->len)
+			g_string_append_c(ret, '\n');
+		
+		g_string_append(ret, *line);
+	}
+	
+	gitg_hash_index_free(index);
+	g_strfreev(lines);
+	
+	return g_string_free(ret, FALSE);
 }
 
-GitgRef *
-gitg_repository_get_current_ref(GitgRepository *repository)
+static gchar const **
+log_arguments(GitgRepository *repository, guint skip, guint extra)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	guint num = g_strv_length(repository->priv->last_args) - skip;
+	gchar const **argv = g_new0(gchar const *, num + extra + 1);
+	guint i;
 	
-	return repository->priv->current_ref;
+	for (i = 0; i < num; ++i)
+		argv[extra + i] = repository->priv->last_args[skip + i];
+	
+	return argv;
 }
 
-gchar *
-gitg_repository_relative(GitgRepository *repository, GFile *file)
+/* History was rewritten (or refs deleted) when one of the old tips can no
+   longer be reached with the log arguments */
+static gboolean
+history_rewritten(GitgRepository *repository, gchar const *tips)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
-	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+	gchar const **argv = log_arguments(repository, 3, 5);
 	
-	GFile *parent = g_file_new_for_path(repository->priv->path);
-	gchar *ret = g_file_get_relative_path(parent, file);
-	g_object_unref(parent);
+	argv[0] = "rev-list";
+	argv[1] = "-n";
+	argv[2] = "1";
+	argv[3] = "--stdin";
+	argv[4] = "--not";
+	
+	gchar **out = query_with_input(repository, argv, tips);
+	gboolean ret = !out || *out;
+	
+	g_free(argv);
+	g_strfreev(out);
 	
 	return ret;
 }
 
-gboolean
-gitg_repository_run_command_with_input(GitgRepository *repository, GitgRunner *runner, gchar const **argv, gchar const *input, GError **error)
+/* Reads the commits the log arguments reach but the old tips do not */
+static GPtrArray *
+load_new_commits(GitgRepository *repository, gchar const *tips)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
-	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
-	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
-	
+	gchar **lines = g_strsplit(tips, "\n", -1);
+	gchar *exclude = g_strjoinv("\n^", lines);
+	gchar *input = g_strconcat("^", exclude, NULL);
+	gchar const **argv = log_arguments(repository, 0, 0);
 	guint num = g_strv_length((gchar **)argv);
-	guint i;
-	gchar const **args = g_new0(gchar const *, num + 2);
-	args[0] = "git";	
 	
-	for (i = 0; i < num; ++i)
-		args[i + 1] = argv[i];
+	argv = g_renew(gchar const *, argv, num + 2);
+	argv[num] = "--stdin";
+	argv[num + 1] = NULL;
 	
-	gboolean ret = gitg_runner_run_with_arguments(runner, args, repository->priv->path, input, error);
-	g_free(args);
+	gchar **out = query_with_input(repository, argv, input);
+	
+	g_strfreev(lines);
+	g_free(exclude);
+	g_free(input);
+	g_free(argv);
+	
+	if (!out)
+		return NULL;
+	
+	GPtrArray *ret = g_ptr_array_new();
+	gchar **line;
+	
+	for (line = out; *line; ++line)
+	{
+		GitgRevision *rv = parse_commit_line(repository, *line);
+		
+		if (!rv)
+			continue;
+		
+		if (gitg_repository_lookup(repository, gitg_revision_get_hash(rv)))
+		{
+			gitg_revision_unref(rv);
+			continue;
+		}
+		
+		g_ptr_array_add(ret, rv);
+	}
 	
+	g_strfreev(out);
 	return ret;
 }
 
-gboolean
-gitg_repository_run_command(GitgRepository *repository, GitgRunner *runner, gchar const **argv, GError **error)
+static void
+ref_row_changed(GitgRepository *repository, gchar const *hash)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
-	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
-	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
-
-	return gitg_repository_run_command_with_input(repository, runner, argv, NULL, error);
+	GtkTreeIter iter;
+	
+	if (!gitg_repository_find_by_hash(repository, hash, &iter))
+		return;
+	
+	GtkTreePath *path = gtk_tree_model_get_path(GTK_TREE_MODEL(repository), &iter);
+	
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(repository), path, &iter);
+	gtk_tree_path_free(path);
 }
 
-gboolean 
-gitg_repository_command_with_input(GitgRepository *repository, gchar const **argv, gchar const *input, GError **error)
+/* Redraws the rows the old and the new refs point at */
+static void
+update_ref_rows(GitgRepository *repository, GSList *old)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
-	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
-
-	GitgRunner *runner = gitg_runner_new_synchronized(1000);
+	GSList *refs = gitg_repository_get_refs(repository);
+	GSList *item;
 	
-	gboolean ret = gitg_repository_run_command_with_input(repository, runner, argv, input, error);
-	g_object_unref(runner);
-
-	return ret;
+	for (item = old; item; item = g_slist_next(item))
+		ref_row_changed(repository, gitg_ref_get_hash((GitgRef *)item->data));
+	
+	for (item = refs; item; item = g_slist_next(item))
+		ref_row_changed(repository, gitg_ref_get_hash((GitgRef *)item->data));
+	
+	g_slist_foreach(refs, (GFunc)gitg_ref_free, NULL);
+	g_slist_free(refs);
 }
 
-gboolean
-gitg_repository_command(GitgRepository *repository, gchar const **argv, GError **error)
+/* Reloads only the virtual rows, for changes of the index. Views do not
+   need to reload for that, so load is not emitted */
+static gboolean
+refresh_virtual(GitgRepository *repository)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
-	g_return_val_if_fail(repository->priv->path != NULL, FALSE);
-
-	return gitg_repository_command_with_input(repository, argv, NULL, error);
+	if (repository->priv->load_stage != LOAD_STAGE_LAST || loading(repository))
+		return FALSE;
+	
+	remove_virtual(repository);
+	load_virtual(repository);
+	
+	return TRUE;
 }
 
-typedef struct
-{
-	gchar **buffer;
-	guint size;
-} CommandOutput;
-
+/* Puts the commits which are new since the history was loaded in front of
+   it, after the virtual rows */
 static void
-command_with_output_update(GitgRunner *runner, gchar **buffer, CommandOutput *output)
+prepend_commits(GitgRepository *repository, GPtrArray *revisions)
 {
-	guint num = g_strv_length(buffer);
-	guint i;
+	gulong first = repository->priv->commits_start;
 	
-	output->buffer = g_realloc(output->buffer, sizeof(gchar *) * (output->size + num + 1));
+	insert_rows(repository, first, (GitgRevision **)revisions->pdata, revisions->len);
 	
-	for (i = 0; i < num; ++i)
-		output->buffer[output->size + i] = g_strdup(buffer[i]);
+	/* The pages keep their commits, paged out ones included */
+	repository->priv->pages_shift += revisions->len;
 	
-	output->size += num;
-	output->buffer[output->size] = NULL;
+	/* A pending relane redoes all rows anyway, a running one is started
+	   over for the new rows */
+	if (repository->priv->relane)
+	{
+		cancel_relane(repository);
+		prepare_relane(repository);
+	}
+	else if (!repository->priv->idle_relane_id)
+		relane_top(repository, first + revisions->len);
 }
 
-gchar **
-gitg_repository_command_with_input_and_output(GitgRepository *repository, gchar const **argv, gchar const *input, GError **error)
+/* Puts the commits which are new since the history was loaded in front of
+   it, and reloads the virtual rows. Returns FALSE when the history needs a
+   full reload */
+static gboolean
+update_history(GitgRepository *repository)
 {
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
-	g_return_val_if_fail(repository->priv->path != NULL, NULL);
-	
-	GitgRunner *runner = gitg_runner_new_synchronized(1000);
-	CommandOutput output = {NULL, 0};
-
-	g_signal_connect(runner, "update", G_CALLBACK(command_with_output_update), &output);
-	gboolean ret = gitg_repository_run_command_with_input(repository, runner, argv, input, error);
-	
-	if (!ret)
+	if (repository->priv->load_stage != LOAD_STAGE_LAST ||
+	    loading(repository) ||
+	    repository->priv->size == 0 ||
+	    !tip_args(repository))
 	{
-		g_strfreev(output.buffer);
-		output.buffer = NULL;
+		return FALSE;
 	}
 	
-	g_object_unref(runner);
-	return output.buffer;
-}
-
-gchar **
-gitg_repository_command_with_output(GitgRepository *repository, gchar const **argv, GError **error)
-{
-	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
-	g_return_val_if_fail(repository->priv->path != NULL, NULL);
-
-	return gitg_repository_command_with_input_and_output(repository, argv, NULL, error);
-}
-
-static gchar const **
-parse_valist(va_list ap)
-{
-	gchar const *a;
-	gchar const **ret = NULL;
-	guint num = 0;
+	GSList *old = gitg_repository_get_refs(repository);
+	gchar *all = ref_tips(repository);
+	gchar *tips = loaded_tips(all, 
+	                          repository->priv->storage + repository->priv->commits_start, 
+	                          repository->priv->size - repository->priv->commits_start);
+	GPtrArray *revisions = NULL;
 	
-	while ((a = va_arg(ap, gchar const *)) != NULL)
+	/* Without tips every commit would come out as new */
+	if (*tips == '\0')
+		goto out;
+	
+	gitg_hash_index_remove_all(repository->priv->refs);
+	gitg_ref_free(repository->priv->current_ref);
+	repository->priv->current_ref = NULL;
+	
+	load_refs(repository);
+	
+	if (history_rewritten(repository, tips))
+		goto out;
+	
+	revisions = load_new_commits(repository, tips);
+	
+	if (!revisions)
+		goto out;
+	
+	remove_virtual(repository);
+	prepend_commits(repository, revisions);
+	
+	update_ref_rows(repository, old);
+	store_history_cache(repository);
+	
+	if (repository->priv->working_ref)
 	{
-		ret = g_realloc(ret, sizeof(gchar const *) * (++num + 1));
-		ret[num - 1] = a;
+		gitg_ref_free(repository->priv->working_ref);
+		repository->priv->working_ref = NULL;
 	}
 	
-	ret[num] = NULL;
-	return ret;
-}
-
-gboolean 
-gitg_repository_commandv(GitgRepository *repository, GError **error, ...)
-{
-	va_list ap;
-	va_start(ap, error);
-	gchar const **argv = parse_valist(ap);
-	va_end(ap);
+	g_signal_emit(repository, repository_signals[LOAD], 0);
+	load_virtual(repository);
 	
-	gboolean ret = gitg_repository_command(repository, argv, error);
-	g_free(argv);
-	return ret;
+	loader_batch_free(revisions);
+	
+out:
+	g_slist_foreach(old, (GFunc)gitg_ref_free, NULL);
+	g_slist_free(old);
+	g_free(tips);
+	g_free(all);
+	
+	return revisions != NULL;
 }
 
-gboolean 
-gitg_repository_command_with_inputv(GitgRepository *repository, gchar const *input, GError **error, ...)
+static GitgScheduler *
+ensure_scheduler(GitgRepository *repository)
 {
-	va_list ap;
-	va_start(ap, error);
-	gchar const **argv = parse_valist(ap);
-	va_end(ap);
+	if (!repository->priv->scheduler)
+		repository->priv->scheduler = gitg_scheduler_new(repository->priv->path, SCHEDULER_MAX_RUNNING);
 	
-	gboolean ret = gitg_repository_command_with_input(repository, argv, input, error);
-	g_free(argv);
-	return ret;
+	return repository->priv->scheduler;
 }
 
-gboolean 
-gitg_repository_run_commandv(GitgRepository *repository, GitgRunner *runner, GError **error, ...)
+/* Runs 'git argv' on runner once a scheduler slot is free. A command still
+   queued for runner is replaced, one running on runner is cancelled. Spawn
+   failures are only reported as warnings */
+void
+gitg_repository_schedule_command(GitgRepository *repository, GitgRunner *runner, GitgSchedulerPriority priority, gchar const **argv)
 {
-	va_list ap;
-	va_start(ap, error);
-	gchar const **argv = parse_valist(ap);
-	va_end(ap);
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+	g_return_if_fail(repository->priv->path != NULL);
 	
-	gboolean ret = gitg_repository_run_command(repository, runner, argv, error);
-	g_free(argv);
-	return ret;
+	gitg_scheduler_run(ensure_scheduler(repository), runner, priority, argv, NULL);
 }
 
-gboolean 
-gitg_repository_run_command_with_inputv(GitgRepository *repository, GitgRunner *runner, gchar const *input, GError **error, ...)
+void
+gitg_repository_schedule_commandv(GitgRepository *repository, GitgRunner *runner, GitgSchedulerPriority priority, ...)
 {
 	va_list ap;
-	va_start(ap, error);
+	va_start(ap, priority);
 	gchar const **argv = parse_valist(ap);
 	va_end(ap);
 	
-	gboolean ret = gitg_repository_run_command_with_input(repository, runner, argv, input, error);
+	gitg_repository_schedule_command(repository, runner, priority, argv);
 	g_free(argv);
-	return ret;
 }
 
-gchar **
-gitg_repository_command_with_outputv(GitgRepository *repository, GError **error, ...)
+/* Drops the command scheduled for runner, and cancels runner */
+void
+gitg_repository_cancel_command(GitgRepository *repository, GitgRunner *runner)
 {
-	va_list ap;
-	va_start(ap, error);
-	gchar const **argv = parse_valist(ap);
-	va_end(ap);
+	g_return_if_fail(GITG_IS_REPOSITORY(repository));
+	g_return_if_fail(GITG_IS_RUNNER(runner));
 	
-	gchar **ret = gitg_repository_command_with_output(repository, argv, error);
-	g_free(argv);
-	return ret;
+	if (repository->priv->scheduler)
+		gitg_scheduler_cancel(repository->priv->scheduler, runner);
+	else
+		gitg_runner_cancel(runner);
 }
 
-gchar **
-gitg_repository_command_with_input_and_outputv(GitgRepository *repository, gchar const *input, GError **error, ...)
+/* Whether a command for runner is queued or running */
+gboolean
+gitg_repository_command_scheduled(GitgRepository *repository, GitgRunner *runner)
 {
-	va_list ap;
-	va_start(ap, error);
-	gchar const **argv = parse_valist(ap);
-	va_end(ap);
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), FALSE);
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
 	
-	gchar **ret = gitg_repository_command_with_input_and_output(repository, argv, input, error);
-	g_free(argv);
-	return ret;
+	if (repository->priv->scheduler)
+		return gitg_scheduler_busy(repository->priv->scheduler, runner);
+	else
+		return gitg_runner_running(runner);
 }
 
 gchar *
@@ -1527,6 +4514,57 @@ gitg_repository_get_current_working_ref(GitgRepository *repository)
 	return repository->priv->working_ref;
 }
 
+/* Looks up name (anything 'git rev-parse' accepts) using a long running
+   'git cat-file --batch-check'. Returns the sha of the object, or NULL if it
+   does not exist. type and size may be NULL */
+gchar *
+gitg_repository_cat_file_check(GitgRepository *repository, gchar const *name, gchar **type, gsize *size)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+	
+	if (!repository->priv->cat_file_check)
+		repository->priv->cat_file_check = gitg_cat_file_new(repository->priv->path, FALSE);
+	
+	return gitg_cat_file_check(repository->priv->cat_file_check, name, type, size);
+}
+
+/* Reads the contents of the object name resolves to using a long running
+   'git cat-file --batch'. Returns NULL if the object does not exist */
+gchar *
+gitg_repository_cat_file(GitgRepository *repository, gchar const *name, gchar **type, gsize *size)
+{
+	g_return_val_if_fail(GITG_IS_REPOSITORY(repository), NULL);
+	g_return_val_if_fail(repository->priv->path != NULL, NULL);
+	
+	if (!repository->priv->cat_file)
+		repository->priv->cat_file = gitg_cat_file_new(repository->priv->path, TRUE);
+	
+	return gitg_cat_file_contents(repository->priv->cat_file, name, type, size);
+}
+
+/* Drops all memoized query output. Called when the monitors see the
+   repository change, after reloading and after running commands which
+   (may) change the repository */
+void
+gitg_repository_invalidate (GitgRepository *repository)
+{
+	g_return_if_fail (GITG_IS_REPOSITORY (repository));
+	
+	++repository->priv->generation;
+	g_hash_table_remove_all (repository->priv->query_cache);
+}
+
+/* The generation is bumped each time the repository might have changed,
+   anything derived from its state can be memoized against it */
+guint
+gitg_repository_get_generation (GitgRepository *repository)
+{
+	g_return_val_if_fail (GITG_IS_REPOSITORY (repository), 0);
+	
+	return repository->priv->generation;
+}
+
 gchar **
 gitg_repository_get_remotes (GitgRepository *repository)
 {
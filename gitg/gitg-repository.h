@@ -27,6 +27,7 @@
 #include "gitg-revision.h"
 #include "gitg-runner.h"
 #include "gitg-ref.h"
+#include "gitg-scheduler.h"
 
 G_BEGIN_DECLS
 
@@ -48,6 +49,26 @@ typedef enum
 	GITG_REPOSITORY_ERROR_NOT_FOUND
 } GitgRepositoryError;
 
+/* What a burst of changes on disk touched, see the changed signal */
+typedef enum
+{
+	GITG_REPOSITORY_CHANGE_NONE = 0,
+	GITG_REPOSITORY_CHANGE_HEAD = 1 << 0,
+	GITG_REPOSITORY_CHANGE_REFS = 1 << 1,
+	GITG_REPOSITORY_CHANGE_INDEX = 1 << 2,
+	GITG_REPOSITORY_CHANGE_CONFIG = 1 << 3
+} GitgRepositoryChange;
+
+/* The refs shown on a row. width caches the width of their labels for the
+   font with font_hash, it is -1 when the refs change */
+typedef struct
+{
+	GSList *refs;
+	
+	gint width;
+	guint font_hash;
+} GitgDecoration;
+
 struct _GitgRepository
 {
 	GObject parent;
@@ -60,6 +81,9 @@ struct _GitgRepositoryClass
 	GObjectClass parent_class;
 	
 	void (*load) (GitgRepository *);
+	void (*begin_bulk_insert) (GitgRepository *);
+	void (*end_bulk_insert) (GitgRepository *);
+	void (*changed) (GitgRepository *, GitgRepositoryChange changes, GSList *refs);
 };
 
 GType gitg_repository_get_type (void) G_GNUC_CONST;
@@ -70,12 +94,19 @@ GitgRunner *gitg_repository_get_loader(GitgRepository *repository);
 gboolean gitg_repository_load(GitgRepository *repository, int argc, gchar const **argv, GError **error);
 
 void gitg_repository_add(GitgRepository *repository, GitgRevision *revision, GtkTreeIter *iter);
+void gitg_repository_add_batch(GitgRepository *repository, GitgRevision **revisions, guint num);
 void gitg_repository_clear(GitgRepository *repository);
 
 gboolean gitg_repository_find_by_hash(GitgRepository *self, gchar const *hash, GtkTreeIter *iter);
 gboolean gitg_repository_find(GitgRepository *store, GitgRevision *revision, GtkTreeIter *iter);
 GitgRevision *gitg_repository_lookup(GitgRepository *store, gchar const *hash);
 
+void gitg_repository_load_details(GitgRepository *repository);
+void gitg_repository_ensure_details(GitgRepository *repository, GitgRevision *revision);
+
+void gitg_repository_set_visible_range(GitgRepository *repository, gulong first, gulong last);
+gboolean gitg_repository_get_row(GitgRepository *repository, GtkTreeIter *iter, GitgRevision **revision, GitgRevision **next_revision, GitgDecoration **decoration);
+
 GSList *gitg_repository_get_refs(GitgRepository *repository);
 GSList *gitg_repository_get_refs_for_hash(GitgRepository *repository, gchar const *hash);
 GitgRef *gitg_repository_get_current_ref(GitgRepository *repository);
@@ -93,19 +124,43 @@ gboolean gitg_repository_run_command_with_inputv(GitgRepository *repository, Git
 gboolean gitg_repository_command_with_input(GitgRepository *repository, gchar const **argv, gchar const *input, GError **error);
 gboolean gitg_repository_command_with_inputv(GitgRepository *repository, gchar const *input, GError **error, ...) G_GNUC_NULL_TERMINATED;
 
+gboolean gitg_repository_run_command_with_input_stream(GitgRepository *repository, GitgRunner *runner, gchar const **argv, GInputStream *input, GError **error);
+
+gboolean gitg_repository_command_with_input_stream(GitgRepository *repository, gchar const **argv, GInputStream *input, GError **error);
+gboolean gitg_repository_command_with_input_streamv(GitgRepository *repository, GInputStream *input, GError **error, ...) G_GNUC_NULL_TERMINATED;
+
 gboolean gitg_repository_command(GitgRepository *repository, gchar const **argv, GError **error);
 gboolean gitg_repository_commandv(GitgRepository *repository, GError **error, ...) G_GNUC_NULL_TERMINATED;
 
 gchar **gitg_repository_command_with_output(GitgRepository *repository, gchar const **argv, GError **error);
 gchar **gitg_repository_command_with_outputv(GitgRepository *repository, GError **error, ...) G_GNUC_NULL_TERMINATED;
 
+/* Memoized read only queries */
+gchar **gitg_repository_command_with_output_cached(GitgRepository *repository, gchar const **argv, GError **error);
+gchar **gitg_repository_command_with_output_cachedv(GitgRepository *repository, GError **error, ...) G_GNUC_NULL_TERMINATED;
+
+void gitg_repository_invalidate(GitgRepository *repository);
+guint gitg_repository_get_generation(GitgRepository *repository);
+
 gchar **gitg_repository_command_with_input_and_output(GitgRepository *repository, gchar const **argv, gchar const *input, GError **error);
 gchar **gitg_repository_command_with_input_and_outputv(GitgRepository *repository, gchar const *input, GError **error, ...) G_GNUC_NULL_TERMINATED;
 
+/* Running git commands through the repository scheduler */
+void gitg_repository_schedule_command(GitgRepository *repository, GitgRunner *runner, GitgSchedulerPriority priority, gchar const **argv);
+void gitg_repository_schedule_commandv(GitgRepository *repository, GitgRunner *runner, GitgSchedulerPriority priority, ...) G_GNUC_NULL_TERMINATED;
+
+void gitg_repository_cancel_command(GitgRepository *repository, GitgRunner *runner);
+gboolean gitg_repository_command_scheduled(GitgRepository *repository, GitgRunner *runner);
+
 gchar *gitg_repository_parse_ref(GitgRepository *repository, gchar const *ref);
 gchar *gitg_repository_parse_head(GitgRepository *repository);
 
+/* Object lookups through long running git cat-file processes */
+gchar *gitg_repository_cat_file_check(GitgRepository *repository, gchar const *name, gchar **type, gsize *size);
+gchar *gitg_repository_cat_file(GitgRepository *repository, gchar const *name, gchar **type, gsize *size);
+
 void gitg_repository_reload(GitgRepository *repository);
+void gitg_repository_update(GitgRepository *repository);
 
 gchar **gitg_repository_get_remotes (GitgRepository *repository);
 
@@ -70,11 +70,26 @@ G_DEFINE_TYPE_EXTENDED(GitgRevisionTreeView, gitg_revision_tree_view, GTK_TYPE_H
 
 static GtkBuildableIface parent_iface;
 
+static void
+cancel_runner(GitgRevisionTreeView *tree, GitgRunner *runner)
+{
+	if (tree->priv->repository)
+		gitg_repository_cancel_command(tree->priv->repository, runner);
+	else
+		gitg_runner_cancel(runner);
+}
+
 static void
 gitg_revision_tree_view_finalize(GObject *object)
 {
 	GitgRevisionTreeView *self = GITG_REVISION_TREE_VIEW(object);
 	
+	cancel_runner(self, self->priv->loader);
+	g_object_unref(self->priv->loader);
+	
+	cancel_runner(self, self->priv->content_runner);
+	g_object_unref(self->priv->content_runner);
+	
 	if (self->priv->revision)
 		gitg_revision_unref(self->priv->revision);
 	
@@ -89,9 +104,6 @@ gitg_revision_tree_view_finalize(GObject *object)
 	if (self->priv->drag_files)
 		g_strfreev(self->priv->drag_files);
 	
-	gitg_runner_cancel(self->priv->loader);
-	g_object_unref(self->priv->loader);
-
 	G_OBJECT_CLASS(gitg_revision_tree_view_parent_class)->finalize(object);
 }
 
@@ -127,7 +139,11 @@ gitg_revision_tree_view_set_property(GObject *object, guint prop_id, const GValu
 			}
 			
 			if (self->priv->repository)
+			{
+				cancel_runner(self, self->priv->loader);
+				cancel_runner(self, self->priv->content_runner);
 				g_object_unref(self->priv->repository);
+			}
 			
 			self->priv->repository = g_value_dup_object(value);
 			gitg_revision_tree_view_reload(self);
@@ -192,7 +208,7 @@ on_selection_changed(GtkTreeSelection *selection, GitgRevisionTreeView *tree)
 	GtkTreeModel *model;
 	GtkTreeIter iter;
 	
-	gitg_runner_cancel(tree->priv->content_runner);
+	cancel_runner(tree, tree->priv->content_runner);
 	
 	gtk_text_buffer_set_text(buffer, "", -1);
 
@@ -232,7 +248,7 @@ on_selection_changed(GtkTreeSelection *selection, GitgRevisionTreeView *tree)
 		gtk_source_buffer_set_language(GTK_SOURCE_BUFFER(buffer), language);
 		
 		gchar *id = node_identity(tree, &iter);
-		gitg_repository_run_commandv(tree->priv->repository, tree->priv->content_runner, NULL, "show", "--encoding=UTF-8", id, NULL);
+		gitg_repository_schedule_commandv(tree->priv->repository, tree->priv->content_runner, GITG_SCHEDULER_PRIORITY_PREFETCH, "show", "--encoding=UTF-8", id, NULL);
 		
 		g_free(id);
 	}
@@ -681,7 +697,7 @@ node_identity(GitgRevisionTreeView *tree, GtkTreeIter *parent)
 static void
 load_node(GitgRevisionTreeView *tree, GtkTreeIter *parent)
 {
-	if (gitg_runner_running(tree->priv->loader))
+	if (gitg_repository_command_scheduled(tree->priv->repository, tree->priv->loader))
 		return;
 	
 	if (tree->priv->load_path)
@@ -695,7 +711,7 @@ load_node(GitgRevisionTreeView *tree, GtkTreeIter *parent)
 		tree->priv->load_path = NULL;
 
 	tree->priv->skipped_blank_line = FALSE;
-	gitg_repository_run_commandv(tree->priv->repository, tree->priv->loader, NULL, "show", "--encoding=UTF-8", id, NULL);
+	gitg_repository_schedule_commandv(tree->priv->repository, tree->priv->loader, GITG_SCHEDULER_PRIORITY_PREFETCH, "show", "--encoding=UTF-8", id, NULL);
 	g_free(id);
 }
 
@@ -719,7 +735,7 @@ gitg_revision_tree_view_reload(GitgRevisionTreeView *tree)
 {
 	g_return_if_fail(GITG_IS_REVISION_TREE_VIEW(tree));
 	
-	gitg_runner_cancel(tree->priv->loader);
+	cancel_runner(tree, tree->priv->loader);
 	gtk_tree_store_clear(tree->priv->store);
 	
 	if (!(tree->priv->repository && tree->priv->revision))
@@ -347,15 +347,29 @@ free_cached_headers(GitgRevisionView *self)
 	self->priv->cached_headers = NULL;
 }
 
+static void
+cancel_diff(GitgRevisionView *self)
+{
+	if (self->priv->repository)
+	{
+		gitg_repository_cancel_command(self->priv->repository, self->priv->diff_runner);
+		gitg_repository_cancel_command(self->priv->repository, self->priv->diff_files_runner);
+	}
+	else
+	{
+		gitg_runner_cancel(self->priv->diff_runner);
+		gitg_runner_cancel(self->priv->diff_files_runner);
+	}
+}
+
 static void
 gitg_revision_view_finalize(GObject *object)
 {
 	GitgRevisionView *self = GITG_REVISION_VIEW(object);
 	
-	gitg_runner_cancel(self->priv->diff_runner);
-	g_object_unref(self->priv->diff_runner);
+	cancel_diff(self);
 	
-	gitg_runner_cancel(self->priv->diff_files_runner);
+	g_object_unref(self->priv->diff_runner);
 	g_object_unref(self->priv->diff_files_runner);
 
 	if (self->priv->repository)
@@ -394,7 +408,10 @@ gitg_revision_view_set_property(GObject *object, guint prop_id, const GValue *va
 		case PROP_REPOSITORY:
 		{
 			if (self->priv->repository)
+			{
+				cancel_diff(self);
 				g_object_unref(self->priv->repository);
+			}
 				
 			self->priv->repository = g_value_dup_object(value);
 		}
@@ -493,38 +510,33 @@ add_diff_file(GitgRevisionView *view, DiffFile *f)
 }
 
 static void
-on_diff_files_update(GitgRunner *runner, gchar **buffer, GitgRevisionView *self)
+on_diff_files_update(GitgRunner *runner, GitgRunnerLine *lines, GitgRevisionView *self)
 {
-	gchar **line;
-	
-	while (*(line = buffer++))
+	for (; lines->line; ++lines)
 	{
-		if (**line == '\0')
+		if (*lines->line == '\0')
 			continue;
 		
 		// Count parents
 		gint parents = 0;
-		gchar *ptr = *line;
+		gchar *ptr = lines->line;
 		
 		while (*(ptr++) == ':')
 			++parents;
 		
 		gint numparts = 3 + 2 * parents;
-		gchar **parts = g_strsplit(ptr, " ", numparts);
+		gchar **parts = g_newa(gchar *, numparts);
 		
-		if (g_strv_length(parts) == numparts)
+		if (gitg_utils_split_inplace(ptr, " ", parts, numparts) == numparts)
 		{
-			gchar **files = g_strsplit(parts[numparts - 1], "\t", -1);
+			gchar *files[3] = {NULL, NULL, NULL};
+			gitg_utils_split_inplace(parts[numparts - 1], "\t", files, 3);
 
 			DiffFile *f = diff_file_new(parts[parents + 1], parts[numparts - 2], files[0], files[1]);
 			
 			add_diff_file(self, f);
 			diff_file_unref(f);
-
-			g_strfreev(files);
 		}
-
-		g_strfreev(parts);
 	}
 }
 
@@ -554,32 +566,31 @@ on_diff_end_loading(GitgRunner *runner, gboolean cancelled, GitgRevisionView *se
 		if (sign == 't')
 			cached = "--cached";
 
-		gitg_repository_run_commandv(self->priv->repository, self->priv->diff_files_runner, NULL,
+		gitg_repository_schedule_commandv(self->priv->repository, self->priv->diff_files_runner, GITG_SCHEDULER_PRIORITY_FOREGROUND,
 									"diff-index", "--raw", "-M", "--abbrev=40", head, cached, NULL);
 		g_free(head);
 	}
 	else
 	{
 		gchar *sha = gitg_revision_get_sha1(self->priv->revision);
-		gitg_repository_run_commandv(self->priv->repository, self->priv->diff_files_runner, NULL,
+		gitg_repository_schedule_commandv(self->priv->repository, self->priv->diff_files_runner, GITG_SCHEDULER_PRIORITY_FOREGROUND,
 								 "show", "--encoding=UTF-8", "--raw", "-M", "--pretty=format:", "--abbrev=40", sha, NULL);
 		g_free(sha);
 	}
 }
 
 static void
-on_diff_update(GitgRunner *runner, gchar **buffer, GitgRevisionView *self)
+on_diff_update(GitgRunner *runner, GitgRunnerLine *lines, GitgRevisionView *self)
 {
-	gchar *line;
 	GtkTextBuffer *buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(self->priv->diff));
 	GtkTextIter iter;
 	
 	gtk_text_buffer_get_end_iter(buf, &iter);
 	
-	while ((line = *buffer++))
+	for (; lines->line; ++lines)
 	{
-		gtk_text_buffer_insert(buf, &iter, line, -1);
-		gtk_text_buffer_insert(buf, &iter, "\n", -1);
+		gtk_text_buffer_insert(buf, &iter, lines->line, lines->length);
+		gtk_text_buffer_insert(buf, &iter, "\n", 1);
 	}
 }
 
@@ -589,15 +600,18 @@ gitg_revision_view_init(GitgRevisionView *self)
 	self->priv = GITG_REVISION_VIEW_GET_PRIVATE(self);
 	
 	self->priv->diff_runner = gitg_runner_new(2000);
+	gitg_runner_set_line_views(self->priv->diff_runner, TRUE);
+	gitg_runner_set_batch_budget(self->priv->diff_runner, 8);
 	
 	g_signal_connect(self->priv->diff_runner, "begin-loading", G_CALLBACK(on_diff_begin_loading), self);
-	g_signal_connect(self->priv->diff_runner, "update", G_CALLBACK(on_diff_update), self);
+	g_signal_connect(self->priv->diff_runner, "update-lines", G_CALLBACK(on_diff_update), self);
 	g_signal_connect(self->priv->diff_runner, "end-loading", G_CALLBACK(on_diff_end_loading), self);
 	
 	self->priv->diff_files_runner = gitg_runner_new(2000);
+	gitg_runner_set_line_views(self->priv->diff_files_runner, TRUE);
 	
 	g_signal_connect(self->priv->diff_files_runner, "begin-loading", G_CALLBACK(on_diff_files_begin_loading), self);
-	g_signal_connect(self->priv->diff_files_runner, "update", G_CALLBACK(on_diff_files_update), self);
+	g_signal_connect(self->priv->diff_files_runner, "update-lines", G_CALLBACK(on_diff_files_update), self);
 	g_signal_connect(self->priv->diff_files_runner, "end-loading", G_CALLBACK(on_diff_files_end_loading), self);
 }
 
@@ -677,6 +691,8 @@ update_parents(GitgRevisionView *self, GitgRevision *revision)
 		if (revision)
 		{
 			GtkWidget *subject = gtk_label_new(NULL);
+			
+			gitg_repository_ensure_details(self->priv->repository, revision);
 
 			gchar *escaped = g_markup_escape_text(gitg_revision_get_subject(revision), -1);
 			gchar *text = g_strdup_printf("(<i>%s</i>)", escaped);
@@ -705,9 +721,8 @@ update_diff(GitgRevisionView *self, GitgRepository *repository)
 {
 	GtkTreeSelection *selection;
 	
-	// First cancel a possibly still running diff
-	gitg_runner_cancel(self->priv->diff_runner);
-	gitg_runner_cancel(self->priv->diff_files_runner);
+	// First cancel a possibly still running or queued diff
+	cancel_diff(self);
 	
 	free_cached_headers(self);
 	
@@ -734,19 +749,19 @@ update_diff(GitgRevisionView *self, GitgRepository *repository)
 	switch (sign)
 	{
 		case 't':
-			gitg_repository_run_commandv(self->priv->repository, self->priv->diff_runner, NULL,
+			gitg_repository_schedule_commandv(self->priv->repository, self->priv->diff_runner, GITG_SCHEDULER_PRIORITY_FOREGROUND,
 										"diff", "--cached", "-M", "--pretty=format:%s%n%n%b",
 										"--encoding=UTF-8", NULL);
 		break;
 		case 'u':
-			gitg_repository_run_commandv(self->priv->repository, self->priv->diff_runner, NULL,
+			gitg_repository_schedule_commandv(self->priv->repository, self->priv->diff_runner, GITG_SCHEDULER_PRIORITY_FOREGROUND,
 										"diff", "-M", "--pretty=format:%s%n%n%b",
 										"--encoding=UTF-8", NULL);
 		break;
 		default:
 		{
 			gchar *hash = gitg_revision_get_sha1(self->priv->revision);
-			gitg_repository_run_commandv(self->priv->repository, self->priv->diff_runner, NULL,
+			gitg_repository_schedule_commandv(self->priv->repository, self->priv->diff_runner, GITG_SCHEDULER_PRIORITY_FOREGROUND,
 										 "show", "-M", "--pretty=format:%s%n%n%b", 
 										 "--encoding=UTF-8", hash, NULL);
 
@@ -766,6 +781,9 @@ gitg_revision_view_update(GitgRevisionView *self, GitgRepository *repository, Gi
 	// Update labels
 	if (revision)
 	{
+		if (repository)
+			gitg_repository_ensure_details(repository, revision);
+		
 		gtk_label_set_text(self->priv->author, gitg_revision_get_author(revision));
 
 		gchar *s = g_markup_escape_text(gitg_revision_get_subject(revision), -1);
@@ -811,6 +829,7 @@ gitg_revision_view_set_repository(GitgRevisionView *view, GitgRepository *reposi
 
 	if (view->priv->repository)
 	{
+		cancel_diff(view);
 		g_object_unref(view->priv->repository);
 		view->priv->repository = NULL;
 	}
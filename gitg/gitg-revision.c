@@ -23,43 +23,350 @@
 #include "gitg-revision.h"
 #include "gitg-utils.h"
 
-struct _GitgRevision
+#include <string.h>
+
+/* An arena stores revisions as columns: one array per field, split in pages
+   of rows which never move once allocated, so readers need no lock. A
+   GitgRevision is only a handle to its row. Rows of revisions which are
+   released are reused, authors and subjects live in a string chunk (authors
+   interned since they repeat a lot) until the arena goes. Revisions created
+   without an arena are stored in a shared one. Revisions created without
+   author and subject get empty ones, until their details are set. Empty
+   strings are not stored */
+#define ARENA_PAGE_ROWS 1024
+#define ARENA_PAGES_MIN 64
+#define ARENA_STRINGS_SIZE (64 * 1024)
+
+/* Rows with more parents keep them in an allocation of their own */
+#define INLINE_PARENTS 2
+
+/* The author and subject were set */
+#define ROW_DETAILS (1 << 0)
+
+typedef struct
+{
+	Hash hashes[ARENA_PAGE_ROWS];
+	gint64 timestamps[ARENA_PAGE_ROWS];
+	Hash parents[ARENA_PAGE_ROWS][INLINE_PARENTS];
+	Hash *more_parents[ARENA_PAGE_ROWS];
+	guint16 num_parents[ARENA_PAGE_ROWS];
+
+	gchar const *authors[ARENA_PAGE_ROWS];
+	gchar const *subjects[ARENA_PAGE_ROWS];
+
+	GitgLaneRow *lanes[ARENA_PAGE_ROWS];
+	gint8 mylanes[ARENA_PAGE_ROWS];
+	gchar signs[ARENA_PAGE_ROWS];
+	guint8 flags[ARENA_PAGE_ROWS];
+
+	GitgRevision *handles[ARENA_PAGE_ROWS];
+} ArenaPage;
+
+struct _GitgRevisionArena
 {
 	gint refcount;
+	GMutex *lock;
 
-	Hash hash;
-	gchar *author;
-	gchar *subject;
-	Hash *parents;
-	guint num_parents;
-	char sign;
-	
-	GSList *lanes;
-	gint8 mylane;
+	GStringChunk *strings;
+
+	/* The page table is replaced when it grows, old tables are kept for
+	   readers which may still have them */
+	ArenaPage **pages;
+	guint num_pages;
+	GSList *old_pages;
 
-	gint64 timestamp;
+	guint32 size;
+	GArray *free_rows;
 };
 
+struct _GitgRevision
+{
+	gint refcount;
+	GitgRevisionArena *arena;
+	guint32 index;
+};
+
+static inline ArenaPage *
+row_page(GitgRevision *revision, guint *slot)
+{
+	ArenaPage **pages = g_atomic_pointer_get(&revision->arena->pages);
+
+	*slot = revision->index % ARENA_PAGE_ROWS;
+	return pages[revision->index / ARENA_PAGE_ROWS];
+}
+
+GitgRevisionArena *
+gitg_revision_arena_new()
+{
+	GitgRevisionArena *arena = g_slice_new0(GitgRevisionArena);
+
+	arena->refcount = 1;
+	arena->lock = g_mutex_new();
+	arena->strings = g_string_chunk_new(ARENA_STRINGS_SIZE);
+	arena->free_rows = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+	arena->num_pages = ARENA_PAGES_MIN;
+	arena->pages = g_new0(ArenaPage *, arena->num_pages);
+
+	return arena;
+}
+
+GitgRevisionArena *
+gitg_revision_arena_ref(GitgRevisionArena *arena)
+{
+	if (arena == NULL)
+		return NULL;
+
+	g_atomic_int_inc(&arena->refcount);
+	return arena;
+}
+
+void
+gitg_revision_arena_unref(GitgRevisionArena *arena)
+{
+	guint i;
+
+	if (arena == NULL)
+		return;
+
+	if (!g_atomic_int_dec_and_test(&arena->refcount))
+		return;
+
+	/* Every revision holds a reference, their rows are released already */
+	for (i = 0; i < arena->num_pages; ++i)
+		g_free(arena->pages[i]);
+
+	g_free(arena->pages);
+
+	g_slist_foreach(arena->old_pages, (GFunc)g_free, NULL);
+	g_slist_free(arena->old_pages);
+
+	g_array_free(arena->free_rows, TRUE);
+	g_string_chunk_free(arena->strings);
+	g_mutex_free(arena->lock);
+
+	g_slice_free(GitgRevisionArena, arena);
+}
+
+/* Called with the arena lock held */
+static gchar const *
+arena_author(GitgRevisionArena *arena, gchar const *author)
+{
+	return *author ? g_string_chunk_insert_const(arena->strings, author) : "";
+}
+
+/* Called with the arena lock held. Subjects rarely repeat, they are not
+   interned */
+static gchar const *
+arena_subject(GitgRevisionArena *arena, gchar const *subject)
+{
+	return *subject ? g_string_chunk_insert(arena->strings, subject) : "";
+}
+
+static GitgRevisionArena *
+shared_arena()
+{
+	static gsize arena = 0;
+
+	if (g_once_init_enter(&arena))
+		g_once_init_leave(&arena, (gsize)gitg_revision_arena_new());
+
+	return (GitgRevisionArena *)arena;
+}
+
+/* Called with the arena lock held. Returns a cleared row for revision */
+static guint32
+row_alloc(GitgRevisionArena *arena, GitgRevision *revision)
+{
+	guint32 index;
+	guint page;
+	guint slot;
+
+	if (arena->free_rows->len)
+	{
+		index = g_array_index(arena->free_rows, guint32, arena->free_rows->len - 1);
+		g_array_set_size(arena->free_rows, arena->free_rows->len - 1);
+	}
+	else
+	{
+		index = arena->size++;
+	}
+
+	page = index / ARENA_PAGE_ROWS;
+	slot = index % ARENA_PAGE_ROWS;
+
+	if (page >= arena->num_pages)
+	{
+		ArenaPage **pages = g_new0(ArenaPage *, arena->num_pages * 2);
+
+		memcpy(pages, arena->pages, sizeof(ArenaPage *) * arena->num_pages);
+		arena->old_pages = g_slist_prepend(arena->old_pages, arena->pages);
+
+		arena->num_pages *= 2;
+		g_atomic_pointer_set(&arena->pages, pages);
+	}
+
+	if (!arena->pages[page])
+		arena->pages[page] = g_new0(ArenaPage, 1);
+
+	ArenaPage *p = arena->pages[page];
+
+	p->timestamps[slot] = 0;
+	p->more_parents[slot] = NULL;
+	p->num_parents[slot] = 0;
+	p->lanes[slot] = NULL;
+	p->mylanes[slot] = 0;
+	p->signs[slot] = 0;
+	p->flags[slot] = 0;
+	p->handles[slot] = revision;
+
+	return index;
+}
+
+/* Called with the arena lock held */
+static void
+row_free(GitgRevisionArena *arena, guint32 index)
+{
+	ArenaPage *p = arena->pages[index / ARENA_PAGE_ROWS];
+	guint slot = index % ARENA_PAGE_ROWS;
+
+	g_free(p->more_parents[slot]);
+	p->more_parents[slot] = NULL;
+	p->handles[slot] = NULL;
+
+	g_array_append_val(arena->free_rows, index);
+}
+
 static void
 free_lanes(GitgRevision *rv)
 {
-	g_slist_foreach(rv->lanes, (GFunc)gitg_lane_free, NULL);
-	g_slist_free(rv->lanes);
-	rv->lanes = NULL;
+	guint slot;
+	ArenaPage *p = row_page(rv, &slot);
+
+	gitg_lane_row_free(p->lanes[slot]);
+	p->lanes[slot] = NULL;
 }
 
 static void
 gitg_revision_finalize(GitgRevision *revision)
 {
-	g_free(revision->author);
-	g_free(revision->subject);
-	g_free(revision->parents);
-	
+	GitgRevisionArena *arena = revision->arena;
+
 	free_lanes(revision);
-	
+
+	g_mutex_lock(arena->lock);
+	row_free(arena, revision->index);
+	g_mutex_unlock(arena->lock);
+
+	gitg_revision_arena_unref(arena);
 	g_slice_free(GitgRevision, revision);
 }
 
+/* Moves the row of revision from its arena into to. The strings are copied
+   unless to took over the strings of the arena. Called with the locks of
+   both arenas held */
+static void
+row_move(GitgRevision *revision, GitgRevisionArena *to, gboolean copy_strings)
+{
+	GitgRevisionArena *from = revision->arena;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+	guint32 index = row_alloc(to, revision);
+	ArenaPage *np = to->pages[index / ARENA_PAGE_ROWS];
+	guint nslot = index % ARENA_PAGE_ROWS;
+
+	memcpy(np->hashes[nslot], p->hashes[slot], sizeof(Hash));
+	memcpy(np->parents[nslot], p->parents[slot], sizeof(Hash) * INLINE_PARENTS);
+
+	np->timestamps[nslot] = p->timestamps[slot];
+	np->more_parents[nslot] = p->more_parents[slot];
+	np->num_parents[nslot] = p->num_parents[slot];
+	np->authors[nslot] = copy_strings ? arena_author(to, p->authors[slot]) : p->authors[slot];
+	np->subjects[nslot] = copy_strings ? arena_subject(to, p->subjects[slot]) : p->subjects[slot];
+	np->lanes[nslot] = p->lanes[slot];
+	np->mylanes[nslot] = p->mylanes[slot];
+	np->signs[nslot] = p->signs[slot];
+	np->flags[nslot] = p->flags[slot];
+
+	/* The parents and lanes went along */
+	p->more_parents[slot] = NULL;
+	p->lanes[slot] = NULL;
+
+	row_free(from, revision->index);
+
+	revision->arena = gitg_revision_arena_ref(to);
+	revision->index = index;
+}
+
+/* Moves the revisions of arena which are still referenced elsewhere into
+   an arena of their own, so they do not keep all of arena around. That
+   arena goes with the last of them. When most rows are still in use, it
+   takes over the strings instead of copying them. No other thread may be
+   using the revisions of arena */
+void
+gitg_revision_arena_detach(GitgRevisionArena *arena)
+{
+	GitgRevisionArena *to;
+	gboolean copy_strings;
+	guint live = 0;
+	guint moved = 0;
+	guint32 i;
+
+	g_return_if_fail(arena != NULL);
+
+	if (arena == shared_arena())
+		return;
+
+	g_mutex_lock(arena->lock);
+
+	for (i = 0; i < arena->size; ++i)
+	{
+		if (arena->pages[i / ARENA_PAGE_ROWS]->handles[i % ARENA_PAGE_ROWS])
+			++live;
+	}
+
+	if (live == 0)
+	{
+		g_mutex_unlock(arena->lock);
+		return;
+	}
+
+	to = gitg_revision_arena_new();
+	copy_strings = live < arena->size / 2;
+
+	if (!copy_strings)
+	{
+		GStringChunk *strings = to->strings;
+
+		to->strings = arena->strings;
+		arena->strings = strings;
+	}
+
+	g_mutex_lock(to->lock);
+
+	for (i = 0; i < arena->size && moved < live; ++i)
+	{
+		ArenaPage *p = arena->pages[i / ARENA_PAGE_ROWS];
+		GitgRevision *rv = p->handles[i % ARENA_PAGE_ROWS];
+
+		if (rv)
+		{
+			row_move(rv, to, copy_strings);
+			++moved;
+		}
+	}
+
+	g_mutex_unlock(to->lock);
+	g_mutex_unlock(arena->lock);
+
+	/* The moved revisions hold to now */
+	gitg_revision_arena_unref(to);
+
+	/* The references of the moved revisions, the caller holds another */
+	while (moved--)
+		gitg_revision_arena_unref(arena);
+}
+
 GitgRevision *
 gitg_revision_ref(GitgRevision *revision)
 {
@@ -88,61 +395,185 @@ GitgRevision *gitg_revision_new(gchar const *sha,
 		gchar const *parents, 
 		gint64 timestamp)
 {
-	GitgRevision *rv = g_slice_new0 (GitgRevision);
-	
+	return gitg_revision_new_from_arena(NULL, sha, author, subject, parents, timestamp);
+}
+
+/* Allocates a revision with room for num_parents parents, which the caller
+   fills in together with the hash */
+static GitgRevision *
+revision_alloc(GitgRevisionArena *arena,
+               gchar const *author,
+               gchar const *subject,
+               guint num_parents,
+               gint64 timestamp,
+               Hash **parents)
+{
+	GitgRevision *rv = g_slice_new(GitgRevision);
+	gboolean details = author != NULL;
+	ArenaPage *p;
+	guint slot;
+
+	if (!arena)
+		arena = shared_arena();
+
+	if (!details)
+	{
+		author = "";
+		subject = "";
+	}
+
 	rv->refcount = 1;
+	rv->arena = gitg_revision_arena_ref(arena);
 
-	gitg_utils_sha1_to_hash(sha, rv->hash);
-	rv->author = g_strdup(author);
-	rv->subject = g_strdup(subject);
-	rv->timestamp = timestamp;
-	
+	g_mutex_lock(arena->lock);
+
+	rv->index = row_alloc(arena, rv);
+	p = arena->pages[rv->index / ARENA_PAGE_ROWS];
+	slot = rv->index % ARENA_PAGE_ROWS;
+
+	p->authors[slot] = arena_author(arena, author);
+	p->subjects[slot] = arena_subject(arena, subject);
+
+	g_mutex_unlock(arena->lock);
+
+	p->timestamps[slot] = timestamp;
+	p->num_parents[slot] = num_parents;
+	p->flags[slot] = details ? ROW_DETAILS : 0;
+
+	if (num_parents > INLINE_PARENTS)
+		p->more_parents[slot] = g_new(Hash, num_parents);
+
+	*parents = p->more_parents[slot] ? p->more_parents[slot] : p->parents[slot];
+	return rv;
+}
+
+/* Like gitg_revision_new, but allocates the revision from arena. arena may
+   be NULL, author and subject are NULL for a revision without details. Safe
+   to call from any thread */
+GitgRevision *
+gitg_revision_new_from_arena(GitgRevisionArena *arena,
+                             gchar const *sha, 
+                             gchar const *author, 
+                             gchar const *subject, 
+                             gchar const *parents, 
+                             gint64 timestamp)
+{
+	GitgRevision *rv;
+	Hash *hashes;
+	ArenaPage *p;
+	guint slot;
+	gint num = 0;
+	gint i;
+
+	/* parents is a space separated list of full shas */
 	if (parents)
-	{
-		gchar **shas = g_strsplit(parents, " ", 0);
-		gint num = g_strv_length(shas);
-		rv->parents = g_new(Hash, num + 1);
-	
-		gint i;
-		for (i = 0; i < num; ++i)
-			gitg_utils_sha1_to_hash(shas[i], rv->parents[i]);
+		num = (strlen(parents) + 1) / (HASH_SHA_SIZE + 1);
+
+	rv = revision_alloc(arena, author, subject, num, timestamp, &hashes);
+	p = row_page(rv, &slot);
+
+	gitg_utils_sha1_to_hash(sha, p->hashes[slot]);
 	
-		g_strfreev(shas);
-		rv->num_parents = num;
-	}
+	for (i = 0; i < num; ++i)
+		gitg_utils_sha1_to_hash(parents + i * (HASH_SHA_SIZE + 1), hashes[i]);
 	
 	return rv;
 }
 
+/* Like gitg_revision_new_from_arena, with binary hashes */
+GitgRevision *
+gitg_revision_new_from_hashes(GitgRevisionArena *arena,
+                              gchar const *hash,
+                              gchar const *author,
+                              gchar const *subject,
+                              Hash const *parents,
+                              guint num_parents,
+                              gint64 timestamp)
+{
+	Hash *hashes;
+	GitgRevision *rv = revision_alloc(arena, author, subject, num_parents, timestamp, &hashes);
+	guint slot;
+	ArenaPage *p = row_page(rv, &slot);
+
+	memcpy(p->hashes[slot], hash, HASH_BINARY_SIZE);
+
+	if (num_parents)
+		memcpy(hashes, parents, sizeof(Hash) * num_parents);
+
+	return rv;
+}
+
+/* Fills in the details of a revision which was created without them */
+void
+gitg_revision_set_details(GitgRevision *revision, gchar const *author, gchar const *subject, gint64 timestamp)
+{
+	GitgRevisionArena *arena = revision->arena;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	/* The old strings stay in the arena until it is released */
+	g_mutex_lock(arena->lock);
+
+	p->authors[slot] = arena_author(arena, author);
+	p->subjects[slot] = arena_subject(arena, subject);
+
+	g_mutex_unlock(arena->lock);
+
+	p->timestamps[slot] = timestamp;
+	p->flags[slot] |= ROW_DETAILS;
+}
+
+/* Whether the revision has its author and subject */
+gboolean
+gitg_revision_has_details(GitgRevision *revision)
+{
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return (p->flags[slot] & ROW_DETAILS) != 0;
+}
+
 gchar const *
 gitg_revision_get_author(GitgRevision *revision)
 {
-	return revision->author;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->authors[slot];
 }
 
 gchar const *
 gitg_revision_get_subject(GitgRevision *revision)
 {
-	return revision->subject;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->subjects[slot];
 }
 
 guint64
 gitg_revision_get_timestamp(GitgRevision *revision)
 {
-	return revision->timestamp;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->timestamps[slot];
 }
 
 gchar const *
 gitg_revision_get_hash(GitgRevision *revision)
 {
-	return revision->hash;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->hashes[slot];
 }
 
 gchar *
 gitg_revision_get_sha1(GitgRevision *revision)
 {
 	char res[HASH_SHA_SIZE];
-	gitg_utils_hash_to_sha1(revision->hash, res);
+	gitg_utils_hash_to_sha1(gitg_revision_get_hash(revision), res);
 
 	return g_strndup(res, HASH_SHA_SIZE);
 }
@@ -150,58 +581,87 @@ gitg_revision_get_sha1(GitgRevision *revision)
 Hash *
 gitg_revision_get_parents_hash(GitgRevision *revision, guint *num_parents)
 {
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
 	if (num_parents)
-		*num_parents = revision->num_parents;
+		*num_parents = p->num_parents[slot];
+
+	if (p->num_parents[slot] == 0)
+		return NULL;
 
-	return revision->parents;
+	return p->more_parents[slot] ? p->more_parents[slot] : p->parents[slot];
 }
 
 gchar **
 gitg_revision_get_parents(GitgRevision *revision)
 {
-	gchar **ret = g_new(gchar *, revision->num_parents + 1);
+	guint num;
+	Hash *parents = gitg_revision_get_parents_hash(revision, &num);
+	gchar **ret = g_new(gchar *, num + 1);
 	
 	int i;
-	for (i = 0; i < revision->num_parents; ++i)
+	for (i = 0; i < num; ++i)
 	{
 		ret[i] = g_new(gchar, HASH_SHA_SIZE + 1);
-		gitg_utils_hash_to_sha1(revision->parents[i], ret[i]);
+		gitg_utils_hash_to_sha1(parents[i], ret[i]);
 		
 		ret[i][HASH_SHA_SIZE] = '\0';
 	}
 
-	ret[revision->num_parents] = NULL;
+	ret[num] = NULL;
 
 	return ret;
 }
 
-GSList *
+GitgLaneRow *
 gitg_revision_get_lanes(GitgRevision *revision)
 {
-	return revision->lanes;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->lanes[slot];
 }
 
-GSList *
-gitg_revision_remove_lane(GitgRevision *revision, GitgLane *lane)
+GitgLaneRow *
+gitg_revision_remove_lane(GitgRevision *revision, guint index)
 {
-	revision->lanes = g_slist_remove(revision->lanes, lane);
-	gitg_lane_free(lane);
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	p->lanes[slot] = gitg_lane_row_remove(p->lanes[slot], index);
 	
-	return revision->lanes;
+	return p->lanes[slot];
 }
 
-GSList *
-gitg_revision_insert_lane(GitgRevision *revision, GitgLane *lane, gint index)
+GitgLaneRow *
+gitg_revision_insert_lane(GitgRevision *revision, guint index, GitgLaneSpec const *lane)
 {
-	revision->lanes = g_slist_insert(revision->lanes, lane, index);
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	p->lanes[slot] = gitg_lane_row_insert(p->lanes[slot], index, lane);
 	
-	return revision->lanes;
+	return p->lanes[slot];
+}
+
+GitgLaneRow *
+gitg_revision_set_lane_boundary(GitgRevision *revision, guint index, GitgLaneType type, gchar const *hash)
+{
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	p->lanes[slot] = gitg_lane_row_set_boundary(p->lanes[slot], index, type, hash);
+	
+	return p->lanes[slot];
 }
 
 static void
 update_lane_type(GitgRevision *revision)
 {
-	GitgLane *lane = (GitgLane *)g_slist_nth_data(revision->lanes, revision->mylane);
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+	GitgLane *lane = gitg_lane_row_get(p->lanes[slot], p->mylanes[slot]);
 	
 	if (lane == NULL)
 		return;
@@ -212,7 +672,7 @@ update_lane_type(GitgRevision *revision)
 	                GITG_LANE_SIGN_STAGED |
 	                GITG_LANE_SIGN_UNSTAGED);
 	
-	switch (revision->sign)
+	switch (p->signs[slot])
 	{
 		case '<':
 			lane->type |= GITG_LANE_SIGN_LEFT;
@@ -233,21 +693,39 @@ update_lane_type(GitgRevision *revision)
 }
 
 void 
-gitg_revision_set_lanes(GitgRevision *revision, GSList *lanes, gint8 mylane)
+gitg_revision_set_lanes(GitgRevision *revision, GitgLaneRow *lanes, gint8 mylane)
 {
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
 	free_lanes(revision);
-	revision->lanes = lanes;
+	p->lanes[slot] = lanes;
 	
 	if (mylane >= 0)
-		revision->mylane = mylane;
+		p->mylanes[slot] = mylane;
 
 	update_lane_type(revision);
 }
 
+/* Takes the lanes out of the revision, the caller owns them */
+GitgLaneRow *
+gitg_revision_steal_lanes(GitgRevision *revision)
+{
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+	GitgLaneRow *lanes = p->lanes[slot];
+	
+	p->lanes[slot] = NULL;
+	return lanes;
+}
+
 gint8
 gitg_revision_get_mylane(GitgRevision *revision)
 {
-	return revision->mylane;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->mylanes[slot];
 }
 
 void 
@@ -255,20 +733,29 @@ gitg_revision_set_mylane(GitgRevision *revision, gint8 mylane)
 {
 	g_return_if_fail(mylane >= 0);
 
-	revision->mylane = mylane;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	p->mylanes[slot] = mylane;
 	update_lane_type(revision);
 }
 
 void
 gitg_revision_set_sign(GitgRevision *revision, char sign)
 {
-	revision->sign = sign;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	p->signs[slot] = sign;
 }
 
 char
 gitg_revision_get_sign(GitgRevision *revision)
 {
-	return revision->sign;
+	guint slot;
+	ArenaPage *p = row_page(revision, &slot);
+
+	return p->signs[slot];
 }
 
 GType 
@@ -288,5 +775,5 @@ gitg_revision_get_type (void)
 GitgLane *
 gitg_revision_get_lane(GitgRevision *revision)
 {
-	return (GitgLane *)g_slist_nth_data(revision->lanes, revision->mylane);
+	return gitg_lane_row_get(gitg_revision_get_lanes(revision), gitg_revision_get_mylane(revision));
 }
@@ -35,11 +35,24 @@ G_BEGIN_DECLS
 #include "gitg-types.h"
 
 typedef struct _GitgRevision		GitgRevision;
+typedef struct _GitgRevisionArena	GitgRevisionArena;
 
 GType gitg_revision_get_type (void) G_GNUC_CONST;
 
 GitgRevision *gitg_revision_new(gchar const *hash, 
 	gchar const *author, gchar const *subject, gchar const *parents, gint64 timestamp);
+GitgRevision *gitg_revision_new_from_arena(GitgRevisionArena *arena, gchar const *hash, 
+	gchar const *author, gchar const *subject, gchar const *parents, gint64 timestamp);
+GitgRevision *gitg_revision_new_from_hashes(GitgRevisionArena *arena, gchar const *hash, 
+	gchar const *author, gchar const *subject, Hash const *parents, guint num_parents, gint64 timestamp);
+
+GitgRevisionArena *gitg_revision_arena_new(void);
+GitgRevisionArena *gitg_revision_arena_ref(GitgRevisionArena *arena);
+void gitg_revision_arena_unref(GitgRevisionArena *arena);
+void gitg_revision_arena_detach(GitgRevisionArena *arena);
+
+void gitg_revision_set_details(GitgRevision *revision, gchar const *author, gchar const *subject, gint64 timestamp);
+gboolean gitg_revision_has_details(GitgRevision *revision);
 
 inline gchar const *gitg_revision_get_author(GitgRevision *revision);
 inline gchar const *gitg_revision_get_subject(GitgRevision *revision);
@@ -50,12 +63,14 @@ inline Hash *gitg_revision_get_parents_hash(GitgRevision *revision, guint *num_p
 gchar *gitg_revision_get_sha1(GitgRevision *revision);
 gchar **gitg_revision_get_parents(GitgRevision *revision);
 
-GSList *gitg_revision_get_lanes(GitgRevision *revision);
+GitgLaneRow *gitg_revision_get_lanes(GitgRevision *revision);
 GitgLane *gitg_revision_get_lane(GitgRevision *revision);
-void gitg_revision_set_lanes(GitgRevision *revision, GSList *lanes, gint8 mylane);
+void gitg_revision_set_lanes(GitgRevision *revision, GitgLaneRow *lanes, gint8 mylane);
+GitgLaneRow *gitg_revision_steal_lanes(GitgRevision *revision);
 
-GSList *gitg_revision_remove_lane(GitgRevision *revision, GitgLane *lane);
-GSList *gitg_revision_insert_lane(GitgRevision *revision, GitgLane *lane, gint index);
+GitgLaneRow *gitg_revision_remove_lane(GitgRevision *revision, guint index);
+GitgLaneRow *gitg_revision_insert_lane(GitgRevision *revision, guint index, GitgLaneSpec const *lane);
+GitgLaneRow *gitg_revision_set_lane_boundary(GitgRevision *revision, guint index, GitgLaneType type, gchar const *hash);
 
 gint8 gitg_revision_get_mylane(GitgRevision *revision);
 void gitg_revision_set_mylane(GitgRevision *revision, gint8 mylane);
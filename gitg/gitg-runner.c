@@ -28,6 +28,9 @@
 #include "gitg-debug.h"
 #include <errno.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #include <gio/gio.h>
 #include <gio/gunixoutputstream.h>
@@ -35,11 +38,20 @@
 
 #define GITG_RUNNER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_RUNNER, GitgRunnerPrivate))
 
+/* Lines held back for batching are emitted after at most this many ms, even
+   when no more output arrives */
+#define BATCH_MAX_DELAY 50
+
+/* Size of the chunks in which input is written to a synchronized runner */
+#define INPUT_CHUNK_SIZE 8192
+
 /* Signals */
 enum
 {
 	BEGIN_LOADING,
 	UPDATE,
+	UPDATE_LINES,
+	UPDATE_BATCH,
 	END_LOADING,
 	LAST_SIGNAL
 };
@@ -51,7 +63,9 @@ enum {
 	PROP_0,
 
 	PROP_BUFFER_SIZE,
-	PROP_SYNCHRONIZED
+	PROP_SYNCHRONIZED,
+	PROP_LINE_VIEWS,
+	PROP_BATCH_BUDGET
 };
 
 struct _GitgRunnerPrivate
@@ -59,8 +73,13 @@ struct _GitgRunnerPrivate
 	GPid pid;
 	GInputStream *input_stream;
 	GOutputStream *output_stream;
+	
+	/* stdin and stdout of a spawned command, -1 otherwise */
+	gint stdin_fd;
+	gint stdout_fd;
 	GCancellable *cancellable;
 	gboolean synchronized;
+	gboolean line_views;
 	
 	guint buffer_size;
 	gchar *buffer;
@@ -68,11 +87,110 @@ struct _GitgRunnerPrivate
 	gchar **lines;
 	gchar **environment;
 	
+	/* line views mode: output is read straight into line_buffer, complete
+	   lines are handed out as views and only the trailing partial line is
+	   carried over (between line_start and line_end) */
+	gchar *line_buffer;
+	gsize line_buffer_size;
+	gsize line_start;
+	gsize line_end;
+	GArray *views;
+	GPtrArray *converted;
+	
+	/* batching: with a budget (in ms), line views of several reads are
+	   collected (starting at line_pending) until handling them is expected
+	   to take about budget ms, based on the measured cost per line */
+	guint batch_budget;
+	gdouble line_cost;
+	gsize line_pending;
+	guint pending_reads;
+	guint flush_id;
+	GTimer *emit_timer;
+	GitgRunnerStats stats;
+	
+	/* threaded mode: output is read and parsed on a worker thread */
+	GitgRunnerParser parser;
+	GDestroyNotify free_batch;
+	gpointer parser_data;
+	struct _ThreadData *thread_data;
+	
+	/* accounting of the spawned command, see gitg_runner_stats_dump. verb
+	   is NULL when the output does not come from a spawned command */
+	gchar *command;
+	gchar *verb;
+	GTimer *run_timer;
+	gdouble spawn_time;
+	gdouble first_byte;
+	guint64 bytes;
+	
 	gint exit_status;
 };
 
+/* Totals of all runs of a single git command */
+typedef struct
+{
+	guint runs;
+	guint cancelled;
+	guint failed;
+	guint first_byte_runs;
+	gdouble spawn_time;
+	gdouble first_byte;
+	gdouble wall_time;
+	gdouble max_wall_time;
+	guint64 bytes;
+	guint64 lines;
+} CommandStats;
+
+G_LOCK_DEFINE_STATIC(command_stats);
+static GHashTable *command_stats = NULL;
+
 G_DEFINE_TYPE(GitgRunner, gitg_runner, G_TYPE_OBJECT)
 
+/* Parsed batches are passed from the worker thread to the main loop on a
+   lock free stack. The worker pushes, the main loop takes the whole stack
+   at once and reverses it */
+typedef struct _ThreadBatch ThreadBatch;
+
+struct _ThreadBatch
+{
+	ThreadBatch *next;
+	gpointer batch;
+	gboolean end;
+	gboolean failed;
+	
+	guint lines;
+	guint reads;
+};
+
+typedef struct _ThreadData
+{
+	volatile gint ref_count;
+	
+	/* runner is used by the worker until it is joined, detached is only
+	   touched on the main loop and set once the runner stops caring */
+	GitgRunner *runner;
+	gboolean detached;
+	
+	GThread *thread;
+	GInputStream *input_stream;
+	GCancellable *cancellable;
+	
+	GitgRunnerParser parser;
+	GDestroyNotify free_batch;
+	gpointer parser_data;
+	
+	gpointer queue;
+	volatile gint idle_scheduled;
+	
+	/* Batches taken from the queue which did not fit in the budget of the
+	   previous idle, main loop only */
+	GQueue *backlog;
+	
+	/* Written by the worker, read after it was joined */
+	gdouble first_byte;
+	guint64 bytes;
+} ThreadData;
+
 typedef struct
 {
 	GitgRunner *runner;
@@ -107,6 +225,22 @@ gitg_runner_error_quark()
 	return quark;
 }
 
+static void
+dummy_cb(GPid pid, gint status, gpointer data)
+{
+}
+
+/* Stops the child without waiting for it, the child watch reaps it */
+static void
+kill_child(GitgRunner *runner)
+{
+	if (runner->priv->pid)
+	{
+		g_child_watch_add(runner->priv->pid, dummy_cb, NULL);
+		kill(runner->priv->pid, SIGTERM);
+	}
+}
+
 static void
 runner_io_exit(GPid pid, gint status, GitgRunner *runner)
 {
@@ -149,6 +283,15 @@ gitg_runner_finalize(GObject *object)
 	g_free(runner->priv->buffer);
 	g_strfreev (runner->priv->environment);
 	
+	g_free(runner->priv->line_buffer);
+	g_array_free(runner->priv->views, TRUE);
+	g_ptr_array_free(runner->priv->converted, TRUE);
+	g_timer_destroy(runner->priv->emit_timer);
+	
+	g_free(runner->priv->command);
+	g_free(runner->priv->verb);
+	g_timer_destroy(runner->priv->run_timer);
+	
 	g_object_unref(runner->priv->cancellable);
 
 	G_OBJECT_CLASS(gitg_runner_parent_class)->finalize(object);
@@ -167,6 +310,12 @@ gitg_runner_get_property(GObject *object, guint prop_id, GValue *value, GParamSp
 		case PROP_SYNCHRONIZED:
 			g_value_set_boolean(value, runner->priv->synchronized);
 			break;
+		case PROP_LINE_VIEWS:
+			g_value_set_boolean(value, runner->priv->line_views);
+			break;
+		case PROP_BATCH_BUDGET:
+			g_value_set_uint(value, runner->priv->batch_budget);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -196,6 +345,12 @@ gitg_runner_set_property (GObject *object, guint prop_id, const GValue *value, G
 		case PROP_SYNCHRONIZED:
 			runner->priv->synchronized = g_value_get_boolean(value);
 			break;
+		case PROP_LINE_VIEWS:
+			gitg_runner_set_line_views(runner, g_value_get_boolean(value));
+			break;
+		case PROP_BATCH_BUDGET:
+			gitg_runner_set_batch_budget(runner, g_value_get_uint(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 			break;
@@ -227,6 +382,22 @@ gitg_runner_class_init(GitgRunnerClass *klass)
 							      "Whether the command is ran synchronized",
 							      FALSE,
 							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property (object_class, PROP_LINE_VIEWS,
+					 g_param_spec_boolean ("line-views",
+							      "LINE VIEWS",
+							      "Whether output is delivered as line views in update-lines",
+							      FALSE,
+							      G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class, PROP_BATCH_BUDGET,
+					 g_param_spec_uint ("batch-budget",
+							      "BATCH BUDGET",
+							      "Time in ms that handling a single update may take, 0 to emit for every read",
+							      0,
+							      G_MAXUINT,
+							      0,
+							      G_PARAM_READWRITE));
 				      
 	runner_signals[BEGIN_LOADING] =
    		g_signal_new ("begin-loading",
@@ -248,6 +419,28 @@ gitg_runner_class_init(GitgRunnerClass *klass)
 			      G_TYPE_NONE,
 			      1,
 			      G_TYPE_POINTER);
+
+	runner_signals[UPDATE_LINES] =
+   		g_signal_new ("update-lines",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GitgRunnerClass, update_lines),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1,
+			      G_TYPE_POINTER);
+
+	runner_signals[UPDATE_BATCH] =
+   		g_signal_new ("update-batch",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GitgRunnerClass, update_batch),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1,
+			      G_TYPE_POINTER);
 			      
 	runner_signals[END_LOADING] =
    		g_signal_new ("end-loading",
@@ -269,6 +462,13 @@ gitg_runner_init(GitgRunner *self)
 	self->priv = GITG_RUNNER_GET_PRIVATE(self);
 	
 	self->priv->cancellable = g_cancellable_new();
+	self->priv->stdin_fd = -1;
+	self->priv->stdout_fd = -1;
+	
+	self->priv->views = g_array_new(FALSE, FALSE, sizeof(GitgRunnerLine));
+	self->priv->converted = g_ptr_array_new();
+	self->priv->emit_timer = g_timer_new();
+	self->priv->run_timer = g_timer_new();
 }
 
 GitgRunner *
@@ -311,6 +511,7 @@ parse_lines(GitgRunner *runner, gchar *buffer, gssize size)
 	gchar *ptr = buffer;
 	gchar *newline = NULL;
 	gint i = 0;
+	gboolean valid = gitg_utils_validate_utf8(buffer, size);
 
 	free_lines(runner);
 	
@@ -329,6 +530,10 @@ parse_lines(GitgRunner *runner, gchar *buffer, gssize size)
 			runner->priv->lines[i++] = gitg_utils_convert_utf8(buffered, -1);
 			g_free(buffered);
 		}
+		else if (valid)
+		{
+			runner->priv->lines[i++] = g_strndup(ptr, linesize);
+		}
 		else
 		{
 			runner->priv->lines[i++] = gitg_utils_convert_utf8(ptr, linesize);
@@ -352,227 +557,1113 @@ parse_lines(GitgRunner *runner, gchar *buffer, gssize size)
 	
 	runner->priv->lines[i] = NULL;
 
+	++runner->priv->stats.emissions;
+	runner->priv->stats.lines += i;
+	runner->priv->stats.max_lines = MAX(runner->priv->stats.max_lines, (guint)i);
+	runner->priv->stats.max_reads = 1;
+
 	g_signal_emit(runner, runner_signals[UPDATE], 0, runner->priv->lines);
 }
 
+/* Points the pending line views which refer to the line buffer at their
+   new location, after the buffer contents moved from old to new */
 static void
-close_streams(GitgRunner *runner)
+rebase_line_views(GitgRunner *runner, gchar *old, gchar *new, gsize size)
 {
-	if (runner->priv->output_stream)
-	{
-		g_output_stream_close (runner->priv->output_stream, NULL, NULL);
-		g_object_unref(runner->priv->output_stream);
-		runner->priv->output_stream = NULL;
-	}
+	guint i;
 	
-	if (runner->priv->input_stream)
+	for (i = 0; i < runner->priv->views->len; ++i)
 	{
-		g_input_stream_close (runner->priv->input_stream, NULL, NULL);
-		g_object_unref(runner->priv->input_stream);
-		runner->priv->input_stream = NULL;
+		GitgRunnerLine *view = &g_array_index(runner->priv->views, GitgRunnerLine, i);
+		
+		/* Converted lines are separate copies */
+		if (view->line >= old && view->line < old + size)
+			view->line = new + (view->line - old);
 	}
-	
-	g_free(runner->priv->buffer);
-	runner->priv->buffer = NULL;
 }
 
-static gboolean
-run_sync(GitgRunner *runner, gchar const *input, GError **error)
+static gchar *
+line_buffer_prepare(GitgRunner *runner)
 {
-	if (input)
+	GitgRunnerPrivate *priv = runner->priv;
+	
+	/* Lines held back for batching have to stay in the buffer */
+	gsize keep = priv->views->len ? priv->line_pending : priv->line_start;
+	gsize used = priv->line_end - keep;
+	gsize needed = used + priv->buffer_size + 1;
+	
+	/* Move what is kept (the partial line carried over) to the front so
+	   that the next read continues it and every line view stays
+	   contiguous */
+	if (keep != 0)
 	{
-		if (!g_output_stream_write_all(runner->priv->output_stream, input, strlen(input), NULL, NULL, error))
-		{
-			runner_io_exit(runner->priv->pid, 1, runner);
-			close_streams(runner);
+		memmove(priv->line_buffer, priv->line_buffer + keep, used);
+		rebase_line_views(runner, priv->line_buffer + keep, priv->line_buffer, used);
 
-			g_signal_emit(runner, runner_signals[END_LOADING], 0, FALSE);
-			return FALSE;
-		}
-		
-		g_output_stream_close(runner->priv->output_stream, NULL, NULL);
+		priv->line_start -= keep;
+		priv->line_pending = 0;
+		priv->line_end = used;
 	}
 	
-	gsize read = runner->priv->buffer_size;
-
-	while (read == runner->priv->buffer_size)
+	if (needed > priv->line_buffer_size)
 	{
-		if (!g_input_stream_read_all(runner->priv->input_stream, runner->priv->read_buffer, runner->priv->buffer_size, &read, NULL, error))
-		{
-			runner_io_exit(runner->priv->pid, 1, runner);
-			close_streams(runner);
+		gchar *buffer;
 
-			g_signal_emit(runner, runner_signals[END_LOADING], 0, TRUE);
-			return FALSE;
-		}
-		
-		runner->priv->read_buffer[read] = '\0';
-		parse_lines(runner, runner->priv->read_buffer, read);
+		priv->line_buffer_size = MAX(priv->line_buffer_size * 2, needed);
+		buffer = g_malloc(priv->line_buffer_size);
+
+		memcpy(buffer, priv->line_buffer, priv->line_end);
+		rebase_line_views(runner, priv->line_buffer, buffer, priv->line_end);
+
+		g_free(priv->line_buffer);
+		priv->line_buffer = buffer;
 	}
 	
-	gchar *b[] = {runner->priv->buffer, NULL};
-	g_signal_emit(runner, runner_signals[UPDATE], 0, b);
+	return priv->line_buffer + priv->line_end;
+}
 
-	gint status = 0;
-	waitpid(runner->priv->pid, &status, 0);
+static gchar *
+read_buffer_prepare(GitgRunner *runner)
+{
+	if (runner->priv->line_views)
+		return line_buffer_prepare(runner);
+	else
+		return runner->priv->read_buffer;
+}
 
-	runner_io_exit(runner->priv->pid, status, runner);
-	close_streams(runner);
-	
-	g_signal_emit(runner, runner_signals[END_LOADING], 0, FALSE);
+static void
+add_line_view(GitgRunner *runner, gchar *line, gsize length, gboolean valid)
+{
+	GitgRunnerLine view = {line, length};
 	
-	if (status != 0 && error)
-		g_set_error(error, GITG_RUNNER_ERROR, GITG_RUNNER_ERROR_EXIT, "Did not exit without error code");
+	if (!valid && !g_utf8_validate(line, length, NULL))
+	{
+		view.line = gitg_utils_convert_utf8(line, length);
+		view.length = strlen(view.line);
+
+		g_ptr_array_add(runner->priv->converted, view.line);
+	}
 	
-	return status == EXIT_SUCCESS;
+	g_array_append_val(runner->priv->views, view);
+}
+
+static GitgRunnerLine *
+terminate_line_views(GitgRunner *runner)
+{
+	GitgRunnerLine sentinel = {NULL, 0};
+
+	g_array_append_val(runner->priv->views, sentinel);
+	return (GitgRunnerLine *)runner->priv->views->data;
 }
 
 static void
-async_failed(AsyncData *data)
+reset_line_views(GitgRunner *runner)
 {
-	runner_io_exit(data->runner->priv->pid, 1, data->runner);
-	close_streams(data->runner);
+	guint i;
 
-	g_signal_emit(data->runner, runner_signals[END_LOADING], 0, TRUE);
+	g_array_set_size(runner->priv->views, 0);
 
-	async_data_free(data);
+	for (i = 0; i < runner->priv->converted->len; ++i)
+		g_free(g_ptr_array_index(runner->priv->converted, i));
+	
+	g_ptr_array_set_size(runner->priv->converted, 0);
 }
 
-static void start_reading(GitgRunner *runner, AsyncData *data);
+static void
+update_stats(GitgRunner *runner, guint lines, guint reads)
+{
+	GitgRunnerStats *stats = &runner->priv->stats;
+
+	++stats->emissions;
+	stats->lines += lines;
+	stats->max_lines = MAX(stats->max_lines, lines);
+	stats->max_reads = MAX(stats->max_reads, reads);
+}
 
 static void
-read_output_ready(GInputStream *stream, GAsyncResult *result, AsyncData *data)
+emit_line_views(GitgRunner *runner)
 {
-	GError *error = NULL;
+	GitgRunnerPrivate *priv = runner->priv;
+	guint num = priv->views->len;
+	GitgRunnerLine *lines = terminate_line_views(runner);
 	
-	gssize read = g_input_stream_read_finish(stream, result, &error);
-
-	if (g_cancellable_is_cancelled(data->cancellable))
+	if (priv->flush_id)
 	{
-		g_input_stream_close (stream, NULL, NULL);
-		async_data_free(data);
-		
-		if (error)
-			g_error_free(error);
-		return;
+		g_source_remove(priv->flush_id);
+		priv->flush_id = 0;
 	}
+	
+	update_stats(runner, num, priv->pending_reads);
+	priv->pending_reads = 0;
+	
+	g_timer_start(priv->emit_timer);
 
-	if (read == -1)
+	if (runner->priv->parser)
 	{
-		g_input_stream_close (stream, NULL, NULL);
-		async_failed(data);
+		gpointer batch = runner->priv->parser(runner, lines, runner->priv->parser_data);
 		
-		if (error)
-			g_error_free(error);
-		return;
+		if (batch)
+		{
+			g_signal_emit(runner, runner_signals[UPDATE_BATCH], 0, batch);
+			
+			if (runner->priv->free_batch)
+				runner->priv->free_batch(batch);
+		}
 	}
-	
-	if (read == 0)
+	else
 	{
-		/* End */
-		gchar *b[] = {data->runner->priv->buffer, NULL};
-		g_signal_emit(data->runner, runner_signals[UPDATE], 0, b);
-
-		gint status = 0;
-		waitpid(data->runner->priv->pid, &status, 0);
-		
-		runner_io_exit(data->runner->priv->pid, status, data->runner);
-		close_streams(data->runner);
-
-		g_signal_emit(data->runner, runner_signals[END_LOADING], 0, FALSE);
-		
-		async_data_free(data);
+		g_signal_emit(runner, runner_signals[UPDATE_LINES], 0, lines);
 	}
-	else
+	
+	/* Keep a moving average of the time it takes to handle a line */
+	if (num > 0)
 	{
-		data->runner->priv->read_buffer[read] = '\0';
-		parse_lines(data->runner, data->runner->priv->read_buffer, read);
+		gdouble cost = g_timer_elapsed(priv->emit_timer, NULL) / num;
 		
-		if (g_cancellable_is_cancelled(data->cancellable))
-		{
-			g_input_stream_close (stream, NULL, NULL);
-			async_data_free(data);
-			return;
-		}
-
-		start_reading(data->runner, data);
+		priv->line_cost = priv->line_cost > 0 ? priv->line_cost * 0.75 + cost * 0.25 : cost;
 	}
+
+	reset_line_views(runner);
 }
 
 static void
-start_reading(GitgRunner *runner, AsyncData *data)
+collect_line_views(GitgRunner *runner, gssize size)
 {
-	g_input_stream_read_async(runner->priv->input_stream, runner->priv->read_buffer, runner->priv->buffer_size, G_PRIORITY_DEFAULT, runner->priv->cancellable, (GAsyncReadyCallback)read_output_ready, data);
+	GitgRunnerPrivate *priv = runner->priv;
+	
+	/* Only the newly read data needs to be scanned, the carried over
+	   partial line is known not to contain a newline */
+	gchar *start = priv->line_buffer + priv->line_start;
+	gchar *ptr = priv->line_buffer + priv->line_end;
+	gchar *end = ptr + size;
+	gchar *last = end;
+	gchar *newline;
+	gboolean valid;
+	
+	if (priv->views->len == 0)
+		priv->line_pending = priv->line_start;
+	
+	priv->line_end += size;
+	
+	/* Validate all complete lines at once, only when that fails are lines
+	   validated (and converted) one by one */
+	while (last > ptr && *(last - 1) != '\n')
+		--last;
+	
+	valid = gitg_utils_validate_utf8(start, last - start);
+	
+	while ((newline = memchr(ptr, '\n', end - ptr)))
+	{
+		*newline = '\0';
+		add_line_view(runner, start, newline - start, valid);
+		
+		start = ptr = newline + 1;
+	}
+	
+	priv->line_start = start - priv->line_buffer;
 }
 
 static void
-write_input_ready(GOutputStream *stream, GAsyncResult *result, AsyncData *data)
+collect_last_line_view(GitgRunner *runner)
 {
-	GError *error = NULL;
-	g_output_stream_write_finish(stream, result, &error);
+	GitgRunnerPrivate *priv = runner->priv;
 	
-	if (g_cancellable_is_cancelled(data->cancellable))
+	if (priv->line_end > priv->line_start)
 	{
-		if (error)
-			g_error_free(error);
-		
-		async_data_free(data);
+		priv->line_buffer[priv->line_end] = '\0';
+		add_line_view(runner, priv->line_buffer + priv->line_start, priv->line_end - priv->line_start, FALSE);
 	}
 	
-	if (error)
+	priv->line_start = priv->line_end = 0;
+}
+
+static gboolean
+flush_timeout(GitgRunner *runner)
+{
+	runner->priv->flush_id = 0;
+	emit_line_views(runner);
+
+	return FALSE;
+}
+
+static gboolean
+batch_complete(GitgRunner *runner)
+{
+	GitgRunnerPrivate *priv = runner->priv;
+	
+	/* The first rows are shown as soon as possible, after that output is
+	   collected until handling it fills the budget */
+	if (!priv->batch_budget || priv->synchronized || priv->stats.emissions == 0 || priv->line_cost <= 0)
+		return TRUE;
+	
+	return priv->views->len * priv->line_cost * 1000 >= priv->batch_budget;
+}
+
+static void
+parse_line_views(GitgRunner *runner, gssize size)
+{
+	collect_line_views(runner, size);
+	++runner->priv->pending_reads;
+	
+	if (batch_complete(runner))
 	{
-		async_failed(data);
-		g_error_free(error);
+		emit_line_views(runner);
 	}
-	else
+	else if (!runner->priv->flush_id && runner->priv->views->len > 0)
 	{
-		start_reading(data->runner, data);
+		runner->priv->flush_id = g_timeout_add(BATCH_MAX_DELAY, (GSourceFunc)flush_timeout, runner);
 	}
 }
 
-gboolean
-gitg_runner_run_streams(GitgRunner *runner, GInputStream *input_stream, GOutputStream *output_stream, gchar const *input, GError **error)
+static void
+flush_line_views(GitgRunner *runner)
 {
-	gitg_runner_cancel(runner);
-	
-	if (output_stream)
-		runner->priv->output_stream = g_object_ref(output_stream);
-	
-	if (input_stream)
-		runner->priv->input_stream = g_object_ref(input_stream);
+	collect_last_line_view(runner);
+	emit_line_views(runner);
+}
+
+static void
+command_read(GitgRunner *runner, gssize size)
+{
+	if (runner->priv->first_byte < 0)
+		runner->priv->first_byte = g_timer_elapsed(runner->priv->run_timer, NULL);
 	
-	/* Emit begin-loading signal */
-	g_signal_emit(runner, runner_signals[BEGIN_LOADING], 0);
+	runner->priv->bytes += size;
+}
+
+static void
+parse_read(GitgRunner *runner, gssize size)
+{
+	++runner->priv->stats.reads;
+	command_read(runner, size);
 	
-	if (runner->priv->synchronized)
+	if (runner->priv->line_views)
 	{
-		return run_sync(runner, input, error);
+		parse_line_views(runner, size);
 	}
 	else
 	{
-		AsyncData *data = async_data_new(runner, runner->priv->cancellable);
-		
-		if (input)
-		{
-			g_output_stream_write_async(runner->priv->output_stream, input, -1, G_PRIORITY_DEFAULT, runner->priv->cancellable, (GAsyncReadyCallback)write_input_ready, data);
-		}
-		else
-		{
-			start_reading(runner, data);
-		}
+		runner->priv->read_buffer[size] = '\0';
+		parse_lines(runner, runner->priv->read_buffer, size);
 	}
-	return TRUE;
 }
 
-gboolean
-gitg_runner_run_with_arguments(GitgRunner *runner, gchar const **argv, gchar const *wd, gchar const *input, GError **error)
+static void
+parse_end(GitgRunner *runner)
 {
-	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+	if (runner->priv->line_views)
+	{
+		flush_line_views(runner);
+	}
+	else
+	{
+		gchar *b[] = {runner->priv->buffer, NULL};
+		g_signal_emit(runner, runner_signals[UPDATE], 0, b);
+	}
+}
 
-	gint stdout;
+static void
+close_streams(GitgRunner *runner)
+{
+	if (runner->priv->output_stream)
+	{
+		g_output_stream_close (runner->priv->output_stream, NULL, NULL);
+		g_object_unref(runner->priv->output_stream);
+		runner->priv->output_stream = NULL;
+	}
+	
+	if (runner->priv->input_stream)
+	{
+		g_input_stream_close (runner->priv->input_stream, NULL, NULL);
+		g_object_unref(runner->priv->input_stream);
+		runner->priv->input_stream = NULL;
+	}
+	
+	runner->priv->stdin_fd = -1;
+	runner->priv->stdout_fd = -1;
+	
+	g_free(runner->priv->buffer);
+	runner->priv->buffer = NULL;
+	
+	if (runner->priv->flush_id)
+	{
+		g_source_remove(runner->priv->flush_id);
+		runner->priv->flush_id = 0;
+	}
+	
+	/* Drop lines held back when cancelled */
+	reset_line_views(runner);
+	runner->priv->pending_reads = 0;
+	
+	runner->priv->line_start = 0;
+	runner->priv->line_end = 0;
+	runner->priv->line_pending = 0;
+	
+	if (gitg_debug_enabled(GITG_DEBUG_RUNNER) && runner->priv->stats.reads > 0)
+	{
+		GitgRunnerStats *stats = &runner->priv->stats;
+
+		g_message("Runner: %u lines from %u reads in %u updates (max %u lines, %u reads per update)", 
+		          stats->lines, stats->reads, stats->emissions, stats->max_lines, stats->max_reads);
+	}
+}
+
+static gchar *
+command_verb(gchar const **argv)
+{
+	gchar *name = g_path_get_basename(argv[0]);
+	gchar const **ptr;
+	
+	if (strcmp(name, "git") != 0)
+		return name;
+	
+	/* Skip global options, 'git --no-pager log' is accounted as log */
+	for (ptr = argv + 1; *ptr; ++ptr)
+	{
+		if (**ptr != '-')
+		{
+			g_free(name);
+			return g_strdup(*ptr);
+		}
+	}
+	
+	return name;
+}
+
+static void
+command_start(GitgRunner *runner, gchar const **argv)
+{
+	g_free(runner->priv->command);
+	g_free(runner->priv->verb);
+
+	runner->priv->command = g_strjoinv(" ", (gchar **)argv);
+	runner->priv->verb = command_verb(argv);
+	runner->priv->spawn_time = 0;
+	
+	g_timer_start(runner->priv->run_timer);
+}
+
+static void
+command_clear(GitgRunner *runner)
+{
+	g_free(runner->priv->command);
+	runner->priv->command = NULL;
+	
+	g_free(runner->priv->verb);
+	runner->priv->verb = NULL;
+}
+
+static void
+command_end(GitgRunner *runner, gboolean cancelled)
+{
+	GitgRunnerPrivate *priv = runner->priv;
+	CommandStats *stats;
+	gdouble wall_time;
+	
+	if (!priv->verb)
+		return;
+	
+	wall_time = g_timer_elapsed(priv->run_timer, NULL);
+	
+	if (gitg_debug_enabled(GITG_DEBUG_RUNNER_STATS))
+	{
+		g_message("Runner: %s: spawn %.1fms, first byte %.1fms, total %.1fms, %" G_GUINT64_FORMAT " bytes, %u lines, status %d%s",
+		          priv->command,
+		          priv->spawn_time * 1000,
+		          priv->first_byte < 0 ? 0 : priv->first_byte * 1000,
+		          wall_time * 1000,
+		          priv->bytes,
+		          priv->stats.lines,
+		          priv->exit_status,
+		          cancelled ? " (cancelled)" : "");
+	}
+	
+	G_LOCK(command_stats);
+	
+	if (!command_stats)
+		command_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	
+	stats = g_hash_table_lookup(command_stats, priv->verb);
+	
+	if (!stats)
+	{
+		stats = g_slice_new0(CommandStats);
+		g_hash_table_insert(command_stats, g_strdup(priv->verb), stats);
+	}
+	
+	++stats->runs;
+	
+	if (cancelled)
+		++stats->cancelled;
+	else if (priv->exit_status != 0)
+		++stats->failed;
+	
+	if (priv->first_byte >= 0)
+	{
+		++stats->first_byte_runs;
+		stats->first_byte += priv->first_byte;
+	}
+	
+	stats->spawn_time += priv->spawn_time;
+	stats->wall_time += wall_time;
+	stats->max_wall_time = MAX(stats->max_wall_time, wall_time);
+	stats->bytes += priv->bytes;
+	stats->lines += priv->stats.lines;
+	
+	G_UNLOCK(command_stats);
+	
+	command_clear(runner);
+}
+
+/* All runs end here, so that they are accounted for */
+static void
+emit_end_loading(GitgRunner *runner, gboolean cancelled)
+{
+	command_end(runner, cancelled);
+	g_signal_emit(runner, runner_signals[END_LOADING], 0, cancelled);
+}
+
+static void
+set_errno_error(GError **error)
+{
+	gint err = errno;
+	
+	g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err), "%s", g_strerror(err));
+}
+
+static void
+close_input(GitgRunner *runner)
+{
+	g_output_stream_close(runner->priv->output_stream, NULL, NULL);
+	runner->priv->stdin_fd = -1;
+}
+
+/* Writes input to stdin while reading stdout, so that a child which fills
+   its stdout pipe before it has read all of its input does not stall */
+static gboolean
+pump_sync(GitgRunner *runner, GInputStream *input, GError **error)
+{
+	GitgRunnerPrivate *priv = runner->priv;
+	gchar *chunk = g_malloc(INPUT_CHUNK_SIZE);
+	gsize chunk_size = 0;
+	gsize chunk_offset = 0;
+	gboolean writing = TRUE;
+	gboolean ret = TRUE;
+	
+	/* A write must never block, the child might be waiting for us to
+	   read its output */
+	fcntl(priv->stdin_fd, F_SETFL, fcntl(priv->stdin_fd, F_GETFL) | O_NONBLOCK);
+	
+	while (TRUE)
+	{
+		struct pollfd fds[2];
+		gint num = 1;
+		
+		fds[0].fd = priv->stdout_fd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		
+		if (writing)
+		{
+			fds[1].fd = priv->stdin_fd;
+			fds[1].events = POLLOUT;
+			fds[1].revents = 0;
+			
+			++num;
+		}
+		
+		if (poll(fds, num, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			
+			set_errno_error(error);
+			ret = FALSE;
+			break;
+		}
+		
+		if (writing && fds[1].revents)
+		{
+			if (chunk_offset == chunk_size)
+			{
+				gssize size = g_input_stream_read(input, chunk, INPUT_CHUNK_SIZE, NULL, error);
+				
+				if (size < 0)
+				{
+					ret = FALSE;
+					break;
+				}
+				
+				chunk_size = size;
+				chunk_offset = 0;
+			}
+			
+			if (chunk_size == 0)
+			{
+				writing = FALSE;
+			}
+			else
+			{
+				gssize written = write(priv->stdin_fd, chunk + chunk_offset, chunk_size - chunk_offset);
+				
+				/* When the child stopped reading (EPIPE), its exit status
+				   tells why */
+				if (written >= 0)
+					chunk_offset += written;
+				else if (errno != EINTR && errno != EAGAIN)
+					writing = FALSE;
+			}
+			
+			if (!writing)
+				close_input(runner);
+		}
+		
+		if (fds[0].revents)
+		{
+			gssize size = read(priv->stdout_fd, read_buffer_prepare(runner), priv->buffer_size);
+			
+			if (size == 0)
+				break;
+			
+			if (size < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				
+				set_errno_error(error);
+				ret = FALSE;
+				break;
+			}
+			
+			parse_read(runner, size);
+		}
+	}
+	
+	/* A child that closed its stdout early might still wait for input */
+	if (writing)
+		close_input(runner);
+	
+	g_free(chunk);
+	return ret;
+}
+
+static gboolean
+read_sync(GitgRunner *runner, GError **error)
+{
+	gsize read = runner->priv->buffer_size;
+
+	while (read == runner->priv->buffer_size)
+	{
+		gchar *buffer = read_buffer_prepare(runner);
+
+		if (!g_input_stream_read_all(runner->priv->input_stream, buffer, runner->priv->buffer_size, &read, NULL, error))
+			return FALSE;
+		
+		parse_read(runner, read);
+	}
+	
+	return TRUE;
+}
+
+static gboolean
+run_sync(GitgRunner *runner, GInputStream *input, GError **error)
+{
+	gboolean ret;
+	
+	if (input && runner->priv->stdin_fd != -1)
+	{
+		ret = pump_sync(runner, input, error);
+	}
+	else
+	{
+		if (input)
+		{
+			if (g_output_stream_splice(runner->priv->output_stream, input, G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, NULL, error) == -1)
+			{
+				runner_io_exit(runner->priv->pid, 1, runner);
+				close_streams(runner);
+
+				emit_end_loading(runner, FALSE);
+				return FALSE;
+			}
+		}
+		
+		ret = read_sync(runner, error);
+	}
+	
+	if (!ret)
+	{
+		kill_child(runner);
+		runner_io_exit(runner->priv->pid, 1, runner);
+		close_streams(runner);
+
+		emit_end_loading(runner, TRUE);
+		return FALSE;
+	}
+	
+	parse_end(runner);
+
+	gint status = 0;
+	waitpid(runner->priv->pid, &status, 0);
+
+	runner_io_exit(runner->priv->pid, status, runner);
+	close_streams(runner);
+	
+	emit_end_loading(runner, FALSE);
+	
+	if (status != 0 && error)
+		g_set_error(error, GITG_RUNNER_ERROR, GITG_RUNNER_ERROR_EXIT, "Did not exit without error code");
+	
+	return status == EXIT_SUCCESS;
+}
+
+static void
+async_failed(AsyncData *data)
+{
+	kill_child(data->runner);
+	runner_io_exit(data->runner->priv->pid, 1, data->runner);
+	close_streams(data->runner);
+
+	emit_end_loading(data->runner, TRUE);
+
+	async_data_free(data);
+}
+
+static void start_reading(GitgRunner *runner, AsyncData *data);
+
+static void
+read_output_ready(GInputStream *stream, GAsyncResult *result, AsyncData *data)
+{
+	GError *error = NULL;
+	
+	gssize read = g_input_stream_read_finish(stream, result, &error);
+
+	if (g_cancellable_is_cancelled(data->cancellable))
+	{
+		g_input_stream_close (stream, NULL, NULL);
+		async_data_free(data);
+		
+		if (error)
+			g_error_free(error);
+		return;
+	}
+
+	if (read == -1)
+	{
+		g_input_stream_close (stream, NULL, NULL);
+		async_failed(data);
+		
+		if (error)
+			g_error_free(error);
+		return;
+	}
+	
+	if (read == 0)
+	{
+		/* End */
+		parse_end(data->runner);
+
+		gint status = 0;
+		waitpid(data->runner->priv->pid, &status, 0);
+		
+		runner_io_exit(data->runner->priv->pid, status, data->runner);
+		close_streams(data->runner);
+
+		emit_end_loading(data->runner, FALSE);
+		
+		async_data_free(data);
+	}
+	else
+	{
+		parse_read(data->runner, read);
+		
+		if (g_cancellable_is_cancelled(data->cancellable))
+		{
+			g_input_stream_close (stream, NULL, NULL);
+			async_data_free(data);
+			return;
+		}
+
+		start_reading(data->runner, data);
+	}
+}
+
+static void
+start_reading(GitgRunner *runner, AsyncData *data)
+{
+	g_input_stream_read_async(runner->priv->input_stream, read_buffer_prepare(runner), runner->priv->buffer_size, G_PRIORITY_DEFAULT, runner->priv->cancellable, (GAsyncReadyCallback)read_output_ready, data);
+}
+
+static void
+splice_input_ready(GOutputStream *stream, GAsyncResult *result, gpointer userdata)
+{
+	GError *error = NULL;
+	
+	/* Failing to write (e.g. because the child exited early) shows up in
+	   the exit status */
+	if (g_output_stream_splice_finish(stream, result, &error) == -1 && error)
+		g_error_free(error);
+}
+
+/* Writes input to stdin in the background, while the output is read. The
+   splice is not cancellable, it ends (and closes stdin) when the input is
+   exhausted or when the killed child no longer accepts it */
+static void
+splice_input(GitgRunner *runner, GInputStream *input)
+{
+	g_output_stream_splice_async(runner->priv->output_stream,
+	                             input,
+	                             G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+	                             G_PRIORITY_DEFAULT,
+	                             NULL,
+	                             (GAsyncReadyCallback)splice_input_ready,
+	                             NULL);
+}
+
+static ThreadData *
+thread_data_ref(ThreadData *data)
+{
+	g_atomic_int_inc(&data->ref_count);
+	return data;
+}
+
+static void
+thread_batch_free(ThreadData *data, ThreadBatch *item)
+{
+	if (item->batch && data->free_batch)
+		data->free_batch(item->batch);
+	
+	g_slice_free(ThreadBatch, item);
+}
+
+static ThreadBatch *
+thread_take(ThreadData *data)
+{
+	ThreadBatch *items;
+	ThreadBatch *ret = NULL;
+	
+	do
+	{
+		items = g_atomic_pointer_get(&data->queue);
+	} while (!g_atomic_pointer_compare_and_exchange(&data->queue, items, NULL));
+	
+	/* Restore the order in which the batches were pushed */
+	while (items)
+	{
+		ThreadBatch *next = items->next;
+
+		items->next = ret;
+		ret = items;
+		items = next;
+	}
+	
+	return ret;
+}
+
+static void
+thread_data_unref(ThreadData *data)
+{
+	if (!g_atomic_int_dec_and_test(&data->ref_count))
+		return;
+	
+	ThreadBatch *item = thread_take(data);
+	
+	while (item)
+	{
+		ThreadBatch *next = item->next;
+
+		thread_batch_free(data, item);
+		item = next;
+	}
+	
+	while ((item = g_queue_pop_head(data->backlog)))
+		thread_batch_free(data, item);
+	
+	g_queue_free(data->backlog);
+	g_object_unref(data->input_stream);
+	g_object_unref(data->cancellable);
+	
+	g_slice_free(ThreadData, data);
+}
+
+static void
+thread_joined(ThreadData *data)
+{
+	GitgRunnerPrivate *priv = data->runner->priv;
+	
+	if (priv->first_byte < 0)
+		priv->first_byte = data->first_byte;
+	
+	priv->bytes += data->bytes;
+}
+
+static void
+thread_finish(ThreadData *data, gboolean failed)
+{
+	GitgRunner *runner = data->runner;
+	gint status = 1;
+	
+	g_thread_join(data->thread);
+	thread_joined(data);
+	
+	data->detached = TRUE;
+	runner->priv->thread_data = NULL;
+	
+	if (failed)
+		kill_child(runner);
+	else
+		waitpid(runner->priv->pid, &status, 0);
+	
+	runner_io_exit(runner->priv->pid, status, runner);
+	close_streams(runner);
+	
+	thread_data_unref(data);
+	
+	emit_end_loading(runner, failed);
+}
+
+static gboolean
+thread_idle(ThreadData *data)
+{
+	ThreadBatch *item;
+	GTimer *timer;
+
+	/* Anything pushed after taking the queue schedules a new idle */
+	g_atomic_int_set(&data->idle_scheduled, 0);
+	item = thread_take(data);
+	
+	while (item)
+	{
+		ThreadBatch *next = item->next;
+
+		g_queue_push_tail(data->backlog, item);
+		item = next;
+	}
+	
+	timer = g_timer_new();
+	
+	while ((item = g_queue_pop_head(data->backlog)))
+	{
+		if (data->detached)
+		{
+			/* Cancelled, only clean up */
+		}
+		else
+		{
+			data->runner->priv->stats.reads += item->reads;
+			
+			if (item->end)
+			{
+				thread_finish(data, item->failed);
+			}
+			else
+			{
+				update_stats(data->runner, item->lines, item->reads);
+				g_signal_emit(data->runner, runner_signals[UPDATE_BATCH], 0, item->batch);
+			}
+		}
+		
+		thread_batch_free(data, item);
+		
+		/* Leave the rest to the next idle when the budget is used up, so
+		   that the main loop gets to draw in between */
+		if (!data->detached && 
+		    data->runner->priv->batch_budget && 
+		    !g_queue_is_empty(data->backlog) &&
+		    g_timer_elapsed(timer, NULL) * 1000 >= data->runner->priv->batch_budget)
+		{
+			g_timer_destroy(timer);
+			return TRUE;
+		}
+	}
+	
+	g_timer_destroy(timer);
+	return FALSE;
+}
+
+static void
+thread_push(ThreadData *data, gpointer batch, guint lines, guint *reads, gboolean end, gboolean failed)
+{
+	ThreadBatch *item = g_slice_new(ThreadBatch);
+	
+	item->batch = batch;
+	item->end = end;
+	item->failed = failed;
+	item->lines = lines;
+	item->reads = *reads;
+	
+	*reads = 0;
+	
+	do
+	{
+		item->next = g_atomic_pointer_get(&data->queue);
+	} while (!g_atomic_pointer_compare_and_exchange(&data->queue, item->next, item));
+	
+	/* Low priority so that the main loop keeps drawing in between */
+	if (g_atomic_int_compare_and_exchange(&data->idle_scheduled, 0, 1))
+	{
+		g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+		                (GSourceFunc)thread_idle,
+		                thread_data_ref(data),
+		                (GDestroyNotify)thread_data_unref);
+	}
+}
+
+static void
+thread_parse(ThreadData *data, guint *reads)
+{
+	GitgRunner *runner = data->runner;
+	guint lines = runner->priv->views->len;
+	gpointer batch;
+	
+	if (lines == 0)
+		return;
+	
+	batch = data->parser(runner, terminate_line_views(runner), data->parser_data);
+	reset_line_views(runner);
+	
+	if (batch)
+		thread_push(data, batch, lines, reads, FALSE, FALSE);
+}
+
+/* Worker thread: reads the output, splits it into line views and parses
+   them. Only the line buffer of the runner is touched here, the main loop
+   leaves it alone until the thread is joined */
+static gpointer
+thread_read(ThreadData *data)
+{
+	GitgRunner *runner = data->runner;
+	gboolean failed = FALSE;
+	guint reads = 0;
+
+	while (!failed)
+	{
+		gchar *buffer = line_buffer_prepare(runner);
+		gssize read = g_input_stream_read(data->input_stream, buffer, runner->priv->buffer_size, data->cancellable, NULL);
+		
+		if (g_cancellable_is_cancelled(data->cancellable))
+			return NULL;
+		
+		if (read == -1)
+		{
+			failed = TRUE;
+		}
+		else if (read == 0)
+		{
+			collect_last_line_view(runner);
+			thread_parse(data, &reads);
+			break;
+		}
+		else
+		{
+			++reads;
+			
+			if (data->first_byte < 0)
+				data->first_byte = g_timer_elapsed(runner->priv->run_timer, NULL);
+			
+			data->bytes += read;
+
+			collect_line_views(runner, read);
+			thread_parse(data, &reads);
+		}
+	}
+	
+	thread_push(data, NULL, 0, &reads, TRUE, failed);
+	return NULL;
+}
+
+static gboolean
+thread_start(GitgRunner *runner, GError **error)
+{
+	ThreadData *data = g_slice_new0(ThreadData);
+	
+	data->ref_count = 1;
+	data->runner = runner;
+	data->input_stream = g_object_ref(runner->priv->input_stream);
+	data->cancellable = g_object_ref(runner->priv->cancellable);
+	data->backlog = g_queue_new();
+	data->first_byte = -1;
+	
+	data->parser = runner->priv->parser;
+	data->free_batch = runner->priv->free_batch;
+	data->parser_data = runner->priv->parser_data;
+	
+	runner->priv->thread_data = data;
+	data->thread = g_thread_create((GThreadFunc)thread_read, data, TRUE, error);
+	
+	if (!data->thread)
+	{
+		runner->priv->thread_data = NULL;
+		thread_data_unref(data);
+
+		runner_io_exit(runner->priv->pid, 1, runner);
+		close_streams(runner);
+
+		emit_end_loading(runner, TRUE);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+/* Called on cancel, after the process was killed and the cancellable
+   triggered, so the worker returns from its read promptly */
+static void
+thread_stop(GitgRunner *runner)
+{
+	ThreadData *data = runner->priv->thread_data;
+	
+	data->detached = TRUE;
+	g_thread_join(data->thread);
+	thread_joined(data);
+	
+	runner->priv->thread_data = NULL;
+	thread_data_unref(data);
+}
+
+gboolean
+gitg_runner_run_streams(GitgRunner *runner, GInputStream *input_stream, GOutputStream *output_stream, GInputStream *input, GError **error)
+{
+	gitg_runner_cancel(runner);
+	
+	if (output_stream)
+		runner->priv->output_stream = g_object_ref(output_stream);
+	
+	if (input_stream)
+		runner->priv->input_stream = g_object_ref(input_stream);
+	
+	memset(&runner->priv->stats, 0, sizeof(GitgRunnerStats));
+	runner->priv->first_byte = -1;
+	runner->priv->bytes = 0;
+	
+	/* Emit begin-loading signal */
+	g_signal_emit(runner, runner_signals[BEGIN_LOADING], 0);
+	
+	if (runner->priv->synchronized)
+		return run_sync(runner, input, error);
+	
+	if (input)
+		splice_input(runner, input);
+	
+	if (runner->priv->parser)
+		return thread_start(runner, error);
+
+	start_reading(runner, async_data_new(runner, runner->priv->cancellable));
+	return TRUE;
+}
+
+/* Runs argv, writing input to its stdin while the output is read. input
+   is read up to its end, but not closed */
+gboolean
+gitg_runner_run_with_input_stream(GitgRunner *runner, gchar const **argv, gchar const *wd, GInputStream *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+
+	gint stdout;
 	gint stdin;
 
 	gitg_runner_cancel(runner);
+	command_start(runner, argv);
 
 	gboolean ret = g_spawn_async_with_pipes(wd, 
 	                                        (gchar **)argv, 
@@ -591,16 +1682,25 @@ gitg_runner_run_with_arguments(GitgRunner *runner, gchar const **argv, gchar con
 	if (!ret)
 	{
 		runner->priv->pid = 0;
+		command_clear(runner);
+
 		return FALSE;
 	}
 	
+	runner->priv->spawn_time = g_timer_elapsed(runner->priv->run_timer, NULL);
+	
 	GInputStream *input_stream = NULL;
 	GOutputStream *output_stream = NULL;
 
 	if (input)
+	{
 		output_stream = G_OUTPUT_STREAM(g_unix_output_stream_new(stdin, TRUE));
+		runner->priv->stdin_fd = stdin;
+	}
 		
 	input_stream = G_INPUT_STREAM(g_unix_input_stream_new(stdout, TRUE));	
+	runner->priv->stdout_fd = stdout;
+
 	ret = gitg_runner_run_streams(runner, input_stream, output_stream, input, error);
 	
 	if (output_stream)
@@ -612,6 +1712,27 @@ gitg_runner_run_with_arguments(GitgRunner *runner, gchar const **argv, gchar con
 	return ret;
 }
 
+gboolean
+gitg_runner_run_with_arguments(GitgRunner *runner, gchar const **argv, gchar const *wd, gchar const *input, GError **error)
+{
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+	
+	GInputStream *stream = NULL;
+	
+	/* The input is copied when an asynchronous run may outlive it */
+	if (input && runner->priv->synchronized)
+		stream = g_memory_input_stream_new_from_data(input, -1, NULL);
+	else if (input)
+		stream = g_memory_input_stream_new_from_data(g_strdup(input), -1, g_free);
+	
+	gboolean ret = gitg_runner_run_with_input_stream(runner, argv, wd, stream, error);
+	
+	if (stream)
+		g_object_unref(stream);
+	
+	return ret;
+}
+
 gboolean
 gitg_runner_run_working_directory(GitgRunner *runner, gchar const **argv, gchar const *wd, GError **error)
 {
@@ -637,9 +1758,67 @@ gitg_runner_get_buffer_size(GitgRunner *runner)
 	return runner->priv->buffer_size;
 }
 
-static void
-dummy_cb(GPid pid, gint status, gpointer data)
+/* Sets the time in ms that handling a single update may take. Line views
+   are then collected over several reads until handling them is expected to
+   fill the budget (the first update is always emitted right away). With a
+   parser installed, batches are handed to the main loop until the budget
+   is used up. 0 emits an update for every read */
+void
+gitg_runner_set_batch_budget(GitgRunner *runner, guint budget)
+{
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+	
+	runner->priv->batch_budget = budget;
+	g_object_notify(G_OBJECT(runner), "batch-budget");
+}
+
+guint
+gitg_runner_get_batch_budget(GitgRunner *runner)
+{
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), 0);
+	return runner->priv->batch_budget;
+}
+
+void
+gitg_runner_get_stats(GitgRunner *runner, GitgRunnerStats *stats)
+{
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+	g_return_if_fail(stats != NULL);
+	
+	*stats = runner->priv->stats;
+}
+
+/* Installs a parser for the output. On an asynchronous runner, reading and
+   parsing then happen on a worker thread and update-batch is emitted on the
+   main loop for each batch the parser returned. Implies line views */
+void
+gitg_runner_set_parser(GitgRunner *runner, GitgRunnerParser parser, GDestroyNotify free_batch, gpointer userdata)
+{
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+	g_return_if_fail(!gitg_runner_running(runner));
+	
+	runner->priv->parser = parser;
+	runner->priv->free_batch = free_batch;
+	runner->priv->parser_data = userdata;
+	
+	if (parser)
+		runner->priv->line_views = TRUE;
+}
+
+void
+gitg_runner_set_line_views(GitgRunner *runner, gboolean line_views)
+{
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+	g_return_if_fail(!gitg_runner_running(runner));
+	
+	runner->priv->line_views = line_views;
+}
+
+gboolean
+gitg_runner_get_line_views(GitgRunner *runner)
 {
+	g_return_val_if_fail(GITG_IS_RUNNER(runner), FALSE);
+	return runner->priv->line_views;
 }
 
 void
@@ -656,14 +1835,15 @@ gitg_runner_cancel(GitgRunner *runner)
 
 		if (runner->priv->pid)
 		{
-			g_child_watch_add(runner->priv->pid, dummy_cb, NULL);
-			kill(runner->priv->pid, SIGTERM);
-		
+			kill_child(runner);
 			runner_io_exit(runner->priv->pid, EXIT_FAILURE, runner);
 		}
 		
+		if (runner->priv->thread_data)
+			thread_stop(runner);
+		
 		close_streams(runner);
-		g_signal_emit(runner, runner_signals[END_LOADING], 0, TRUE);
+		emit_end_loading(runner, TRUE);
 	}
 }
 
@@ -739,3 +1919,56 @@ gitg_runner_add_environment (GitgRunner *runner, gchar const *key, gchar const *
 	runner->priv->environment[len] = g_strconcat (key, "=", value, NULL);
 	runner->priv->environment[len + 1] = NULL;
 }
+
+static gint
+compare_command_runs(gchar const *a, gchar const *b, GHashTable *table)
+{
+	CommandStats *sa = g_hash_table_lookup(table, a);
+	CommandStats *sb = g_hash_table_lookup(table, b);
+	
+	return sa->runs == sb->runs ? strcmp(a, b) : (sa->runs > sb->runs ? -1 : 1);
+}
+
+/* Prints the accounting of all commands run so far, per git command and
+   ordered by the number of runs. Times are averages in ms, except for max */
+void
+gitg_runner_stats_dump()
+{
+	GList *verbs;
+	GList *item;
+	
+	G_LOCK(command_stats);
+	
+	if (!command_stats)
+	{
+		G_UNLOCK(command_stats);
+		return;
+	}
+	
+	verbs = g_list_sort_with_data(g_hash_table_get_keys(command_stats),
+	                              (GCompareDataFunc)compare_command_runs,
+	                              command_stats);
+	
+	g_printerr("%-16s %6s %6s %6s %8s %8s %8s %8s %10s %10s\n",
+	           "command", "runs", "cancel", "failed", "spawn", "first", "total", "max", "KiB", "lines");
+	
+	for (item = verbs; item; item = g_list_next(item))
+	{
+		CommandStats *stats = g_hash_table_lookup(command_stats, item->data);
+		
+		g_printerr("%-16s %6u %6u %6u %8.1f %8.1f %8.1f %8.1f %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "\n",
+		           (gchar const *)item->data,
+		           stats->runs,
+		           stats->cancelled,
+		           stats->failed,
+		           stats->spawn_time * 1000 / stats->runs,
+		           stats->first_byte_runs ? stats->first_byte * 1000 / stats->first_byte_runs : 0,
+		           stats->wall_time * 1000 / stats->runs,
+		           stats->max_wall_time * 1000,
+		           stats->bytes / 1024,
+		           stats->lines);
+	}
+	
+	G_UNLOCK(command_stats);
+	g_list_free(verbs);
+}
@@ -48,6 +48,34 @@ typedef enum
 	GITG_RUNNER_ERROR_EXIT
 } GitgRunnerError;
 
+/* A view on a single line of output. line points into the runners read
+   buffer (or to a converted copy when the line was not valid UTF-8) and is
+   only valid for the duration of the update-lines signal. Arrays of line
+   views are terminated by a view with line set to NULL */
+typedef struct
+{
+	gchar *line;
+	gsize length;
+} GitgRunnerLine;
+
+/* Statistics on how output was delivered during the last run. An emission
+   is a single update-lines or update-batch signal, which may carry the lines
+   of several reads when batching to a time budget */
+typedef struct
+{
+	guint emissions;
+	guint reads;
+	guint lines;
+	guint max_lines;
+	guint max_reads;
+} GitgRunnerStats;
+
+/* Called for each set of lines read when a parser is installed. On an
+   asynchronous runner this happens on a worker thread, so it must not touch
+   anything owned by the main loop. The returned batch (if not NULL) is
+   passed to update-batch on the main loop and then freed */
+typedef gpointer (*GitgRunnerParser) (GitgRunner *runner, GitgRunnerLine *lines, gpointer userdata);
+
 struct _GitgRunner {
 	GObject parent;
 	
@@ -60,6 +88,8 @@ struct _GitgRunnerClass {
 	/* signals */
 	void (* begin_loading) (GitgRunner *runner);
 	void (* update) (GitgRunner *runner, gchar **buffer);
+	void (* update_lines) (GitgRunner *runner, GitgRunnerLine *lines);
+	void (* update_batch) (GitgRunner *runner, gpointer batch);
 	void (* end_loading) (GitgRunner *runner, gboolean cancelled);
 };
 
@@ -69,9 +99,20 @@ GitgRunner *gitg_runner_new_synchronized(guint buffer_size);
 
 guint gitg_runner_get_buffer_size(GitgRunner *runner);
 
+void gitg_runner_set_line_views(GitgRunner *runner, gboolean line_views);
+gboolean gitg_runner_get_line_views(GitgRunner *runner);
+
+void gitg_runner_set_batch_budget(GitgRunner *runner, guint budget);
+guint gitg_runner_get_batch_budget(GitgRunner *runner);
+
+void gitg_runner_get_stats(GitgRunner *runner, GitgRunnerStats *stats);
+
+void gitg_runner_set_parser(GitgRunner *runner, GitgRunnerParser parser, GDestroyNotify free_batch, gpointer userdata);
+
 gboolean gitg_runner_run_stream(GitgRunner *runner, GInputStream *stream, GError **error);
 
 gboolean gitg_runner_run_with_arguments(GitgRunner *runner, gchar const **argv, gchar const *wd, gchar const *input, GError **error);
+gboolean gitg_runner_run_with_input_stream(GitgRunner *runner, gchar const **argv, gchar const *wd, GInputStream *input, GError **error);
 gboolean gitg_runner_run_working_directory(GitgRunner *runner, gchar const **argv, gchar const *wd, GError **error);
 gboolean gitg_runner_run(GitgRunner *runner, gchar const **argv, GError **error);
 gboolean gitg_runner_running(GitgRunner *runner);
@@ -84,6 +125,8 @@ void gitg_runner_add_environment(GitgRunner *runner, gchar const *key, gchar con
 
 GQuark gitg_runner_error_quark();
 
+void gitg_runner_stats_dump();
+
 G_END_DECLS
 
 #endif /* __GITG_RUNNER_H__ */
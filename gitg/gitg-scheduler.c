@@ -0,0 +1,365 @@
+/*
+ * gitg-scheduler.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-scheduler.h"
+
+#define GITG_SCHEDULER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_SCHEDULER, GitgSchedulerPrivate))
+
+/* Properties */
+enum
+{
+	PROP_0,
+
+	PROP_PATH,
+	PROP_MAX_RUNNING
+};
+
+typedef struct
+{
+	GitgRunner *runner;
+	GitgSchedulerPriority priority;
+	gchar **argv;
+	gchar *input;
+
+	gboolean running;
+	gulong end_id;
+} Job;
+
+struct _GitgSchedulerPrivate
+{
+	gchar *path;
+	guint max_running;
+	guint num_running;
+
+	/* Queued jobs per priority, and all jobs (queued or running) by runner */
+	GQueue *queued[GITG_SCHEDULER_NUM_PRIORITIES];
+	GHashTable *jobs;
+
+	guint dispatch_id;
+};
+
+G_DEFINE_TYPE(GitgScheduler, gitg_scheduler, G_TYPE_OBJECT)
+
+static void on_runner_finalized(GitgScheduler *scheduler, GObject *runner);
+
+static void schedule_dispatch(GitgScheduler *scheduler);
+
+static void
+job_free(Job *job)
+{
+	g_strfreev(job->argv);
+	g_free(job->input);
+
+	g_slice_free(Job, job);
+}
+
+/* Removes job from the scheduler. A running job is cancelled if cancel is
+   TRUE. alive is FALSE when called because the runner was finalized */
+static void
+job_remove(GitgScheduler *scheduler, Job *job, gboolean cancel, gboolean alive)
+{
+	g_hash_table_remove(scheduler->priv->jobs, job->runner);
+
+	if (alive)
+		g_object_weak_unref(G_OBJECT(job->runner), (GWeakNotify)on_runner_finalized, scheduler);
+
+	if (job->running)
+	{
+		/* The slot is free for the next queued job */
+		--scheduler->priv->num_running;
+		schedule_dispatch(scheduler);
+
+		if (alive)
+		{
+			g_signal_handler_disconnect(job->runner, job->end_id);
+
+			/* This emits end-loading, which might schedule new jobs */
+			if (cancel)
+				gitg_runner_cancel(job->runner);
+		}
+	}
+	else
+	{
+		g_queue_remove(scheduler->priv->queued[job->priority], job);
+	}
+
+	job_free(job);
+}
+
+static void
+on_runner_finalized(GitgScheduler *scheduler, GObject *runner)
+{
+	Job *job = g_hash_table_lookup(scheduler->priv->jobs, runner);
+
+	if (job)
+		job_remove(scheduler, job, FALSE, FALSE);
+}
+
+static gboolean dispatch(GitgScheduler *scheduler);
+
+static void
+schedule_dispatch(GitgScheduler *scheduler)
+{
+	/* Jobs are started from an idle, never from within the end-loading
+	   emission of a previous job */
+	if (!scheduler->priv->dispatch_id)
+	{
+		scheduler->priv->dispatch_id = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+		                                               (GSourceFunc)dispatch,
+		                                               scheduler,
+		                                               NULL);
+	}
+}
+
+static void
+on_job_end(GitgRunner *runner, gboolean cancelled, GitgScheduler *scheduler)
+{
+	Job *job = g_hash_table_lookup(scheduler->priv->jobs, runner);
+
+	if (job && job->running)
+	{
+		job_remove(scheduler, job, FALSE, TRUE);
+	}
+}
+
+static void
+job_start(GitgScheduler *scheduler, Job *job)
+{
+	GError *error = NULL;
+	GitgRunner *runner = job->runner;
+
+	job->running = TRUE;
+	++scheduler->priv->num_running;
+
+	job->end_id = g_signal_connect(runner, "end-loading", G_CALLBACK(on_job_end), scheduler);
+
+	/* The job might be finished (synchronized runner) and freed by now */
+	if (!gitg_runner_run_with_arguments(runner, (gchar const **)job->argv, scheduler->priv->path, job->input, &error))
+	{
+		if (error)
+		{
+			g_warning("Could not run git: %s", error->message);
+			g_error_free(error);
+		}
+
+		job = g_hash_table_lookup(scheduler->priv->jobs, runner);
+
+		if (job && job->running && !gitg_runner_running(runner))
+			job_remove(scheduler, job, FALSE, TRUE);
+	}
+}
+
+static gboolean
+dispatch(GitgScheduler *scheduler)
+{
+	GitgSchedulerPriority priority = GITG_SCHEDULER_PRIORITY_FOREGROUND;
+
+	scheduler->priv->dispatch_id = 0;
+
+	while (scheduler->priv->num_running < scheduler->priv->max_running &&
+	       priority < GITG_SCHEDULER_NUM_PRIORITIES)
+	{
+		Job *job = g_queue_pop_head(scheduler->priv->queued[priority]);
+
+		if (!job)
+		{
+			++priority;
+			continue;
+		}
+
+		job_start(scheduler, job);
+	}
+
+	return FALSE;
+}
+
+static void
+gitg_scheduler_finalize(GObject *object)
+{
+	GitgScheduler *scheduler = GITG_SCHEDULER(object);
+	GList *jobs = g_hash_table_get_values(scheduler->priv->jobs);
+	GList *item;
+	gint i;
+
+	/* Runners are owned by their views, leave them running */
+	for (item = jobs; item; item = g_list_next(item))
+		job_remove(scheduler, item->data, FALSE, TRUE);
+
+	g_list_free(jobs);
+
+	/* Removing running jobs schedules a dispatch */
+	if (scheduler->priv->dispatch_id)
+		g_source_remove(scheduler->priv->dispatch_id);
+
+	for (i = 0; i < GITG_SCHEDULER_NUM_PRIORITIES; ++i)
+		g_queue_free(scheduler->priv->queued[i]);
+
+	g_hash_table_destroy(scheduler->priv->jobs);
+	g_free(scheduler->priv->path);
+
+	G_OBJECT_CLASS(gitg_scheduler_parent_class)->finalize(object);
+}
+
+static void
+gitg_scheduler_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GitgScheduler *self = GITG_SCHEDULER(object);
+
+	switch (prop_id)
+	{
+		case PROP_PATH:
+			g_free(self->priv->path);
+			self->priv->path = g_value_dup_string(value);
+		break;
+		case PROP_MAX_RUNNING:
+			self->priv->max_running = g_value_get_uint(value);
+			schedule_dispatch(self);
+		break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gitg_scheduler_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GitgScheduler *self = GITG_SCHEDULER(object);
+
+	switch (prop_id)
+	{
+		case PROP_PATH:
+			g_value_set_string(value, self->priv->path);
+		break;
+		case PROP_MAX_RUNNING:
+			g_value_set_uint(value, self->priv->max_running);
+		break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gitg_scheduler_class_init(GitgSchedulerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	object_class->finalize = gitg_scheduler_finalize;
+	object_class->set_property = gitg_scheduler_set_property;
+	object_class->get_property = gitg_scheduler_get_property;
+
+	g_object_class_install_property(object_class, PROP_PATH,
+					 g_param_spec_string("path",
+							      "PATH",
+							      "The repository path",
+							      NULL,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property(object_class, PROP_MAX_RUNNING,
+					 g_param_spec_uint("max-running",
+							      "MAX RUNNING",
+							      "Maximum number of git processes running at the same time",
+							      1,
+							      G_MAXUINT,
+							      2,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+	g_type_class_add_private(object_class, sizeof(GitgSchedulerPrivate));
+}
+
+static void
+gitg_scheduler_init(GitgScheduler *self)
+{
+	gint i;
+
+	self->priv = GITG_SCHEDULER_GET_PRIVATE(self);
+
+	for (i = 0; i < GITG_SCHEDULER_NUM_PRIORITIES; ++i)
+		self->priv->queued[i] = g_queue_new();
+
+	self->priv->jobs = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+GitgScheduler *
+gitg_scheduler_new(gchar const *path, guint max_running)
+{
+	return GITG_SCHEDULER(g_object_new(GITG_TYPE_SCHEDULER, "path", path, "max-running", max_running, NULL));
+}
+
+/* Schedules 'git argv' to run on runner. A job still queued for runner is
+   dropped, a job running on runner is cancelled */
+void
+gitg_scheduler_run(GitgScheduler *scheduler, GitgRunner *runner, GitgSchedulerPriority priority, gchar const **argv, gchar const *input)
+{
+	g_return_if_fail(GITG_IS_SCHEDULER(scheduler));
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+	g_return_if_fail(priority < GITG_SCHEDULER_NUM_PRIORITIES);
+
+	gitg_scheduler_cancel(scheduler, runner);
+
+	Job *job = g_slice_new0(Job);
+	guint num = g_strv_length((gchar **)argv);
+	guint i;
+
+	job->runner = runner;
+	job->priority = priority;
+	job->input = g_strdup(input);
+	job->argv = g_new0(gchar *, num + 2);
+	job->argv[0] = g_strdup("git");
+
+	for (i = 0; i < num; ++i)
+		job->argv[i + 1] = g_strdup(argv[i]);
+
+	g_object_weak_ref(G_OBJECT(runner), (GWeakNotify)on_runner_finalized, scheduler);
+
+	g_hash_table_insert(scheduler->priv->jobs, runner, job);
+	g_queue_push_tail(scheduler->priv->queued[priority], job);
+
+	schedule_dispatch(scheduler);
+}
+
+/* Drops the job queued for runner, or cancels it when it is running. Also
+   cancels runner when it was not started by the scheduler */
+void
+gitg_scheduler_cancel(GitgScheduler *scheduler, GitgRunner *runner)
+{
+	g_return_if_fail(GITG_IS_SCHEDULER(scheduler));
+	g_return_if_fail(GITG_IS_RUNNER(runner));
+
+	Job *job;
+
+	/* Cancelling emits end-loading, which may schedule again */
+	while ((job = g_hash_table_lookup(scheduler->priv->jobs, runner)))
+		job_remove(scheduler, job, TRUE, TRUE);
+
+	gitg_runner_cancel(runner);
+}
+
+/* Whether a job for runner is queued or running */
+gboolean
+gitg_scheduler_busy(GitgScheduler *scheduler, GitgRunner *runner)
+{
+	g_return_val_if_fail(GITG_IS_SCHEDULER(scheduler), FALSE);
+
+	return g_hash_table_lookup(scheduler->priv->jobs, runner) != NULL || gitg_runner_running(runner);
+}
@@ -0,0 +1,77 @@
+/*
+ * gitg-scheduler.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_SCHEDULER_H__
+#define __GITG_SCHEDULER_H__
+
+#include <glib-object.h>
+
+#include "gitg-runner.h"
+
+G_BEGIN_DECLS
+
+#define GITG_TYPE_SCHEDULER				(gitg_scheduler_get_type ())
+#define GITG_SCHEDULER(obj)				(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_SCHEDULER, GitgScheduler))
+#define GITG_SCHEDULER_CONST(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_SCHEDULER, GitgScheduler const))
+#define GITG_SCHEDULER_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GITG_TYPE_SCHEDULER, GitgSchedulerClass))
+#define GITG_IS_SCHEDULER(obj)			(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GITG_TYPE_SCHEDULER))
+#define GITG_IS_SCHEDULER_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GITG_TYPE_SCHEDULER))
+#define GITG_SCHEDULER_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GITG_TYPE_SCHEDULER, GitgSchedulerClass))
+
+typedef struct _GitgScheduler			GitgScheduler;
+typedef struct _GitgSchedulerClass		GitgSchedulerClass;
+typedef struct _GitgSchedulerPrivate	GitgSchedulerPrivate;
+
+typedef enum
+{
+	GITG_SCHEDULER_PRIORITY_FOREGROUND = 0,
+	GITG_SCHEDULER_PRIORITY_PREFETCH,
+	GITG_SCHEDULER_PRIORITY_BACKGROUND,
+	GITG_SCHEDULER_NUM_PRIORITIES
+} GitgSchedulerPriority;
+
+/* Runs git commands on runners, at most max-running at a time and higher
+   priorities first. A runner has at most one job: scheduling a command on
+   a runner drops a job still queued for it, or cancels the one running */
+struct _GitgScheduler
+{
+	GObject parent;
+
+	GitgSchedulerPrivate *priv;
+};
+
+struct _GitgSchedulerClass
+{
+	GObjectClass parent_class;
+};
+
+GType gitg_scheduler_get_type (void) G_GNUC_CONST;
+
+GitgScheduler *gitg_scheduler_new(gchar const *path, guint max_running);
+
+void gitg_scheduler_run(GitgScheduler *scheduler, GitgRunner *runner, GitgSchedulerPriority priority, gchar const **argv, gchar const *input);
+void gitg_scheduler_cancel(GitgScheduler *scheduler, GitgRunner *runner);
+gboolean gitg_scheduler_busy(GitgScheduler *scheduler, GitgRunner *runner);
+
+G_END_DECLS
+
+#endif /* __GITG_SCHEDULER_H__ */
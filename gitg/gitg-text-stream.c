@@ -0,0 +1,188 @@
+/*
+ * gitg-text-stream.c
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gitg-text-stream.h"
+
+#include <string.h>
+
+#define GITG_TEXT_STREAM_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GITG_TYPE_TEXT_STREAM, GitgTextStreamPrivate))
+
+/* Characters taken from the buffer at a time */
+#define CHUNK_CHARS 4096
+
+typedef struct
+{
+	GtkTextMark *start;
+	GtkTextMark *end;
+} Range;
+
+struct _GitgTextStreamPrivate
+{
+	GtkTextBuffer *buffer;
+	GQueue *ranges;
+
+	GString *chunk;
+	gsize offset;
+};
+
+G_DEFINE_TYPE(GitgTextStream, gitg_text_stream, G_TYPE_INPUT_STREAM)
+
+static void
+range_free(GitgTextStream *stream, Range *range)
+{
+	gtk_text_buffer_delete_mark(stream->priv->buffer, range->start);
+	gtk_text_buffer_delete_mark(stream->priv->buffer, range->end);
+
+	g_slice_free(Range, range);
+}
+
+static void
+free_ranges(GitgTextStream *stream)
+{
+	Range *range;
+
+	while ((range = g_queue_pop_head(stream->priv->ranges)))
+		range_free(stream, range);
+}
+
+/* Takes the next chunk of text out of the buffer, FALSE at the end */
+static gboolean
+next_chunk(GitgTextStream *stream)
+{
+	Range *range = g_queue_peek_head(stream->priv->ranges);
+	GtkTextIter start;
+	GtkTextIter end;
+	GtkTextIter next;
+	gchar *text;
+
+	if (!range)
+		return FALSE;
+
+	gtk_text_buffer_get_iter_at_mark(stream->priv->buffer, &start, range->start);
+	gtk_text_buffer_get_iter_at_mark(stream->priv->buffer, &end, range->end);
+
+	next = start;
+
+	if (!gtk_text_iter_forward_chars(&next, CHUNK_CHARS) || gtk_text_iter_compare(&next, &end) >= 0)
+	{
+		next = end;
+		range_free(stream, g_queue_pop_head(stream->priv->ranges));
+	}
+	else
+	{
+		gtk_text_buffer_move_mark(stream->priv->buffer, range->start, &next);
+	}
+
+	text = gtk_text_buffer_get_text(stream->priv->buffer, &start, &next, FALSE);
+
+	g_string_assign(stream->priv->chunk, text);
+	stream->priv->offset = 0;
+
+	g_free(text);
+	return TRUE;
+}
+
+static gssize
+gitg_text_stream_read(GInputStream *stream, void *buffer, gsize count, GCancellable *cancellable, GError **error)
+{
+	GitgTextStream *self = GITG_TEXT_STREAM(stream);
+	gsize num;
+
+	while (self->priv->offset == self->priv->chunk->len)
+	{
+		if (!next_chunk(self))
+			return 0;
+	}
+
+	num = MIN(count, self->priv->chunk->len - self->priv->offset);
+	memcpy(buffer, self->priv->chunk->str + self->priv->offset, num);
+
+	self->priv->offset += num;
+	return num;
+}
+
+static gboolean
+gitg_text_stream_close(GInputStream *stream, GCancellable *cancellable, GError **error)
+{
+	free_ranges(GITG_TEXT_STREAM(stream));
+	return TRUE;
+}
+
+static void
+gitg_text_stream_finalize(GObject *object)
+{
+	GitgTextStream *self = GITG_TEXT_STREAM(object);
+
+	free_ranges(self);
+	g_queue_free(self->priv->ranges);
+
+	g_string_free(self->priv->chunk, TRUE);
+	g_object_unref(self->priv->buffer);
+
+	G_OBJECT_CLASS(gitg_text_stream_parent_class)->finalize(object);
+}
+
+static void
+gitg_text_stream_class_init(GitgTextStreamClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+	GInputStreamClass *stream_class = G_INPUT_STREAM_CLASS(klass);
+
+	object_class->finalize = gitg_text_stream_finalize;
+
+	stream_class->read_fn = gitg_text_stream_read;
+	stream_class->close_fn = gitg_text_stream_close;
+
+	g_type_class_add_private(object_class, sizeof(GitgTextStreamPrivate));
+}
+
+static void
+gitg_text_stream_init(GitgTextStream *self)
+{
+	self->priv = GITG_TEXT_STREAM_GET_PRIVATE(self);
+
+	self->priv->ranges = g_queue_new();
+	self->priv->chunk = g_string_new("");
+}
+
+GitgTextStream *
+gitg_text_stream_new(GtkTextBuffer *buffer)
+{
+	GitgTextStream *stream = GITG_TEXT_STREAM(g_object_new(GITG_TYPE_TEXT_STREAM, NULL));
+
+	stream->priv->buffer = g_object_ref(buffer);
+	return stream;
+}
+
+/* Appends the text between start and end to what the stream reads */
+void
+gitg_text_stream_add_range(GitgTextStream *stream, GtkTextIter const *start, GtkTextIter const *end)
+{
+	g_return_if_fail(GITG_IS_TEXT_STREAM(stream));
+
+	Range *range = g_slice_new(Range);
+
+	range->start = gtk_text_buffer_create_mark(stream->priv->buffer, NULL, start, TRUE);
+	range->end = gtk_text_buffer_create_mark(stream->priv->buffer, NULL, end, FALSE);
+
+	g_queue_push_tail(stream->priv->ranges, range);
+}
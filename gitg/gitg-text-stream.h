@@ -0,0 +1,66 @@
+/*
+ * gitg-text-stream.h
+ * This file is part of gitg - git repository viewer
+ *
+ * Copyright (C) 2009 - Jesse van den Kieboom
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GITG_TEXT_STREAM_H__
+#define __GITG_TEXT_STREAM_H__
+
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GITG_TYPE_TEXT_STREAM				(gitg_text_stream_get_type ())
+#define GITG_TEXT_STREAM(obj)				(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_TEXT_STREAM, GitgTextStream))
+#define GITG_TEXT_STREAM_CONST(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GITG_TYPE_TEXT_STREAM, GitgTextStream const))
+#define GITG_TEXT_STREAM_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GITG_TYPE_TEXT_STREAM, GitgTextStreamClass))
+#define GITG_IS_TEXT_STREAM(obj)			(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GITG_TYPE_TEXT_STREAM))
+#define GITG_IS_TEXT_STREAM_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GITG_TYPE_TEXT_STREAM))
+#define GITG_TEXT_STREAM_GET_CLASS(obj)		(G_TYPE_INSTANCE_GET_CLASS ((obj), GITG_TYPE_TEXT_STREAM, GitgTextStreamClass))
+
+typedef struct _GitgTextStream			GitgTextStream;
+typedef struct _GitgTextStreamClass		GitgTextStreamClass;
+typedef struct _GitgTextStreamPrivate	GitgTextStreamPrivate;
+
+/* Reads ranges of a text buffer, a chunk at a time, so the text does not
+   have to be copied out of the buffer as a whole. The ranges are tracked
+   with marks. Like the buffer itself, only to be read from the main loop,
+   which is what synchronized runners do */
+struct _GitgTextStream
+{
+	GInputStream parent;
+
+	GitgTextStreamPrivate *priv;
+};
+
+struct _GitgTextStreamClass
+{
+	GInputStreamClass parent_class;
+};
+
+GType gitg_text_stream_get_type (void) G_GNUC_CONST;
+
+GitgTextStream *gitg_text_stream_new(GtkTextBuffer *buffer);
+void gitg_text_stream_add_range(GitgTextStream *stream, GtkTextIter const *start, GtkTextIter const *end);
+
+G_END_DECLS
+
+#endif /* __GITG_TEXT_STREAM_H__ */
@@ -22,7 +22,9 @@
 
 #include <string.h>
 #include <glib.h>
+#include <glib/gi18n.h>
 #include <stdlib.h>
+#include <time.h>
 #include <gconf/gconf-client.h>
 
 #include "gitg-utils.h"
@@ -233,6 +235,70 @@ gitg_utils_convert_utf8(gchar const *str, gssize size)
 	return convert_fallback(str, size, "?");
 }
 
+#define ASCII_MASK G_GUINT64_CONSTANT(0x8080808080808080)
+
+/* Validates a whole chunk of output at once. Git output is mostly plain
+   ASCII, so it is checked a word at a time and only characters that have
+   the high bit set are validated by glib */
+gboolean
+gitg_utils_validate_utf8(gchar const *str, gsize size)
+{
+	gchar const *end = str + size;
+	
+	while (str < end)
+	{
+		guint64 word;
+		
+		if ((gsize)(end - str) >= sizeof(guint64))
+		{
+			memcpy(&word, str, sizeof(guint64));
+			
+			if (!(word & ASCII_MASK))
+			{
+				str += sizeof(guint64);
+				continue;
+			}
+		}
+		
+		if (!(*str & 0x80))
+		{
+			++str;
+			continue;
+		}
+		
+		gsize skip = g_utf8_skip[*(guchar *)str];
+		
+		if (skip > (gsize)(end - str) || !g_utf8_validate(str, skip, NULL))
+			return FALSE;
+		
+		str += skip;
+	}
+	
+	return TRUE;
+}
+
+/* Splits str in place on any of the characters in delimiters, without
+   allocating. At most max_parts pointers are stored in parts, the last one
+   holding the remainder of the string. Returns the number of parts */
+guint
+gitg_utils_split_inplace(gchar *str, gchar const *delimiters, gchar **parts, guint max_parts)
+{
+	guint num = 0;
+	
+	if (max_parts == 0)
+		return 0;
+	
+	parts[num++] = str;
+	
+	while (num < max_parts && (str = strpbrk(str, delimiters)) != NULL)
+	{
+		*str++ = '\0';
+		parts[num++] = str;
+	}
+	
+	return num;
+}
+
 guint
 gitg_utils_hash_hash(gconstpointer v)
 {
@@ -466,14 +532,46 @@ gchar *
 gitg_utils_timestamp_to_str(guint64 timestamp)
 {
 	time_t t = timestamp;
-
-	struct tm *tms = localtime(&t);
+	struct tm tms;
 	gchar buf[255];
 	
-	strftime(buf, 254, "%c", tms);
+	localtime_r(&t, &tms);
+	
+	strftime(buf, 254, "%c", &tms);
 	return gitg_utils_convert_utf8(buf, -1);
 }
 
+/* Falls back to the full date for commits older than a week */
+gchar *
+gitg_utils_timestamp_to_relative_str(guint64 timestamp, guint64 now)
+{
+	gint64 diff = (gint64)now - (gint64)timestamp;
+	gint num;
+	
+	if (diff < 60)
+		return g_strdup(_("Just now"));
+	
+	if (diff < 60 * 60)
+	{
+		num = diff / 60;
+		return g_strdup_printf(ngettext("%d minute ago", "%d minutes ago", num), num);
+	}
+	
+	if (diff < 24 * 60 * 60)
+	{
+		num = diff / (60 * 60);
+		return g_strdup_printf(ngettext("%d hour ago", "%d hours ago", num), num);
+	}
+	
+	if (diff < 7 * 24 * 60 * 60)
+	{
+		num = diff / (24 * 60 * 60);
+		return g_strdup_printf(ngettext("%d day ago", "%d days ago", num), num);
+	}
+	
+	return gitg_utils_timestamp_to_str(timestamp);
+}
+
 GtkCellRenderer *
 gitg_utils_find_cell_at_pos (GtkTreeView *tree_view, GtkTreeViewColumn *column, GtkTreePath *path, gint x)
 {
@@ -43,6 +43,8 @@ gboolean gitg_utils_export_files(GitgRepository *repository, GitgRevision *revis
 gchar const *todir, gchar * const *paths);
 
 gchar *gitg_utils_convert_utf8(gchar const *str, gssize size);
+gboolean gitg_utils_validate_utf8(gchar const *str, gsize size);
+guint gitg_utils_split_inplace(gchar *str, gchar const *delimiters, gchar **parts, guint max_parts);
 
 guint gitg_utils_hash_hash(gconstpointer v);
 gboolean gitg_utils_hash_equal(gconstpointer a, gconstpointer b);
@@ -62,6 +64,7 @@ gchar *gitg_utils_get_monospace_font_name();
 void gitg_utils_set_monospace_font(GtkWidget *widget);
 
 gchar *gitg_utils_timestamp_to_str(guint64 timestamp);
+gchar *gitg_utils_timestamp_to_relative_str(guint64 timestamp, guint64 now);
 
 GtkBuilder *gitg_utils_new_builder(gchar const *filename);
 GtkCellRenderer *gitg_utils_find_cell_at_pos (GtkTreeView *tree_view, GtkTreeViewColumn *column, GtkTreePath *path, gint x);
@@ -23,6 +23,7 @@
 #include <gdk/gdkkeysyms.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <glib/gi18n.h>
 
 #include "sexy-icon-entry.h"
@@ -44,6 +45,7 @@
 #include "gitg-branch-actions.h"
 #include "gitg-preferences.h"
 #include "gitg-config.h"
+#include "gitg-date-cache.h"
 
 #define DYNAMIC_ACTION_DATA_KEY "GitgDynamicActionDataKey"
 #define DYNAMIC_ACTION_DATA_REMOTE_KEY "GitgDynamicActionDataRemoteKey"
@@ -86,6 +88,12 @@ struct _GitgWindowPrivate
 
 	GitgCellRendererPath *renderer_path;
 	
+	/* Relative dates, only while the preference is set */
+	GtkTreeViewColumn *column_date;
+	GtkCellRenderer *renderer_date;
+	GitgDateCache *date_cache;
+	guint date_timeout_id;
+	
 	GTimer *load_timer;
 	GdkCursor *hand;
 	
@@ -95,6 +103,10 @@ struct _GitgWindowPrivate
 	GitgRef *popup_refs[2];
 	
 	GList *branch_actions;
+	
+	/* View state saved while the history is detached for a bulk insert */
+	GList *bulk_selection;
+	GtkTreePath *bulk_top;
 };
 
 static gboolean on_tree_view_motion(GtkTreeView *treeview, GdkEventMotion *event, GitgWindow *window);
@@ -141,6 +153,11 @@ gitg_window_finalize(GObject *object)
 	g_timer_destroy(self->priv->load_timer);
 	gdk_cursor_unref(self->priv->hand);
 	
+	if (self->priv->date_timeout_id)
+		g_source_remove(self->priv->date_timeout_id);
+	
+	gitg_date_cache_free(self->priv->date_cache);
+	
 	GList *copy = g_list_copy (self->priv->branch_actions);
 	GList *item;
 	
@@ -245,6 +262,17 @@ search_equal_func(GtkTreeModel *model, gint column, gchar const *key, GtkTreeIte
 	return ret;
 }
 
+/* Subjects and authors are loaded for the rows which are shown, searching
+   them needs them all */
+static void
+on_search_changed(GtkEditable *editable, GitgWindow *window)
+{
+	gint column = gtk_tree_view_get_search_column(window->priv->tree_view);
+	
+	if (window->priv->repository && (column == 1 || column == 2))
+		gitg_repository_load_details(window->priv->repository);
+}
+
 static void
 focus_search(GtkAccelGroup *group, GObject *acceleratable, guint keyval, GdkModifierType modifier, gpointer userdata)
 {
@@ -260,6 +288,8 @@ build_search_entry(GitgWindow *window, GtkBuilder *builder)
 	GtkImage *image = GTK_IMAGE(gtk_image_new_from_stock(GTK_STOCK_FIND, GTK_ICON_SIZE_MENU));
 	sexy_icon_entry_set_icon(SEXY_ICON_ENTRY(entry), SEXY_ICON_ENTRY_PRIMARY, image);
 	
+	/* Before the tree view searches */
+	g_signal_connect(entry, "changed", G_CALLBACK(on_search_changed), window);
 	gtk_tree_view_set_search_entry(window->priv->tree_view, GTK_ENTRY(entry));
 	gtk_widget_show(entry);
 	gtk_box_pack_end(GTK_BOX(box), entry, FALSE, FALSE, 0);
@@ -305,49 +335,24 @@ static void
 on_renderer_path(GtkTreeViewColumn *column, GitgCellRendererPath *renderer, GtkTreeModel *model, GtkTreeIter *iter, GitgWindow *window)
 {
 	GitgRevision *rv;
+	GitgRevision *next_revision;
+	GitgDecoration *decoration;
 	
-	gtk_tree_model_get(model, iter, 0, &rv, -1);
-	GtkTreeIter iter1 = *iter;
-	
-	GitgRevision *next_revision = NULL;
-	
-	if (gtk_tree_model_iter_next(model, &iter1))
-		gtk_tree_model_get(model, &iter1, 0, &next_revision, -1);
+	if (!gitg_repository_get_row(GITG_REPOSITORY(model), iter, &rv, &next_revision, &decoration))
+		return;
 	
-	GSList *labels;
-	const gchar *lbl = NULL;
-
 	switch (gitg_revision_get_sign(rv))
 	{
 		case 't':
-			lbl = "staged";
-		break;
 		case 'u':
-			lbl = "unstaged";
+			g_object_set(renderer, "style", PANGO_STYLE_ITALIC, NULL);
 		break;
 		default:
+			g_object_set(renderer, "style", PANGO_STYLE_NORMAL, NULL);
 		break;
 	}
 	
-	if (lbl != NULL)
-	{
-		g_object_set(renderer, "style", PANGO_STYLE_ITALIC, NULL);
-		labels = g_slist_append(NULL, gitg_ref_new(gitg_revision_get_hash(rv), lbl));
-	}
-	else
-	{
-		g_object_set(renderer, "style", PANGO_STYLE_NORMAL, NULL);
-		labels = gitg_repository_get_refs_for_hash(GITG_REPOSITORY(model), gitg_revision_get_hash(rv));
-	}
-
-	g_object_set(renderer, 
-	             "revision", rv, 
-	             "next_revision", next_revision, 
-	             "labels", labels,
-	             NULL);
-
-	gitg_revision_unref(next_revision);
-	gitg_revision_unref(rv);
+	gitg_cell_renderer_path_set_row(renderer, rv, next_revision, decoration);
 }
 
 static gboolean
@@ -556,6 +561,87 @@ on_refs_dnd (GitgRef *source, GitgRef *dest, gboolean dropped, GitgWindow *windo
 	return ret;
 }
 
+static void
+on_renderer_date(GtkTreeViewColumn *column, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, GitgWindow *window)
+{
+	GitgRevision *rv;
+	
+	gtk_tree_model_get(model, iter, 0, &rv, -1);
+	
+	/* Until the details are in, the timestamp is the committer time */
+	g_object_set(renderer, 
+	             "text", gitg_revision_has_details(rv) ? gitg_date_cache_lookup(window->priv->date_cache, gitg_revision_get_timestamp(rv)) : "", 
+	             NULL);
+	
+	gitg_revision_unref(rv);
+}
+
+/* Relative dates are formatted against the time of the last minute, the
+   rows are only drawn again once that changes */
+static gboolean
+on_date_timeout(GitgWindow *window)
+{
+	gitg_date_cache_set_now(window->priv->date_cache, time(NULL));
+	gtk_widget_queue_draw(GTK_WIDGET(window->priv->tree_view));
+	
+	return TRUE;
+}
+
+static void
+update_relative_dates(GitgWindow *window)
+{
+	gboolean relative;
+	
+	g_object_get(gitg_preferences_get_default(), "history-relative-dates", &relative, NULL);
+	
+	if (relative == (window->priv->date_cache != NULL))
+		return;
+	
+	if (relative)
+	{
+		window->priv->date_cache = gitg_date_cache_new(TRUE);
+		window->priv->date_timeout_id = g_timeout_add_seconds(60, (GSourceFunc)on_date_timeout, window);
+		
+		gtk_tree_view_column_clear_attributes(window->priv->column_date, window->priv->renderer_date);
+		gtk_tree_view_column_set_cell_data_func(window->priv->column_date, window->priv->renderer_date, (GtkTreeCellDataFunc)on_renderer_date, window, NULL);
+	}
+	else
+	{
+		g_source_remove(window->priv->date_timeout_id);
+		window->priv->date_timeout_id = 0;
+		
+		gtk_tree_view_column_set_cell_data_func(window->priv->column_date, window->priv->renderer_date, NULL, NULL, NULL);
+		gtk_tree_view_column_add_attribute(window->priv->column_date, window->priv->renderer_date, "text", 3);
+		
+		gitg_date_cache_free(window->priv->date_cache);
+		window->priv->date_cache = NULL;
+	}
+	
+	gtk_widget_queue_draw(GTK_WIDGET(window->priv->tree_view));
+}
+
+/* Tells the repository which rows to announce when their lanes change */
+static void
+update_visible_range(GitgWindow *window)
+{
+	GtkTreeModel *model = gtk_tree_view_get_model(window->priv->tree_view);
+	GtkTreePath *start;
+	GtkTreePath *end;
+	
+	if (!model || !GITG_IS_REPOSITORY(model))
+		return;
+	
+	if (!gtk_tree_view_get_visible_range(window->priv->tree_view, &start, &end))
+		return;
+	
+	gitg_repository_set_visible_range(GITG_REPOSITORY(model), 
+	                                  gtk_tree_path_get_indices(start)[0], 
+	                                  gtk_tree_path_get_indices(end)[0]);
+	
+	gtk_tree_path_free(start);
+	gtk_tree_path_free(end);
+}
+
 static void
 init_tree_view (GitgWindow *window, GtkBuilder *builder)
 {
@@ -565,6 +651,29 @@ init_tree_view (GitgWindow *window, GtkBuilder *builder)
 
 	gtk_tree_view_column_set_cell_data_func(col, GTK_CELL_RENDERER(window->priv->renderer_path), (GtkTreeCellDataFunc)on_renderer_path, window, NULL);
 	
+	window->priv->column_date = GTK_TREE_VIEW_COLUMN(gtk_builder_get_object(builder, "rv_column3"));
+	window->priv->renderer_date = GTK_CELL_RENDERER(gtk_builder_get_object(builder, "rv_renderer_date"));
+	
+	update_relative_dates(window);
+	
+	g_signal_connect_object(gitg_preferences_get_default(), 
+	                        "notify::history-relative-dates", 
+	                        G_CALLBACK(update_relative_dates), 
+	                        window, 
+	                        G_CONNECT_SWAPPED);
+	
+	g_signal_connect_swapped(gtk_tree_view_get_vadjustment(window->priv->tree_view), 
+	                         "value-changed", 
+	                         G_CALLBACK(update_visible_range), 
+	                         window);
+	
+	g_signal_connect_data(window->priv->tree_view, 
+	                      "size-allocate", 
+	                      G_CALLBACK(update_visible_range), 
+	                      window, 
+	                      NULL, 
+	                      G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+	
 	gitg_dnd_enable (window->priv->tree_view, (GitgDndCallback)on_refs_dnd, window);
 }
 
@@ -789,7 +898,7 @@ on_end_loading(GitgRunner *loader, gboolean cancelled, GitgWindow *window)
 }
 
 static void
-on_update(GitgRunner *loader, gchar **revisions, GitgWindow *window)
+on_update(GitgRunner *loader, gpointer batch, GitgWindow *window)
 {
 	gchar *msg = g_strdup_printf(_("Loading %d revisions..."), gtk_tree_model_iter_n_children(GTK_TREE_MODEL(window->priv->repository), NULL));
 
@@ -1047,6 +1156,60 @@ on_repository_load(GitgRepository *repository, GitgWindow *window)
 	update_window_title (window);
 }
 
+static void
+on_repository_begin_bulk_insert(GitgRepository *repository, GitgWindow *window)
+{
+	if (window->priv->destroy_has_run)
+		return;
+
+	GtkTreeSelection *selection = gtk_tree_view_get_selection(window->priv->tree_view);
+	GtkTreePath *end = NULL;
+	
+	/* Rows are only appended, so paths stay valid */
+	window->priv->bulk_selection = gtk_tree_selection_get_selected_rows(selection, NULL);
+	
+	if (gtk_tree_view_get_visible_range(window->priv->tree_view, &window->priv->bulk_top, &end))
+		gtk_tree_path_free(end);
+	
+	/* Detaching clears the selection, the revision view keeps showing it */
+	g_signal_handlers_block_by_func(selection, on_selection_changed, window);
+	gtk_tree_view_set_model(window->priv->tree_view, NULL);
+}
+
+static void
+on_repository_end_bulk_insert(GitgRepository *repository, GitgWindow *window)
+{
+	if (!window->priv->destroy_has_run)
+	{
+		GtkTreeSelection *selection = gtk_tree_view_get_selection(window->priv->tree_view);
+		GList *item;
+	
+		gtk_tree_view_set_model(window->priv->tree_view, GTK_TREE_MODEL(repository));
+	
+		for (item = window->priv->bulk_selection; item; item = g_list_next(item))
+		{
+			gtk_tree_selection_select_path(selection, (GtkTreePath *)item->data);
+		}
+	
+		g_signal_handlers_unblock_by_func(selection, on_selection_changed, window);
+	
+		if (window->priv->bulk_top)
+		{
+			gtk_tree_view_scroll_to_cell(window->priv->tree_view, window->priv->bulk_top, NULL, TRUE, 0, 0);
+		}
+	}
+	
+	if (window->priv->bulk_top)
+	{
+		gtk_tree_path_free(window->priv->bulk_top);
+		window->priv->bulk_top = NULL;
+	}
+	
+	g_list_foreach(window->priv->bulk_selection, (GFunc)gtk_tree_path_free, NULL);
+	g_list_free(window->priv->bulk_selection);
+	window->priv->bulk_selection = NULL;
+}
+
 static void
 add_recent_item(GitgWindow *window)
 {
@@ -1078,6 +1241,8 @@ load_repository(GitgWindow *window, gchar const *path, gint argc, gchar const **
 	{
 		gtk_tree_view_set_model(window->priv->tree_view, NULL);
 		g_signal_handlers_disconnect_by_func(window->priv->repository, G_CALLBACK(on_repository_load), window);
+		g_signal_handlers_disconnect_by_func(window->priv->repository, G_CALLBACK(on_repository_begin_bulk_insert), window);
+		g_signal_handlers_disconnect_by_func(window->priv->repository, G_CALLBACK(on_repository_end_bulk_insert), window);
 
 		g_object_unref(window->priv->repository);
 		window->priv->repository = NULL;
@@ -1094,7 +1259,7 @@ load_repository(GitgWindow *window, gchar const *path, gint argc, gchar const **
 	
 		g_signal_connect(loader, "begin-loading", G_CALLBACK(on_begin_loading), window);
 		g_signal_connect(loader, "end-loading", G_CALLBACK(on_end_loading), window);
-		g_signal_connect(loader, "update", G_CALLBACK(on_update), window);
+		g_signal_connect(loader, "update-batch", G_CALLBACK(on_update), window);
 		
 		g_object_unref(loader);
 		
@@ -1112,6 +1277,8 @@ load_repository(GitgWindow *window, gchar const *path, gint argc, gchar const **
 		}
 
 		g_signal_connect(window->priv->repository, "load", G_CALLBACK(on_repository_load), window);
+		g_signal_connect(window->priv->repository, "begin-bulk-insert", G_CALLBACK(on_repository_begin_bulk_insert), window);
+		g_signal_connect(window->priv->repository, "end-bulk-insert", G_CALLBACK(on_repository_end_bulk_insert), window);
 		clear_branches_combo(window);
 		
 		gitg_repository_load(window->priv->repository, argc, ar, NULL);
@@ -1384,14 +1551,14 @@ find_lane_boundary(GitgWindow *window, GtkTreePath *path, gint cell_x, gchar con
 	g_object_get(window->priv->renderer_path, "lane-width", &width, NULL);
 	guint laneidx = cell_x / width;
 	
-	GSList *lanes = gitg_revision_get_lanes(revision);
-	GitgLane *lane = (GitgLane *)g_slist_nth_data(lanes, laneidx);
+	GitgLaneRow *lanes = gitg_revision_get_lanes(revision);
+	GitgLane *lane = gitg_lane_row_get(lanes, laneidx);
 	gboolean ret;
 
 	if (lane && GITG_IS_LANE_BOUNDARY(lane))
 	{
 		if (hash)
-			*hash = ((GitgLaneBoundary *)lane)->hash;
+			*hash = gitg_lane_row_get_hash(lanes, lane);
 
 		ret = TRUE;
 	}
@@ -25,6 +25,7 @@
 #include <glib/gi18n.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <gtksourceview/gtksourcelanguagemanager.h>
 #include <gtksourceview/gtksourcestyleschememanager.h>
 
@@ -35,6 +36,7 @@
 #include "gitg-settings.h"
 #include "gitg-dirs.h"
 #include "gitg-utils.h"
+#include "gitg-runner.h"
 
 static gboolean commit_mode = FALSE;
 
@@ -167,6 +169,10 @@ main(int argc, char **argv)
 {
 	g_thread_init(NULL);
 	
+	/* Writing to a git process that died (e.g. a long running cat-file)
+	   should fail with EPIPE instead of killing gitg */
+	signal(SIGPIPE, SIG_IGN);
+	
 	gitg_debug_init();
 
 	bindtextdomain(GETTEXT_PACKAGE, GITG_LOCALEDIR);
@@ -195,6 +201,9 @@ main(int argc, char **argv)
 		gitg_window_show_commit(window);
 	
 	gtk_main();
+	
+	if (gitg_debug_enabled(GITG_DEBUG_RUNNER_STATS))
+		gitg_runner_stats_dump();
 
 	/* Finalize settings */
 	g_object_unref(settings);	